@@ -87,6 +87,7 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend class uring_diskmgr_t;
     pool_diskmgr_t *parent;
 
     bool is_read;
@@ -103,6 +104,13 @@ private:
 
     int64_t io_result;
 
+    // Used by uring_diskmgr_t, which runs an action in stages: a datasync (if
+    // `wrap_in_datasyncs` is set), the transfer, and another datasync.  These are the
+    // stage we're in and the number of its completions we're still waiting for.
+    enum uring_stage_t { URING_SYNC_BEFORE, URING_TRANSFER, URING_SYNC_AFTER };
+    uring_stage_t uring_stage;
+    size_t uring_completions_left;
+
     void run();
     void done();
 
@@ -0,0 +1,422 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#if USE_IO_URING
+
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Upper bound on the number of ring entries we ask for, to keep the locked memory
+// used by the rings small even if somebody asks for a huge queue depth.
+#define MAX_URING_ENTRIES 4096
+
+// How long to wait before trying a submission again after the kernel said it was short
+// on resources, if nothing we have in flight is going to wake us up sooner.
+#define URING_SUBMIT_RETRY_MS 1
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+unsigned load_acquire(const unsigned *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned *p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+unsigned ring_entries_for_queue_depth(int queue_depth) {
+    // Most actions take one entry; writev()s of more than IOV_MAX buffers take more.
+    unsigned wanted = std::min<unsigned>(MAX_URING_ENTRIES, queue_depth * 2);
+    unsigned entries = 1;
+    while (entries < wanted) {
+        entries *= 2;
+    }
+    return entries;
+}
+
+}  // namespace
+
+bool uring_diskmgr_t::is_available() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = sys_io_uring_setup(1, &params);
+    if (fd == -1) {
+        return false;
+    }
+
+    eventfd_event_t event;
+    const int event_fd = event.get_notify_fd();
+    // Some sandboxes let the ring be set up but not used, so try entering it too.
+    const bool ok = sys_io_uring_register(fd, IORING_REGISTER_EVENTFD, &event_fd, 1) == 0
+        && sys_io_uring_enter(fd, 0, 0, 0) == 0;
+
+    int res = close(fd);
+    guarantee_err(res == 0 || errno == EINTR, "Could not close io_uring fd");
+    return ok;
+}
+
+uring_diskmgr_t::uring_diskmgr_t(linux_event_queue_t *_queue,
+                                 passive_producer_t<action_t *> *_source,
+                                 int _queue_depth)
+    : queue(_queue),
+      queue_depth(_queue_depth),
+      source(_source),
+      next_action(NULL),
+      n_pending(0),
+      cq_ring_ptr(NULL),
+      sq_local_tail(0),
+      sqes_unsubmitted(0),
+      sqes_in_flight(0),
+      sqes_reserved(0),
+      submit_retry_timer(NULL) {
+    guarantee(queue_depth > 0);
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = sys_io_uring_setup(ring_entries_for_queue_depth(queue_depth), &params);
+    guarantee_err(ring_fd != -1, "Could not set up io_uring");
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring_ptr = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    guarantee_err(sq_ring_ptr != MAP_FAILED, "Could not map io_uring submission queue");
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        guarantee_err(cq_ring_ptr != MAP_FAILED, "Could not map io_uring completion queue");
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes_ptr = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    guarantee_err(sqes_ptr != MAP_FAILED, "Could not map io_uring submission entries");
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+    char *sq = static_cast<char *>(sq_ring_ptr);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring_entries = params.sq_entries;
+    sq_local_tail = *sq_tail;
+
+    requests.init(ring_entries);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        free_requests.push_back(&requests[i]);
+    }
+
+    char *cq = static_cast<char *>(cq_ring_ptr);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // We never have more entries in flight than fit in the submission queue, and the
+    // completion queue is at least as large, so it can't overflow.
+    guarantee(params.cq_entries >= params.sq_entries);
+
+    const int event_fd = completion_event.get_notify_fd();
+    int res = sys_io_uring_register(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1);
+    guarantee_err(res == 0, "Could not register eventfd with io_uring");
+
+    queue->watch_resource(completion_event.get_notify_fd(), poll_event_in, this);
+
+    if (source->available->get()) { pump(); }
+    source->available->set_callback(this);
+}
+
+uring_diskmgr_t::~uring_diskmgr_t() {
+    assert_thread();
+    rassert(n_pending == 0);
+    rassert(next_action == NULL);
+    rassert(free_requests.size() == requests.size());
+    if (submit_retry_timer != NULL) {
+        cancel_timer(submit_retry_timer);
+    }
+    source->available->unset_callback();
+    queue->forget_resource(completion_event.get_notify_fd(), this);
+
+    munmap(sqes, sqes_size);
+    if (cq_ring_ptr != sq_ring_ptr) {
+        munmap(cq_ring_ptr, cq_ring_size);
+    }
+    munmap(sq_ring_ptr, sq_ring_size);
+
+    int res = close(ring_fd);
+    guarantee_err(res == 0 || errno == EINTR, "Could not close io_uring fd");
+}
+
+void uring_diskmgr_t::on_source_availability_changed() {
+    assert_thread();
+    if (source->available->get()) pump();
+}
+
+size_t uring_diskmgr_t::sqes_needed(action_t *a) {
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    // readv and writev take at most IOV_MAX iovecs each.  The datasyncs run on their
+    // own, before and after the transfer, so they don't add to this.
+    return std::max<size_t>(1, (vecs_len + IOV_MAX - 1) / IOV_MAX);
+}
+
+uring_diskmgr_t::request_t *uring_diskmgr_t::new_request(action_t *a) {
+    guarantee(!free_requests.empty());
+    request_t *r = free_requests.back();
+    free_requests.pop_back();
+    r->action = a;
+    r->vecs = NULL;
+    r->vecs_len = 0;
+    r->offset = 0;
+    r->bytes_left = 0;
+    return r;
+}
+
+void uring_diskmgr_t::free_request(request_t *r) {
+    r->remainder.reset();
+    free_requests.push_back(r);
+}
+
+io_uring_sqe *uring_diskmgr_t::next_sqe() {
+    // The entry isn't visible to the kernel until `submit_pending` publishes the new
+    // tail, after the caller has filled it in.
+    rassert(sq_local_tail - load_acquire(sq_head) < ring_entries);
+    const unsigned index = sq_local_tail & sq_mask;
+    io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sq_local_tail;
+    ++sqes_unsubmitted;
+    ++sqes_in_flight;
+    return sqe;
+}
+
+void uring_diskmgr_t::submit_request(request_t *r) {
+    action_t *a = r->action;
+    io_uring_sqe *sqe = next_sqe();
+    if (r->vecs_len == 0) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    } else {
+        sqe->opcode = a->is_read ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->off = r->offset;
+        sqe->addr = reinterpret_cast<uintptr_t>(r->vecs);
+        sqe->len = r->vecs_len;
+    }
+    sqe->fd = a->fd;
+    sqe->user_data = reinterpret_cast<uintptr_t>(r);
+}
+
+void uring_diskmgr_t::start_stage(action_t *a) {
+    if (a->uring_stage != action_t::URING_TRANSFER) {
+        a->uring_completions_left = 1;
+        submit_request(new_request(a));
+        return;
+    }
+
+    iovec *vecs;
+    size_t vecs_len;
+    a->get_bufs(&vecs, &vecs_len);
+    a->uring_completions_left = 0;
+    int64_t partial_offset = a->offset;
+    for (size_t i = 0; i < vecs_len; i += IOV_MAX) {
+        request_t *r = new_request(a);
+        r->vecs = vecs + i;
+        r->vecs_len = std::min<size_t>(IOV_MAX, vecs_len - i);
+        r->offset = partial_offset;
+        for (size_t j = 0; j < r->vecs_len; ++j) {
+            r->bytes_left += r->vecs[j].iov_len;
+        }
+        partial_offset += r->bytes_left;
+
+        ++a->uring_completions_left;
+        submit_request(r);
+    }
+    guarantee(a->uring_completions_left > 0);
+}
+
+void uring_diskmgr_t::resubmit_remainder(request_t *r, int64_t transferred) {
+    size_t skipped = 0;
+    int64_t partial = transferred;
+    while (partial >= static_cast<int64_t>(r->vecs[skipped].iov_len)) {
+        partial -= r->vecs[skipped].iov_len;
+        ++skipped;
+    }
+    rassert(skipped < r->vecs_len);
+
+    // `r->vecs` might point into `r->remainder`, so this copies before replacing it.
+    scoped_array_t<iovec> rest(r->vecs_len - skipped);
+    std::copy(r->vecs + skipped, r->vecs + r->vecs_len, rest.data());
+    rest[0].iov_base = static_cast<char *>(rest[0].iov_base) + partial;
+    rest[0].iov_len -= partial;
+
+    r->remainder = std::move(rest);
+    r->vecs = r->remainder.data();
+    r->vecs_len = r->remainder.size();
+    r->offset += transferred;
+    submit_request(r);
+}
+
+void uring_diskmgr_t::on_completion(request_t *r, int res) {
+    action_t *a = r->action;
+
+    if (res < 0) {
+        // Keep the first error we see.
+        if (a->io_result >= 0) {
+            a->io_result = res;
+        }
+    } else if (r->vecs_len > 0) {
+        if (a->io_result >= 0) {
+            a->io_result += res;
+        }
+        r->bytes_left -= res;
+        rassert(r->bytes_left >= 0);
+        if (r->bytes_left > 0) {
+            if (res > 0) {
+                // A short transfer: go on from where it stopped.
+                resubmit_remainder(r, res);
+                return;
+            }
+            // Nothing was transferred, so trying again won't help.  (Reads only stop
+            // early like this at the end of the file.)
+            if (a->io_result >= 0) {
+                a->io_result = -EIO;
+            }
+        }
+    }
+
+    free_request(r);
+    rassert(a->uring_completions_left > 0);
+    if (--a->uring_completions_left > 0) {
+        return;
+    }
+
+    if (a->io_result >= 0 && a->uring_stage != action_t::URING_SYNC_AFTER
+        && (a->uring_stage == action_t::URING_SYNC_BEFORE || a->wrap_in_datasyncs)) {
+        a->uring_stage = a->uring_stage == action_t::URING_SYNC_BEFORE
+            ? action_t::URING_TRANSFER
+            : action_t::URING_SYNC_AFTER;
+        start_stage(a);
+        return;
+    }
+
+    const size_t reserved = sqes_needed(a);
+    rassert(sqes_reserved >= reserved);
+    sqes_reserved -= reserved;
+    --n_pending;
+    done_fun(a);
+}
+
+void uring_diskmgr_t::submit_pending() {
+    // Publish the entries we've filled in.
+    store_release(sq_tail, sq_local_tail);
+
+    while (sqes_unsubmitted > 0) {
+        int res = sys_io_uring_enter(ring_fd, sqes_unsubmitted, 0, 0);
+        if (res >= 0) {
+            rassert(static_cast<unsigned>(res) <= sqes_unsubmitted);
+            sqes_unsubmitted -= res;
+        } else if (errno == EAGAIN || errno == EBUSY) {
+            // The kernel is short on resources.  If anything is in flight, its
+            // completion will call pump() and we'll try again then; otherwise we
+            // try again after a little while.
+            if (sqes_in_flight == sqes_unsubmitted && submit_retry_timer == NULL) {
+                submit_retry_timer = fire_timer_once(URING_SUBMIT_RETRY_MS, this);
+            }
+            break;
+        } else {
+            guarantee_err(errno == EINTR, "io_uring_enter failed");
+        }
+    }
+}
+
+void uring_diskmgr_t::pump() {
+    assert_thread();
+    for (;;) {
+        if (next_action == NULL) {
+            if (n_pending >= queue_depth || !source->available->get()) {
+                break;
+            }
+            next_action = source->pop();
+        }
+
+        const size_t needed = sqes_needed(next_action);
+        guarantee(needed <= ring_entries, "An I/O request has too many iovecs for io_uring.");
+        if (needed > ring_entries - sqes_reserved) {
+            break;
+        }
+
+        action_t *a = next_action;
+        next_action = NULL;
+        sqes_reserved += needed;
+        ++n_pending;
+
+        a->io_result = 0;
+        a->uring_stage = a->wrap_in_datasyncs
+            ? action_t::URING_SYNC_BEFORE
+            : action_t::URING_TRANSFER;
+        start_stage(a);
+    }
+
+    submit_pending();
+}
+
+void uring_diskmgr_t::on_timer() {
+    assert_thread();
+    submit_retry_timer = NULL;
+    submit_pending();
+}
+
+void uring_diskmgr_t::on_event(DEBUG_VAR int events) {
+    assert_thread();
+    rassert(events == poll_event_in);
+    completion_event.consume_wakey_wakeys();
+    reap_completions();
+}
+
+void uring_diskmgr_t::reap_completions() {
+    unsigned head = *cq_head;
+    while (head != load_acquire(cq_tail)) {
+        const io_uring_cqe *cqe = &cqes[head & cq_mask];
+        request_t *r = reinterpret_cast<request_t *>(static_cast<uintptr_t>(cqe->user_data));
+        const int res = cqe->res;
+        ++head;
+        store_release(cq_head, head);
+
+        rassert(sqes_in_flight > 0);
+        --sqes_in_flight;
+        on_completion(r, res);
+    }
+
+    // This submits the follow-up entries made above, along with any new actions that
+    // now fit.
+    pump();
+}
+
+#endif  // USE_IO_URING
@@ -0,0 +1,153 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <sys/syscall.h>
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/function.hpp>
+
+#include "arch/io/disk/pool.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/timer.hpp"
+#include "concurrency/queue/passive_producer.hpp"
+
+#if defined(__linux) && defined(__NR_io_uring_setup) && !defined(NO_EVENTFD) && !defined(NO_IO_URING)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+
+#include "arch/runtime/system_event/eventfd_event.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/* The io_uring disk manager submits requests to the kernel through an io_uring
+submission queue instead of running blocking syscalls on a `blocker_pool_t`. A single
+thread can keep many requests in flight this way without any thread handoffs.
+Completions are signalled through an eventfd that is registered with the ring and
+watched by our event queue, so they are handled on the disk manager's home thread like
+everything else.
+
+It takes the same actions as `pool_diskmgr_t` and fits in the same place in the disk
+manager stack. We talk to the kernel through the raw syscalls, so there's no
+dependency on liburing. If io_uring is unavailable (old kernel, or blocked by a
+seccomp policy), `is_available()` returns false and the caller should fall back to
+`pool_diskmgr_t`. The server can also be told to use the pool with --no-io-uring. */
+
+class uring_diskmgr_t : private availability_callback_t,
+                        private linux_event_callback_t,
+                        private timer_callback_t,
+                        public home_thread_mixin_debug_only_t {
+public:
+    typedef pool_diskmgr_action_t action_t;
+
+    // Returns true if this kernel lets us set up an io_uring with an eventfd and
+    // submit to it.
+    static bool is_available();
+
+    /* The `uring_diskmgr_t` will draw actions to run from `source`, keeping at most
+    `queue_depth` of them in flight. It will call `done_fun` on each one when it's
+    done. */
+    uring_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
+                    int queue_depth);
+    boost::function<void(action_t *)> done_fun;
+    ~uring_diskmgr_t();
+
+private:
+    /* What one submission queue entry is doing, so that its completion can be matched
+    up with it. */
+    struct request_t {
+        action_t *action;
+        // For reads and writes, the iovecs that are still to be transferred, where
+        // they go and how many bytes they add up to.  `vecs_len` is zero for datasyncs.
+        iovec *vecs;
+        size_t vecs_len;
+        int64_t offset;
+        int64_t bytes_left;
+        // Holds the rest of the iovecs after a short transfer, for resubmission.
+        scoped_array_t<iovec> remainder;
+    };
+
+    void on_source_availability_changed();
+    void on_event(int events);
+    void on_timer();
+
+    void pump();
+
+    // How many submission queue entries `a` can have in flight at once.
+    static size_t sqes_needed(action_t *a);
+    void start_stage(action_t *a);
+    void on_completion(request_t *r, int res);
+    void resubmit_remainder(request_t *r, int64_t transferred);
+    void submit_request(request_t *r);
+    request_t *new_request(action_t *a);
+    void free_request(request_t *r);
+    io_uring_sqe *next_sqe();
+    void submit_pending();
+    void reap_completions();
+
+    linux_event_queue_t *const queue;
+    const int queue_depth;
+    passive_producer_t<action_t *> *source;
+
+    // An action we have already popped from `source` but couldn't fit in the
+    // submission queue yet.
+    action_t *next_action;
+    int n_pending;
+
+    // The ring itself.
+    fd_t ring_fd;
+    eventfd_event_t completion_event;
+
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    unsigned ring_entries;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe *cqes;
+
+    // The tail of the entries we have filled in.  It's only published to the kernel,
+    // through `*sq_tail`, when we submit them.
+    unsigned sq_local_tail;
+
+    // Entries that have been filled in but not yet consumed by the kernel, and entries
+    // whose completions we haven't seen yet (which includes the former).
+    unsigned sqes_unsubmitted;
+    unsigned sqes_in_flight;
+
+    // The entries that the pending actions may have in flight at once.  An action is
+    // only started when its share fits, so that its later stages and resubmissions
+    // always find room in the ring.
+    unsigned sqes_reserved;
+
+    // Set while we wait to retry a submission that the kernel turned away for lack
+    // of resources, when there was no completion to wait for instead.
+    timer_token_t *submit_retry_timer;
+
+    // One request per ring entry, so that there's always one free for an entry.
+    scoped_array_t<request_t> requests;
+    std::vector<request_t *> free_requests;
+
+    DISABLE_COPYING(uring_diskmgr_t);
+};
+
+#endif  // USE_IO_URING
+
+#endif  // ARCH_IO_DISK_URING_HPP_
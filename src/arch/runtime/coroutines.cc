@@ -9,13 +9,11 @@
 #endif
 
 #include "errors.hpp"
-#include <boost/bind.hpp>
 
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "config/args.hpp"
-#include "do_on_thread.hpp"
 
 #include "perfmon/perfmon.hpp"
 #include "utils.hpp"
@@ -27,6 +25,7 @@ static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_c
     NULLPTR);
 
 size_t coro_stack_size = COROUTINE_STACK_SIZE; //Default, setable by command-line parameter
+bool coro_work_stealing = false; //Default, setable by command-line parameter
 
 /* `coro_globals_t` holds all of the thread-local variables that coroutines need
 to operate. There is one per thread; it is constructed by the constructor for
@@ -47,6 +46,10 @@ struct coro_globals_t {
     /* A list of coro_t objects that are not in use. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* This thread's work stealer, which holds our coro_t objects that finished on
+    other threads until we take them back. */
+    linux_work_stealer_t *work_stealer;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -69,9 +72,10 @@ struct coro_globals_t {
 
 #endif  // NDEBUG
 
-    coro_globals_t()
+    explicit coro_globals_t(linux_work_stealer_t *_work_stealer)
         : current_coro(NULL)
         , prev_coro(NULL)
+        , work_stealer(_work_stealer)
 #ifndef NDEBUG
         , coro_count(0)
         , assert_no_coro_waiting_counter(0)
@@ -84,6 +88,7 @@ struct coro_globals_t {
         rassert(!current_coro);
 
         /* Destroy remaining coroutines */
+        coro_t::reclaim_returned_coros();
         while (coro_t *s = free_coros.head()) {
             free_coros.remove(s);
             delete s;
@@ -94,9 +99,9 @@ struct coro_globals_t {
 
 static __thread coro_globals_t *cglobals = NULL;
 
-coro_runtime_t::coro_runtime_t() {
+coro_runtime_t::coro_runtime_t(linux_work_stealer_t *work_stealer) {
     rassert(!cglobals, "coro runtime initialized twice on this thread");
-    cglobals = new coro_globals_t;
+    cglobals = new coro_globals_t(work_stealer);
 }
 
 coro_runtime_t::~coro_runtime_t() {
@@ -122,7 +127,9 @@ coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
     current_thread_(linux_thread_pool_t::thread_id),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    next_returned_(NULL),
+    stolen_(false)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS * ++coro_selfname_counter)
 #endif
@@ -141,6 +148,16 @@ void coro_t::return_coro_to_free_list(coro_t *coro) {
     cglobals->free_coros.push_back(coro);
 }
 
+void coro_t::reclaim_returned_coros() {
+    coro_t *coro = cglobals->work_stealer->take_returned_coros();
+    while (coro != NULL) {
+        coro_t *next = coro->next_returned_;
+        coro->next_returned_ = NULL;
+        return_coro_to_free_list(coro);
+        coro = next;
+    }
+}
+
 coro_t::~coro_t() {
     /* We never move contexts from one thread to another any more. */
     rassert(get_thread_id() == home_thread());
@@ -185,8 +202,17 @@ void coro_t::run() {
         // Destroy the Callable object which was either allocated within the coro_t or on the heap
         coro->action_wrapper.reset();
 
+        if (coro->stolen_) {
+            coro->stolen_ = false;
+            linux_thread_pool_t::thread->work_stealer.end_steal();
+        }
+
         /* Return the context to the free-contexts list we took it from. */
-        do_on_thread(coro->home_thread(), boost::bind(coro_t::return_coro_to_free_list, coro));
+        if (coro->home_thread() == get_thread_id()) {
+            return_coro_to_free_list(coro);
+        } else {
+            linux_thread_pool_t::thread->work_stealer.return_coro_later(coro);
+        }
         --pm_active_coroutines;
 
         if (cglobals->prev_coro) {
@@ -332,6 +358,20 @@ void coro_t::set_coroutine_stack_size(size_t size) {
     coro_stack_size = size;
 }
 
+void coro_t::set_work_stealing(bool enabled) {
+    coro_work_stealing = enabled;
+}
+
+bool coro_t::work_stealing_enabled() {
+    return coro_work_stealing;
+}
+
+void coro_t::queue_stealable(coro_t *coro) {
+    if (!coro_work_stealing || !linux_thread_pool_t::thread->work_stealer.push(coro)) {
+        coro->notify_sometime();
+    }
+}
+
 artificial_stack_t* coro_t::get_stack() {
     return &stack;
 }
@@ -352,6 +392,10 @@ coro_t * coro_t::get_coro() {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
+    if (cglobals->free_coros.size() == 0) {
+        reclaim_returned_coros();
+    }
+
     if (cglobals->free_coros.size() == 0) {
         coro = new coro_t();
     } else {
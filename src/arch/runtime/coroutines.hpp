@@ -45,6 +45,30 @@ public:
         get_and_init_coro(action)->notify_later_ordered();
     }
 
+    /* Spawns a coroutine that doesn't care which thread it runs on. When work
+    stealing is on (see `set_work_stealing()`), it is queued on this thread and an
+    idle thread may take it and run it there instead; otherwise this is the same as
+    `spawn_sometime()`. The action must not touch anything whose home thread is the
+    current thread, except by switching back with `on_thread_t`. */
+    template<class Callable>
+    static void spawn_stealable(const Callable &action) {
+        queue_stealable(get_and_init_coro(action));
+    }
+
+    /* Runs `fn` in a stealable coroutine and waits for it to return, so that this
+    thread can get on with other coroutines in the meantime. `fn` has the same
+    restrictions as for `spawn_stealable()`, and must not throw. Without work
+    stealing, just calls `fn`. */
+    template<class Callable>
+    static void run_stealable(const Callable &fn) {
+        if (!work_stealing_enabled()) {
+            fn();
+        } else {
+            spawn_stealable(stealable_job_t<Callable>(&fn, self()));
+            wait();
+        }
+    }
+
     // Use coro_t::spawn_*(boost::bind(...)) for spawning with parameters.
 
     /* `spawn()` and `notify()` are aliases for `spawn_later_ordered()` and
@@ -107,6 +131,10 @@ public:
 
     static void set_coroutine_stack_size(size_t size);
 
+    /* Work stealing is off by default. Turn it on before starting the thread pool. */
+    static void set_work_stealing(bool enabled);
+    static bool work_stealing_enabled();
+
     artificial_stack_t * get_stack();
 
 private:
@@ -133,7 +161,27 @@ private:
 
     static coro_t * get_coro();
 
+    static void queue_stealable(coro_t *coro);
+
+    template<class Callable>
+    class stealable_job_t {
+    public:
+        stealable_job_t(const Callable *_fn, coro_t *_waiter) : fn(_fn), waiter(_waiter) { }
+        void operator()() const {
+            (*fn)();
+            waiter->notify_sometime();
+        }
+    private:
+        const Callable *fn;
+        coro_t *waiter;
+    };
+
+    // Hands coroutines that haven't started yet to other threads, and finished ones
+    // back to their home threads.
+    friend class linux_work_stealer_t;
+
     static void return_coro_to_free_list(coro_t *coro);
+    static void reclaim_returned_coros();
 
     static void run() NORETURN;
 
@@ -152,6 +200,13 @@ private:
 
     callable_action_wrapper_t action_wrapper;
 
+    // Links the coroutine into its home thread's list of coroutines that finished
+    // on other threads (see `linux_work_stealer_t`).
+    coro_t *next_returned_;
+
+    // Set while the coroutine runs on a thread that stole it, until it finishes.
+    bool stolen_;
+
 #ifndef NDEBUG
     int64_t selfname_number;
     std::string coroutine_type;
@@ -2,6 +2,7 @@
 #include "arch/runtime/message_hub.hpp"
 
 #include <math.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "config/args.hpp"
@@ -17,22 +18,36 @@
 linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          linux_thread_pool_t *thread_pool,
                                          threadnum_t current_thread)
-    : queue_(queue), thread_pool_(thread_pool), current_thread_(current_thread) {
+    : queue_(queue), thread_pool_(thread_pool),
+      incoming_head_(&incoming_stub_), incoming_tail_(&incoming_stub_),
+      wakeup_pending_(false), current_thread_(current_thread) {
+    for (int i = 0; i < MAX_THREADS; i++) {
+        queues_[i].head = queues_[i].tail = NULL;
+    }
+    memset(dirty_queues_, 0, sizeof(dirty_queues_));
 
     queue_->watch_resource(event_.get_notify_fd(), poll_event_in, this);
 }
 
 linux_message_hub_t::~linux_message_hub_t() {
     for (int i = 0; i < thread_pool_->n_threads; i++) {
-        guarantee(queues_[i].msg_local_list.empty());
+        guarantee(queues_[i].head == NULL);
     }
 
-    guarantee(incoming_messages_.empty());
+    guarantee(incoming_head_ == &incoming_stub_ && incoming_stub_.hub_next_ == NULL);
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
     rassert(0 <= nthread.threadnum && nthread.threadnum < thread_pool_->n_threads);
-    queues_[nthread.threadnum].msg_local_list.push_back(msg);
+    rassert(msg->hub_next_ == NULL);
+    thread_queue_t *queue = &queues_[nthread.threadnum];
+    if (queue->head == NULL) {
+        queue->head = msg;
+        dirty_queues_[nthread.threadnum / 64] |= uint64_t(1) << (nthread.threadnum % 64);
+    } else {
+        queue->tail->hub_next_ = msg;
+    }
+    queue->tail = msg;
 }
 
 // Collects a message for a given thread onto a local list.
@@ -70,19 +85,64 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = incoming_messages_.empty();
-        incoming_messages_.push_back(msg);
-    }
+    rassert(msg->hub_next_ == NULL);
+    push_incoming(msg, msg);
+}
 
-    // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+void linux_message_hub_t::append_incoming(linux_thread_message_t *first,
+                                          linux_thread_message_t *last) {
+    rassert(last->hub_next_ == NULL);
+    linux_thread_message_t *prev = __atomic_exchange_n(&incoming_tail_, last, __ATOMIC_ACQ_REL);
+    // Until this store, the consumer sees the queue end at `prev`.
+    __atomic_store_n(&prev->hub_next_, first, __ATOMIC_RELEASE);
+}
+
+void linux_message_hub_t::push_incoming(linux_thread_message_t *first,
+                                        linux_thread_message_t *last) {
+    append_incoming(first, last);
+
+    // Wakey wakey eggs and bakey, unless somebody already has.
+    if (!__atomic_exchange_n(&wakeup_pending_, true, __ATOMIC_SEQ_CST)) {
         event_.wakey_wakey();
     }
 }
 
+linux_thread_message_t *linux_message_hub_t::pop_incoming() {
+    linux_thread_message_t *head = incoming_head_;
+    linux_thread_message_t *next = __atomic_load_n(&head->hub_next_, __ATOMIC_ACQUIRE);
+
+    if (head == &incoming_stub_) {
+        if (next == NULL) {
+            return NULL;
+        }
+        incoming_head_ = head = next;
+        next = __atomic_load_n(&head->hub_next_, __ATOMIC_ACQUIRE);
+    }
+
+    if (next != NULL) {
+        incoming_head_ = next;
+        head->hub_next_ = NULL;
+        return head;
+    }
+
+    // `head` looks like the last message. If it isn't, a producer has swapped in a
+    // new tail but not yet linked it to `head`, and will wake us when it does.
+    if (head != __atomic_load_n(&incoming_tail_, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    // Put the stub back behind `head` so that we can take `head` off the queue.
+    incoming_stub_.hub_next_ = NULL;
+    append_incoming(&incoming_stub_, &incoming_stub_);
+    next = __atomic_load_n(&head->hub_next_, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        incoming_head_ = next;
+        head->hub_next_ = NULL;
+        return head;
+    }
+    return NULL;
+}
+
 void linux_message_hub_t::on_event(int events) {
     if (events != poll_event_in) {
         logERR("Unexpected event mask: %d", events);
@@ -92,61 +152,65 @@ void linux_message_hub_t::on_event(int events) {
     // up and so that poll-based event triggering doesn't infinite-loop.
     event_.consume_wakey_wakeys();
 
-    msg_list_t msg_list;
-
-    // Pull the messages
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        msg_list.append_and_clear(&incoming_messages_);
-    }
+    // Anything pushed after this point will wake us up again.
+    __atomic_store_n(&wakeup_pending_, false, __ATOMIC_SEQ_CST);
 
 #ifndef NDEBUG
     start_watchdog(); // Initialize watchdog before handling messages
 #endif
 
-    while (linux_thread_message_t *m = msg_list.head()) {
-        msg_list.remove(m);
+    // Only handle the messages that were queued before we looked, like the old
+    // locked queue did when it swapped out the whole list. Otherwise other threads
+    // could keep us here indefinitely and starve our timers and I/O. Whoever
+    // pushes after this point wakes us up again. The tail can be the stub even
+    // when messages are queued in front of it (`pop_incoming()` puts it back
+    // behind the last message), so in that case we stop when we reach the stub.
+    linux_thread_message_t *const last = __atomic_load_n(&incoming_tail_, __ATOMIC_ACQUIRE);
+
+    while (last != &incoming_stub_ || incoming_head_ != &incoming_stub_) {
+        linux_thread_message_t *m = pop_incoming();
+        if (m == NULL) {
+            break;
+        }
+
+        // `m` may be gone once it has been handled.
+        const bool end_of_batch = m == last;
+
 #ifndef NDEBUG
         if (m->reloop_count_ > 0) {
             --m->reloop_count_;
             do_store_message(current_thread_, m);
-            continue;
-        }
+        } else
 #endif
-
-        m->on_thread_switch();
+        {
+            m->on_thread_switch();
+        }
 
 #ifndef NDEBUG
         pet_watchdog(); // Verify that each message completes in the acceptable time range
 #endif
+
+        if (end_of_batch) {
+            break;
+        }
     }
 }
 
-// Pushes messages collected locally global lists available to all
-// threads.
+// Hands the messages collected for each thread over to that thread's incoming queue.
 void linux_message_hub_t::push_messages() {
-    for (int i = 0; i < thread_pool_->n_threads; i++) {
-        // Append the local list for ith thread to that thread's global
-        // message list.
-        thread_queue_t *queue = &queues_[i];
-        if (!queue->msg_local_list.empty()) {
-            // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up = thread_pool_->threads[i]->message_hub.incoming_messages_.empty();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+    for (int word = 0; word < (MAX_THREADS + 63) / 64; word++) {
+        uint64_t dirty = dirty_queues_[word];
+        dirty_queues_[word] = 0;
+        while (dirty != 0) {
+            const int i = word * 64 + __builtin_ctzll(dirty);
+            dirty &= dirty - 1;
+
+            thread_queue_t *queue = &queues_[i];
+            rassert(queue->head != NULL);
+            linux_thread_message_t *first = queue->head;
+            linux_thread_message_t *last = queue->tail;
+            queue->head = queue->tail = NULL;
+            thread_pool_->threads[i]->message_hub.push_incoming(first, last);
         }
     }
 }
@@ -3,14 +3,13 @@
 #define ARCH_RUNTIME_MESSAGE_HUB_HPP_
 
 #include <pthread.h>
+#include <stdint.h>
 #include <strings.h>
 
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
 #include "config/args.hpp"
-#include "containers/intrusive_list.hpp"
 #include "utils.hpp"
 
 class linux_thread_pool_t;
@@ -18,21 +17,22 @@ class linux_thread_pool_t;
 /* There is one message hub per thread, NOT one message hub for the entire program.
 
 Each message hub stores messages that are going from that message hub's home thread to
-other threads. It keeps a separate queue for messages destined for each other thread. */
+other threads. It keeps a separate queue for messages destined for each other thread.
+Once per event loop iteration, `push_messages()` hands each nonempty queue over to the
+destination thread's hub, which has a lock-free queue of incoming messages that any
+thread can append to. */
 
 class linux_message_hub_t : private linux_event_callback_t {
 public:
-    typedef intrusive_list_t<linux_thread_message_t> msg_list_t;
-
     linux_message_hub_t(linux_event_queue_t *queue, linux_thread_pool_t *thread_pool,
                         threadnum_t current_thread);
 
-    /* For each thread, transfer messages from our msg_local_list for that thread to our
-    msg_global_list for that thread */
+    /* For each thread that we have collected messages for, append them to that
+    thread's incoming queue */
     void push_messages();
 
-    /* Schedules the given message to be sent to the given thread by pushing it onto our
-    msg_local_list for that thread */
+    /* Schedules the given message to be sent to the given thread by putting it on our
+    local queue for that thread */
     void store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
     // Schedules the given message to be sent to the given thread.  However, these are not
@@ -51,31 +51,54 @@ private:
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
 
-    /* pull_messages should be called on thread N with N as its argument. (The argument is
-    partially redundant.) It will cause the actual delivery of messages that originated
-    on this->current_thread and are destined for thread N. It is (almost) the only method on
-    linux_message_hub_t that is not called on the thread that the message hub belongs to. */
-    void pull_messages(threadnum_t thread);
-
     linux_event_queue_t *const queue_;
     linux_thread_pool_t *const thread_pool_;
 
-    /* Queue for messages going from this->current_thread to other threads */
+    /* Messages going from this->current_thread to other threads are collected here, one
+    singly-linked list per destination thread, until the next `push_messages()`. */
     struct thread_queue_t {
-        //TODO this doesn't need to be a class anymore
-
-        /* Messages are cached here before being pushed to the global list so that we don't
-        have to acquire the spinlock as often */
-        msg_list_t msg_local_list;
+        linux_thread_message_t *head;
+        linux_thread_message_t *tail;
     } queues_[MAX_THREADS];
 
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    // Bit `i % 64` of `dirty_queues_[i / 64]` is set if `queues_[i]` is nonempty, so
+    // that `push_messages()` only visits threads that have something to receive.
+    uint64_t dirty_queues_[(MAX_THREADS + 63) / 64];
+
+    /* Messages coming in to this thread from all threads. This is an intrusive
+    multi-producer single-consumer queue (Vyukov's design): a producer appends a whole
+    batch with one atomic exchange on `incoming_tail_` and never waits, and only this
+    thread touches `incoming_head_`. The queue always contains at least
+    `incoming_stub_`, so the tail pointer is never NULL. */
+    class stub_message_t : public linux_thread_message_t {
+        void on_thread_switch() {
+            unreachable("The message hub stub message was delivered.");
+        }
+    };
+
+    // Appends the messages from `first` to `last`, which must already be linked
+    // together through `hub_next_`, and wakes us up if necessary. Called on any thread.
+    void push_incoming(linux_thread_message_t *first, linux_thread_message_t *last);
+    void append_incoming(linux_thread_message_t *first, linux_thread_message_t *last);
+
+    // Returns the oldest incoming message, or NULL if there are none. It can also
+    // return NULL while a producer is halfway through `push_incoming()`; that
+    // producer will then wake us up again.
+    linux_thread_message_t *pop_incoming();
+
+    stub_message_t incoming_stub_;
+    linux_thread_message_t *incoming_head_;
+    linux_thread_message_t *incoming_tail_;
+
+    // Set by whoever writes to `event_`, and cleared by us before we empty the
+    // incoming queue. A producer only writes to `event_` if it's the one to set
+    // this, so we get at most one wakeup per pass over the queue.
+    bool wakeup_pending_;
 
     void on_event(int events);
 
-    // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // The eventfd (or pipe-based alternative) notified when messages are put onto
+    // the incoming queue.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
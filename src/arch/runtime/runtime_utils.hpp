@@ -15,8 +15,9 @@ typedef int fd_t;
 class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message_t> {
 public:
     linux_thread_message_t()
+        : hub_next_(NULL)
 #ifndef NDEBUG
-        : reloop_count_(0)
+        , reloop_count_(0)
 #endif
         { }
     virtual void on_thread_switch() = 0;
@@ -24,6 +25,8 @@ protected:
     virtual ~linux_thread_message_t() {}
 private:
     friend class linux_message_hub_t;
+    // The next message in whichever `linux_message_hub_t` queue this one is in.
+    linux_thread_message_t *hub_next_;
 #ifndef NDEBUG
     int reloop_count_;
 #endif
@@ -26,6 +26,8 @@ linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affini
 #endif
       interrupt_message(NULL),
       generic_blocker_pool(NULL),
+      stolen_coros_in_flight(0),
+      threads_shutting_down(false),
       n_threads(worker_threads + 1),    // we create an extra utility thread
       do_set_affinity(_do_set_affinity)
 {
@@ -163,6 +165,7 @@ void linux_thread_pool_t::enable_coroutine_summary() {
 
 void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_message) {
     do_shutdown = false;
+    threads_shutting_down = false;
 
     // Start child threads
     thread_barrier_t barrier(n_threads + 1);
@@ -247,6 +250,10 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
     std::vector<std::map<std::string, size_t> > coroutine_counts(n_threads);
 #endif
 
+    // Any work stealer that sees the last stolen coroutine finish after this point
+    // wakes all the threads up, so that they notice they can stop.
+    __atomic_store_n(&threads_shutting_down, true, __ATOMIC_SEQ_CST);
+
     // Shut down child threads
     for (int i = 0; i < n_threads; i++) {
         // Cause child thread to break out of its loop
@@ -354,7 +361,9 @@ linux_thread_pool_t::~linux_thread_pool_t() {
 linux_thread_t::linux_thread_t(linux_thread_pool_t *parent_pool, int thread_id)
     : queue(this),
       message_hub(&queue, parent_pool, threadnum_t(thread_id)),
+      work_stealer(&queue, parent_pool, threadnum_t(thread_id)),
       timer_handler(&queue),
+      coro_runtime(&work_stealer),
       do_shutdown(false)
 #ifndef NDEBUG
       , coroutine_counts_at_shutdown(NULL)
@@ -382,6 +391,7 @@ linux_thread_t::~linux_thread_t() {
 }
 
 void linux_thread_t::pump() {
+    work_stealer.pump();
     message_hub.push_messages();
 }
 
@@ -400,7 +410,9 @@ bool linux_thread_t::should_shut_down() {
     bool result = do_shutdown;
     res = pthread_mutex_unlock(&do_shutdown_mutex);
     guarantee_xerr(res == 0, res, "could not unlock do_shutdown_mutex");
-    return result;
+    // Coroutines that were stolen have to be handed back before the threads' work
+    // stealers are destroyed.
+    return result && work_stealer.drained();
 }
 
 #ifndef NDEBUG
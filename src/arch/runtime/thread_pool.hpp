@@ -11,9 +11,11 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/system_event.hpp"
 #include "arch/runtime/message_hub.hpp"
+#include "arch/runtime/work_stealer.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/timer.hpp"
 
 class linux_thread_t;
@@ -23,7 +25,7 @@ construct one coro_runtime_t per thread. Coroutines can only be used
 when a coro_runtime_t exists. It exists to take advantage of RAII. */
 
 struct coro_runtime_t {
-    coro_runtime_t();
+    explicit coro_runtime_t(linux_work_stealer_t *work_stealer);
     ~coro_runtime_t();
 
 #ifndef NDEBUG
@@ -84,6 +86,12 @@ public:
     pthread_t pthreads[MAX_THREADS];
     linux_thread_t *threads[MAX_THREADS];
 
+    // Used by the threads' work stealers: the number of coroutines that have been
+    // stolen and haven't finished yet, and whether the threads have been told to
+    // shut down.
+    intptr_t stolen_coros_in_flight;
+    bool threads_shutting_down;
+
     // Cooperatively run a blocking function call using the generic_blocker_pool
     template <class Callable>
     static void run_in_blocker_pool(const Callable &);
@@ -150,6 +158,7 @@ public:
 
     linux_event_queue_t queue;
     linux_message_hub_t message_hub;
+    linux_work_stealer_t work_stealer;
     timer_handler_t timer_handler;
 
     /* Never accessed; its constructor and destructor set up and tear down thread-local variables
@@ -0,0 +1,259 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/runtime/work_stealer.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "logger.hpp"
+#include "perfmon/perfmon.hpp"
+
+static perfmon_counter_t pm_stolen_coroutines;
+static perfmon_membership_t pm_stolen_coroutines_membership(&get_global_perfmon_collection(),
+    &pm_stolen_coroutines, "stolen_coroutines");
+
+linux_coro_deque_t::linux_coro_deque_t() : top_(0), bottom_(0) {
+    CT_ASSERT((COROUTINE_DEQUE_SIZE & (COROUTINE_DEQUE_SIZE - 1)) == 0);
+    for (int64_t i = 0; i < capacity; ++i) {
+        slots_[i] = NULL;
+    }
+}
+
+bool linux_coro_deque_t::push(coro_t *coro) {
+    const int64_t b = __atomic_load_n(&bottom_, __ATOMIC_RELAXED);
+    const int64_t t = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+    if (b - t >= capacity) {
+        return false;
+    }
+    __atomic_store_n(&slots_[b & (capacity - 1)], coro, __ATOMIC_RELAXED);
+    __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+coro_t *linux_coro_deque_t::pop() {
+    const int64_t b = __atomic_load_n(&bottom_, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&bottom_, b, __ATOMIC_RELAXED);
+    // A thief that reads `bottom_` after this fence won't take slot `b`.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        // It was already empty.
+        __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    coro_t *coro = __atomic_load_n(&slots_[b & (capacity - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        // This is the last one, so we have to race the thieves for it.
+        if (!__atomic_compare_exchange_n(&top_, &t, t + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            coro = NULL;
+        }
+        __atomic_store_n(&bottom_, b + 1, __ATOMIC_RELAXED);
+    }
+    return coro;
+}
+
+coro_t *linux_coro_deque_t::steal() {
+    int64_t t = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    const int64_t b = __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return NULL;
+    }
+
+    coro_t *coro = __atomic_load_n(&slots_[t & (capacity - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&top_, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return coro;
+}
+
+int64_t linux_coro_deque_t::approx_size() const {
+    const int64_t t = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+    const int64_t b = __atomic_load_n(&bottom_, __ATOMIC_ACQUIRE);
+    return b > t ? b - t : 0;
+}
+
+linux_work_stealer_t::linux_work_stealer_t(linux_event_queue_t *queue,
+                                           linux_thread_pool_t *thread_pool,
+                                           threadnum_t current_thread)
+    : thread_pool_(thread_pool), current_thread_(current_thread),
+      returned_coros_(NULL), wakeup_pending_(false), idle_(true),
+      next_thread_(current_thread.threadnum + 1) {
+    queue->watch_resource(event_.get_notify_fd(), poll_event_in, this);
+}
+
+linux_work_stealer_t::~linux_work_stealer_t() {
+    guarantee(deque_.approx_size() == 0);
+    guarantee(finished_coros_.empty());
+    guarantee(returned_coros_ == NULL);
+}
+
+bool linux_work_stealer_t::push(coro_t *coro) {
+    rassert(linux_thread_pool_t::thread_id == current_thread_.threadnum);
+    if (!deque_.push(coro)) {
+        return false;
+    }
+    wake_up();
+
+    // One queued coroutine will be picked up by our own thread soon enough; it's
+    // only worth waking somebody else up if there is a backlog.
+    if (deque_.approx_size() > 1) {
+        wake_an_idle_thread();
+    }
+    return true;
+}
+
+void linux_work_stealer_t::pump() {
+    while (coro_t *coro = finished_coros_.head()) {
+        finished_coros_.remove(coro);
+        thread_pool_->threads[coro->home_thread().threadnum]->work_stealer.push_returned_coro(coro);
+    }
+
+    if (deque_.approx_size() == 0) {
+        __atomic_store_n(&idle_, true, __ATOMIC_RELAXED);
+    }
+}
+
+void linux_work_stealer_t::return_coro_later(coro_t *coro) {
+    rassert(coro->home_thread().threadnum != current_thread_.threadnum);
+    finished_coros_.push_back(coro);
+}
+
+void linux_work_stealer_t::push_returned_coro(coro_t *coro) {
+    coro_t *head = __atomic_load_n(&returned_coros_, __ATOMIC_RELAXED);
+    do {
+        coro->next_returned_ = head;
+    } while (!__atomic_compare_exchange_n(&returned_coros_, &head, coro, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+coro_t *linux_work_stealer_t::take_returned_coros() {
+    rassert(linux_thread_pool_t::thread_id == current_thread_.threadnum);
+    return __atomic_exchange_n(&returned_coros_, static_cast<coro_t *>(NULL), __ATOMIC_ACQUIRE);
+}
+
+void linux_work_stealer_t::end_steal() {
+    const intptr_t res = __atomic_sub_fetch(&thread_pool_->stolen_coros_in_flight, 1,
+                                            __ATOMIC_SEQ_CST);
+    rassert(res >= 0);
+    // Threads that have been told to shut down may be waiting for this.
+    if (res == 0 && __atomic_load_n(&thread_pool_->threads_shutting_down, __ATOMIC_SEQ_CST)) {
+        for (int i = 0; i < thread_pool_->n_threads; ++i) {
+            if (linux_thread_t *thread = thread_pool_->threads[i]) {
+                thread->work_stealer.wake_up();
+            }
+        }
+    }
+}
+
+bool linux_work_stealer_t::drained() const {
+    return deque_.approx_size() == 0
+        && __atomic_load_n(&thread_pool_->stolen_coros_in_flight, __ATOMIC_SEQ_CST) == 0;
+}
+
+void linux_work_stealer_t::on_event(int events) {
+    if (events != poll_event_in) {
+        logERR("Unexpected event mask: %d", events);
+    }
+
+    event_.consume_wakey_wakeys();
+    // Anything pushed after this point will wake us up again.
+    __atomic_store_n(&wakeup_pending_, false, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&idle_, false, __ATOMIC_RELAXED);
+
+    if (deque_.approx_size() != 0) {
+        for (int i = 0; i < COROUTINE_DEQUE_DRAIN_BATCH; ++i) {
+            coro_t *coro = deque_.pop();
+            if (coro == NULL) {
+                return;
+            }
+            run(coro);
+        }
+        // Let the rest of the event loop have a turn before we take any more.
+        if (deque_.approx_size() != 0) {
+            wake_up();
+        }
+    } else if (coro_t *coro = begin_steal()) {
+        // Come back for more on the next pass through the event loop, rather than
+        // right away, so that our own events aren't starved.
+        wake_up();
+        run(coro);
+    }
+}
+
+void linux_work_stealer_t::wake_up() {
+    if (!__atomic_exchange_n(&wakeup_pending_, true, __ATOMIC_SEQ_CST)) {
+        event_.wakey_wakey();
+    }
+}
+
+void linux_work_stealer_t::wake_an_idle_thread() {
+    const int n_threads = thread_pool_->n_threads;
+    for (int i = 0; i < n_threads; ++i) {
+        const int threadnum = (next_thread_ + i) % n_threads;
+        linux_thread_t *thread = thread_pool_->threads[threadnum];
+        if (threadnum == current_thread_.threadnum || thread == NULL) {
+            continue;
+        }
+
+        linux_work_stealer_t *other = &thread->work_stealer;
+        if (__atomic_load_n(&other->idle_, __ATOMIC_RELAXED)
+            && __atomic_exchange_n(&other->idle_, false, __ATOMIC_ACQ_REL)) {
+            next_thread_ = threadnum + 1;
+            other->wake_up();
+            return;
+        }
+    }
+}
+
+coro_t *linux_work_stealer_t::begin_steal() {
+    if (__atomic_load_n(&thread_pool_->threads_shutting_down, __ATOMIC_SEQ_CST)) {
+        return NULL;
+    }
+
+    // Count the steal before checking whether we are shutting down. Then a thread
+    // that is about to leave its event loop either sees the count, or we see the
+    // flag and don't steal anything it might be needed for.
+    __atomic_add_fetch(&thread_pool_->stolen_coros_in_flight, 1, __ATOMIC_SEQ_CST);
+    coro_t *coro = NULL;
+    if (!__atomic_load_n(&thread_pool_->threads_shutting_down, __ATOMIC_SEQ_CST)) {
+        coro = steal_from_another_thread();
+    }
+
+    if (coro == NULL) {
+        end_steal();
+    } else {
+        coro->stolen_ = true;
+    }
+    return coro;
+}
+
+coro_t *linux_work_stealer_t::steal_from_another_thread() {
+    const int n_threads = thread_pool_->n_threads;
+    for (int i = 0; i < n_threads; ++i) {
+        const int threadnum = (next_thread_ + i) % n_threads;
+        linux_thread_t *thread = thread_pool_->threads[threadnum];
+        if (threadnum == current_thread_.threadnum || thread == NULL) {
+            continue;
+        }
+
+        linux_coro_deque_t *victim = &thread->work_stealer.deque_;
+        if (victim->approx_size() != 0) {
+            if (coro_t *coro = victim->steal()) {
+                next_thread_ = threadnum;
+                ++pm_stolen_coroutines;
+                return coro;
+            }
+        }
+    }
+    return NULL;
+}
+
+void linux_work_stealer_t::run(coro_t *coro) {
+    // The coroutine hasn't started yet, so it has nothing that is tied to the
+    // thread that spawned it.
+    coro->current_thread_ = current_thread_;
+    coro->notify_now_deprecated();
+}
@@ -0,0 +1,140 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_WORK_STEALER_HPP_
+#define ARCH_RUNTIME_WORK_STEALER_HPP_
+
+#include <stdint.h>
+
+#include "arch/runtime/event_queue.hpp"
+#include "arch/runtime/runtime_utils.hpp"
+#include "arch/runtime/system_event.hpp"
+#include "config/args.hpp"
+#include "containers/intrusive_list.hpp"
+#include "utils.hpp"
+
+class coro_t;
+class linux_thread_pool_t;
+
+/* `linux_coro_deque_t` is a fixed-size Chase-Lev work-stealing deque of
+coroutines. Only the thread that owns it may call `push()` and `pop()`, which
+work on the bottom end; any thread may call `steal()`, which takes from the top
+end. None of them ever block. */
+
+class linux_coro_deque_t {
+public:
+    linux_coro_deque_t();
+
+    // Returns false if the deque is full.
+    MUST_USE bool push(coro_t *coro);
+
+    // Returns the most recently pushed coroutine, or NULL if the deque is empty.
+    coro_t *pop();
+
+    // Returns the oldest coroutine, or NULL if the deque is empty or another
+    // thread got to it first.
+    coro_t *steal();
+
+    // Only a hint when called from a thread other than the owner.
+    int64_t approx_size() const;
+
+private:
+    static const int64_t capacity = COROUTINE_DEQUE_SIZE;
+
+    int64_t top_;
+    int64_t bottom_;
+    coro_t *slots_[COROUTINE_DEQUE_SIZE];
+
+    DISABLE_COPYING(linux_coro_deque_t);
+};
+
+/* There is one work stealer per thread. It holds the coroutines that were spawned
+on its thread with `coro_t::spawn_stealable()` and have not started yet. Its own
+thread runs them newest-first in batches of `COROUTINE_DEQUE_DRAIN_BATCH`,
+interleaved with the rest of the event loop. Meanwhile, when its backlog grows,
+it wakes up one idle thread, which steals the oldest coroutine and runs it there.
+A thread that has stolen something keeps stealing until it finds nothing.
+
+Wakeups go through an eventfd rather than a thread message, so that a wakeup that
+arrives while the thread pool is shutting down is simply never read. */
+
+class linux_work_stealer_t : private linux_event_callback_t {
+public:
+    linux_work_stealer_t(linux_event_queue_t *queue, linux_thread_pool_t *thread_pool,
+                         threadnum_t current_thread);
+    ~linux_work_stealer_t();
+
+    // Queues a coroutine that has been initialized but not notified. Returns false
+    // if the deque is full, in which case the caller should just notify it.
+    MUST_USE bool push(coro_t *coro);
+
+    // Called by the thread once per event loop iteration, once no coroutine is
+    // running. Hands finished coroutines back to their home threads, and marks the
+    // thread idle if it has nothing queued.
+    void pump();
+
+    // Called when a coroutine that was stolen from another thread finishes on ours.
+    // It's handed back by the next `pump()`, once we are no longer on its stack.
+    void return_coro_later(coro_t *coro);
+
+    // Called by coroutines on our thread. Returns the coroutines from our thread
+    // that have finished on other threads, linked through `coro_t::next_returned_`.
+    coro_t *take_returned_coros();
+
+    // Called when a coroutine that some thread stole finishes on ours (and by
+    // `begin_steal()` when it doesn't find anything to steal).
+    void end_steal();
+
+    // True if our thread can leave its event loop once it has been told to shut
+    // down: nothing is queued on it, and every coroutine that any thread has stolen
+    // has finished. A stolen coroutine may move to any thread before it finishes,
+    // and it's only handed back to its home thread by the `pump()` of the thread
+    // it finishes on, so every thread keeps going until all of them are done.
+    bool drained() const;
+
+private:
+    void on_event(int events);
+
+    // Makes our thread call `on_event()` soon, unless it's already going to. Can be
+    // called from any thread.
+    void wake_up();
+    void wake_an_idle_thread();
+
+    // Returns a coroutine stolen from another thread, or NULL. Stealing stops once
+    // the thread pool starts shutting down.
+    coro_t *begin_steal();
+    coro_t *steal_from_another_thread();
+    void run(coro_t *coro);
+
+    // Called on any thread.
+    void push_returned_coro(coro_t *coro);
+
+    linux_thread_pool_t *const thread_pool_;
+    const threadnum_t current_thread_;
+
+    linux_coro_deque_t deque_;
+
+    /* Finished coroutines go back to their home thread's free list, but a thread
+    message could still be in flight when the thread pool shuts down, so they go
+    through these lists instead. `finished_coros_` holds stolen coroutines that
+    finished on our thread and is only touched by us. `returned_coros_` is a
+    lock-free stack of our coroutines that finished on other threads; anybody can
+    push to it, and we take the whole thing at once. */
+    intrusive_list_t<coro_t> finished_coros_;
+    coro_t *returned_coros_;
+
+    // Set by whoever writes to `event_`, cleared by us before we look for work.
+    bool wakeup_pending_;
+    system_event_t event_;
+
+    // Set by us when we go around the event loop with nothing queued (and at first,
+    // since a thread that hasn't started doing anything is idle), cleared by whoever
+    // wakes us up. Only a hint.
+    bool idle_;
+
+    // Where the next search for a victim or an idle thread starts, so that we
+    // don't always pick on the same thread.
+    int next_thread_;
+
+    DISABLE_COPYING(linux_work_stealer_t);
+};
+
+#endif  // ARCH_RUNTIME_WORK_STEALER_HPP_
@@ -94,6 +94,13 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// How the disk manager runs I/O requests: with blocking syscalls on a thread pool,
+// or through io_uring (falling back to the thread pool if io_uring is unavailable).
+enum class file_io_backend_t {
+    pool,
+    uring_desired
+};
+
 
 
 class semantic_checking_file_t {
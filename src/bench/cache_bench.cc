@@ -0,0 +1,92 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/timing.hpp"
+#include "buffer_cache/buffer_cache.hpp"
+#include "serializer/config.hpp"
+#include "serializer/translator.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/mock_file.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::mock_file_opener_t;
+using unittest::run_in_thread_pool;
+
+/* Mixes point reads of a small hot set with a sequential scan that is larger than the
+cache, and reports how often the hot reads hit the cache and how long the whole thing
+took. With the random policy the scan evicts the hot set; with 2Q it should only churn
+the probationary segment. */
+void run_scan_resistance_benchmark(page_repl_policy_t policy, const char *name) {
+    const int num_hot_blocks = 64;
+    const int num_scan_blocks = 16384;
+    const int cache_blocks = 128;
+
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+    standard_serializer_t log_serializer(standard_serializer_t::dynamic_config_t(),
+                                         &file_opener,
+                                         &get_global_perfmon_collection());
+    std::vector<standard_serializer_t *> serializers;
+    serializers.push_back(&log_serializer);
+    serializer_multiplexer_t::create(serializers, 1);
+    serializer_multiplexer_t multiplexer(serializers);
+    mc_cache_t::create(multiplexer.proxies[0]);
+
+    std::vector<block_id_t> block_ids;
+    {
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.max_size = GIGABYTE;
+        mc_cache_t cache(multiplexer.proxies[0], cache_cfg, &get_global_perfmon_collection());
+        mc_transaction_t txn(&cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                             order_token_t::ignore, WRITE_DURABILITY_HARD);
+        for (int i = 0; i < num_hot_blocks + num_scan_blocks; ++i) {
+            mc_buf_lock_t buf(&txn);
+            *static_cast<int *>(buf.get_data_write()) = i;
+            block_ids.push_back(buf.get_block_id());
+        }
+    }
+
+    mirrored_cache_config_t cache_cfg;
+    cache_cfg.max_size = cache_blocks * log_serializer.get_block_size().ser_value();
+    cache_cfg.page_repl_policy = policy;
+    mc_cache_t cache(multiplexer.proxies[0], cache_cfg, &get_global_perfmon_collection());
+
+    // Warm up the hot set; two passes so that it counts as re-referenced.
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < num_hot_blocks; ++i) {
+            mc_transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+            mc_buf_lock_t buf(&txn, block_ids[i], rwi_read);
+        }
+    }
+
+    int hot_hits = 0;
+    const ticks_t start = get_ticks();
+    for (int i = num_hot_blocks; i < num_hot_blocks + num_scan_blocks; ++i) {
+        mc_transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+        {
+            mc_buf_lock_t buf(&txn, block_ids[i], rwi_read);
+        }
+        const block_id_t hot = block_ids[randint(num_hot_blocks)];
+        hot_hits += cache.contains_block(hot) ? 1 : 0;
+        mc_buf_lock_t buf(&txn, hot, rwi_read);
+    }
+    const ticks_t end = get_ticks();
+
+    printf("%s: %.3f hot hit ratio, %.0f scanned blocks/sec\n", name,
+           static_cast<double>(hot_hits) / num_scan_blocks,
+           num_scan_blocks / ticks_to_secs(end - start));
+}
+
+TEST(CacheBench, ScanResistance) {
+    run_in_thread_pool(boost::bind(&run_scan_resistance_benchmark,
+                                   PAGE_REPL_POLICY_RANDOM, "random"));
+    run_in_thread_pool(boost::bind(&run_scan_resistance_benchmark,
+                                   PAGE_REPL_POLICY_2Q, "2q"));
+}
+
+}  // namespace bench
@@ -0,0 +1,73 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/runtime.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::run_in_thread_pool;
+
+/* `Refcount` runs a map/filter/reduce over the same rows before and after they're
+shared across threads, to compare plain and atomic reference counting. */
+
+counted_t<const ql::datum_t> make_rows(int num_rows) {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    for (int i = 0; i < num_rows; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > row;
+        row["id"] = make_counted<const ql::datum_t>(static_cast<double>(i));
+        row["name"] = make_counted<const ql::datum_t>("row");
+        rows.push_back(make_counted<const ql::datum_t>(std::move(row)));
+    }
+    return make_counted<const ql::datum_t>(std::move(rows));
+}
+
+double sum_ids_over(const counted_t<const ql::datum_t> &rows, int threshold) {
+    double sum = 0;
+    for (size_t i = 0; i < rows->size(); ++i) {
+        counted_t<const ql::datum_t> row = rows->get(i);
+        counted_t<const ql::datum_t> id = row->get("id");
+        // The references a function call takes on its arguments.
+        std::vector<counted_t<const ql::datum_t> > args;
+        args.push_back(row);
+        args.push_back(id);
+        if (args[1]->as_num() >= threshold) {
+            sum += args[1]->as_num();
+        }
+    }
+    return sum;
+}
+
+double run_pipeline(const counted_t<const ql::datum_t> &rows, int passes) {
+    double sum = 0;
+    const ticks_t start = get_ticks();
+    for (int i = 0; i < passes; ++i) {
+        sum += sum_ids_over(rows, i % 10);
+    }
+    const double secs = ticks_to_secs(get_ticks() - start);
+    EXPECT_LT(0, sum);
+    return secs;
+}
+
+void run_refcount_benchmark() {
+    const int num_rows = 10000;
+    const int passes = 200;
+    counted_t<const ql::datum_t> rows = make_rows(num_rows);
+
+    const double plain_secs = run_pipeline(rows, passes);
+    rows->share_across_threads();
+    const double atomic_secs = run_pipeline(rows, passes);
+
+    printf("plain refcounts: %.0f rows/sec, atomic refcounts: %.0f rows/sec\n",
+           num_rows * passes / plain_secs, num_rows * passes / atomic_secs);
+}
+
+TEST(DatumBench, Refcount) {
+    run_in_thread_pool(&run_refcount_benchmark);
+}
+
+}  // namespace bench
@@ -0,0 +1,97 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/disk.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::run_in_thread_pool;
+using unittest::temp_file_t;
+
+static const size_t io_size = 4096;
+
+/* Keeps `queue_depth` random 4 KiB reads in flight against a file until `num_reads`
+have been done, and reports the number of reads per second. */
+
+struct random_read_state_t {
+    int to_issue;
+    int outstanding;
+    cond_t all_done;
+};
+
+struct random_reader_t : public linux_iocallback_t {
+    random_reader_t(file_t *_file, int64_t _num_blocks, random_read_state_t *_state)
+        : file(_file), num_blocks(_num_blocks), state(_state),
+          buf(static_cast<char *>(malloc_aligned(io_size, DEVICE_BLOCK_SIZE))) { }
+    ~random_reader_t() { free(buf); }
+
+    void issue() {
+        --state->to_issue;
+        ++state->outstanding;
+        file->read_async(randint(num_blocks) * io_size, io_size, buf, DEFAULT_DISK_ACCOUNT, this);
+    }
+
+    void on_io_complete() {
+        --state->outstanding;
+        if (state->to_issue > 0) {
+            issue();
+        } else if (state->outstanding == 0) {
+            state->all_done.pulse();
+        }
+    }
+
+    file_t *file;
+    int64_t num_blocks;
+    random_read_state_t *state;
+    char *buf;
+};
+
+void run_random_read_benchmark(file_io_backend_t io_backend, const char *name) {
+    const int64_t num_blocks = 1024;
+    const int queue_depth = 64;
+    const int num_reads = 20000;
+
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS, io_backend);
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read | linux_file_t::mode_write | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+    file->set_size_at_least(num_blocks * io_size);
+
+    random_read_state_t state;
+    state.to_issue = num_reads;
+    state.outstanding = 0;
+    std::vector<random_reader_t *> readers;
+    const ticks_t start = get_ticks();
+    for (int i = 0; i < queue_depth; ++i) {
+        readers.push_back(new random_reader_t(file.get(), num_blocks, &state));
+        readers.back()->issue();
+    }
+    state.all_done.wait();
+    const double secs = ticks_to_secs(get_ticks() - start);
+
+    for (size_t i = 0; i < readers.size(); ++i) {
+        delete readers[i];
+    }
+
+    printf("%s backend: %.0f reads/sec at queue depth %d\n",
+           name, num_reads / secs, queue_depth);
+}
+
+TEST(DiskBackendBench, RandomRead) {
+    run_in_thread_pool(boost::bind(&run_random_read_benchmark, file_io_backend_t::pool, "pool"));
+    run_in_thread_pool(boost::bind(&run_random_read_benchmark, file_io_backend_t::uring_desired, "uring"));
+}
+
+}  // namespace bench
@@ -0,0 +1,106 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string>
+#include <vector>
+
+#include "btree/internal_node.hpp"
+#include "btree/keys.hpp"
+#include "btree/leaf_node.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/leaf_node_tracker.hpp"
+#include "utils.hpp"
+
+namespace bench {
+
+using unittest::LeafNodeTracker;
+
+/* Fills a 4 KiB leaf and reports how long lookups in it take, for short keys, for
+keys that differ in their first eight bytes and for keys that don't. */
+std::string short_key(unsigned int i) { return strprintf("%06u", i); }
+std::string long_key(unsigned int i) { return strprintf("%06u:0123456789", i); }
+std::string prefixed_key(unsigned int i) { return strprintf("user:000%06u", i); }
+
+void run_find_key_benchmark(std::string (*make_key)(unsigned int)) {
+    LeafNodeTracker node;
+    std::vector<store_key_t> keys;
+    for (int i = 0; ; ++i) {
+        store_key_t key(make_key((i * 2654435761U) % 1000000));
+        if (!node.Insert(key, "v")) {
+            break;
+        }
+        keys.push_back(key);
+    }
+    ASSERT_GT(keys.size(), 100u);
+
+    const int num_lookups = 1000000;
+    int found = 0;
+    ticks_t start = get_ticks();
+    for (int i = 0; i < num_lookups; ++i) {
+        int index;
+        found += leaf::find_key(node.node(), keys[i % keys.size()].btree_key(), &index);
+    }
+    ticks_t end = get_ticks();
+    ASSERT_EQ(num_lookups, found);
+
+    printf("find_key on a full leaf (%zu keys like %s): %.1f ns/op\n",
+           keys.size(), key_to_debug_str(keys[0]).c_str(),
+           static_cast<double>(end - start) / num_lookups);
+}
+
+TEST(LeafNodeBench, FindKey) {
+    run_find_key_benchmark(&short_key);
+    run_find_key_benchmark(&long_key);
+    run_find_key_benchmark(&prefixed_key);
+}
+
+// A UUID string from a deterministic sequence, like `print_primary` makes of a
+// generated primary key.
+std::string random_uuid_str(uint32_t *seed) {
+    std::string res;
+    for (int i = 0; i < 16; ++i) {
+        *seed = *seed * 1103515245U + 12345U;
+        res += strprintf("%02x", (*seed >> 16) & 0xff);
+        if (i == 3 || i == 5 || i == 7 || i == 9) {
+            res += "-";
+        }
+    }
+    return res;
+}
+
+/* Reports how many documents fit in a leaf and how many children fit in an internal
+node for each block size a table can have, and how deep that makes the tree of a
+table with ten million documents. The keys are UUID primary keys; the values are the
+size of the blob references 1-2 KB documents get. */
+TEST(LeafNodeBench, BlockSizeFanOut) {
+    const int num_documents = 10000000;
+    for (uint32_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+         block_size <= MAX_BTREE_BLOCK_SIZE;
+         block_size *= 2) {
+        uint32_t seed = 1;
+        LeafNodeTracker leaf(block_size);
+        int num_leaf_keys = 0;
+        while (leaf.Insert(store_key_t("S" + random_uuid_str(&seed)), std::string(24, 'r'))) {
+            ++num_leaf_keys;
+        }
+
+        block_size_t bs = block_size_t::unsafe_make(block_size);
+        scoped_malloc_t<internal_node_t> internal(bs.value());
+        internal_node::init(bs, internal.get());
+        for (block_id_t i = 0; !internal_node::is_full(internal.get()); ++i) {
+            store_key_t key("S" + random_uuid_str(&seed));
+            ASSERT_TRUE(internal_node::insert(bs, internal.get(), key.btree_key(), i, i + 1));
+        }
+
+        // Nodes are about three quarters full once the tree has been split a lot.
+        const double leaf_fan_out = num_leaf_keys * 0.75;
+        const double internal_fan_out = internal->npairs * 0.75;
+        int depth = 1;
+        for (double nodes = num_documents / leaf_fan_out; nodes > 1; nodes /= internal_fan_out) {
+            ++depth;
+        }
+        printf("%u byte blocks: %d documents per leaf, %d children per internal node, "
+               "depth %d for %d documents\n",
+               block_size, num_leaf_keys, internal->npairs, depth, num_documents);
+    }
+}
+
+}  // namespace bench
@@ -0,0 +1,71 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "rpc/mailbox/mailbox.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::get_unittest_addresses;
+using unittest::run_in_thread_pool;
+
+/* Measures how fast mailboxes can be created and destroyed while many others are
+alive, and how fast a `mailbox_table_t` looks them up, which is what every incoming
+message does. */
+
+void run_mailbox_table_benchmark() {
+    const int num_live = 10000;
+    const int num_churn = 200000;
+    const int num_lookups = 2000000;
+
+    connectivity_cluster_t c;
+    mailbox_manager_t m(&c);
+    connectivity_cluster_t::run_t r(&c, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m, 0, NULL);
+
+    // Nobody sends to these mailboxes, so they don't need a callback.
+    std::vector<raw_mailbox_t *> live;
+    for (int i = 0; i < num_live; ++i) {
+        live.push_back(new raw_mailbox_t(&m, NULL));
+    }
+
+    ticks_t start = get_ticks();
+    for (int i = 0; i < num_churn; ++i) {
+        const size_t victim = randint(num_live);
+        delete live[victim];
+        live[victim] = new raw_mailbox_t(&m, NULL);
+    }
+    const double churn_secs = ticks_to_secs(get_ticks() - start);
+
+    mailbox_table_t table;
+    std::vector<raw_mailbox_t::id_t> ids;
+    for (int i = 0; i < num_live; ++i) {
+        ids.push_back(table.register_mailbox(live[i]));
+    }
+
+    start = get_ticks();
+    int found = 0;
+    for (int i = 0; i < num_lookups; ++i) {
+        if (table.find_mailbox(ids[i % num_live]) != NULL) {
+            ++found;
+        }
+    }
+    const double lookup_secs = ticks_to_secs(get_ticks() - start);
+    EXPECT_EQ(num_lookups, found);
+
+    for (int i = 0; i < num_live; ++i) {
+        table.unregister_mailbox(ids[i]);
+        delete live[i];
+    }
+
+    printf("mailbox churn: %.0f creations+destructions/sec with %d live mailboxes\n",
+           num_churn / churn_secs, num_live);
+    printf("mailbox lookup: %.0f lookups/sec\n", num_lookups / lookup_secs);
+}
+
+TEST(RPCMailboxBench, MailboxTable) {
+    run_in_thread_pool(&run_mailbox_table_benchmark);
+}
+
+}  // namespace bench
@@ -0,0 +1,99 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::run_in_thread_pool;
+
+static void send_to_thread(threadnum_t thread, linux_thread_message_t *msg) {
+    if (continue_on_thread(thread, msg)) {
+        call_later_on_this_thread(msg);
+    }
+}
+
+/* Two microbenchmarks for cross-thread messaging. `PingPong` bounces a
+single message between two threads, so it measures the latency of one hop.
+`FanOut` has thread 0 send a burst of messages to every other thread,
+each of which sends it straight back, so it measures throughput when many
+threads are sending to the same one. */
+
+struct ping_message_t : public linux_thread_message_t {
+    ping_message_t(int _hops_left, threadnum_t _a, threadnum_t _b, cond_t *_done)
+        : hops_left(_hops_left), a(_a), b(_b), done(_done) { }
+    void on_thread_switch() {
+        if (--hops_left == 0) {
+            done->pulse();
+            return;
+        }
+        send_to_thread(get_thread_id() == a ? b : a, this);
+    }
+    int hops_left;
+    threadnum_t a, b;
+    cond_t *done;
+};
+
+void run_ping_pong_benchmark() {
+    const int num_round_trips = 200000;
+
+    cond_t done;
+    ping_message_t msg(2 * num_round_trips, threadnum_t(0), threadnum_t(1), &done);
+    const ticks_t start = get_ticks();
+    send_to_thread(threadnum_t(1), &msg);
+    done.wait();
+    const double secs = ticks_to_secs(get_ticks() - start);
+
+    printf("ping-pong: %.0f round trips/sec\n", num_round_trips / secs);
+}
+
+TEST(MessageHubBench, PingPong) {
+    run_in_thread_pool(&run_ping_pong_benchmark, 2);
+}
+
+struct boomerang_message_t : public linux_thread_message_t {
+    boomerang_message_t() : returning(false), remaining(NULL), done(NULL) { }
+    void on_thread_switch() {
+        if (!returning) {
+            returning = true;
+            send_to_thread(threadnum_t(0), this);
+        } else if (--*remaining == 0) {
+            done->pulse();
+        }
+    }
+    bool returning;
+    int *remaining;
+    cond_t *done;
+};
+
+void run_fan_out_benchmark() {
+    const int num_rounds = 50;
+    const int messages_per_thread = 2000;
+    const int num_threads = get_num_threads();
+
+    scoped_array_t<boomerang_message_t> messages((num_threads - 1) * messages_per_thread);
+    const ticks_t start = get_ticks();
+    for (int round = 0; round < num_rounds; ++round) {
+        int remaining = messages.size();
+        cond_t done;
+        for (size_t i = 0; i < messages.size(); ++i) {
+            messages[i].returning = false;
+            messages[i].remaining = &remaining;
+            messages[i].done = &done;
+            send_to_thread(threadnum_t(1 + i % (num_threads - 1)), &messages[i]);
+        }
+        done.wait();
+    }
+    const double secs = ticks_to_secs(get_ticks() - start);
+
+    printf("fan-out to %d threads: %.0f round trips/sec\n",
+           num_threads - 1, num_rounds * messages.size() / secs);
+}
+
+TEST(MessageHubBench, FanOut) {
+    run_in_thread_pool(&run_fan_out_benchmark, 8);
+}
+
+}  // namespace bench
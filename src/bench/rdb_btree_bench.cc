@@ -0,0 +1,196 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "btree/btree_store.hpp"
+#include "btree/operations.hpp"
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "serializer/config.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::run_in_thread_pool;
+using unittest::temp_file_t;
+
+/* Inserts the document it is given for each key, the way `insert` does. */
+class insert_replacer_t : public btree_batched_replacer_t {
+public:
+    explicit insert_replacer_t(const std::vector<counted_t<const ql::datum_t> > *_docs)
+        : docs(_docs) { }
+    counted_t<const ql::datum_t> replace(
+        const counted_t<const ql::datum_t> &, size_t index) const {
+        return (*docs)[index];
+    }
+    bool should_return_vals() const { return false; }
+private:
+    const std::vector<counted_t<const ql::datum_t> > *const docs;
+};
+
+void insert_batch(btree_store_t<rdb_protocol_t> *store,
+                  const std::vector<counted_t<const ql::datum_t> > &docs) {
+    cond_t dummy_interruptor;
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> real_superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        rwi_write, repli_timestamp_t::invalid,
+        1, WRITE_DURABILITY_SOFT,
+        &token_pair, &txn, &real_superblock, &dummy_interruptor);
+    block_id_t sindex_block_id = real_superblock->get_sindex_block_id();
+    scoped_ptr_t<superblock_t> superblock(real_superblock.release());
+
+    const std::string primary_key("id");
+    std::vector<store_key_t> keys;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        keys.push_back(store_key_t(docs[i]->get(primary_key)->print_primary()));
+    }
+
+    insert_replacer_t replacer(&docs);
+    rdb_modification_report_cb_t sindex_cb(
+        store, &token_pair, txn.get(), sindex_block_id,
+        auto_drainer_t::lock_t(&store->drainer));
+    rdb_batched_replace(
+        btree_info_t(store->btree.get(), repli_timestamp_t::invalid, txn.get(),
+                     &primary_key),
+        &superblock, keys, &replacer, &sindex_cb);
+}
+
+/* Inserts `num_batches` batches of `batch_size` documents with random keys, either
+a batch per `rdb_batched_replace` call or a document per call, and reports the
+number of documents inserted per second. */
+void run_batched_insert_benchmark(int batch_size, bool one_per_call) {
+    const int num_batches = 40;
+
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(&file_opener,
+                                  standard_serializer_t::static_config_t());
+    standard_serializer_t serializer(standard_serializer_t::dynamic_config_t(),
+                                     &file_opener,
+                                     &get_global_perfmon_collection());
+    rdb_protocol_t::store_t store(&serializer, "bench_store", GIGABYTE, NULL,
+                                  PAGE_REPL_POLICY_2Q, true,
+                                  &get_global_perfmon_collection(), NULL,
+                                  &io_backender, base_path_t("."));
+
+    srandom(1);
+    ticks_t start = get_ticks();
+    for (int b = 0; b < num_batches; ++b) {
+        std::vector<counted_t<const ql::datum_t> > docs;
+        for (int i = 0; i < batch_size; ++i) {
+            std::string data = strprintf("{\"id\" : %ld, \"payload\" : \"0123456789abcdef\"}",
+                                         random());
+            docs.push_back(make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))));
+        }
+        if (one_per_call) {
+            for (size_t i = 0; i < docs.size(); ++i) {
+                insert_batch(&store, std::vector<counted_t<const ql::datum_t> >(1, docs[i]));
+            }
+        } else {
+            insert_batch(&store, docs);
+        }
+    }
+    double secs = ticks_to_secs(get_ticks() - start);
+    printf("%d batches of %d documents, %s: %.0f documents/s\n",
+           num_batches, batch_size, one_per_call ? "one document per call" : "one batch per call",
+           num_batches * batch_size / secs);
+}
+
+void run_batched_insert_benchmarks() {
+    run_batched_insert_benchmark(1000, true);
+    run_batched_insert_benchmark(1000, false);
+}
+
+TEST(RDBBtreeBench, BatchedInsert) {
+    run_in_thread_pool(&run_batched_insert_benchmarks);
+}
+
+void get_rows(btree_store_t<rdb_protocol_t> *store, const std::vector<store_key_t> &keys,
+              bool one_per_call, size_t *rows_found_out) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &superblock,
+            &dummy_interruptor, true);
+
+    if (one_per_call) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            point_read_response_t response;
+            rdb_get(keys[i], store->btree.get(), NULL, txn.get(), superblock.get(),
+                    &response);
+            if (response.data->get_type() != ql::datum_t::R_NULL) {
+                ++*rows_found_out;
+            }
+        }
+    } else {
+        batched_point_read_response_t response;
+        rdb_get_multiple(keys, store->btree.get(), NULL, txn.get(), superblock.get(),
+                         &response);
+        *rows_found_out += response.data.size();
+    }
+}
+
+/* Reads batches of 1000 random keys, half of which have a row, out of a table of
+20000 rows, with a point read per key and with one traversal per batch. */
+void run_get_multiple_benchmark() {
+    const int num_rows = 20000;
+
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(&file_opener,
+                                  standard_serializer_t::static_config_t());
+    standard_serializer_t serializer(standard_serializer_t::dynamic_config_t(),
+                                     &file_opener,
+                                     &get_global_perfmon_collection());
+    rdb_protocol_t::store_t store(&serializer, "bench_store", GIGABYTE, NULL,
+                                  PAGE_REPL_POLICY_2Q, true,
+                                  &get_global_perfmon_collection(), NULL,
+                                  &io_backender, base_path_t("."));
+
+    std::vector<counted_t<const ql::datum_t> > docs;
+    for (int i = 0; i < num_rows; ++i) {
+        std::string data = strprintf("{\"id\" : %d, \"payload\" : \"0123456789abcdef\"}",
+                                     i * 2);
+        docs.push_back(make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str()))));
+    }
+    insert_batch(&store, docs);
+
+    const int batch_size = 1000;
+    const int num_batches = 20;
+    for (int one_per_call = 0; one_per_call < 2; ++one_per_call) {
+        srandom(1);
+        size_t rows_found = 0;
+        ticks_t start = get_ticks();
+        for (int b = 0; b < num_batches; ++b) {
+            std::vector<store_key_t> keys;
+            for (int i = 0; i < batch_size; ++i) {
+                keys.push_back(store_key_t(make_counted<const ql::datum_t>(
+                    static_cast<double>(random() % (num_rows * 2)))->print_primary()));
+            }
+            std::sort(keys.begin(), keys.end());
+            get_rows(&store, keys, one_per_call, &rows_found);
+        }
+        double secs = ticks_to_secs(get_ticks() - start);
+        printf("%d keys per batch, %s: %.3f ms per batch (%zu rows found)\n",
+               batch_size, one_per_call ? "a point read per key" : "one traversal",
+               secs * 1000 / num_batches, rows_found);
+    }
+}
+
+TEST(RDBBtreeBench, GetMultiple) {
+    run_in_thread_pool(&run_get_multiple_benchmark);
+}
+
+}  // namespace bench
@@ -0,0 +1,199 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <map>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+#include "clustering/administration/metadata.hpp"
+#include "extproc/extproc_pool.hpp"
+#include "extproc/extproc_spawner.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/stream.hpp"
+#include "rpc/directory/read_manager.hpp"
+#include "rpc/semilattice/semilattice_manager.hpp"
+#include "serializer/config.hpp"
+#include "unittest/dummy_namespace_interface.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::dummy_namespace_interface_t;
+using unittest::dummy_namespace_repo_t;
+using unittest::run_in_thread_pool;
+using unittest::temp_file_t;
+
+/* Sets up a table with `num_shards` shards, each with its own store, and hands its
+namespace interface to `fun`. The shards split the raw keys that start with a
+lowercase letter evenly. */
+void run_with_shards(int num_shards,
+                     boost::function<void(namespace_interface_t<rdb_protocol_t> *,
+                                          order_source_t *)> fun) {
+    recreate_temporary_directory(base_path_t("."));
+
+    order_source_t order_source;
+
+    std::vector<rdb_protocol_t::region_t> shards;
+    for (int i = 0; i < num_shards; ++i) {
+        const store_key_t left(std::string(1, 'a' + 26 * i / num_shards));
+        const store_key_t right(std::string(1, 'a' + 26 * (i + 1) / num_shards));
+        shards.push_back(rdb_protocol_t::region_t(key_range_t(
+            i == 0 ? key_range_t::none : key_range_t::closed, left,
+            i == num_shards - 1 ? key_range_t::none : key_range_t::open, right)));
+    }
+
+    boost::ptr_vector<temp_file_t> temp_files;
+    for (int i = 0; i < num_shards; ++i) {
+        temp_files.push_back(new temp_file_t);
+    }
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    scoped_array_t<scoped_ptr_t<serializer_t> > serializers(num_shards);
+    for (int i = 0; i < num_shards; ++i) {
+        filepath_file_opener_t file_opener(temp_files[i].name(), &io_backender);
+        standard_serializer_t::create(&file_opener,
+                                      standard_serializer_t::static_config_t());
+        serializers[i].init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                                      &file_opener,
+                                                      &get_global_perfmon_collection()));
+    }
+
+    extproc_pool_t extproc_pool(2);
+
+    connectivity_cluster_t c;
+    semilattice_manager_t<cluster_semilattice_metadata_t> slm(&c, cluster_semilattice_metadata_t());
+    connectivity_cluster_t::run_t cr(&c, unittest::get_unittest_addresses(), peer_address_t(), ANY_PORT, &slm, 0, NULL);
+
+    connectivity_cluster_t c2;
+    directory_read_manager_t<cluster_directory_metadata_t> read_manager(&c2);
+    connectivity_cluster_t::run_t cr2(&c2, unittest::get_unittest_addresses(), peer_address_t(), ANY_PORT, &read_manager, 0, NULL);
+
+    boost::shared_ptr<semilattice_readwrite_view_t<auth_semilattice_metadata_t> > dummy_auth;
+    rdb_protocol_t::context_t ctx(&extproc_pool, NULL, slm.get_root_view(),
+                                  dummy_auth, &read_manager, generate_uuid());
+
+    boost::ptr_vector<rdb_protocol_t::store_t> underlying_stores;
+    boost::ptr_vector<store_view_t<rdb_protocol_t> > stores;
+    for (int i = 0; i < num_shards; ++i) {
+        underlying_stores.push_back(
+                new rdb_protocol_t::store_t(serializers[i].get(),
+                    temp_files[i].name().permanent_path(), GIGABYTE, NULL,
+                    PAGE_REPL_POLICY_2Q, true, &get_global_perfmon_collection(), &ctx,
+                    &io_backender, base_path_t(".")));
+        stores.push_back(new store_subview_t<rdb_protocol_t>(&underlying_stores[i], shards[i]));
+    }
+
+    dummy_namespace_interface_t<rdb_protocol_t> nsi(shards, stores.c_array(), &order_source, &ctx);
+
+    fun(&nsi, &order_source);
+}
+
+std::string create_sindex(namespace_interface_t<rdb_protocol_t> *nsi,
+                          order_source_t *osource) {
+    std::string id = uuid_to_str(generate_uuid());
+
+    const ql::sym_t arg(1);
+    ql::protob_t<const Term> mapping = ql::r::var(arg)["sid"].release_counted();
+    ql::map_wire_func_t m(mapping, make_vector(arg), get_backtrace(mapping));
+
+    rdb_protocol_t::write_t write(rdb_protocol_t::sindex_create_t(id, m, SINGLE));
+    rdb_protocol_t::write_response_t response;
+    cond_t interruptor;
+    nsi->write(write, &response, osource->check_in("bench::create_sindex"), &interruptor);
+    EXPECT_TRUE(boost::get<rdb_protocol_t::sindex_create_response_t>(&response.response) != NULL);
+    return id;
+}
+
+/* Times ordered scans of a whole table, by primary key and by a secondary index,
+in both directions. An ordered scan keeps a cursor on every shard and merges what
+they send back, so it reports how long the first row takes, which is when every
+shard has answered once, and how fast the rows come after that. */
+void run_ordered_rget_benchmark(int num_shards,
+                                namespace_interface_t<rdb_protocol_t> *nsi,
+                                order_source_t *osource) {
+    const int num_rows = 20000;
+
+    const std::string sindex_id = create_sindex(nsi, osource);
+    for (int i = 0; i < num_rows; ++i) {
+        ql::datum_ptr_t row(ql::datum_t::R_OBJECT);
+        const std::string id = strprintf("%c%06d", 'a' + i % 26, i);
+        UNUSED bool b = row.add("id", make_counted<const ql::datum_t>(std::string(id)));
+        b = row.add("sid", make_counted<const ql::datum_t>(
+                        static_cast<double>((i * 37) % num_rows)));
+        b = row.add("padding", make_counted<const ql::datum_t>(std::string(200, 'x')));
+
+        // Raw keys, so that the rows are spread over the shards.
+        rdb_protocol_t::write_t write(rdb_protocol_t::point_write_t(store_key_t(id),
+                                                                    row.to_counted()),
+                                      DURABILITY_REQUIREMENT_SOFT);
+        rdb_protocol_t::write_response_t response;
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("bench::run_ordered_rget_benchmark"),
+                   &interruptor);
+    }
+    ASSERT_EQ(static_cast<size_t>(num_shards), nsi->get_sharding_scheme().size());
+
+    dummy_namespace_repo_t<rdb_protocol_t> ns_repo(nsi);
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    namespace_repo_t<rdb_protocol_t>::access_t ns_access(&ns_repo, generate_uuid(), &interruptor);
+    const std::map<std::string, ql::wire_func_t> optargs;
+
+    for (int use_sindex = 0; use_sindex < 2; ++use_sindex) {
+        for (int descending = 0; descending < 2; ++descending) {
+            const sorting_t sorting = descending ? DESCENDING : ASCENDING;
+
+            const ticks_t start = get_ticks();
+            boost::shared_ptr<query_language::json_stream_t> stream;
+            if (use_sindex) {
+                stream.reset(new query_language::batched_rget_stream_t(
+                                 ns_access, sindex_id,
+                                 counted_t<const ql::datum_t>(), false,
+                                 counted_t<const ql::datum_t>(), false,
+                                 optargs, false, sorting, NULL));
+            } else {
+                stream.reset(new query_language::batched_rget_stream_t(
+                                 ns_access,
+                                 counted_t<const ql::datum_t>(), false,
+                                 counted_t<const ql::datum_t>(), false,
+                                 optargs, false, sorting, NULL));
+            }
+            int rows = 0;
+            ASSERT_TRUE(stream->next(&env).has());
+            ++rows;
+            const ticks_t first_row = get_ticks();
+            while (stream->next(&env).has()) {
+                ++rows;
+            }
+            const ticks_t end = get_ticks();
+            ASSERT_EQ(num_rows, rows);
+
+            printf("%d shards, %s %s scan: %.2f ms to the first row, %.0f rows/sec\n",
+                   num_shards, use_sindex ? "sindex" : "primary key",
+                   descending ? "descending" : "ascending",
+                   ticks_to_secs(first_row - start) * 1000,
+                   rows / ticks_to_secs(end - start));
+        }
+    }
+}
+
+void run_ordered_rget_benchmarks() {
+    const int shard_counts[] = { 1, 4, 8 };
+    for (size_t i = 0; i < sizeof(shard_counts) / sizeof(shard_counts[0]); ++i) {
+        run_with_shards(shard_counts[i], boost::bind(&run_ordered_rget_benchmark,
+                                                     shard_counts[i], _1, _2));
+    }
+}
+
+TEST(RDBProtocolBench, OrderedRget) {
+    extproc_spawner_t extproc_spawner;
+    run_in_thread_pool(&run_ordered_rget_benchmarks);
+}
+
+}  // namespace bench
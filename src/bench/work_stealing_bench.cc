@@ -0,0 +1,70 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace bench {
+
+using unittest::run_in_thread_pool;
+
+/* Each job spins for a while, records which thread it ran on, and wakes up the
+spawner when it is the last one to finish. */
+
+struct spin_job_t {
+    spin_job_t(int _spin_iterations, int *_runs_per_thread, int *_remaining, coro_t *_waiter)
+        : spin_iterations(_spin_iterations), runs_per_thread(_runs_per_thread),
+          remaining(_remaining), waiter(_waiter) { }
+    void operator()() const {
+        volatile int sink = 0;
+        for (int i = 0; i < spin_iterations; ++i) {
+            sink += i;
+        }
+        __sync_fetch_and_add(&runs_per_thread[get_thread_id().threadnum], 1);
+        if (__sync_sub_and_fetch(remaining, 1) == 0) {
+            waiter->notify_sometime();
+        }
+    }
+    int spin_iterations;
+    int *runs_per_thread;
+    int *remaining;
+    coro_t *waiter;
+};
+
+/* `SkewedLoad` puts all of the work on thread 0, with and without work stealing,
+and reports how long it took and how much of it other threads did. */
+
+void run_skewed_load_benchmark(bool work_stealing) {
+    const int num_jobs = 5000;
+
+    scoped_array_t<int> runs_per_thread(get_num_threads());
+    for (int i = 0; i < get_num_threads(); ++i) {
+        runs_per_thread[i] = 0;
+    }
+
+    int remaining = num_jobs;
+    const ticks_t start = get_ticks();
+    for (int i = 0; i < num_jobs; ++i) {
+        coro_t::spawn_stealable(spin_job_t(20000, runs_per_thread.data(),
+                                           &remaining, coro_t::self()));
+    }
+    coro_t::wait();
+    const double secs = ticks_to_secs(get_ticks() - start);
+
+    printf("%s work stealing: %.0f jobs/sec, %d of %d jobs stolen\n",
+           work_stealing ? "with" : "without", num_jobs / secs,
+           num_jobs - runs_per_thread[0], num_jobs);
+}
+
+TEST(WorkStealingBench, SkewedLoad) {
+    run_in_thread_pool(boost::bind(&run_skewed_load_benchmark, false), 8);
+    coro_t::set_work_stealing(true);
+    run_in_thread_pool(boost::bind(&run_skewed_load_benchmark, true), 8);
+    coro_t::set_work_stealing(false);
+}
+
+}  // namespace bench
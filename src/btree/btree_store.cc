@@ -1,6 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "btree/btree_store.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "btree/depth_first_traversal.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
 #include "concurrency/wait_any.hpp"
@@ -24,6 +29,8 @@ template <class protocol_t>
 btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
                                          const std::string &perfmon_name,
                                          int64_t cache_target,
+                                         cache_balancer_t *balancer,
+                                         page_repl_policy_t page_repl_policy,
                                          bool create,
                                          perfmon_collection_t *parent_perfmon_collection,
                                          typename protocol_t::context_t *,
@@ -32,7 +39,8 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     : store_view_t<protocol_t>(protocol_t::region_t::universe()),
       perfmon_collection(),
       io_backender_(io_backender), base_path_(base_path),
-      perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name)
+      perfmon_collection_membership(parent_perfmon_collection, &perfmon_collection, perfmon_name),
+      key_filter_mode(KEY_FILTER_MODE_AUTO)
 {
     if (create) {
         cache_t::create(serializer);
@@ -41,6 +49,8 @@ btree_store_t<protocol_t>::btree_store_t(serializer_t *serializer,
     // TODO: Don't specify cache dynamic config here.
     cache_dynamic_config.max_size = cache_target;
     cache_dynamic_config.max_dirty_size = cache_target / 2;
+    cache_dynamic_config.balancer = balancer;
+    cache_dynamic_config.page_repl_policy = page_repl_policy;
     cache.init(new cache_t(serializer, cache_dynamic_config, &perfmon_collection));
 
     if (create) {
@@ -1045,6 +1055,101 @@ void btree_store_t<protocol_t>::acquire_superblock_for_write(
     get_btree_superblock_and_txn(btree.get(), access, expected_change_count, timestamp, order_token, durability, sb_out, txn_out);
 }
 
+template <class protocol_t>
+key_filter_t *btree_store_t<protocol_t>::get_key_filter(
+        btree_slice_t *slice,
+        const boost::optional<std::string> &sindex_id,
+        key_filter_t::key_part_t key_part) {
+    assert_thread();
+    if (!slice->key_filter.has()) {
+        if (key_filter_mode == KEY_FILTER_MODE_OFF
+            || (key_filter_mode == KEY_FILTER_MODE_AUTO
+                && slice->key_lookup_misses < KEY_FILTER_AUTO_MIN_MISSES)) {
+            return NULL;
+        }
+        slice->key_filter = make_counted<key_filter_t>(key_part, &slice->stats);
+    }
+    counted_t<key_filter_t> filter = slice->key_filter;
+
+    if (filter->needs_rebuild()) {
+        // The keys that get written from now on go into the new bits; the scan
+        // takes care of the ones that are there already.
+        filter->start_rebuild();
+        coro_t::spawn_sometime(boost::bind(&btree_store_t<protocol_t>::rebuild_key_filter,
+                                           this, filter, sindex_id,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+
+    return filter->is_ready() ? filter.get() : NULL;
+}
+
+class key_filter_rebuild_callback_t : public depth_first_traversal_callback_t {
+public:
+    key_filter_rebuild_callback_t(key_filter_t *_filter, signal_t *_interruptor)
+        : filter(_filter), interruptor(_interruptor) { }
+
+    bool handle_pair(scoped_key_value_t &&keyvalue) {
+        if (filter->is_detached() || interruptor->is_pulsed()) {
+            return false;
+        }
+        filter->add_from_rebuild(keyvalue.key());
+        return true;
+    }
+
+private:
+    key_filter_t *filter;
+    signal_t *interruptor;
+};
+
+template <class protocol_t>
+void btree_store_t<protocol_t>::rebuild_key_filter(
+        counted_t<key_filter_t> filter,
+        boost::optional<std::string> sindex_id,
+        auto_drainer_t::lock_t keepalive) {
+    bool done = false;
+    try {
+        // Read the btree like a backfill does: from a snapshot, and with the cache
+        // account that keeps it from pushing everything else out of the cache.
+        read_token_pair_t token_pair;
+        new_read_token_pair(&token_pair);
+
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_backfill(&token_pair.main_read_token, &txn, &superblock,
+                                        keepalive.get_drain_signal());
+
+        scoped_ptr_t<real_superblock_t> sindex_superblock;
+        real_superblock_t *root_superblock = superblock.get();
+        if (sindex_id) {
+            if (!acquire_sindex_superblock_for_read(*sindex_id,
+                                                    superblock->get_sindex_block_id(),
+                                                    &token_pair, txn.get(),
+                                                    &sindex_superblock, NULL,
+                                                    keepalive.get_drain_signal())) {
+                // The sindex was dropped; so was its slice.
+                filter->abort_rebuild();
+                return;
+            }
+            superblock->release();
+            root_superblock = sindex_superblock.get();
+        }
+
+        key_filter_rebuild_callback_t callback(filter.get(), keepalive.get_drain_signal());
+        done = btree_depth_first_traversal(btree.get(), txn.get(), root_superblock,
+                                           key_range_t::universe(), &callback, FORWARD);
+    } catch (const interrupted_exc_t &) {
+        // The store is going away.
+    } catch (const sindex_not_post_constructed_exc_t &) {
+        // The sindex got dropped and created again.
+    }
+
+    if (done && !filter->is_detached()) {
+        filter->finish_rebuild();
+    } else {
+        filter->abort_rebuild();
+    }
+}
+
 /* store_view_t interface */
 template <class protocol_t>
 void btree_store_t<protocol_t>::new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) {
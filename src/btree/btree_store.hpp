@@ -13,6 +13,7 @@
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include "btree/erase_range.hpp"
+#include "btree/key_filter.hpp"
 #include "btree/secondary_operations.hpp"
 #include "buffer_cache/mirrored/config.hpp"  // TODO: Move to buffer_cache/config.hpp or something.
 #include "buffer_cache/types.hpp"
@@ -46,6 +47,8 @@ public:
     btree_store_t(serializer_t *serializer,
                   const std::string &perfmon_name,
                   int64_t cache_target,
+                  cache_balancer_t *balancer,
+                  page_repl_policy_t page_repl_policy,
                   bool create,
                   perfmon_collection_t *parent_perfmon_collection,
                   typename protocol_t::context_t *,
@@ -309,6 +312,28 @@ public:
         return &(secondary_index_slices.at(id));
     }
 
+    /* Returns the key filter of `slice` (the primary btree, or the sindex `sindex_id`),
+    or NULL if it isn't ready. The first call for a slice that the key filter mode
+    says should have a filter creates it, with `key_part` saying what the filter holds
+    for each key, and starts filling it in the background. */
+    key_filter_t *get_key_filter(btree_slice_t *slice,
+                                 const boost::optional<std::string> &sindex_id,
+                                 key_filter_t::key_part_t key_part);
+
+    // Only affects the btrees that don't have a filter yet. The default is
+    // KEY_FILTER_MODE_AUTO.
+    void set_key_filter_mode(key_filter_mode_t mode) {
+        assert_thread();
+        key_filter_mode = mode;
+    }
+
+private:
+    void rebuild_key_filter(counted_t<key_filter_t> filter,
+                            boost::optional<std::string> sindex_id,
+                            auto_drainer_t::lock_t keepalive);
+
+public:
+
     virtual void protocol_read(const typename protocol_t::read_t &read,
                                typename protocol_t::read_response_t *response,
                                btree_slice_t *btree,
@@ -421,6 +446,8 @@ public:
     base_path_t base_path_;
     perfmon_membership_t perfmon_collection_membership;
 
+    key_filter_mode_t key_filter_mode;
+
     boost::ptr_map<const std::string, btree_slice_t> secondary_index_slices;
 
     std::vector<internal_disk_backed_queue_t *> sindex_queues;
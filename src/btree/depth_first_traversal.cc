@@ -1,15 +1,48 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "btree/depth_first_traversal.hpp"
 
+#include <algorithm>
+
 #include "btree/operations.hpp"
 
+/* Without help, a range scan waits for the disk once for every leaf it reads.
+`prefetch_window_t` decides how many of the upcoming children of the internal node
+being scanned should be loading in the background. When the scan gets to a prefetched
+child that still isn't in memory, the disk isn't keeping up and the window doubles;
+after a whole window's worth of children that were ready in time, it shrinks by one,
+so that a scan that is slow anyway (or that stops early) doesn't read more than it
+needs to. */
+class prefetch_window_t {
+public:
+    prefetch_window_t() : size_(BTREE_PREFETCH_MIN_WINDOW), ready_streak_(0) { }
+
+    int size() const { return size_; }
+
+    void on_prefetched_child(bool was_ready) {
+        if (!was_ready) {
+            size_ = std::min(size_ * 2, BTREE_PREFETCH_MAX_WINDOW);
+            ready_streak_ = 0;
+        } else if (++ready_streak_ >= size_) {
+            size_ = std::max(size_ - 1, BTREE_PREFETCH_MIN_WINDOW);
+            ready_streak_ = 0;
+        }
+    }
+
+private:
+    int size_;
+    int ready_streak_;
+
+    DISABLE_COPYING(prefetch_window_t);
+};
+
 /* Returns `true` if we reached the end of the subtree or range, and `false` if
 `cb->handle_value()` returned `false`. */
 bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction,
                                  counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
-                                 direction_t direction);
+                                 direction_t direction,
+                                 prefetch_window_t *prefetch_window);
 
 bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transaction, superblock_t *superblock, const key_range_t &range, depth_first_traversal_callback_t *cb, direction_t direction) {
     block_id_t root_block_id = superblock->get_root_block_id();
@@ -20,7 +53,8 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
         auto root_block = make_counted<counted_buf_lock_t>(transaction, root_block_id,
                                                            rwi_read);
         superblock->release();
-        return btree_depth_first_traversal(slice, transaction, std::move(root_block), range, cb, direction);
+        prefetch_window_t prefetch_window;
+        return btree_depth_first_traversal(slice, transaction, std::move(root_block), range, cb, direction, &prefetch_window);
     }
 }
 
@@ -28,7 +62,8 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
                                  counted_t<counted_buf_lock_t> block,
                                  const key_range_t &range,
                                  depth_first_traversal_callback_t *cb,
-                                 direction_t direction) {
+                                 direction_t direction,
+                                 prefetch_window_t *prefetch_window) {
     const node_t *node = reinterpret_cast<const node_t *>(block->get_data_read());
     if (node::is_internal(node)) {
         const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
@@ -41,13 +76,32 @@ bool btree_depth_first_traversal(btree_slice_t *slice, transaction_t *transactio
             r.decrement();
             end_index = internal_node::get_offset_index(inode, r.btree_key()) + 1;
         }
-        for (int i = 0; i < end_index - start_index; ++i) {
+        const int num_children = end_index - start_index;
+        // Children before `num_prefetched` have been visited or prefetched.
+        int num_prefetched = 0;
+        for (int i = 0; i < num_children; ++i) {
             int true_index = (direction == FORWARD ? start_index + i : (end_index - 1) - i);
             const btree_internal_pair *pair = internal_node::get_pair_by_index(inode, true_index);
+            if (i < num_prefetched) {
+                prefetch_window->on_prefetched_child(transaction->prefetch_block(pair->lnode));
+            }
+
+            // We still hold `block`, so none of its children can go away while we
+            // load them.
+            num_prefetched = std::max(num_prefetched, i + 1);
+            const int prefetch_end = std::min(num_children, i + 1 + prefetch_window->size());
+            for (; num_prefetched < prefetch_end; ++num_prefetched) {
+                int prefetch_index = (direction == FORWARD
+                                      ? start_index + num_prefetched
+                                      : (end_index - 1) - num_prefetched);
+                transaction->prefetch_block(
+                    internal_node::get_pair_by_index(inode, prefetch_index)->lnode);
+            }
+
             auto lock = make_counted<counted_buf_lock_t>(transaction, pair->lnode,
                                                          rwi_read);
             if (!btree_depth_first_traversal(slice, transaction, std::move(lock),
-                                             range, cb, direction)) {
+                                             range, cb, direction, prefetch_window)) {
                 return false;
             }
         }
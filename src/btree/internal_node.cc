@@ -337,8 +337,32 @@ btree_internal_pair *get_pair_by_index(internal_node_t *node, int index) {
     return get_pair(node, node->pair_offsets[index]);
 }
 
+// Returns the index of the first of the first `end` pairs whose key is not less
+// than the key `cmp` compares to, or `end` if there is none.
+template <class cmp_t>
+int get_offset_index_with(const internal_node_t *node, const cmp_t &cmp, int end) {
+    int beg = 0;
+    while (beg < end) {
+        int test_point = beg + (end - beg) / 2;
+        if (cmp(&get_pair_by_index(node, test_point)->key) > 0) {
+            beg = test_point + 1;
+        } else {
+            end = test_point;
+        }
+    }
+    return beg;
+}
+
 int get_offset_index(const internal_node_t *node, const btree_key_t *key) {
-    return std::lower_bound(node->pair_offsets, node->pair_offsets+node->npairs-1, (uint16_t) internal_key_comp::faux_offset, internal_key_comp(node, key)) - node->pair_offsets;
+    // The last pair's key is ignored.
+    const int end = node->npairs - 1;
+    if (end > 0
+        && btree_key_prefixes_help(key, &get_pair_by_index(node, 0)->key,
+                                   &get_pair_by_index(node, end - 1)->key)) {
+        return get_offset_index_with(node, btree_key_prefix_cmp_t(key), end);
+    } else {
+        return get_offset_index_with(node, btree_key_plain_cmp_t(key), end);
+    }
 }
 
 int nodecmp(const internal_node_t *node1, const internal_node_t *node2) {
@@ -0,0 +1,169 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "btree/key_filter.hpp"
+
+#include <algorithm>
+
+#include "btree/slice.hpp"
+#include "config/args.hpp"
+
+// How many bits each key sets. This is about ln 2 * KEY_FILTER_BITS_PER_KEY, which
+// is what gives the fewest false positives.
+const int KEY_FILTER_NUM_HASHES = 7;
+
+// A block is a cache line's worth of bits.
+const int KEY_FILTER_WORDS_PER_BLOCK = 8;
+const int KEY_FILTER_BITS_PER_BLOCK = KEY_FILTER_WORDS_PER_BLOCK * 64;
+
+// The finalizer of MurmurHash3. It makes every bit of the result depend on every bit
+// of the input.
+inline uint64_t key_filter_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+key_filter_t::bits_t::bits_t(int64_t _capacity)
+    : capacity(_capacity),
+      num_keys(0),
+      blocks(KEY_FILTER_WORDS_PER_BLOCK
+             * std::max<int64_t>(1, ceil_divide(capacity * KEY_FILTER_BITS_PER_KEY,
+                                                KEY_FILTER_BITS_PER_BLOCK)),
+             0) { }
+
+bool key_filter_t::bits_t::add(uint64_t hash) {
+    const uint64_t num_blocks = blocks.size() / KEY_FILTER_WORDS_PER_BLOCK;
+    uint64_t *block = blocks.data()
+        + KEY_FILTER_WORDS_PER_BLOCK * (((hash >> 32) * num_blocks) >> 32);
+    uint64_t bit_hash = key_filter_mix(hash);
+    bool changed = false;
+    for (int i = 0; i < KEY_FILTER_NUM_HASHES; ++i) {
+        const int bit = bit_hash % KEY_FILTER_BITS_PER_BLOCK;
+        bit_hash /= KEY_FILTER_BITS_PER_BLOCK;
+        const uint64_t mask = uint64_t(1) << (bit % 64);
+        changed |= (block[bit / 64] & mask) == 0;
+        block[bit / 64] |= mask;
+    }
+    if (changed) {
+        ++num_keys;
+    }
+    return changed;
+}
+
+bool key_filter_t::bits_t::test(uint64_t hash) const {
+    const uint64_t num_blocks = blocks.size() / KEY_FILTER_WORDS_PER_BLOCK;
+    const uint64_t *block = blocks.data()
+        + KEY_FILTER_WORDS_PER_BLOCK * (((hash >> 32) * num_blocks) >> 32);
+    uint64_t bit_hash = key_filter_mix(hash);
+    for (int i = 0; i < KEY_FILTER_NUM_HASHES; ++i) {
+        const int bit = bit_hash % KEY_FILTER_BITS_PER_BLOCK;
+        bit_hash /= KEY_FILTER_BITS_PER_BLOCK;
+        if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+key_filter_t::key_filter_t(key_part_t _key_part, btree_stats_t *_stats)
+    : key_part(_key_part), stats(_stats), ready(false) { }
+
+key_filter_t::~key_filter_t() {
+    // The btree detaches the filter before it goes away.
+    guarantee(is_detached());
+}
+
+// FNV-1a, mixed some more, since the block number comes from the top bits.
+uint64_t key_filter_hash(const uint8_t *contents, int size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < size; ++i) {
+        h ^= contents[i];
+        h *= 0x100000001b3ULL;
+    }
+    return key_filter_mix(h);
+}
+
+uint64_t key_filter_t::hash(const btree_key_t *key) const {
+    if (key_part == NULL) {
+        return key_filter_hash(key->contents, key->size);
+    }
+    store_key_t part = key_part(key);
+    return key_filter_hash(part.contents(), part.size());
+}
+
+void key_filter_t::add(const btree_key_t *key) {
+    if (!ready && !rebuild_bits.has()) {
+        return;
+    }
+    const uint64_t h = hash(key);
+    if (ready) {
+        bits->add(h);
+    }
+    if (rebuild_bits.has()) {
+        rebuild_bits->add(h);
+    }
+}
+
+bool key_filter_t::may_contain(const store_key_t &part) {
+    guarantee(ready && !is_detached());
+    if (!bits->test(key_filter_hash(part.contents(), part.size()))) {
+        stats->pm_key_filter_negatives.record();
+        return false;
+    }
+    return true;
+}
+
+void key_filter_t::on_false_positive() {
+    guarantee(!is_detached());
+    stats->pm_key_filter_false_positives.record();
+}
+
+bool key_filter_t::needs_rebuild() const {
+    return !is_detached() && !rebuild_bits.has() && (!ready || bits->num_keys > bits->capacity);
+}
+
+void key_filter_t::start_rebuild() {
+    guarantee(!is_detached() && !rebuild_bits.has());
+    const int64_t capacity = std::max<int64_t>(KEY_FILTER_MIN_KEYS,
+                                               bits.has() ? 2 * bits->num_keys : 0);
+    rebuild_bits.init(new bits_t(capacity));
+    stats->pm_key_filter_bytes += rebuild_bits->size_in_bytes();
+}
+
+void key_filter_t::add_from_rebuild(const btree_key_t *key) {
+    guarantee(rebuild_bits.has());
+    rebuild_bits->add(hash(key));
+}
+
+void key_filter_t::finish_rebuild() {
+    guarantee(!is_detached() && rebuild_bits.has());
+    if (bits.has()) {
+        stats->pm_key_filter_bytes -= bits->size_in_bytes();
+    }
+    bits.reset();
+    bits.init(rebuild_bits.release());
+    ready = true;
+}
+
+void key_filter_t::abort_rebuild() {
+    guarantee(rebuild_bits.has());
+    if (!is_detached()) {
+        stats->pm_key_filter_bytes -= rebuild_bits->size_in_bytes();
+    }
+    rebuild_bits.reset();
+}
+
+void key_filter_t::detach() {
+    guarantee(!is_detached());
+    if (bits.has()) {
+        stats->pm_key_filter_bytes -= bits->size_in_bytes();
+    }
+    if (rebuild_bits.has()) {
+        stats->pm_key_filter_bytes -= rebuild_bits->size_in_bytes();
+    }
+    stats = NULL;
+    ready = false;
+    bits.reset();
+}
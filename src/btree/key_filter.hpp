@@ -0,0 +1,108 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BTREE_KEY_FILTER_HPP_
+#define BTREE_KEY_FILTER_HPP_
+
+#include <vector>
+
+#include "btree/keys.hpp"
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+
+class btree_stats_t;
+
+/* Whether a server builds key filters for its btrees. A filter takes about
+KEY_FILTER_BITS_PER_KEY bits of memory per key, and only pays for itself on a btree
+that gets asked for keys it doesn't have, so by default (KEY_FILTER_MODE_AUTO) a btree
+only gets one after KEY_FILTER_AUTO_MIN_MISSES of its lookups found nothing. */
+enum key_filter_mode_t {
+    KEY_FILTER_MODE_OFF,
+    KEY_FILTER_MODE_AUTO,
+    KEY_FILTER_MODE_ON
+};
+
+/* `key_filter_t` is a blocked Bloom filter over the keys of a btree. It lets a lookup
+of a key that isn't in the btree skip going down the tree. Every key sets a few bits
+within one 64-byte block, so a lookup only touches one cache line of the filter.
+
+Keys can't be taken out of a Bloom filter, so deleted keys stay in it until the next
+rebuild; all that does is make the filter say "maybe" more often. A filter starts out
+empty and not ready to be used. A rebuild (see `btree_store_t::get_key_filter`) fills
+a new set of bits from a scan of the btree. Every key that gets written after the
+rebuild starts goes into the new bits as well, so the keys the scan doesn't see are in
+there too. When the scan is done the new bits replace the old ones, and the filter is
+ready. Filters aren't persisted; after a restart, a btree's filter gets rebuilt the
+first time it's needed.
+
+The rebuild holds a reference to the filter, so that the btree can go away while it
+is going on; the btree detaches the filter when it does, and the rebuild stops. */
+class key_filter_t : public single_threaded_countable_t<key_filter_t> {
+public:
+    // Turns a key of the btree into what the filter holds for it. NULL means the
+    // whole key.
+    typedef store_key_t (*key_part_t)(const btree_key_t *key);
+
+    key_filter_t(key_part_t key_part, btree_stats_t *stats);
+    ~key_filter_t();
+
+    // Has to be called for every key that gets written to the btree.
+    void add(const btree_key_t *key);
+
+    bool is_ready() const { return ready; }
+
+    // Returns false if no key in the btree has that key part. The filter has to be
+    // ready.
+    bool may_contain(const store_key_t &key_part);
+
+    // To be called when `may_contain` said true but there was no such key.
+    void on_false_positive();
+
+    // True if the filter isn't ready, or if more keys went into it than it was sized
+    // for, and it isn't being rebuilt already.
+    bool needs_rebuild() const;
+
+    void start_rebuild();
+    void add_from_rebuild(const btree_key_t *key);
+    void finish_rebuild();
+    void abort_rebuild();
+
+    // Called by the btree when it goes away.
+    void detach();
+    bool is_detached() const { return stats == NULL; }
+
+private:
+    class bits_t {
+    public:
+        explicit bits_t(int64_t capacity);
+
+        // Returns true if that set any bit that wasn't set before.
+        bool add(uint64_t hash);
+        bool test(uint64_t hash) const;
+
+        size_t size_in_bytes() const { return blocks.size() * sizeof(uint64_t); }
+
+        // How many keys the bits were sized for, and how many different keys went
+        // into them (as far as the bits can tell).
+        int64_t capacity;
+        int64_t num_keys;
+
+    private:
+        std::vector<uint64_t> blocks;
+    };
+
+    uint64_t hash(const btree_key_t *key) const;
+
+    const key_part_t key_part;
+
+    // NULL once the filter is detached.
+    btree_stats_t *stats;
+
+    bool ready;
+    scoped_ptr_t<bits_t> bits;
+
+    // Present while a rebuild is going on.
+    scoped_ptr_t<bits_t> rebuild_bits;
+
+    DISABLE_COPYING(key_filter_t);
+};
+
+#endif  // BTREE_KEY_FILTER_HPP_
@@ -34,6 +34,68 @@ inline int btree_key_cmp(const btree_key_t *left, const btree_key_t *right) {
     return sized_strcmp(left->contents, left->size, right->contents, right->size);
 }
 
+/* The first eight bytes of a key, padded with zeros, as a big-endian integer. When
+two keys' prefixes differ, comparing the prefixes as integers orders the keys the
+same way `btree_key_cmp()` does. */
+inline uint64_t btree_key_prefix(const btree_key_t *key) {
+    uint64_t prefix = 0;
+    if (key->size >= sizeof(prefix)) {
+        memcpy(&prefix, key->contents, sizeof(prefix));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        prefix = __builtin_bswap64(prefix);
+#endif
+    } else {
+        for (int i = 0; i < key->size; ++i) {
+            prefix |= static_cast<uint64_t>(key->contents[i]) << (56 - 8 * i);
+        }
+    }
+    return prefix;
+}
+
+/* Node searches compare lots of keys to the one key they are looking for. If the
+keys in a node differ in their first eight bytes, most of those comparisons are
+decided by comparing prefixes as integers, which is a lot cheaper than a memcmp()
+each; if they all share their prefix, or the key is short, the prefixes don't tell
+anything apart and are just overhead. Searches use `btree_key_prefixes_help()` to
+pick `btree_key_prefix_cmp_t` or `btree_key_plain_cmp_t`. */
+class btree_key_plain_cmp_t {
+public:
+    explicit btree_key_plain_cmp_t(const btree_key_t *key) : key_(key) { }
+
+    // Returns the same as `btree_key_cmp(key, other)`.
+    int operator()(const btree_key_t *other) const {
+        return btree_key_cmp(key_, other);
+    }
+
+private:
+    const btree_key_t *key_;
+};
+
+class btree_key_prefix_cmp_t {
+public:
+    explicit btree_key_prefix_cmp_t(const btree_key_t *key)
+        : key_(key), prefix_(btree_key_prefix(key)) { }
+
+    // Returns the same as `btree_key_cmp(key, other)`.
+    int operator()(const btree_key_t *other) const {
+        const uint64_t other_prefix = btree_key_prefix(other);
+        if (prefix_ != other_prefix) {
+            return prefix_ < other_prefix ? -1 : 1;
+        }
+        return btree_key_cmp(key_, other);
+    }
+
+private:
+    const btree_key_t *key_;
+    uint64_t prefix_;
+};
+
+// `first` and `last` are the smallest and largest keys in the node being searched.
+inline bool btree_key_prefixes_help(const btree_key_t *key,
+                                    const btree_key_t *first, const btree_key_t *last) {
+    return key->size >= sizeof(uint64_t) && btree_key_prefix(first) != btree_key_prefix(last);
+}
+
 struct store_key_t {
 public:
     store_key_t() {
@@ -913,19 +913,21 @@ void move_elements(value_sizer_t<void> *sizer, leaf_node_t *fro, int beg, int en
     validate(sizer, tow);
 }
 
-void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+// Moves the entries at the end of node whose mandatory cost adds up to about
+// rpercent percent of node's mandatory cost to rnode.
+void split_at_percent(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out, int rpercent) {
     int tstamp_back_offset;
     int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
     rassert(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
 
-    // We shall split the mandatory cost of this node as evenly as possible.
+    const int target_rcost = mandatory * rpercent / 100;
 
     int num_mandatories = 0;
     int i = node->num_pairs - 1;
     int prev_rcost = 0;
     int rcost = 0;
-    while (i >= 0 && rcost < mandatory / 2) {
+    while (i >= 0 && rcost < target_rcost) {
         int offset = node->pair_offsets[i];
         entry_t *ent = get_entry(node, offset);
 
@@ -958,13 +960,15 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
     rassert(i < node->num_pairs);
     rassert(i > 0);
 
-    // Now prev_rcost and rcost envelope mandatory / 2.
-    rassert(prev_rcost < mandatory / 2);
-    rassert(rcost >= mandatory / 2, "rcost = %d, mandatory / 2 = %d, i = %d", rcost, mandatory / 2, i);
+    // Now prev_rcost and rcost envelope target_rcost.
+    rassert(prev_rcost < target_rcost);
+    rassert(rcost >= target_rcost, "rcost = %d, target_rcost = %d, i = %d", rcost, target_rcost, i);
 
+    // Whichever is closer to the target, but rnode always gets something.
     int s;
     int end_rcost;
-    if ((mandatory - prev_rcost) - prev_rcost < rcost - (mandatory - rcost)) {
+    const int twice_target = mandatory * rpercent / 50;
+    if (twice_target - 2 * prev_rcost < 2 * rcost - twice_target && i + 2 < node->num_pairs) {
         end_rcost = prev_rcost;
         s = i + 2;
         --num_mandatories;
@@ -974,8 +978,9 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
     }
 
     // If our math was right, neither node can be underfull just
-    // considering the split of the mandatory costs.
-    rassert(end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
+    // considering the split of the mandatory costs -- unless we were asked
+    // for an uneven split.
+    rassert(rpercent != 50 || end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
     rassert(mandatory - end_rcost >= free_space(sizer) / 2 - leaf_epsilon(sizer));
 
     // Now we wish to move the elements at indices [s, num_pairs) to rnode.
@@ -988,6 +993,15 @@ void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, bt
     keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
 }
 
+void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+    // We shall split the mandatory cost of this node as evenly as possible.
+    split_at_percent(sizer, node, rnode, median_out, 50);
+}
+
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out) {
+    split_at_percent(sizer, node, rnode, median_out, 100 - BTREE_APPEND_SPLIT_FILL_PERCENT);
+}
+
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
     rassert(left != right);
 
@@ -998,9 +1012,13 @@ void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right) {
     int mandatory = mandatory_cost(sizer, left, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
 
     int left_copysize = mandatory;
-    // Uncount the uint16_t cost of mandatory  entries.  Sigh.
+    // Uncount the uint16_t cost of mandatory  entries.  Sigh.  Those are the live
+    // entries and the deletion entries before tstamp_back_offset, the same ones that
+    // split_at_percent counts.  Deletion entries past tstamp_back_offset don't get
+    // copied and weren't counted in the first place.
     for (int i = 0; i < left->num_pairs; ++i) {
-        if (left->pair_offsets[i] < tstamp_back_offset || entry_is_deletion(get_entry(left, left->pair_offsets[i]))) {
+        const int offset = left->pair_offsets[i];
+        if (offset < tstamp_back_offset || entry_is_live(get_entry(left, offset))) {
             left_copysize -= sizeof(uint16_t);
         }
     }
@@ -1118,10 +1136,8 @@ bool is_mergable(value_sizer_t<void> *sizer, const leaf_node_t *node, const leaf
     return is_underfull(sizer, node) && is_underfull(sizer, sibling);
 }
 
-// Sets *index_out to the index for the live entry or deletion entry
-// for the key, or to the index the key would have if it were
-// inserted.  Returns true if the key at said index is actually equal.
-bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
+template <class cmp_t>
+bool find_key_with(const leaf_node_t *node, const cmp_t &cmp, int *index_out) {
     int beg = 0;
     int end = node->num_pairs;
 
@@ -1134,7 +1150,7 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
 
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = sized_strcmp(key->contents, key->size, ek->contents, ek->size);
+        int res = cmp(ek);
 
         if (res < 0) {
             // key < *test_point.
@@ -1156,6 +1172,29 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     return false;
 }
 
+// Sets *index_out to the index for the live entry or deletion entry
+// for the key, or to the index the key would have if it were
+// inserted.  Returns true if the key at said index is actually equal.
+bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
+    if (node->num_pairs > 0
+        && btree_key_prefixes_help(key,
+                                   entry_key(get_entry(node, node->pair_offsets[0])),
+                                   entry_key(get_entry(node, node->pair_offsets[node->num_pairs - 1])))) {
+        return find_key_with(node, btree_key_prefix_cmp_t(key), index_out);
+    } else {
+        return find_key_with(node, btree_key_plain_cmp_t(key), index_out);
+    }
+}
+
+bool is_at_end(const leaf_node_t *node, const btree_key_t *key) {
+    int index;
+    if (find_key(node, key, &index)) {
+        return index == node->num_pairs - 1;
+    } else {
+        return index == node->num_pairs;
+    }
+}
+
 bool lookup(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out) {
     int index;
     if (find_key(node, key, &index)) {
@@ -127,6 +127,12 @@ bool is_underfull(value_sizer_t<void> *sizer, const leaf_node_t *node);
 
 void split(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
 
+// Splits the node for a key that goes past its last one, leaving it
+// BTREE_APPEND_SPLIT_FILL_PERCENT percent full instead of half full, so that
+// keys written in ascending order pack their leaves. rnode can end up underfull;
+// writes at the end of a leaf don't level it (see apply_keyvalue_change).
+void split_for_append(value_sizer_t<void> *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_key_t *median_out);
+
 void merge(value_sizer_t<void> *sizer, leaf_node_t *left, leaf_node_t *right);
 
 bool level(value_sizer_t<void> *sizer, int nodecmp_node_with_sib, leaf_node_t *node, leaf_node_t *sibling, btree_key_t *replacement_key_out);
@@ -135,6 +141,9 @@ bool is_mergable(value_sizer_t<void> *sizer, const leaf_node_t *node, const leaf
 
 bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out);
 
+// Whether key is the last key in the node, or would be if it were inserted.
+bool is_at_end(const leaf_node_t *node, const btree_key_t *key);
+
 bool lookup(value_sizer_t<void> *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out);
 
 void insert(value_sizer_t<void> *sizer, leaf_node_t *node, const btree_key_t *key, const void *value, repli_timestamp_t tstamp, UNUSED key_modification_proof_t km_proof);
@@ -381,10 +381,19 @@ void check_and_handle_split(value_sizer_t<void> *sizer, transaction_t *txn, buf_
     store_key_t median_buffer;
     btree_key_t *median = median_buffer.btree_key();
 
-    node::split(sizer,
-                static_cast<node_t *>(buf->get_data_write()),
-                static_cast<node_t *>(rbuf.get_data_write()),
-                median);
+    // Keys written in ascending order always go past the end of the leaf, and
+    // an even split would leave every leaf behind them half empty.
+    if (node::is_leaf(node) && leaf::is_at_end(reinterpret_cast<const leaf_node_t *>(node), key)) {
+        leaf::split_for_append(sizer,
+                               static_cast<leaf_node_t *>(buf->get_data_write()),
+                               static_cast<leaf_node_t *>(rbuf.get_data_write()),
+                               median);
+    } else {
+        node::split(sizer,
+                    static_cast<node_t *>(buf->get_data_write()),
+                    static_cast<node_t *>(rbuf.get_data_write()),
+                    median);
+    }
     rbuf.set_eviction_priority(buf->get_eviction_priority());
 
     // Insert the key that sets the two nodes apart into the parent.
@@ -155,6 +155,22 @@ class null_key_modification_callback_t : public key_modification_callback_t<Valu
 };
 
 
+template <class Value>
+class multi_get_callback_t {
+public:
+    // Called by get_multiple_keys for every key that has a value, while the leaf
+    // it's in is still held. Calls for keys in different leaves can be made
+    // concurrently.
+    virtual void on_value(transaction_t *txn, size_t index, const Value *value) = 0;
+
+    multi_get_callback_t() { }
+protected:
+    virtual ~multi_get_callback_t() { }
+private:
+    DISABLE_COPYING(multi_get_callback_t);
+};
+
+
 /* This iterator encapsulates most of the metainfo data layout. Unfortunately,
  * functions set_superblock_metainfo and delete_superblock_metainfo also know a
  * lot about the data layout, so if it's changed, these functions must be
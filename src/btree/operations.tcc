@@ -1,11 +1,15 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "btree/operations.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
 #include "btree/slice.hpp"
 #include "buffer_cache/buffer_cache.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/promise.hpp"
 
 // TODO: consider B#/B* trees to improve space efficiency
@@ -92,6 +96,65 @@ void find_keyvalue_location_for_write(transaction_t *txn, superblock_t *superblo
     keyvalue_location_out->buf.swap(buf);
 }
 
+/* Returns whether key belongs in the leaf that keyvalue_location holds, going by
+ * what the leaf's parent says now. A batch of writes uses this to pick out the
+ * keys that it can hope to write without another descent. */
+template <class Value>
+bool keyvalue_location_covers(const keyvalue_location_t<Value> &keyvalue_location, const btree_key_t *key) {
+    if (keyvalue_location.last_buf.is_acquired()) {
+        const internal_node_t *parent = reinterpret_cast<const internal_node_t *>(keyvalue_location.last_buf.get_data_read());
+        return internal_node::lookup(parent, key) == keyvalue_location.buf.get_block_id();
+    }
+    // The leaf is the root, so every key goes in it.
+    return true;
+}
+
+/* Points keyvalue_location at key, if key belongs in the leaf that it already
+ * holds, so that a batch of writes to neighbouring keys doesn't have to go down
+ * the tree again for every one of them. Another change to the leaf can split or
+ * merge it, so its parent has to be in the state the descent would leave it in:
+ * not full and not underfull. If any of that isn't the case, this returns false
+ * and leaves keyvalue_location alone; the caller then has to destroy it and call
+ * find_keyvalue_location_for_write. */
+template <class Value>
+bool find_keyvalue_location_in_same_leaf(transaction_t *txn, const btree_key_t *key, keyvalue_location_t<Value> *keyvalue_location) {
+    value_sizer_t<Value> sizer(txn->get_cache()->get_block_size());
+
+    if (keyvalue_location->last_buf.is_acquired()) {
+        // A merge that left the root with one child deletes the root.
+        if (keyvalue_location->last_buf.is_deleted()) {
+            return false;
+        }
+
+        const internal_node_t *parent = reinterpret_cast<const internal_node_t *>(keyvalue_location->last_buf.get_data_read());
+        if (internal_node::is_full(parent)) {
+            return false;
+        }
+
+        // We still hold the superblock only if the parent is the root, which
+        // is never underfull.
+        if (!keyvalue_location->superblock && internal_node::is_underfull(sizer.block_size(), parent)) {
+            return false;
+        }
+
+        if (internal_node::lookup(parent, key) != keyvalue_location->buf.get_block_id()) {
+            return false;
+        }
+    } else if (!keyvalue_location->superblock) {
+        return false;
+    }
+
+    keyvalue_location->there_originally_was_value = false;
+    keyvalue_location->value.reset();
+
+    scoped_malloc_t<Value> tmp(sizer.max_possible_size());
+    if (leaf::lookup(&sizer, reinterpret_cast<const leaf_node_t *>(keyvalue_location->buf.get_data_read()), key, tmp.get())) {
+        keyvalue_location->there_originally_was_value = true;
+        keyvalue_location->value = std::move(tmp);
+    }
+    return true;
+}
+
 template <class Value>
 void find_keyvalue_location_for_read(transaction_t *txn, superblock_t *superblock, const btree_key_t *key, keyvalue_location_t<Value> *keyvalue_location_out, eviction_priority_t root_eviction_priority, btree_stats_t *stats) {
     stats->pm_keys_read.record();
@@ -140,6 +203,101 @@ void find_keyvalue_location_for_read(transaction_t *txn, superblock_t *superbloc
     }
 }
 
+/* The keys of a get_multiple_keys batch that go to one child of an internal node:
+ * keys[beg] up to (but not including) keys[end]. */
+struct multi_get_child_t {
+    multi_get_child_t(block_id_t _block_id, size_t _beg, size_t _end)
+        : block_id(_block_id), beg(_beg), end(_end) { }
+    block_id_t block_id;
+    size_t beg;
+    size_t end;
+};
+
+inline void get_multiple_keys_acquire_child(transaction_t *txn, const std::vector<multi_get_child_t> *children, eviction_priority_t eviction_priority, buf_lock_t *bufs_out, int i) {
+    buf_lock_t tmp(txn, (*children)[i].block_id, rwi_read);
+    tmp.set_eviction_priority(eviction_priority);
+    bufs_out[i].swap(tmp);
+}
+
+template <class Value>
+void get_multiple_keys_from_node(transaction_t *txn, buf_lock_t *buf, const std::vector<store_key_t> *keys, size_t beg, size_t end, multi_get_callback_t<Value> *cb);
+
+template <class Value>
+void get_multiple_keys_from_child(transaction_t *txn, buf_lock_t *bufs, const std::vector<multi_get_child_t> *children, const std::vector<store_key_t> *keys, multi_get_callback_t<Value> *cb, int i) {
+    get_multiple_keys_from_node(txn, &bufs[i], keys, (*children)[i].beg, (*children)[i].end, cb);
+}
+
+template <class Value>
+void get_multiple_keys_from_node(transaction_t *txn, buf_lock_t *buf, const std::vector<store_key_t> *keys, size_t beg, size_t end, multi_get_callback_t<Value> *cb) {
+    value_sizer_t<Value> sizer(txn->get_cache()->get_block_size());
+
+#ifndef NDEBUG
+    node::validate(&sizer, reinterpret_cast<const node_t *>(buf->get_data_read()));
+#endif  // NDEBUG
+
+    if (node::is_internal(reinterpret_cast<const node_t *>(buf->get_data_read()))) {
+        const internal_node_t *node = reinterpret_cast<const internal_node_t *>(buf->get_data_read());
+
+        // The keys are sorted, so the ones that go to the same child are next to
+        // each other.
+        std::vector<multi_get_child_t> children;
+        for (size_t i = beg; i < end; ++i) {
+            block_id_t child_id = internal_node::lookup(node, (*keys)[i].btree_key());
+            rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+            if (!children.empty() && children.back().block_id == child_id) {
+                children.back().end = i + 1;
+            } else {
+                children.push_back(multi_get_child_t(child_id, i, i + 1));
+            }
+        }
+
+        // Acquire all the children at once, so that the ones that aren't in the
+        // cache get loaded concurrently, and only then let go of the node.
+        scoped_array_t<buf_lock_t> child_bufs(children.size());
+        pmap(children.size(), boost::bind(&get_multiple_keys_acquire_child, txn, &children,
+                                          incr_priority(buf->get_eviction_priority()),
+                                          child_bufs.data(), _1));
+        buf->release();
+
+        pmap(children.size(), boost::bind(&get_multiple_keys_from_child<Value>, txn,
+                                          child_bufs.data(), &children, keys, cb, _1));
+    } else {
+        const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(buf->get_data_read());
+        scoped_malloc_t<Value> value(sizer.max_possible_size());
+        for (size_t i = beg; i < end; ++i) {
+            if (leaf::lookup(&sizer, leaf, (*keys)[i].btree_key(), value.get())) {
+                cb->on_value(txn, i, value.get());
+            }
+        }
+    }
+}
+
+/* Looks up all of keys, which have to be sorted, going down each path of the tree
+ * that leads to one of them only once. */
+template <class Value>
+void get_multiple_keys(transaction_t *txn, superblock_t *superblock, const std::vector<store_key_t> &keys, eviction_priority_t root_eviction_priority, btree_stats_t *stats, multi_get_callback_t<Value> *cb) {
+    rassert(std::is_sorted(keys.begin(), keys.end()));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        stats->pm_keys_read.record();
+    }
+
+    block_id_t node_id = superblock->get_root_block_id();
+    rassert(node_id != SUPERBLOCK_ID);
+
+    if (node_id == NULL_BLOCK_ID || keys.empty()) {
+        // There is no root, so the tree is empty.
+        superblock->release();
+        return;
+    }
+
+    buf_lock_t buf(txn, node_id, rwi_read);
+    buf.set_eviction_priority(root_eviction_priority);
+
+    superblock->release();
+
+    get_multiple_keys_from_node(txn, &buf, &keys, 0, keys.size(), cb);
+}
+
 template <class Value>
 void apply_keyvalue_change(transaction_t *txn, keyvalue_location_t<Value> *kv_loc, const btree_key_t *key, repli_timestamp_t tstamp, bool expired, key_modification_callback_t<Value> *km_callback, eviction_priority_t *root_eviction_priority) {
     value_sizer_t<Value> sizer(txn->get_cache()->get_block_size());
@@ -204,8 +362,15 @@ void apply_keyvalue_change(transaction_t *txn, keyvalue_location_t<Value> *kv_lo
     }
 
     // Check to see if the leaf is underfull (following a change in
-    // size or a deletion, and merge/level if it is.
-    check_and_handle_underfull(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key);
+    // size or a deletion, and merge/level if it is.  A leaf that just
+    // got a value at its end is left alone: it's usually the right half
+    // of an append split (see leaf::split_for_append) that the keys
+    // after this one are about to fill, and leveling it would undo the
+    // split.  The next write anywhere else in it takes care of it.
+    if (!kv_loc->value.has()
+        || !leaf::is_at_end(static_cast<const leaf_node_t *>(kv_loc->buf.get_data_read()), key)) {
+        check_and_handle_underfull(&sizer, txn, &kv_loc->buf, &kv_loc->last_buf, kv_loc->superblock, key);
+    }
 
     //Modify the stats block
     buf_lock_t stat_block(txn, kv_loc->stat_block, rwi_write, buffer_cache_order_mode_ignore);
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "errors.hpp"
 
+#include "btree/key_filter.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
@@ -50,6 +51,7 @@ void btree_slice_t::create(cache_t *cache, block_id_t superblock_id, transaction
 
 btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent, const std::string &identifier, block_id_t _superblock_id)
     : stats(parent, identifier),
+      key_lookup_misses(0),
       cache_(c),
       superblock_id_(_superblock_id),
       root_eviction_priority(INITIAL_ROOT_EVICTION_PRIORITY) {
@@ -58,4 +60,8 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent, const std
     pre_begin_txn_checkpoint_.set_tagappend("pre_begin_txn");
 }
 
-btree_slice_t::~btree_slice_t() { }
+btree_slice_t::~btree_slice_t() {
+    if (key_filter.has()) {
+        key_filter->detach();
+    }
+}
@@ -7,12 +7,14 @@
 
 #include "buffer_cache/types.hpp"
 #include "concurrency/fifo_checker.hpp"
+#include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "perfmon/perfmon.hpp"
 
 const unsigned int STARTING_ROOT_EVICTION_PRIORITY = 2 << 16;
 
 class backfill_callback_t;
+class key_filter_t;
 class key_tester_t;
 
 class btree_stats_t {
@@ -27,6 +29,13 @@ public:
               &pm_keys_read, "keys_read",
               &pm_keys_set, "keys_set",
               &pm_keys_expired, "keys_expired",
+              NULLPTR),
+          pm_key_filter_negatives(secs_to_ticks(1)),
+          pm_key_filter_false_positives(secs_to_ticks(1)),
+          pm_key_filter_membership(&btree_collection,
+              &pm_key_filter_negatives, "key_filter_negatives",
+              &pm_key_filter_false_positives, "key_filter_false_positives",
+              &pm_key_filter_bytes, "key_filter_bytes",
               NULLPTR)
     { }
 
@@ -37,6 +46,14 @@ public:
         pm_keys_set,
         pm_keys_expired;
     perfmon_multi_membership_t pm_keys_membership;
+
+    // Lookups that the key filter saved from going down the tree, and lookups that
+    // it let go down the tree for nothing.
+    perfmon_rate_monitor_t
+        pm_key_filter_negatives,
+        pm_key_filter_false_positives;
+    perfmon_counter_t pm_key_filter_bytes;
+    perfmon_multi_membership_t pm_key_filter_membership;
 };
 
 /* btree_slice_t is a thin wrapper around cache_t that handles initializing the buffer
@@ -68,6 +85,14 @@ public:
 
     btree_stats_t stats;
 
+    // Created the first time somebody wants to skip lookups of missing keys; see
+    // btree/key_filter.hpp.
+    counted_t<key_filter_t> key_filter;
+
+    // How many lookups of single keys found nothing without having a ready key filter
+    // to ask; in KEY_FILTER_MODE_AUTO that's what decides when a btree gets one.
+    int64_t key_lookup_misses;
+
     block_id_t get_superblock_id();
 private:
     cache_t *cache_;
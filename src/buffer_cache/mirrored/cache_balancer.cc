@@ -0,0 +1,153 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/cache_balancer.hpp"
+
+#include <algorithm>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "buffer_cache/mirrored/mirrored.hpp"
+#include "concurrency/pmap.hpp"
+
+cache_balancer_t::cache_balancer_t(int64_t _total_size, int64_t interval_ms)
+    : total_size(_total_size),
+      allocated_size(0),
+      timer(interval_ms, this) { }
+
+cache_balancer_t::~cache_balancer_t() {
+    assert_thread();
+    rassert(caches.empty());
+}
+
+int64_t cache_balancer_t::register_cache(mc_cache_t *cache, int64_t requested_size) {
+    const threadnum_t cache_thread = get_thread_id();
+    on_thread_t th(home_thread());
+    mutex_t::acq_t acq(&mutex);
+
+    // A cache always gets its minimum, even if that overcommits the budget for a
+    // while; the next round takes it back from somebody else.
+    const int64_t free_size = std::max<int64_t>(total_size - allocated_size, 0);
+    const int64_t size = std::max(std::min(requested_size, free_size),
+                                  std::min<int64_t>(requested_size,
+                                                    CACHE_BALANCER_MIN_CACHE_SIZE));
+
+    guarantee(caches.find(cache) == caches.end());
+    cache_info_t *info = &caches[cache];
+    info->cache = cache;
+    info->thread = cache_thread;
+    info->size = size;
+    allocated_size += size;
+    return size;
+}
+
+void cache_balancer_t::unregister_cache(mc_cache_t *cache) {
+    on_thread_t th(home_thread());
+    mutex_t::acq_t acq(&mutex);
+
+    std::map<mc_cache_t *, cache_info_t>::iterator it = caches.find(cache);
+    guarantee(it != caches.end());
+    allocated_size -= it->second.size;
+    caches.erase(it);
+}
+
+void cache_balancer_t::on_ring() {
+    // Don't let rounds pile up if one takes longer than the interval.
+    if (!mutex.is_locked()) {
+        coro_t::spawn_sometime(boost::bind(&cache_balancer_t::rebalance, this,
+                                           auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
+bool cache_balancer_t::has_higher_benefit(const cache_info_t *a, const cache_info_t *b) {
+    return a->benefit > b->benefit;
+}
+
+void cache_balancer_t::rebalance(UNUSED auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    mutex_t::acq_t acq(&mutex);
+    if (caches.empty()) {
+        return;
+    }
+
+    std::vector<cache_info_t *> infos;
+    for (std::map<mc_cache_t *, cache_info_t>::iterator it = caches.begin();
+         it != caches.end();
+         ++it) {
+        infos.push_back(&it->second);
+    }
+
+    pmap(infos.size(), boost::bind(&cache_balancer_t::take_sample, this, &infos, _1));
+
+    std::map<cache_info_t *, int64_t> old_sizes;
+    for (size_t i = 0; i < infos.size(); ++i) {
+        cache_info_t *info = infos[i];
+        const double benefit = info->sample.ghost_size == 0
+            ? 0.0
+            : static_cast<double>(info->sample.ghost_hits) / info->sample.ghost_size;
+        info->benefit = (info->benefit + benefit) / 2;
+        info->step = info->sample.ghost_size;
+        old_sizes[info] = info->size;
+    }
+
+    std::sort(infos.begin(), infos.end(), &cache_balancer_t::has_higher_benefit);
+
+    // If caches got their minimum size when the budget was used up, take that
+    // memory back from the caches that need it least.
+    for (size_t i = infos.size(); i-- > 0 && allocated_size > total_size;) {
+        const int64_t spare = infos[i]->size - CACHE_BALANCER_MIN_CACHE_SIZE;
+        if (spare > 0) {
+            const int64_t amount = std::min(spare, allocated_size - total_size);
+            infos[i]->size -= amount;
+            allocated_size -= amount;
+        }
+    }
+
+    // Memory that nobody has (because a table went away, for example) goes to the
+    // caches that want it most.
+    for (size_t i = 0; i < infos.size() && allocated_size < total_size; ++i) {
+        if (infos[i]->benefit <= 0) {
+            break;
+        }
+        const int64_t amount = std::min(infos[i]->step, total_size - allocated_size);
+        infos[i]->size += amount;
+        allocated_size += amount;
+    }
+
+    // Then each of the caches that would gain the most takes a step from one of the
+    // caches that would lose the least.
+    size_t receiver = 0;
+    size_t donor = infos.size() - 1;
+    while (receiver < donor && infos[receiver]->benefit > infos[donor]->benefit) {
+        const int64_t spare = infos[donor]->size - CACHE_BALANCER_MIN_CACHE_SIZE;
+        if (spare <= 0) {
+            --donor;
+            continue;
+        }
+        const int64_t amount = std::min(infos[receiver]->step, spare);
+        infos[donor]->size -= amount;
+        infos[receiver]->size += amount;
+        ++receiver;
+        --donor;
+    }
+
+    std::vector<cache_info_t *> changed;
+    for (size_t i = 0; i < infos.size(); ++i) {
+        if (infos[i]->size != old_sizes[infos[i]]) {
+            changed.push_back(infos[i]);
+        }
+    }
+    pmap(changed.size(), boost::bind(&cache_balancer_t::apply_size, this, &changed, _1));
+}
+
+void cache_balancer_t::take_sample(const std::vector<cache_info_t *> *infos, int i) {
+    cache_info_t *info = (*infos)[i];
+    on_thread_t th(info->thread);
+    info->sample = info->cache->take_balancer_sample();
+}
+
+void cache_balancer_t::apply_size(const std::vector<cache_info_t *> *infos, int i) {
+    cache_info_t *info = (*infos)[i];
+    on_thread_t th(info->thread);
+    info->cache->set_max_size(info->size);
+}
@@ -0,0 +1,98 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_CACHE_BALANCER_HPP_
+#define BUFFER_CACHE_MIRRORED_CACHE_BALANCER_HPP_
+
+#include <map>
+#include <vector>
+
+#include "arch/timing.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/mutex.hpp"
+#include "utils.hpp"
+
+class mc_cache_t;
+
+/* What a cache tells the balancer about the time since it was last asked. */
+struct cache_balancer_sample_t {
+    cache_balancer_sample_t()
+        : hits(0), misses(0), ghost_hits(0), ghost_size(0) { }
+
+    int64_t hits;
+    int64_t misses;
+
+    // Misses on blocks that were among the last `ghost_size` bytes worth of blocks
+    // the cache evicted. They would have been hits had the cache been that much
+    // bigger.
+    int64_t ghost_hits;
+    int64_t ghost_size;
+};
+
+/* `cache_balancer_t` divides a node-wide memory budget between the buffer caches of
+all the tables on the node. Each cache starts out with what its table asks for, if
+there is that much left, and every `interval_ms` the balancer moves memory from the
+caches that would miss it least to the ones that would gain the most from it.
+
+The gain is measured with ghost lists: each cache remembers which blocks it evicted
+recently, and a miss on one of the last `ghost_size` bytes worth of them is a miss
+that a cache `ghost_size` bytes bigger wouldn't have had. Ghost hits per ghost byte
+are the cache's marginal benefit. The balancer pairs up the caches with the highest
+benefit with those with the lowest, and moves one step (the receiving cache's ghost
+size) from each donor to its receiver. We don't keep track of the other end of the
+donor's hit curve, so we take its ghost benefit as what it loses by shrinking;
+since hit curves flatten out as caches grow, that underestimates the loss a bit,
+and the smoothing over rounds keeps that from turning into oscillation.
+
+The balancer lives on the thread it was created on; caches register and unregister
+from their own threads. Only the clean page limit is moved around; the caches' dirty
+page limits stay what they were configured to be. */
+
+class cache_balancer_t : public home_thread_mixin_t, private repeating_timer_callback_t {
+public:
+    cache_balancer_t(int64_t total_size, int64_t interval_ms);
+    ~cache_balancer_t();
+
+    // Called by `mc_cache_t` on its own thread. Returns the cache's size in bytes.
+    int64_t register_cache(mc_cache_t *cache, int64_t requested_size);
+    void unregister_cache(mc_cache_t *cache);
+
+    int64_t get_total_size() const { return total_size; }
+
+private:
+    struct cache_info_t {
+        cache_info_t() : cache(NULL), thread(-1), size(0), benefit(0), step(0) { }
+
+        mc_cache_t *cache;
+        threadnum_t thread;
+        int64_t size;
+
+        // Ghost hits per byte of ghost list, smoothed over rounds.
+        double benefit;
+        int64_t step;
+
+        cache_balancer_sample_t sample;
+    };
+
+    static bool has_higher_benefit(const cache_info_t *a, const cache_info_t *b);
+
+    void on_ring();
+    void rebalance(auto_drainer_t::lock_t keepalive);
+
+    void take_sample(const std::vector<cache_info_t *> *infos, int i);
+    void apply_size(const std::vector<cache_info_t *> *infos, int i);
+
+    const int64_t total_size;
+    int64_t allocated_size;
+
+    std::map<mc_cache_t *, cache_info_t> caches;
+
+    // Held while a round is in progress, and while caches come and go, so that a
+    // round never sees a cache that is being destroyed.
+    mutex_t mutex;
+
+    auto_drainer_t drainer;
+    repeating_timer_t timer;
+
+    DISABLE_COPYING(cache_balancer_t);
+};
+
+#endif  // BUFFER_CACHE_MIRRORED_CACHE_BALANCER_HPP_
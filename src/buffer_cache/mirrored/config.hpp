@@ -8,6 +8,17 @@
 
 #define NEVER_FLUSH (-1)
 
+class cache_balancer_t;
+
+/* Which page replacement policy the cache uses; see page_repl.hpp. */
+enum page_repl_policy_t {
+    PAGE_REPL_POLICY_RANDOM = 0,
+    PAGE_REPL_POLICY_2Q
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(page_repl_policy_t, int8_t,
+                                      PAGE_REPL_POLICY_RANDOM, PAGE_REPL_POLICY_2Q);
+
 /* Configuration for the cache (it can all change from run to run) */
 
 struct mirrored_cache_config_t {
@@ -20,6 +31,8 @@ struct mirrored_cache_config_t {
         max_concurrent_flushes = DEFAULT_MAX_CONCURRENT_FLUSHES;
         io_priority_reads = CACHE_READS_IO_PRIORITY;
         io_priority_writes = CACHE_WRITES_IO_PRIORITY;
+        page_repl_policy = PAGE_REPL_POLICY_2Q;
+        balancer = NULL;
     }
 
     // Max amount of memory that will be used for the cache, in bytes.
@@ -49,6 +62,15 @@ struct mirrored_cache_config_t {
     int io_priority_reads;
     int io_priority_writes;
 
+    // The policy used to choose which blocks to evict when the cache is full. The
+    // --cache-replacement-policy serve option sets it for all of a server's tables.
+    page_repl_policy_t page_repl_policy;
+
+    // If this is set, the cache gets its size from the node-wide balancer rather
+    // than from max_size, which is then only what it asks for at first. This only
+    // makes sense on this node, so it isn't serialized.
+    cache_balancer_t *balancer;
+
     void rdb_serialize(write_message_t &msg /* NOLINT */) const {
         msg << max_size;
         msg << flush_timer_ms;
@@ -57,6 +79,7 @@ struct mirrored_cache_config_t {
         msg << max_concurrent_flushes;
         msg << io_priority_reads;
         msg << io_priority_writes;
+        msg << page_repl_policy;
     }
 
     archive_result_t rdb_deserialize(read_stream_t *s) {
@@ -74,6 +97,8 @@ struct mirrored_cache_config_t {
         res = deserialize(s, &io_priority_reads);
         if (res) { return res; }
         res = deserialize(s, &io_priority_writes);
+        if (res) { return res; }
+        res = deserialize(s, &page_repl_policy);
         return res;
     }
 };
@@ -185,8 +185,14 @@ void mc_inner_buf_t::load_inner_buf(bool should_lock, file_account_t *io_account
     }
 }
 
+void mc_inner_buf_t::load_inner_buf_with_keepalive(file_account_t *io_account,
+                                                   UNUSED auto_drainer_t::lock_t keepalive) {
+    load_inner_buf(true, io_account);
+}
+
 // This form of the buf constructor is used when the block exists on disk and needs to be loaded
-mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_account_t *_io_account)
+mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_account_t *_io_account,
+                               auto_drainer_t::lock_t keepalive)
     : evictable_t(_cache),
       writeback_t::local_buf_t(),
       block_id(_block_id),
@@ -207,7 +213,7 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, file_ac
     // Some things expect us to return immediately (as of 5/12/2011), so we do the loading in a
     // separate coro. We have to make sure that load_inner_buf() acquires the lock first
     // however, so we use spawn_now_dangerously().
-    coro_t::spawn_now_dangerously(boost::bind(&mc_inner_buf_t::load_inner_buf, this, true, _io_account));
+    coro_t::spawn_now_dangerously(boost::bind(&mc_inner_buf_t::load_inner_buf_with_keepalive, this, _io_account, keepalive));
 
     // TODO: only increment pm_n_blocks_in_memory when we actually load the block into memory.
     ++_cache->stats->pm_n_blocks_in_memory;
@@ -328,6 +334,7 @@ mc_inner_buf_t::mc_inner_buf_t(mc_cache_t *_cache, block_id_t _block_id, version
 }
 
 void mc_inner_buf_t::unload() {
+    cache->note_evicted(block_id);
     delete this;
 }
 
@@ -519,6 +526,8 @@ mc_buf_lock_t::mc_buf_lock_t(mc_transaction_t *transaction,
         // scattered around everywhere (eg: here). consolidate it, perhaps in mc_buf_lock_t.
         rassert(!inner_buf->do_delete || snapshotted);
 
+        inner_buf->touch_page_repl();
+
         // ensures we're using the top version
         if (!inner_buf->data.has() && !inner_buf->do_delete &&
             // if we're accessing a snapshot rather than the top version, no need to load it here
@@ -1186,6 +1195,11 @@ void mc_transaction_t::get_subtree_recencies(block_id_t *block_ids, size_t num_b
     }
 }
 
+bool mc_transaction_t::prefetch_block(block_id_t block_id) {
+    assert_thread();
+    return cache->prefetch_block(block_id);
+}
+
 mc_cache_account_t::mc_cache_account_t(threadnum_t thread, file_account_t *io_account)
     : thread_(thread), io_account_(io_account) { }
 
@@ -1224,6 +1238,7 @@ mc_cache_t::mc_cache_t(serializer_t *_serializer,
     page_repl(
         // Launch page replacement if the user-specified maximum number of blocks is reached
         dynamic_config.max_size / _serializer->get_block_size().ser_value(),
+        dynamic_config.page_repl_policy,
         this),
     writeback(
         this,
@@ -1238,7 +1253,9 @@ mc_cache_t::mc_cache_t(serializer_t *_serializer,
     num_live_non_writeback_transactions(0),
     to_pulse_when_last_transaction_commits(NULL),
     read_ahead_registered(false),
-    next_snapshot_version(mc_inner_buf_t::faux_version_id+1) {
+    prefetch_drainer(new auto_drainer_t),
+    next_snapshot_version(mc_inner_buf_t::faux_version_id+1),
+    num_evictions(0) {
 
     {
         on_thread_t thread_switcher(serializer->home_thread());
@@ -1252,11 +1269,21 @@ mc_cache_t::mc_cache_t(serializer_t *_serializer,
 
     /* Init the stat system with the block size */
     stats->pm_block_size.block_size = get_block_size().ser_value();
+    stats->pm_cache_size += dynamic_config.max_size;
+
+    if (dynamic_config.balancer != NULL) {
+        set_max_size(dynamic_config.balancer->register_cache(this, dynamic_config.max_size));
+    }
 }
 
 mc_cache_t::~mc_cache_t() {
     assert_thread();
 
+    // After this, the balancer won't touch us anymore.
+    if (dynamic_config.balancer != NULL) {
+        dynamic_config.balancer->unregister_cache(this);
+    }
+
     shutting_down = true;
     serializer->unregister_read_ahead_cb(this);
 
@@ -1281,6 +1308,10 @@ mc_cache_t::~mc_cache_t() {
     }
 
     rassert(!writeback.has_active_flushes());
+
+    /* Wait for the loads of prefetched blocks */
+    prefetch_drainer.reset();
+
     rassert(num_live_writeback_transactions + num_live_non_writeback_transactions == 0,
             "num_live_writeback_transactions = %d, num_live_non_writeback_transactions = %d",
             num_live_writeback_transactions, num_live_non_writeback_transactions);
@@ -1356,12 +1387,66 @@ mc_inner_buf_t *mc_cache_t::find_buf(block_id_t block_id) {
     mc_inner_buf_t *buf = page_map.find(block_id);
     if (buf) {
         ++stats->pm_cache_hits;
+        ++balancer_sample.hits;
     } else {
         ++stats->pm_cache_misses;
+        ++balancer_sample.misses;
+
+        const uint64_t evicted = evicted_at.get(block_id);
+        if (evicted != 0) {
+            evicted_at.set(block_id, 0);
+            const uint64_t ghost_blocks = ghost_size() / get_block_size().ser_value();
+            if (num_evictions - evicted < ghost_blocks) {
+                ++stats->pm_ghost_hits;
+                ++balancer_sample.ghost_hits;
+            }
+        }
     }
     return buf;
 }
 
+void mc_cache_t::set_max_size(int64_t max_size) {
+    assert_thread();
+    stats->pm_cache_size += max_size - dynamic_config.max_size;
+
+    // The dirty limit stays the same fraction of the cache. Otherwise a shrunken cache
+    // could fill up with dirty blocks that it can't unload, and a grown one would
+    // still throttle writes as if it were small.
+    dynamic_config.max_dirty_size = static_cast<int64_t>(
+        static_cast<double>(dynamic_config.max_dirty_size) * max_size / dynamic_config.max_size);
+    dynamic_config.max_size = max_size;
+
+    const int64_t block_size = get_block_size().ser_value();
+    page_repl.set_unload_threshold(max_size / block_size);
+    writeback.set_max_dirty_blocks(dynamic_config.max_dirty_size / block_size);
+    page_repl.make_space();
+}
+
+cache_balancer_sample_t mc_cache_t::take_balancer_sample() {
+    assert_thread();
+    cache_balancer_sample_t sample = balancer_sample;
+    sample.ghost_size = ghost_size();
+    balancer_sample = cache_balancer_sample_t();
+
+    const int64_t accesses = sample.hits + sample.misses;
+    if (accesses > 0) {
+        stats->pm_hit_ratio.hit_ratio = static_cast<double>(sample.hits) / accesses;
+    }
+    return sample;
+}
+
+int64_t mc_cache_t::ghost_size() const {
+    return std::max<int64_t>(dynamic_config.max_size * CACHE_BALANCER_STEP_FRACTION,
+                             CACHE_BALANCER_MIN_STEP);
+}
+
+void mc_cache_t::note_evicted(block_id_t block_id) {
+    if (dynamic_config.balancer != NULL) {
+        ++num_evictions;
+        evicted_at.set(block_id, num_evictions);
+    }
+}
+
 unsigned int mc_cache_t::num_blocks() {
     return page_map.num_pages();
 }
@@ -1370,6 +1455,28 @@ bool mc_cache_t::contains_block(block_id_t block_id) {
     return find_buf(block_id) != NULL;
 }
 
+bool mc_cache_t::prefetch_block(block_id_t block_id) {
+    assert_thread();
+
+    // We don't go through find_buf(), because this isn't an access; the cache
+    // hit or miss gets counted when the block is actually acquired.
+    mc_inner_buf_t *inner_buf = page_map.find(block_id);
+    if (inner_buf != NULL) {
+        return inner_buf->data.has() && !inner_buf->lock.locked();
+    }
+
+    if (shutting_down || !writeback.can_read_ahead_block_be_accepted(block_id)) {
+        return false;
+    }
+
+    // The buf is locked until it's loaded, so nothing can evict it in the meantime.
+    inner_buf = new mc_inner_buf_t(this, block_id, reads_io_account.get(),
+                                   auto_drainer_t::lock_t(prefetch_drainer.get()));
+    inner_buf->mark_prefetched();
+    ++stats->pm_n_blocks_prefetched;
+    return false;
+}
+
 
 void mc_cache_t::create_cache_account(int priority, scoped_ptr_t<mc_cache_account_t> *out) {
     // We assume that a priority of 100 means that the transaction should have the same priority as
@@ -10,6 +10,7 @@
 #include "arch/types.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/access.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/coro_fifo.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/rwi_lock.hpp"
@@ -17,17 +18,19 @@
 #include "concurrency/mutex.hpp"
 #include "containers/intrusive_list.hpp"
 #include "containers/scoped.hpp"
+#include "buffer_cache/mirrored/cache_balancer.hpp"
 #include "buffer_cache/mirrored/config.hpp"
 #include "buffer_cache/mirrored/stats.hpp"
 #include "repli_timestamp.hpp"
 
 #include "buffer_cache/mirrored/writeback.hpp"
 
-#include "buffer_cache/mirrored/page_repl_random.hpp"
+#include "buffer_cache/mirrored/page_repl.hpp"
 
 #include "buffer_cache/mirrored/free_list.hpp"
 
 #include "buffer_cache/mirrored/page_map.hpp"
+#include "containers/two_level_array.hpp"
 
 
 class mc_cache_account_t;
@@ -42,7 +45,7 @@ class mc_inner_buf_t : public evictable_t,
     friend class mc_buf_lock_t;
     friend class writeback_t;
     friend class writeback_t::local_buf_t;
-    friend class page_repl_random_t;
+    friend class page_repl_t;
     friend class array_map_t;
 
     typedef uint64_t version_id_t;
@@ -60,8 +63,9 @@ class mc_inner_buf_t : public evictable_t,
     bool safe_to_unload();
     void unload();
 
-    // Load an existing buf from disk
-    mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id, file_account_t *io_account);
+    // Load an existing buf from disk. `keepalive` is held until the load is done.
+    mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id, file_account_t *io_account,
+                   auto_drainer_t::lock_t keepalive = auto_drainer_t::lock_t());
 
     // Load an existing buf but use the provided data buffer (for read ahead)
     mc_inner_buf_t(mc_cache_t *cache, block_id_t block_id,
@@ -77,6 +81,7 @@ class mc_inner_buf_t : public evictable_t,
 
     // Loads data from the serializer.
     void load_inner_buf(bool should_lock, file_account_t *io_account);
+    void load_inner_buf_with_keepalive(file_account_t *io_account, auto_drainer_t::lock_t keepalive);
 
     // Informs us that a certain data buffer (whether the current one or one used by a
     // buf_snapshot_t) has been written back to disk; used by writeback
@@ -256,6 +261,12 @@ public:
 
     void get_subtree_recencies(block_id_t *block_ids, size_t num_block_ids, repli_timestamp_t *recencies_out, get_subtree_recencies_callback_t *cb);
 
+    // Starts loading `block_id` in the background, so that acquiring it later won't
+    // have to wait for the disk. Returns true if the block is already in memory and
+    // not being loaded. The block must not be deleted while we are looking at it,
+    // which is the case for the children of a node the caller holds a lock on.
+    bool prefetch_block(block_id_t block_id);
+
     // This just sets the snapshotted flag, we finalize the snapshot as soon as the first block has been acquired (see finalize_version() )
     void snapshot();
 
@@ -316,9 +327,10 @@ class mc_cache_t : public home_thread_mixin_t, public serializer_read_ahead_call
     friend class mc_transaction_t;
     friend class writeback_t;
     friend class writeback_t::local_buf_t;
-    friend class page_repl_random_t;
+    friend class page_repl_t;
     friend class evictable_t;
     friend class array_map_t;
+    friend class cache_balancer_t;
 
 public:
     typedef mc_buf_lock_t buf_lock_type;
@@ -331,12 +343,23 @@ public:
 
     block_size_t get_block_size() const;
 
+    // How much memory the cache may use, in bytes. This changes over time if the
+    // cache has a balancer.
+    int64_t get_max_size() const { return dynamic_config.max_size; }
+
+    // How much unsaved data the cache may hold before it throttles writes. It stays
+    // the same fraction of `get_max_size()`.
+    int64_t get_max_dirty_size() const { return dynamic_config.max_dirty_size; }
+
     // TODO: Come up with a consistent priority scheme, i.e. define a "default" priority etc.
     // TODO: As soon as we can support it, we might consider supporting a mem_cap paremeter.
     void create_cache_account(int priority, scoped_ptr_t<mc_cache_account_t> *out);
 
     bool contains_block(block_id_t block_id);
 
+    // See mc_transaction_t::prefetch_block().
+    bool prefetch_block(block_id_t block_id);
+
     unsigned int num_blocks();
 
     mc_inner_buf_t::version_id_t get_current_version_id() { return next_snapshot_version; }
@@ -365,6 +388,12 @@ private:
     mc_inner_buf_t *find_buf(block_id_t block_id);
     void on_transaction_commit(mc_transaction_t *txn);
 
+    // Used by the balancer.
+    void set_max_size(int64_t max_size);
+    cache_balancer_sample_t take_balancer_sample();
+    int64_t ghost_size() const;
+    void note_evicted(block_id_t block_id);
+
 public:
     void offer_read_ahead_buf(block_id_t block_id,
                               scoped_malloc_t<ser_buffer_t> *buf,
@@ -405,7 +434,7 @@ private:
     scoped_ptr_t<file_account_t> writes_io_account;
 
     array_map_t page_map;
-    page_repl_random_t page_repl;
+    page_repl_t page_repl;
     writeback_t writeback;
     array_free_list_t free_list;
 
@@ -423,11 +452,22 @@ private:
 
     bool read_ahead_registered;
 
+    // Prefetched blocks are loaded outside of any transaction, so the destructor
+    // has to wait for them separately.
+    scoped_ptr_t<auto_drainer_t> prefetch_drainer;
+
     std::map<mc_inner_buf_t::version_id_t, mc_transaction_t *> active_snapshots;
     mc_inner_buf_t::version_id_t next_snapshot_version;
 
     coro_fifo_t co_begin_coro_fifo_;
 
+    // If we have a balancer, `evicted_at` is the value `num_evictions` had when each
+    // block was last evicted (or 0). A miss on a block evicted fewer than
+    // `ghost_size()` bytes ago is a ghost hit.
+    uint64_t num_evictions;
+    two_level_array_t<uint64_t> evicted_at;
+    cache_balancer_sample_t balancer_sample;
+
     DISABLE_COPYING(mc_cache_t);
 };
 
@@ -1,12 +1,13 @@
-// Copyright 2010-2012 RethinkDB, all rights reserved.
-#include "buffer_cache/mirrored/page_repl_random.hpp"
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "buffer_cache/mirrored/page_repl.hpp"
 
 #include "buffer_cache/mirrored/mirrored.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 
 evictable_t::evictable_t(mc_cache_t *_cache, bool loaded)
-    : eviction_priority(DEFAULT_EVICTION_PRIORITY), cache(_cache), page_repl_index(static_cast<size_t>(-1))
+    : eviction_priority(DEFAULT_EVICTION_PRIORITY), cache(_cache), page_repl_index(static_cast<size_t>(-1)),
+      page_repl_protected(false), page_repl_referenced(false), page_repl_prefetched(false)
 {
     cache->assert_thread();
     if (loaded) {
@@ -31,12 +32,15 @@ void evictable_t::insert_into_page_repl() {
     cache->assert_thread();
     page_repl_index = cache->page_repl.array.size();
     cache->page_repl.array.push_back(this);
+    // Everything starts out on probation.
+    page_repl_referenced = false;
 }
 
 void evictable_t::remove_from_page_repl() {
     cache->assert_thread();
 
     rassert(page_repl_index < cache->page_repl.array.size());
+    set_protected(false);
     evictable_t *replacement = cache->page_repl.array.back();
     replacement->page_repl_index = page_repl_index;
     std::swap(cache->page_repl.array[page_repl_index],
@@ -45,12 +49,64 @@ void evictable_t::remove_from_page_repl() {
     page_repl_index = static_cast<size_t>(-1);
 }
 
-page_repl_random_t::page_repl_random_t(size_t _unload_threshold, cache_t *_cache)
+void evictable_t::touch_page_repl() {
+    cache->assert_thread();
+    if (page_repl_prefetched) {
+        // This is the access we were prefetched for, not a second one.
+        page_repl_prefetched = false;
+        ++cache->stats->pm_n_prefetch_hits;
+        return;
+    }
+
+    if (!in_page_repl() || cache->page_repl.policy != PAGE_REPL_POLICY_2Q) {
+        return;
+    }
+
+    if (page_repl_protected) {
+        page_repl_referenced = true;
+    } else {
+        // Second access: we're part of the working set, not a scan.
+        set_protected(true);
+        page_repl_referenced = false;
+    }
+}
+
+void evictable_t::mark_prefetched() {
+    cache->assert_thread();
+    rassert(!page_repl_protected);
+    page_repl_prefetched = true;
+}
+
+void evictable_t::set_protected(bool is_protected) {
+    if (page_repl_protected == is_protected) {
+        return;
+    }
+    page_repl_protected = is_protected;
+    if (is_protected) {
+        ++cache->page_repl.protected_count;
+        ++cache->stats->pm_n_blocks_protected;
+    } else {
+        rassert(cache->page_repl.protected_count > 0);
+        --cache->page_repl.protected_count;
+        --cache->stats->pm_n_blocks_protected;
+    }
+}
+
+page_repl_t::page_repl_t(size_t _unload_threshold, page_repl_policy_t _policy, cache_t *_cache)
     : unload_threshold(_unload_threshold),
-      cache(_cache)
+      policy(_policy),
+      cache(_cache),
+      protected_count(0),
+      protected_limit(static_cast<size_t>(_unload_threshold * PAGE_REPL_2Q_PROTECTED_FRACTION))
     {}
 
-bool page_repl_random_t::is_full(size_t space_needed) {
+void page_repl_t::set_unload_threshold(size_t _unload_threshold) {
+    cache->assert_thread();
+    unload_threshold = _unload_threshold;
+    protected_limit = static_cast<size_t>(unload_threshold * PAGE_REPL_2Q_PROTECTED_FRACTION);
+}
+
+bool page_repl_t::is_full(size_t space_needed) {
     cache->assert_thread();
     return array.size() + space_needed > unload_threshold;
 }
@@ -65,10 +121,36 @@ size_t randsize(size_t n) {
     return x % n;
 }
 
+bool page_repl_t::is_better_victim(evictable_t *current, evictable_t *candidate) {
+    if (current == NULL) {
+        return true;
+    }
+
+    if (policy == PAGE_REPL_POLICY_2Q
+        && current->page_repl_protected != candidate->page_repl_protected) {
+        // Probationary bufs always go before protected ones.
+        return current->page_repl_protected;
+    }
+
+    return current->eviction_priority < candidate->eviction_priority;
+}
+
+void page_repl_t::age_protected(evictable_t *block) {
+    rassert(block->page_repl_protected);
+    if (protected_count <= protected_limit) {
+        return;
+    }
+
+    if (block->page_repl_referenced) {
+        block->page_repl_referenced = false;
+    } else {
+        block->set_protected(false);
+    }
+}
 
 // make_space tries to make sure that the number of blocks currently in memory is at least
 // 'space_needed' less than the user-specified memory limit.
-void page_repl_random_t::make_space(size_t space_needed) {
+void page_repl_t::make_space(size_t space_needed) {
     cache->assert_thread();
     size_t target;
     // TODO(rntz): why, if more space is needed than unload_threshold, do we set the target number
@@ -90,12 +172,13 @@ void page_repl_random_t::make_space(size_t space_needed) {
 
             // TODO we don't have code that sets buf_snapshot_t eviction priorities.
 
+            if (policy == PAGE_REPL_POLICY_2Q && block->page_repl_protected) {
+                age_protected(block);
+            }
+
             if (!block->safe_to_unload()) {
                 /* nothing to do here, jetpack away to the next iteration of this loop */
-            } else if (block_to_unload == NULL) {
-                /* The block is safe to unload, and our only candidate so far, so he's in */
-                block_to_unload = block;
-            } else if (block_to_unload->eviction_priority < block->eviction_priority) {
+            } else if (is_better_victim(block_to_unload, block)) {
                 /* This block is a better candidate than one before, he's in */
                 block_to_unload = block;
             } else {
@@ -123,7 +206,7 @@ void page_repl_random_t::make_space(size_t space_needed) {
     }
 }
 
-evictable_t *page_repl_random_t::get_first_buf() {
+evictable_t *page_repl_t::get_first_buf() {
     cache->assert_thread();
     return array.empty() ? NULL : array[0];
 }
@@ -0,0 +1,135 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
+#define BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
+
+#include <vector>
+
+#include "buffer_cache/mirrored/config.hpp"
+#include "buffer_cache/types.hpp"
+#include "containers/segmented_vector.hpp"
+#include "config/args.hpp"
+
+/* The page replacement component needs to be able to quickly choose a random
+buf among all the bufs in memory. This is accomplished using a dense array of
+evictable_t* in a completely arbitrary order.  Because the array is dense, choosing a
+random buf is as simple as choosing a random number less than the number of bufs in
+memory. When a buf is removed from memory, the last buf in the array is moved to the
+slot it last occupied, keeping the array dense. Each buf carries an index which is
+its position in the dense random array; this allows all insertion, deletion, and
+random selection to be done in constant time.
+
+On top of the random sampling, the policy decides which of the sampled bufs to
+evict:
+
+ - PAGE_REPL_POLICY_RANDOM picks the sampled buf with the highest eviction
+   priority, ignoring how recently or often it was used.
+
+ - PAGE_REPL_POLICY_2Q is a sampled approximation of 2Q. Bufs enter the cache in
+   a probationary segment and are promoted to the protected segment on their
+   second access. Eviction prefers probationary bufs, so a one-shot scan (a
+   large rget or a backfill) only churns the probationary segment and leaves
+   the hot working set alone. The protected segment is capped at
+   PAGE_REPL_2Q_PROTECTED_FRACTION of the cache; when it grows past that, sampled
+   protected bufs are given a CLOCK-style second chance and demoted if they have
+   not been accessed since they were last sampled.
+
+Blocks that were loaded ahead of time because a range scan is about to get to them
+(see mc_cache_t::prefetch_block()) are marked as prefetched. The scan's access is the
+first real one, so it doesn't promote them; they stay probationary until somebody
+else touches them. */
+
+class mc_cache_t;
+
+class evictable_t {
+public:
+    explicit evictable_t(mc_cache_t *cache, bool loaded = true);
+    // removes us from the page repl if necessary; does not call unload()
+    virtual ~evictable_t();
+    // Returns true if this object can be unloaded from the cache.
+    virtual bool safe_to_unload() = 0;
+    // Called when the page_repl_t decides to evict this object. Must
+    // relinquish the buf associated with this object.
+    virtual void unload() = 0;
+
+    bool in_page_repl();
+    void insert_into_page_repl();
+    void remove_from_page_repl(); // does *not* call unload()
+
+    // Tells the page replacement policy that this object has been accessed
+    // again while it was in memory.
+    void touch_page_repl();
+
+    // Tells the page replacement policy that this object was loaded before anybody
+    // asked for it.
+    void mark_prefetched();
+
+    /* The eviction priority represents how bad of a choice a buf is for
+     * eviction the buffer cache will (probabalistically) evict blocks of
+     * lower priority first. */
+    eviction_priority_t eviction_priority;
+
+protected:
+    mc_cache_t *cache;
+private:
+    friend class page_repl_t;
+
+    void set_protected(bool is_protected);
+
+    size_t page_repl_index;
+
+    // Used by PAGE_REPL_POLICY_2Q: whether we are in the protected segment, and
+    // whether we have been accessed since the policy last looked at us.
+    bool page_repl_protected;
+    bool page_repl_referenced;
+
+    // Whether we were prefetched and nobody has accessed us yet.
+    bool page_repl_prefetched;
+};
+
+class page_repl_t {
+    typedef mc_cache_t cache_t;
+    friend class evictable_t;
+
+public:
+    page_repl_t(size_t _unload_threshold, page_repl_policy_t _policy, cache_t *_cache);
+
+    // If is_full(space_needed), the next call to make_space(space_needed) probably
+    // has to evict something
+    bool is_full(size_t space_needed);
+
+    // make_space tries to make sure that the number of blocks currently in memory is
+    // at least 'space_needed' less than the user-specified memory limit.
+    void make_space(size_t space_needed = 0);
+
+    // Changes the memory limit, in blocks. Doesn't evict anything by itself.
+    void set_unload_threshold(size_t _unload_threshold);
+    size_t get_unload_threshold() const { return unload_threshold; }
+
+    /* The page replacement component actually serves two roles. In addition to its
+    primary role as a mechanism for kicking out buffers when memory runs low, it also
+    has the job of keeping track of all of the buffers in memory in such a way that
+    the cache can quickly request a pointer to the next buffer in memory. This is
+    used during the cache's destructor. The rationale is that any reasonable
+    implementation of a page replacement system will need to keep track of all of the
+    buffers in memory anyway, so the cache can depend on the page replacement
+    system's buffer list rather than keeping a buffer list of its own. */
+    evictable_t *get_first_buf();
+
+private:
+    // Returns true if `candidate` is a better choice for eviction than `current`.
+    bool is_better_victim(evictable_t *current, evictable_t *candidate);
+
+    // Gives a sampled protected buf its second chance, demoting it to the
+    // probationary segment if it has not been referenced and the protected
+    // segment is over its limit.
+    void age_protected(evictable_t *block);
+
+    size_t unload_threshold;
+    page_repl_policy_t policy;
+    cache_t *cache;
+    segmented_vector_t<evictable_t *> array;
+    size_t protected_count;
+    size_t protected_limit;
+};
+
+#endif  // BUFFER_CACHE_MIRRORED_PAGE_REPL_HPP_
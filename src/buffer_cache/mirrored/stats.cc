@@ -21,6 +21,23 @@ mc_cache_stats_t::perfmon_cache_custom_t::end_stats(void *) {
     return make_scoped<perfmon_result_t>(strprintf("%" PRIu32, block_size));
 }
 
+mc_cache_stats_t::perfmon_hit_ratio_t::perfmon_hit_ratio_t()
+    : hit_ratio(0)
+{
+}
+
+void *mc_cache_stats_t::perfmon_hit_ratio_t::begin_stats() {
+    return NULL;
+}
+
+void mc_cache_stats_t::perfmon_hit_ratio_t::visit_stats(void *) {
+}
+
+scoped_ptr_t<perfmon_result_t>
+mc_cache_stats_t::perfmon_hit_ratio_t::end_stats(void *) {
+    return make_scoped<perfmon_result_t>(strprintf("%.4f", hit_ratio));
+}
+
 mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
     : cache_collection(),
       cache_membership(parent, &cache_collection, "cache"),
@@ -43,7 +60,13 @@ mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
       pm_n_blocks_dirty(),
       pm_n_blocks_total(),
       pm_n_blocks_evicted(),
+      pm_n_blocks_protected(),
+      pm_n_blocks_prefetched(),
+      pm_n_prefetch_hits(),
       pm_block_size(),
+      pm_cache_size(),
+      pm_ghost_hits(),
+      pm_hit_ratio(),
       cache_collection_membership(&cache_collection,
           &pm_registered_snapshots, "registered_snapshots",
           &pm_registered_snapshot_blocks, "registered_snapshot_blocks",
@@ -64,7 +87,13 @@ mc_cache_stats_t::mc_cache_stats_t(perfmon_collection_t *parent)
           &pm_n_blocks_dirty, "blocks_dirty",
           &pm_n_blocks_total, "blocks_total",
           &pm_n_blocks_evicted, "blocks_evicted",
+          &pm_n_blocks_protected, "blocks_protected",
+          &pm_n_blocks_prefetched, "blocks_prefetched",
+          &pm_n_prefetch_hits, "prefetch_hits",
           &pm_block_size, "block_size",
+          &pm_cache_size, "cache_size",
+          &pm_ghost_hits, "ghost_hits",
+          &pm_hit_ratio, "recent_hit_ratio",
           NULLPTR) { }
 
 
@@ -48,8 +48,16 @@ struct mc_cache_stats_t {
         pm_n_blocks_dirty,
         pm_n_blocks_total;
 
-    // used in buffer_cache/mirrored/page_repl_random.cc
-    perfmon_counter_t pm_n_blocks_evicted;
+    // used in buffer_cache/mirrored/page_repl.cc
+    perfmon_counter_t
+        pm_n_blocks_evicted,
+        pm_n_blocks_protected;
+
+    /* Used by mc_cache_t::prefetch_block(): how many blocks were loaded ahead of
+    time, and how many of those were used before they got evicted. */
+    perfmon_counter_t
+        pm_n_blocks_prefetched,
+        pm_n_prefetch_hits;
 
     /* This is for exposing the block size */
     struct perfmon_cache_custom_t : public perfmon_t {
@@ -63,6 +71,24 @@ struct mc_cache_stats_t {
     };
     perfmon_cache_custom_t pm_block_size;
 
+    /* Used by the cache balancer: how much memory this cache may use, how many of
+    its misses were on blocks it had evicted recently, and its hit ratio since the
+    balancer last looked at it. */
+    perfmon_counter_t
+        pm_cache_size,
+        pm_ghost_hits;
+
+    struct perfmon_hit_ratio_t : public perfmon_t {
+    public:
+        perfmon_hit_ratio_t();
+        void *begin_stats();
+        void visit_stats(void *);
+        scoped_ptr_t<perfmon_result_t> end_stats(void *);
+    public:
+        double hit_ratio;
+    };
+    perfmon_hit_ratio_t pm_hit_ratio;
+
     perfmon_multi_membership_t cache_collection_membership;
 };
 
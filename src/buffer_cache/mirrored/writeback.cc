@@ -89,6 +89,13 @@ void writeback_t::sync(sync_callback_t *callback) {
     }
 }
 
+void writeback_t::set_max_dirty_blocks(unsigned int _max_dirty_blocks) {
+    cache->assert_thread();
+    rassert(_max_dirty_blocks >= 10);
+    max_dirty_blocks = _max_dirty_blocks;
+    dirty_block_semaphore.set_capacity(max_dirty_blocks);
+}
+
 void writeback_t::sync_patiently(sync_callback_t *callback) {
     if (callback != NULL) {
         sync_callbacks.push_back(callback);
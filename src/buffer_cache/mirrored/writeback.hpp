@@ -89,10 +89,15 @@ public:
         DISABLE_COPYING(local_buf_t);
     };
 
+    /* Changes how many dirty blocks write transactions may leave behind before they
+    get throttled. Transactions that are already waiting get in as soon as the new
+    limit allows it. */
+    void set_max_dirty_blocks(unsigned int max_dirty_blocks);
+
     /* User-controlled settings. */
 
     const unsigned int max_concurrent_flushes;
-    const unsigned int max_dirty_blocks;
+    unsigned int max_dirty_blocks;
 
     bool has_active_flushes() { return active_flushes > 0; }
 
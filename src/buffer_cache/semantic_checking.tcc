@@ -59,6 +59,12 @@ void scc_buf_lock_t<inner_cache_t>::mark_deleted() {
     internal_buf_lock->mark_deleted();
 }
 
+template<class inner_cache_t>
+bool scc_buf_lock_t<inner_cache_t>::is_deleted() const {
+    rassert(internal_buf_lock.has());
+    return internal_buf_lock->is_deleted();
+}
+
 template<class inner_cache_t>
 void scc_buf_lock_t<inner_cache_t>::touch_recency(repli_timestamp_t timestamp) {
     rassert(internal_buf_lock.has());
@@ -168,6 +174,11 @@ void scc_transaction_t<inner_cache_t>::get_subtree_recencies(block_id_t *block_i
     return inner_transaction.get_subtree_recencies(block_ids, num_block_ids, recencies_out, cb);
 }
 
+template<class inner_cache_t>
+bool scc_transaction_t<inner_cache_t>::prefetch_block(block_id_t block_id) {
+    return inner_transaction.prefetch_block(block_id);
+}
+
 /* Cache */
 
 template<class inner_cache_t>
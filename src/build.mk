@@ -7,7 +7,9 @@ LDPATHDS ?=
 CXXPATHDS ?=
 LDFLAGS ?=
 CXXFLAGS ?=
-RT_LDFLAGS := $(LDFLAGS) $(RE2_LIBS) $(TERMCAP_LIBS)
+# Only set by configure if lz4 was found.
+LZ4_LIBS ?=
+RT_LDFLAGS := $(LDFLAGS) $(RE2_LIBS) $(TERMCAP_LIBS) $(LZ4_LIBS)
 RT_LDFLAGS += $(V8_LIBS) $(PROTOBUF_LIBS) $(TCMALLOC_MINIMAL_LIBS) $(PTHREAD_LIBS)
 RT_CXXFLAGS := $(CXXFLAGS) $(RE2_CXXFLAGS)
 
@@ -261,6 +263,10 @@ ifeq ($(FULL_PERFMON),1)
   RT_CXXFLAGS += -DFULL_PERFMON
 endif
 
+ifeq ($(HAVE_LZ4),1)
+  RT_CXXFLAGS += -DHAVE_LZ4
+endif
+
 RT_CXXFLAGS += -I$(PROTO_DIR)
 
 UNIT_STATIC_LIBRARY_PATH := $(EXTERNAL_DIR)/gtest/make/gtest.a
@@ -272,7 +278,7 @@ RT_CXXFLAGS += -DMIGRATION_SCRIPT_LOCATION=\"$(scripts_dir)/rdb_migrate\"
 
 SOURCES := $(shell find $(SOURCE_DIR) -name '*.cc')
 
-SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/%,$(SOURCES))
+SERVER_EXEC_SOURCES := $(filter-out $(SOURCE_DIR)/unittest/% $(SOURCE_DIR)/bench/%,$(SOURCES))
 
 QL2_PROTO_NAMES := rdb_protocol/ql2 rdb_protocol/ql2_extensions
 QL2_PROTO_SOURCES := $(foreach _,$(QL2_PROTO_NAMES),$(SOURCE_DIR)/$_.proto)
@@ -288,10 +294,15 @@ OBJS := $(QL2_PROTO_OBJS) $(patsubst %,$(OBJ_DIR)/%.o,$(NAMES))
 
 SERVER_EXEC_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(SERVER_EXEC_SOURCES))
 
-SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc,$(SOURCES)))
+SERVER_NOMAIN_OBJS := $(QL2_PROTO_OBJS) $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter-out %/main.cc $(SOURCE_DIR)/bench/%,$(SOURCES)))
 
 SERVER_UNIT_TEST_OBJS := $(SERVER_NOMAIN_OBJS) $(OBJ_DIR)/unittest/main.o
 
+# The benchmarks reuse the unit tests' helpers, but none of the tests themselves.
+UNIT_TEST_HELPER_OBJS := $(patsubst %,$(OBJ_DIR)/unittest/%.o,unittest_utils mock_file server_test_helper)
+SERVER_BENCH_OBJS := $(filter-out $(OBJ_DIR)/unittest/%,$(SERVER_NOMAIN_OBJS)) $(UNIT_TEST_HELPER_OBJS)
+SERVER_BENCH_OBJS += $(patsubst $(SOURCE_DIR)/%.cc,$(OBJ_DIR)/%.o,$(filter $(SOURCE_DIR)/bench/%,$(SOURCES)))
+
 ##### Version number handling
 
 RT_CXXFLAGS += -DRETHINKDB_VERSION=\"$(RETHINKDB_VERSION)\"
@@ -316,6 +327,11 @@ unit: $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME)
 	$P RUN $(SERVER_UNIT_TEST_NAME)
 	$(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME) --gtest_filter=$(UNIT_TEST_FILTER)
 
+.PHONY: bench
+bench: $(BUILD_DIR)/$(SERVER_BENCH_NAME)
+	$P RUN $(SERVER_BENCH_NAME)
+	$(BUILD_DIR)/$(SERVER_BENCH_NAME) --gtest_filter=$(BENCH_FILTER)
+
 .PRECIOUS: $(PROTO_DIR)/. $(QL2_PROTO_HEADERS) $(QL2_PROTO_CODE)
 
 $(PROTO_DIR)/%.pb.h $(PROTO_DIR)/%.pb.cc: $(SOURCE_DIR)/%.proto | $(PROTOC_DEP) $(PROTO_DIR)/.
@@ -348,11 +364,17 @@ endif
 # The unittests use gtest, which uses macros that expand into switch statements which don't contain
 # default cases. So we have to remove the -Wswitch-default argument for them.
 $(OBJ_DIR)/unittest/%.o: RT_CXXFLAGS := $(filter-out -Wswitch-default,$(RT_CXXFLAGS)) $(UNIT_TEST_INCLUDE_FLAG)
+$(OBJ_DIR)/bench/%.o: RT_CXXFLAGS := $(filter-out -Wswitch-default,$(RT_CXXFLAGS)) $(UNIT_TEST_INCLUDE_FLAG)
 
 $(BUILD_DIR)/$(SERVER_UNIT_TEST_NAME): $(SERVER_UNIT_TEST_OBJS) $(UNIT_STATIC_LIBRARY_PATH) | $(BUILD_DIR)/. $(TCMALLOC_DEP)
 	$P LD $@
 	$(RT_CXX) $(SERVER_UNIT_TEST_OBJS) $(RT_LDFLAGS) $(UNIT_STATIC_LIBRARY_PATH) -o $@ $(LD_OUTPUT_FILTER)
 
+# The benchmarks use gtest as their runner, so that `--gtest_filter` picks which ones to run.
+$(BUILD_DIR)/$(SERVER_BENCH_NAME): $(SERVER_BENCH_OBJS) $(UNIT_STATIC_LIBRARY_PATH) | $(BUILD_DIR)/. $(TCMALLOC_DEP)
+	$P LD $@
+	$(RT_CXX) $(SERVER_BENCH_OBJS) $(RT_LDFLAGS) $(UNIT_STATIC_LIBRARY_PATH) -o $@ $(LD_OUTPUT_FILTER)
+
 $(BUILD_DIR)/$(GDB_FUNCTIONS_NAME):
 	$P CP $@
 	cp $(SCRIPTS_DIR)/$(GDB_FUNCTIONS_NAME) $@
@@ -33,6 +33,8 @@ void check_namespaces_for_protocol(
             check("namespace", it->first, "secondary_pinnings", it->second.get_ref().secondary_pinnings, out);
             check("namespace", it->first, "database", it->second.get_ref().database, out);
             check("namespace", it->first, "cache_size", it->second.get_ref().cache_size, out);
+            check("namespace", it->first, "cpu_sharding_factor", it->second.get_ref().cpu_sharding_factor, out);
+            check("namespace", it->first, "block_size", it->second.get_ref().block_size, out);
         }
     }
 }
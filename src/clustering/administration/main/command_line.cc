@@ -22,6 +22,7 @@
 
 #include "arch/io/disk.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/starter.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/cli/admin_command_parser.hpp"
@@ -308,15 +309,31 @@ public:
     serve_info_t(const std::vector<host_and_port_t> &_joins,
                  service_address_ports_t _ports,
                  std::string _web_assets,
+                 log_serializer_dynamic_config_t _serializer_config,
+                 int64_t _total_cache_size,
+                 page_repl_policy_t _page_repl_policy,
+                 key_filter_mode_t _key_filter_mode,
+                 cluster_send_batching_t _send_batching,
                  boost::optional<std::string> _config_file):
         joins(&_joins),
         ports(_ports),
         web_assets(_web_assets),
+        serializer_config(_serializer_config),
+        total_cache_size(_total_cache_size),
+        page_repl_policy(_page_repl_policy),
+        key_filter_mode(_key_filter_mode),
+        send_batching(_send_batching),
         config_file(_config_file) { }
 
     const std::vector<host_and_port_t> *joins;
     service_address_ports_t ports;
     std::string web_assets;
+    log_serializer_dynamic_config_t serializer_config;
+    // In bytes; 0 means that each table's cache has the size set for the table.
+    int64_t total_cache_size;
+    page_repl_policy_t page_repl_policy;
+    key_filter_mode_t key_filter_mode;
+    cluster_send_batching_t send_batching;
     boost::optional<std::string> config_file;
 };
 
@@ -600,6 +617,7 @@ service_address_ports_t get_service_address_ports(const std::map<std::string, op
 void run_rethinkdb_create(const base_path_t &base_path,
                           const name_string_t &machine_name,
                           const file_direct_io_mode_t direct_io_mode,
+                          const file_io_backend_t io_backend,
                           const int max_concurrent_io_requests,
                           bool *const result_out) {
     machine_id_t our_machine_id = generate_uuid();
@@ -612,7 +630,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
     machine_semilattice_metadata.datacenter = vclock_t<datacenter_id_t>(nil_uuid(), our_machine_id);
     cluster_metadata.machines.machines.insert(std::make_pair(our_machine_id, make_deletable(machine_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -703,6 +721,7 @@ std::string uname_msr() {
 void run_rethinkdb_serve(const base_path_t &base_path,
                          const serve_info_t &serve_info,
                          const file_direct_io_mode_t direct_io_mode,
+                         const file_io_backend_t io_backend,
                          const int max_concurrent_io_requests,
                          const machine_id_t *our_machine_id,
                          const cluster_semilattice_metadata_t *cluster_metadata,
@@ -714,7 +733,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logINF("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests, io_backend);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -759,6 +778,11 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                             look_up_peers_addresses(*serve_info.joins),
                             serve_info.ports,
                             serve_info.web_assets,
+                            serve_info.serializer_config,
+                            serve_info.total_cache_size,
+                            serve_info.page_repl_policy,
+                            serve_info.key_filter_mode,
+                            serve_info.send_batching,
                             &sigint_cond,
                             serve_info.config_file);
 
@@ -774,6 +798,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const name_string_t &machine_name,
                              const file_direct_io_mode_t direct_io_mode,
+                             const file_io_backend_t io_backend,
                              const int max_concurrent_io_requests,
                              const bool new_directory,
                              const serve_info_t &serve_info,
@@ -781,7 +806,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, io_backend, max_concurrent_io_requests,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -814,7 +839,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info,
-                            direct_io_mode, max_concurrent_io_requests,
+                            direct_io_mode, io_backend, max_concurrent_io_requests,
                             &our_machine_id, &cluster_metadata,
                             data_directory_lock, result_out);
     }
@@ -828,6 +853,7 @@ void run_rethinkdb_proxy(const serve_info_t &serve_info, bool *const result_out)
         *result_out = serve_proxy(look_up_peers_addresses(*serve_info.joins),
                                   serve_info.ports,
                                   serve_info.web_assets,
+                                  serve_info.send_batching,
                                   &sigint_cond,
                                   serve_info.config_file);
     } catch (const host_lookup_exc_t &ex) {
@@ -870,6 +896,10 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     help.add("--no-direct-io", "disable direct I/O");
+    options_out->push_back(options::option_t(options::names_t("--no-io-uring"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--no-io-uring",
+             "run disk I/O on a thread pool even if the kernel supports io_uring");
     return help;
 }
 
@@ -943,18 +973,164 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              options::OPTIONAL_REPEAT));
     help.add("--canonical-address addr", "address that other rethinkdb instances will use to connect to us, can be specified multiple times"); 
 
+    options_out->push_back(options::option_t(options::names_t("--cluster-flush-delay"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_CLUSTER_SEND_FLUSH_DELAY_MS)));
+    help.add("--cluster-flush-delay ms",
+             "how long to gather messages to another node so they can share a write");
+    options_out->push_back(options::option_t(options::names_t("--cluster-flush-bytes"),
+                                             options::OPTIONAL,
+                                             strprintf("%lld", DEFAULT_CLUSTER_SEND_FLUSH_BYTES)));
+    help.add("--cluster-flush-bytes n",
+             "send gathered messages to another node right away once there are this many bytes");
+
     return help;
 }
 
+MUST_USE bool parse_cluster_send_options(const std::map<std::string, options::values_t> &opts,
+                                         cluster_send_batching_t *send_batching_out) {
+    const int flush_delay_ms = get_single_int(opts, "--cluster-flush-delay");
+    if (flush_delay_ms < 0 || flush_delay_ms > MAX_CLUSTER_SEND_FLUSH_DELAY_MS) {
+        fprintf(stderr, "ERROR: cluster-flush-delay must be between 0 and %d\n",
+                MAX_CLUSTER_SEND_FLUSH_DELAY_MS);
+        return false;
+    }
+    const int flush_bytes = get_single_int(opts, "--cluster-flush-bytes");
+    if (flush_bytes <= 0) {
+        fprintf(stderr, "ERROR: cluster-flush-bytes must be at least 1\n");
+        return false;
+    }
+    send_batching_out->flush_delay_ms = flush_delay_ms;
+    send_batching_out->flush_bytes = flush_bytes;
+    return true;
+}
+
 options::help_section_t get_cpu_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("CPU options");
     options_out->push_back(options::option_t(options::names_t("--cores", "-c"),
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--work-stealing"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--work-stealing", "let idle cores run query work queued on busy ones");
+    return help;
+}
+
+options::help_section_t get_disk_write_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Disk write options");
+    options_out->push_back(options::option_t(options::names_t("--group-commit-window"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_GROUP_COMMIT_WINDOW_MS)));
+    help.add("--group-commit-window ms",
+             "how long to gather concurrent writes so they can share a metablock write and fsync");
+    options_out->push_back(options::option_t(options::names_t("--group-commit-max-writes"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_GROUP_COMMIT_MAX_WRITES)));
+    help.add("--group-commit-max-writes n",
+             "the most writes that can share a metablock write and fsync");
+    options_out->push_back(options::option_t(options::names_t("--block-compression"),
+                                             options::OPTIONAL,
+                                             "none"));
+    help.add("--block-compression {none,lz4}",
+             "compress data blocks before writing them to disk");
+    return help;
+}
+
+MUST_USE bool parse_disk_write_options(const std::map<std::string, options::values_t> &opts,
+                                       log_serializer_dynamic_config_t *serializer_config_out) {
+    const int window_ms = get_single_int(opts, "--group-commit-window");
+    if (window_ms < 0 || window_ms > MAX_GROUP_COMMIT_WINDOW_MS) {
+        fprintf(stderr, "ERROR: group-commit-window must be between 0 and %d\n",
+                MAX_GROUP_COMMIT_WINDOW_MS);
+        return false;
+    }
+    const int max_writes = get_single_int(opts, "--group-commit-max-writes");
+    if (max_writes <= 0) {
+        fprintf(stderr, "ERROR: group-commit-max-writes must be at least 1\n");
+        return false;
+    }
+    const std::string compression = get_single_option(opts, "--block-compression");
+    if (compression == "none") {
+        serializer_config_out->block_compression = BLOCK_COMPRESSION_NONE;
+    } else if (compression == "lz4") {
+#ifdef HAVE_LZ4
+        serializer_config_out->block_compression = BLOCK_COMPRESSION_LZ4;
+#else
+        fprintf(stderr, "ERROR: this build of RethinkDB doesn't support lz4 block-compression\n");
+        return false;
+#endif
+    } else {
+        fprintf(stderr, "ERROR: block-compression must be 'none' or 'lz4'\n");
+        return false;
+    }
+    serializer_config_out->group_commit_window_ms = window_ms;
+    serializer_config_out->group_commit_max_writes = max_writes;
+    return true;
+}
+
+options::help_section_t get_cache_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("Cache options");
+    options_out->push_back(options::option_t(options::names_t("--cache-size"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--cache-size mb",
+             "total cache memory for all tables on this server, moved between them as "
+             "their workloads change; 0 gives each table the cache size set for it");
+    options_out->push_back(options::option_t(options::names_t("--cache-replacement-policy"),
+                                             options::OPTIONAL,
+                                             "2q"));
+    help.add("--cache-replacement-policy {2q,random}",
+             "how the caches choose what to evict; 2q keeps blocks that are read more than "
+             "once from being pushed out by large scans");
+    options_out->push_back(options::option_t(options::names_t("--key-filters"),
+                                             options::OPTIONAL,
+                                             "auto"));
+    help.add("--key-filters {auto,on,off}",
+             "whether tables keep in-memory filters that let lookups of missing keys skip "
+             "the disk; auto only builds one for a table once lookups of keys it doesn't "
+             "have are common");
     return help;
 }
 
+MUST_USE bool parse_cache_options(const std::map<std::string, options::values_t> &opts,
+                                  int64_t *total_cache_size_out,
+                                  page_repl_policy_t *page_repl_policy_out,
+                                  key_filter_mode_t *key_filter_mode_out) {
+    const int cache_size_mb = get_single_int(opts, "--cache-size");
+    if (cache_size_mb < 0) {
+        fprintf(stderr, "ERROR: cache-size must not be negative\n");
+        return false;
+    }
+    if (cache_size_mb != 0 && cache_size_mb * MEGABYTE < CACHE_BALANCER_MIN_CACHE_SIZE) {
+        fprintf(stderr, "ERROR: cache-size must be 0 or at least %lld MB\n",
+                CACHE_BALANCER_MIN_CACHE_SIZE / MEGABYTE);
+        return false;
+    }
+    const std::string policy = get_single_option(opts, "--cache-replacement-policy");
+    if (policy == "2q") {
+        *page_repl_policy_out = PAGE_REPL_POLICY_2Q;
+    } else if (policy == "random") {
+        *page_repl_policy_out = PAGE_REPL_POLICY_RANDOM;
+    } else {
+        fprintf(stderr, "ERROR: cache-replacement-policy must be '2q' or 'random'\n");
+        return false;
+    }
+    const std::string key_filters = get_single_option(opts, "--key-filters");
+    if (key_filters == "auto") {
+        *key_filter_mode_out = KEY_FILTER_MODE_AUTO;
+    } else if (key_filters == "on") {
+        *key_filter_mode_out = KEY_FILTER_MODE_ON;
+    } else if (key_filters == "off") {
+        *key_filter_mode_out = KEY_FILTER_MODE_OFF;
+    } else {
+        fprintf(stderr, "ERROR: key-filters must be 'auto', 'on' or 'off'\n");
+        return false;
+    }
+    *total_cache_size_out = cache_size_mb * MEGABYTE;
+    return true;
+}
+
 MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t> &opts,
                                  int *num_workers_out) {
     int num_workers = get_single_int(opts, "--cores");
@@ -1016,6 +1192,8 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
     help_out->push_back(get_network_options(false, options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
+    help_out->push_back(get_disk_write_options(options_out));
+    help_out->push_back(get_cache_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1068,6 +1246,8 @@ void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_
     help_out->push_back(get_network_options(false, options_out));
     help_out->push_back(get_web_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
+    help_out->push_back(get_disk_write_options(options_out));
+    help_out->push_back(get_cache_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1147,6 +1327,12 @@ file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, op
         file_direct_io_mode_t::direct_desired;
 }
 
+file_io_backend_t parse_io_backend_option(const std::map<std::string, options::values_t> &opts) {
+    return exists_option(opts, "--no-io-uring") ?
+        file_io_backend_t::pool :
+        file_io_backend_t::uring_desired;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1192,11 +1378,13 @@ int main_rethinkdb_create(int argc, char *argv[]) {
         initialize_logfile(opts, base_path);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_create, base_path,
                                      machine_name,
                                      direct_io_mode,
+                                     io_backend,
                                      max_concurrent_io_requests,
                                      &result),
                            num_workers);
@@ -1276,18 +1464,37 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        cluster_send_batching_t send_batching;
+        if (!parse_cluster_send_options(opts, &send_batching)) {
+            return EXIT_FAILURE;
+        }
+
         const std::string web_path = get_web_path(opts, argv);
 
         int num_workers;
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        coro_t::set_work_stealing(exists_option(opts, "--work-stealing"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        log_serializer_dynamic_config_t serializer_config;
+        if (!parse_disk_write_options(opts, &serializer_config)) {
+            return EXIT_FAILURE;
+        }
+
+        int64_t total_cache_size;
+        page_repl_policy_t page_repl_policy;
+        key_filter_mode_t key_filter_mode;
+        if (!parse_cache_options(opts, &total_cache_size, &page_repl_policy,
+                                 &key_filter_mode)) {
+            return EXIT_FAILURE;
+        }
+
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
         directory_lock_t data_directory_lock(base_path, false, &is_new_directory);
@@ -1313,15 +1520,19 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
-        serve_info_t serve_info(joins, address_ports, web_path,
+        serve_info_t serve_info(joins, address_ports, web_path, serializer_config,
+                                total_cache_size, page_repl_policy, key_filter_mode,
+                                send_batching,
                                 get_optional_option(opts, "--config-file"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve, base_path,
                                      serve_info,
                                      direct_io_mode,
+                                     io_backend,
                                      max_concurrent_io_requests,
                                      static_cast<machine_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
@@ -1403,6 +1614,11 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        cluster_send_batching_t send_batching;
+        if (!parse_cluster_send_options(opts, &send_batching)) {
+            return EXIT_FAILURE;
+        }
+
         if (joins.empty()) {
             fprintf(stderr, "No --join option(s) given. A proxy needs to connect to something!\n"
                     "Run 'rethinkdb help proxy' for more information.\n");
@@ -1434,7 +1650,8 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
         extproc_spawner_t extproc_spawner;
 
         serve_info_t serve_info(joins, address_ports, web_path,
-                                get_optional_option(opts, "--config-file"));
+                                log_serializer_dynamic_config_t(), 0, PAGE_REPL_POLICY_2Q,
+                                KEY_FILTER_MODE_AUTO, send_batching, get_optional_option(opts, "--config-file"));
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_proxy, serve_info, &result),
@@ -1533,18 +1750,37 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         const service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        cluster_send_batching_t send_batching;
+        if (!parse_cluster_send_options(opts, &send_batching)) {
+            return EXIT_FAILURE;
+        }
+
         const std::string web_path = get_web_path(opts, argv);
 
         int num_workers;
         if (!parse_cores_option(opts, &num_workers)) {
             return EXIT_FAILURE;
         }
+        coro_t::set_work_stealing(exists_option(opts, "--work-stealing"));
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
         }
 
+        log_serializer_dynamic_config_t serializer_config;
+        if (!parse_disk_write_options(opts, &serializer_config)) {
+            return EXIT_FAILURE;
+        }
+
+        int64_t total_cache_size;
+        page_repl_policy_t page_repl_policy;
+        key_filter_mode_t key_filter_mode;
+        if (!parse_cache_options(opts, &total_cache_size, &page_repl_policy,
+                                 &key_filter_mode)) {
+            return EXIT_FAILURE;
+        }
+
         // Attempt to create the directory early so that the log file can use it.
         // If we create the file, it will be cleaned up unless directory_initialized()
         // is called on it.  This will be done after the metadata files have been created.
@@ -1574,16 +1810,20 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         extproc_spawner_t extproc_spawner;
 
-        serve_info_t serve_info(joins, address_ports, web_path,
+        serve_info_t serve_info(joins, address_ports, web_path, serializer_config,
+                                total_cache_size, page_repl_policy, key_filter_mode,
+                                send_batching,
                                 get_optional_option(opts, "--config-file"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const file_io_backend_t io_backend = parse_io_backend_option(opts);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
                                      base_path,
                                      machine_name,
                                      direct_io_mode,
+                                     io_backend,
                                      max_concurrent_io_requests,
                                      is_new_directory,
                                      serve_info,
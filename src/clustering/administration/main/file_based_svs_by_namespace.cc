@@ -14,10 +14,14 @@ template <class protocol_t>
 struct store_args_t {
     store_args_t(io_backender_t *_io_backender, const base_path_t &_base_path,
             namespace_id_t _namespace_id, int64_t _cache_size,
+            cache_balancer_t *_balancer, page_repl_policy_t _page_repl_policy,
+            key_filter_mode_t _key_filter_mode,
             perfmon_collection_t *_serializers_perfmon_collection, typename
             protocol_t::context_t *_ctx)
         : io_backender(_io_backender), base_path(_base_path),
           namespace_id(_namespace_id), cache_size(_cache_size),
+          balancer(_balancer), page_repl_policy(_page_repl_policy),
+          key_filter_mode(_key_filter_mode),
           serializers_perfmon_collection(_serializers_perfmon_collection),
           ctx(_ctx)
     { }
@@ -26,6 +30,9 @@ struct store_args_t {
     base_path_t base_path;
     namespace_id_t namespace_id;
     int64_t cache_size;
+    cache_balancer_t *balancer;
+    page_repl_policy_t page_repl_policy;
+    key_filter_mode_t key_filter_mode;
     perfmon_collection_t *serializers_perfmon_collection;
     typename protocol_t::context_t *ctx;
 };
@@ -49,8 +56,10 @@ void do_construct_existing_store(
     // TODO: Can we pass serializers_perfmon_collection across threads like this?
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
-        store_args.cache_size, false, store_args.serializers_perfmon_collection,
+        store_args.cache_size, store_args.balancer, store_args.page_repl_policy,
+        false, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->set_key_filter_mode(store_args.key_filter_mode);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -67,8 +76,10 @@ void do_create_new_store(
     on_thread_t th(threads[thread_offset]);
     typename protocol_t::store_t *store = new typename protocol_t::store_t(
         multiplexer->proxies[thread_offset], hash_shard_perfmon_name(thread_offset),
-        store_args.cache_size, true, store_args.serializers_perfmon_collection,
+        store_args.cache_size, store_args.balancer, store_args.page_repl_policy,
+        true, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path);
+    store->set_key_filter_mode(store_args.key_filter_mode);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -79,6 +90,8 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
             int64_t cache_size,
+            int cpu_sharding_factor,
+            int block_size,
             stores_lifetimer_t<protocol_t> *stores_out,
             scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
             typename protocol_t::context_t *ctx) {
@@ -95,14 +108,13 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     // TODO: We should use N slices on M serializers, not N slices
     // on N serializers.
 
-    const int num_stores = CPU_SHARDING_FACTOR;
+    guarantee(cpu_sharding_factor > 0);
     scoped_array_t<scoped_ptr_t<typename protocol_t::store_t> > *stores_out_stores
         = stores_out->stores();
-    stores_out_stores->init(num_stores);
 
     const threadnum_t serializer_thread = next_thread(num_db_threads);
     std::vector<threadnum_t> store_threads;
-    for (int i = 0; i < num_stores; ++i) {
+    for (int i = 0; i < cpu_sharding_factor; ++i) {
         store_threads.push_back(next_thread(num_db_threads));
     }
 
@@ -111,19 +123,20 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
     scoped_ptr_t<multistore_ptr_t<protocol_t> > mptr;
     {
         on_thread_t th(serializer_thread);
-        scoped_array_t<store_view_t<protocol_t> *> store_views(num_stores);
+        scoped_array_t<store_view_t<protocol_t> *> store_views;
 
         const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
         int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
         store_args_t<protocol_t> store_args(io_backender_, base_path_,
-                                            namespace_id, cache_size,
+                                            namespace_id, cache_size, balancer_,
+                                            page_repl_policy_, key_filter_mode_,
                                             serializers_perfmon_collection, ctx);
         filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
         if (res == 0) {
             // TODO: Could we handle failure when loading the serializer?  Right
             // now, we don't.
             serializer.init(new standard_serializer_t(
-                                standard_serializer_t::dynamic_config_t(),
+                                serializer_config_,
                                 &file_opener,
                                 serializers_perfmon_collection));
 
@@ -131,6 +144,15 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
             ptrs.push_back(serializer.get());
             multiplexer.init(new serializer_multiplexer_t(ptrs));
 
+            // The file was created with some number of stores, and that's what it
+            // has, whatever the table's metadata says now.
+            const int num_stores = multiplexer->proxies.size();
+            while (static_cast<int>(store_threads.size()) < num_stores) {
+                store_threads.push_back(store_threads[store_threads.size() % cpu_sharding_factor]);
+            }
+            stores_out_stores->init(num_stores);
+            store_views.init(num_stores);
+
             // TODO: Exceptions?  Can exceptions happen, and then
             // store_views' values would leak.  That is, are we handling
             // them in the pmap?  No.
@@ -140,13 +162,18 @@ file_based_svs_by_namespace_t<protocol_t>::get_svs(
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t<protocol_t>(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
+            standard_serializer_t::static_config_t static_config;
+            static_config.block_size_ = block_size;
+            standard_serializer_t::create(&file_opener, static_config);
             serializer.init(new standard_serializer_t(
-                                standard_serializer_t::dynamic_config_t(),
+                                serializer_config_,
                                 &file_opener,
                                 serializers_perfmon_collection));
 
+            const int num_stores = cpu_sharding_factor;
+            stores_out_stores->init(num_stores);
+            store_views.init(num_stores);
+
             std::vector<standard_serializer_t *> ptrs;
             ptrs.push_back(serializer.get());
             serializer_multiplexer_t::create(ptrs, num_stores);
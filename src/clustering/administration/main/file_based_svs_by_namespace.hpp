@@ -4,18 +4,32 @@
 
 #include <string>
 
+#include "btree/key_filter.hpp"
+#include "buffer_cache/mirrored/config.hpp"
 #include "clustering/administration/reactor_driver.hpp"
+#include "serializer/log/config.hpp"
+
+class cache_balancer_t;
 
 template <class protocol_t>
 class file_based_svs_by_namespace_t : public svs_by_namespace_t<protocol_t> {
 public:
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
-                                  const base_path_t& base_path)
-        : io_backender_(io_backender), base_path_(base_path), thread_counter_(0) { }
+                                  const base_path_t& base_path,
+                                  const log_serializer_dynamic_config_t &serializer_config,
+                                  cache_balancer_t *balancer,
+                                  page_repl_policy_t page_repl_policy,
+                                  key_filter_mode_t key_filter_mode)
+        : io_backender_(io_backender), base_path_(base_path),
+          serializer_config_(serializer_config), balancer_(balancer),
+          page_repl_policy_(page_repl_policy), key_filter_mode_(key_filter_mode),
+          thread_counter_(0) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
                  int64_t cache_size,
+                 int cpu_sharding_factor,
+                 int block_size,
                  stores_lifetimer_t<protocol_t> *stores_out,
                  scoped_ptr_t<multistore_ptr_t<protocol_t> > *svs_out,
                  typename protocol_t::context_t *);
@@ -27,6 +41,12 @@ public:
 private:
     io_backender_t *io_backender_;
     const base_path_t base_path_;
+    const log_serializer_dynamic_config_t serializer_config_;
+    // Shared by the caches of all tables, or NULL if each has a fixed size.
+    cache_balancer_t *balancer_;
+    // The same for every table's cache on this server.
+    const page_repl_policy_t page_repl_policy_;
+    const key_filter_mode_t key_filter_mode_;
 
     threadnum_t next_thread(int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
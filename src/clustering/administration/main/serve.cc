@@ -5,6 +5,7 @@
 
 #include "arch/arch.hpp"
 #include "arch/os_signal.hpp"
+#include "buffer_cache/mirrored/cache_balancer.hpp"
 #include "clustering/administration/admin_tracker.hpp"
 #include "clustering/administration/auto_reconnect.hpp"
 #include "clustering/administration/http/server.hpp"
@@ -71,6 +72,11 @@ bool do_serve(
     const peer_address_set_t &joins,
     service_address_ports_t address_ports,
     std::string web_assets,
+    const log_serializer_dynamic_config_t &serializer_config,
+    int64_t total_cache_size,
+    page_repl_policy_t page_repl_policy,
+    key_filter_mode_t key_filter_mode,
+    const cluster_send_batching_t &send_batching,
     signal_t *stop_cond,
     const boost::optional<std::string> &config_file) {
     try {
@@ -96,6 +102,7 @@ bool do_serve(
 #endif
 
         connectivity_cluster_t connectivity_cluster;
+        connectivity_cluster.set_send_batching(send_batching);
         message_multiplexer_t message_multiplexer(&connectivity_cluster);
 
         message_multiplexer_t::client_t heartbeat_manager_client(&message_multiplexer, 'H');
@@ -257,6 +264,14 @@ bool do_serve(
         {
             // Reactor drivers
 
+            // The caches of all tables share `total_cache_size` if it is set; this
+            // has to outlive all of the stores.
+            scoped_ptr_t<cache_balancer_t> cache_balancer;
+            if (i_am_a_server && total_cache_size > 0) {
+                cache_balancer.init(new cache_balancer_t(total_cache_size,
+                                                         CACHE_BALANCER_INTERVAL_MS));
+            }
+
             // Dummy
             scoped_ptr_t<file_based_svs_by_namespace_t<mock::dummy_protocol_t> > dummy_svs_source;
             scoped_ptr_t<reactor_driver_t<mock::dummy_protocol_t> > dummy_reactor_driver;
@@ -265,7 +280,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 dummy_svs_source.init(new file_based_svs_by_namespace_t<mock::dummy_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, serializer_config,
+                    cache_balancer.get(), page_repl_policy, key_filter_mode));
                 dummy_reactor_driver.init(new reactor_driver_t<mock::dummy_protocol_t>(
                     base_path,
                     io_backender,
@@ -298,7 +314,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 memcached_svs_source.init(new file_based_svs_by_namespace_t<memcached_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, serializer_config,
+                    cache_balancer.get(), page_repl_policy, key_filter_mode));
                 memcached_reactor_driver.init(new reactor_driver_t<memcached_protocol_t>(
                     base_path,
                     io_backender,
@@ -331,7 +348,8 @@ bool do_serve(
 
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t<rdb_protocol_t>(
-                    io_backender, base_path));
+                    io_backender, base_path, serializer_config,
+                    cache_balancer.get(), page_repl_policy, key_filter_mode));
                 rdb_reactor_driver.init(new reactor_driver_t<rdb_protocol_t>(
                         base_path,
                         io_backender,
@@ -469,6 +487,11 @@ bool serve(io_backender_t *io_backender,
            const peer_address_set_t &joins,
            service_address_ports_t address_ports,
            std::string web_assets,
+           const log_serializer_dynamic_config_t &serializer_config,
+           int64_t total_cache_size,
+           page_repl_policy_t page_repl_policy,
+           key_filter_mode_t key_filter_mode,
+           const cluster_send_batching_t &send_batching,
            signal_t *stop_cond,
            const boost::optional<std::string>& config_file) {
     return do_serve(io_backender,
@@ -479,6 +502,11 @@ bool serve(io_backender_t *io_backender,
                     joins,
                     address_ports,
                     web_assets,
+                    serializer_config,
+                    total_cache_size,
+                    page_repl_policy,
+                    key_filter_mode,
+                    send_batching,
                     stop_cond,
                     config_file);
 }
@@ -486,6 +514,7 @@ bool serve(io_backender_t *io_backender,
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t address_ports,
                  std::string web_assets,
+                 const cluster_send_batching_t &send_batching,
                  signal_t *stop_cond,
                  const boost::optional<std::string>& config_file) {
     // TODO: filepath doesn't _seem_ ignored.
@@ -498,6 +527,11 @@ bool serve_proxy(const peer_address_set_t &joins,
                     joins,
                     address_ports,
                     web_assets,
+                    log_serializer_dynamic_config_t(),
+                    0,
+                    PAGE_REPL_POLICY_2Q,
+                    KEY_FILTER_MODE_AUTO,
+                    send_batching,
                     stop_cond,
                     config_file);
 }
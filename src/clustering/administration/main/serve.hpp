@@ -8,6 +8,10 @@
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/persist.hpp"
 #include "arch/address.hpp"
+#include "btree/key_filter.hpp"
+#include "buffer_cache/mirrored/config.hpp"
+#include "rpc/connectivity/send_queue.hpp"
+#include "serializer/log/config.hpp"
 
 class invalid_port_exc_t : public std::exception {
 public:
@@ -90,12 +94,18 @@ bool serve(io_backender_t *io_backender,
            const peer_address_set_t &joins,
            service_address_ports_t ports,
            std::string web_assets,
+           const log_serializer_dynamic_config_t &serializer_config,
+           int64_t total_cache_size,
+           page_repl_policy_t page_repl_policy,
+           key_filter_mode_t key_filter_mode,
+           const cluster_send_batching_t &send_batching,
            signal_t *stop_cond,
            const boost::optional<std::string>& config_file);
 
 bool serve_proxy(const peer_address_set_t &joins,
                  service_address_ports_t ports,
                  std::string web_assets,
+                 const cluster_send_batching_t &send_batching,
                  signal_t *stop_cond,
                  const boost::optional<std::string>& config_file);
 
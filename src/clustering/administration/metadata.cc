@@ -258,6 +258,8 @@ json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespace_semi
     res["primary_key"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<std::string>(&target->primary_key, ctx));
     res["database"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<database_id_t>(&target->database, ctx));
     res["cache_size"] = boost::shared_ptr<json_adapter_if_t>(new json_vclock_adapter_t<int64_t>(&target->cache_size, ctx));
+    res["cpu_sharding_factor"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<int32_t>, vclock_ctx_t>(&target->cpu_sharding_factor, ctx));
+    res["block_size"] = boost::shared_ptr<json_adapter_if_t>(new json_ctx_read_only_adapter_t<vclock_t<int32_t>, vclock_ctx_t>(&target->block_size, ctx));
     return res;
 }
 
@@ -297,6 +299,10 @@ inline json_adapter_if_t::json_adapter_map_t with_ctx_get_json_subfields(namespa
 
     default_namespace.cache_size = default_namespace.cache_size.make_new_version(GIGABYTE, ctx.us);
 
+    default_namespace.cpu_sharding_factor = default_namespace.cpu_sharding_factor.make_new_version(DEFAULT_CPU_SHARDING_FACTOR, ctx.us);
+
+    default_namespace.block_size = default_namespace.block_size.make_new_version(DEFAULT_BTREE_BLOCK_SIZE, ctx.us);
+
     deletable_t<namespace_semilattice_metadata_t<protocol_t> > default_ns_in_deletable(default_namespace);
     return json_ctx_adapter_with_inserter_t<typename namespaces_semilattice_metadata_t<protocol_t>::namespace_map_t, vclock_ctx_t>(&target->namespaces, generate_uuid, ctx, default_ns_in_deletable).get_subfields();
 }
@@ -4,6 +4,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
 #include "arch/runtime/thread_pool.hpp"
 #include "buffer_cache/blob.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -38,6 +43,98 @@ struct cluster_metadata_superblock_t {
 /* Etymology: (R)ethink(D)B (m)eta(d)ata */
 const block_magic_t expected_magic = { { 'R', 'D', 'm', 'd' } };
 
+/* The cluster metadata file gets its own magic because its format has changed
+since `expected_magic` was introduced: tables now also record their CPU sharding
+factor and btree block size. Files that still carry `expected_magic` are in the
+old format; they are read with the `v1_*` types below, upgraded, and rewritten
+with the new magic on the next metadata update. */
+const block_magic_t cluster_metadata_magic = { { 'R', 'D', 'm', '2' } };
+
+template <class protocol_t>
+class v1_namespace_semilattice_metadata_t {
+public:
+    vclock_t<persistable_blueprint_t<protocol_t> > blueprint;
+    vclock_t<datacenter_id_t> primary_datacenter;
+    vclock_t<std::map<datacenter_id_t, int32_t> > replica_affinities;
+    vclock_t<std::map<datacenter_id_t, ack_expectation_t> > ack_expectations;
+    vclock_t<nonoverlapping_regions_t<protocol_t> > shards;
+    vclock_t<name_string_t> name;
+    vclock_t<int> port;
+    vclock_t<region_map_t<protocol_t, machine_id_t> > primary_pinnings;
+    vclock_t<region_map_t<protocol_t, std::set<machine_id_t> > > secondary_pinnings;
+    vclock_t<std::string> primary_key;
+    vclock_t<database_id_t> database;
+    vclock_t<int64_t> cache_size;
+
+    RDB_MAKE_ME_SERIALIZABLE_12(blueprint, primary_datacenter, replica_affinities, ack_expectations, shards, name, port, primary_pinnings, secondary_pinnings, primary_key, database, cache_size);
+};
+
+template <class protocol_t>
+class v1_namespaces_semilattice_metadata_t {
+public:
+    std::map<namespace_id_t, deletable_t<v1_namespace_semilattice_metadata_t<protocol_t> > > namespaces;
+
+    RDB_MAKE_ME_SERIALIZABLE_1(namespaces);
+};
+
+class v1_cluster_semilattice_metadata_t {
+public:
+    v1_namespaces_semilattice_metadata_t<mock::dummy_protocol_t> dummy_namespaces;
+    v1_namespaces_semilattice_metadata_t<memcached_protocol_t> memcached_namespaces;
+    v1_namespaces_semilattice_metadata_t<rdb_protocol_t> rdb_namespaces;
+
+    machines_semilattice_metadata_t machines;
+    datacenters_semilattice_metadata_t datacenters;
+    databases_semilattice_metadata_t databases;
+
+    RDB_MAKE_ME_SERIALIZABLE_6(dummy_namespaces, memcached_namespaces, rdb_namespaces, machines, datacenters, databases);
+};
+
+/* Tables from a v1 file were all created with the sharding factor and block size
+that used to be hard-coded, which are still the defaults, so the new fields keep
+their default values. Their vector clocks are empty, so every server that
+upgrades its own copy of the metadata arrives at the same, unconflicted value. */
+template <class protocol_t>
+static void upgrade_namespaces(const v1_namespaces_semilattice_metadata_t<protocol_t> &old_namespaces,
+                               cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> > *namespaces_out) {
+    typename cow_ptr_t<namespaces_semilattice_metadata_t<protocol_t> >::change_t change(namespaces_out);
+    change.get()->namespaces.clear();
+    for (typename std::map<namespace_id_t, deletable_t<v1_namespace_semilattice_metadata_t<protocol_t> > >::const_iterator it = old_namespaces.namespaces.begin();
+         it != old_namespaces.namespaces.end();
+         ++it) {
+        deletable_t<namespace_semilattice_metadata_t<protocol_t> > ns;
+        if (it->second.is_deleted()) {
+            ns.mark_deleted();
+        } else {
+            const v1_namespace_semilattice_metadata_t<protocol_t> &old_ns = it->second.get_ref();
+            namespace_semilattice_metadata_t<protocol_t> *new_ns = ns.get_mutable();
+            new_ns->blueprint = old_ns.blueprint;
+            new_ns->primary_datacenter = old_ns.primary_datacenter;
+            new_ns->replica_affinities = old_ns.replica_affinities;
+            new_ns->ack_expectations = old_ns.ack_expectations;
+            new_ns->shards = old_ns.shards;
+            new_ns->name = old_ns.name;
+            new_ns->port = old_ns.port;
+            new_ns->primary_pinnings = old_ns.primary_pinnings;
+            new_ns->secondary_pinnings = old_ns.secondary_pinnings;
+            new_ns->primary_key = old_ns.primary_key;
+            new_ns->database = old_ns.database;
+            new_ns->cache_size = old_ns.cache_size;
+        }
+        change.get()->namespaces.insert(std::make_pair(it->first, ns));
+    }
+}
+
+static void upgrade_metadata(const v1_cluster_semilattice_metadata_t &old_metadata,
+                             cluster_semilattice_metadata_t *metadata_out) {
+    upgrade_namespaces(old_metadata.dummy_namespaces, &metadata_out->dummy_namespaces);
+    upgrade_namespaces(old_metadata.memcached_namespaces, &metadata_out->memcached_namespaces);
+    upgrade_namespaces(old_metadata.rdb_namespaces, &metadata_out->rdb_namespaces);
+    metadata_out->machines = old_metadata.machines;
+    metadata_out->datacenters = old_metadata.datacenters;
+    metadata_out->databases = old_metadata.databases;
+}
+
 template <class T>
 static void write_blob(transaction_t *txn, char *ref, int maxreflen, const T &value) {
     write_message_t msg;
@@ -216,7 +313,7 @@ cluster_persistent_file_t::cluster_persistent_file_t(io_backender_t *io_backende
     cluster_metadata_superblock_t *sb = static_cast<cluster_metadata_superblock_t *>(superblock.get_data_write());
 
     bzero(sb, get_cache_block_size().value());
-    sb->magic = expected_magic;
+    sb->magic = cluster_metadata_magic;
     sb->machine_id = machine_id;
     write_blob(txn.get(),
                sb->metadata_blob,
@@ -249,7 +346,14 @@ cluster_semilattice_metadata_t cluster_persistent_file_t::read_metadata() {
 
     const cluster_metadata_superblock_t *sb = static_cast<const cluster_metadata_superblock_t *>(superblock.get_data_read());
     cluster_semilattice_metadata_t metadata;
-    read_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
+    if (sb->magic == cluster_metadata_magic) {
+        read_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &metadata);
+    } else {
+        guarantee(sb->magic == expected_magic, "Unrecognized cluster metadata format.");
+        v1_cluster_semilattice_metadata_t old_metadata;
+        read_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, &old_metadata);
+        upgrade_metadata(old_metadata, &metadata);
+    }
     return metadata;
 }
 
@@ -259,6 +363,7 @@ void cluster_persistent_file_t::update_metadata(const cluster_semilattice_metada
     buf_lock_t superblock(txn.get(), SUPERBLOCK_ID, rwi_write);
 
     cluster_metadata_superblock_t *sb = static_cast<cluster_metadata_superblock_t *>(superblock.get_data_write());
+    sb->magic = cluster_metadata_magic;
     write_blob(txn.get(), sb->metadata_blob, cluster_metadata_superblock_t::METADATA_BLOB_MAXREFLEN, metadata);
 }
 
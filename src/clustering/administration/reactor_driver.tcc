@@ -115,6 +115,8 @@ public:
                             reactor_driver_t<protocol_t> *parent,
                             namespace_id_t namespace_id,
                             int64_t _cache_size,
+                            int _cpu_sharding_factor,
+                            int _block_size,
                             const blueprint_t<protocol_t> &bp,
                             svs_by_namespace_t<protocol_t> *svs_by_namespace,
                             typename protocol_t::context_t *_ctx) :
@@ -124,7 +126,9 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
-        cache_size(_cache_size)
+        cache_size(_cache_size),
+        cpu_sharding_factor(_cpu_sharding_factor),
+        block_size(_block_size)
     {
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t<protocol_t>::initialize_reactor, this, io_backender));
     }
@@ -307,7 +311,7 @@ private:
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, cache_size, cpu_sharding_factor, block_size, &stores_lifetimer_, &svs_, ctx);
 
         reactor_.init(new reactor_t<protocol_t>(
             base_path,
@@ -356,6 +360,8 @@ private:
 
     scoped_ptr_t<typename watchable_t<directory_echo_wrapper_t<cow_ptr_t<reactor_business_card_t<protocol_t> > > >::subscription_t> reactor_directory_subscription_;
     int64_t cache_size;
+    int cpu_sharding_factor;
+    int block_size;
 
     DISABLE_COPYING(watchable_and_reactor_t);
 };
@@ -471,8 +477,39 @@ void reactor_driver_t<protocol_t>::on_change() {
                                 it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str());
                     }
 
+                    int cpu_sharding_factor;
+                    if (it->second.get_ref().cpu_sharding_factor.in_conflict()) {
+                        cpu_sharding_factor = DEFAULT_CPU_SHARDING_FACTOR;
+                    } else {
+                        cpu_sharding_factor = it->second.get_ref().cpu_sharding_factor.get();
+                    }
+
+                    if (cpu_sharding_factor < 1 || cpu_sharding_factor > MAX_CPU_SHARDING_FACTOR) {
+                        cpu_sharding_factor = DEFAULT_CPU_SHARDING_FACTOR;
+                        logINF("Namespace %s(%s) has an invalid cpu sharding factor. Using %d instead.\n",
+                                uuid_to_str(it->first).c_str(),
+                                it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                cpu_sharding_factor);
+                    }
+
+                    int block_size;
+                    if (it->second.get_ref().block_size.in_conflict()) {
+                        block_size = DEFAULT_BTREE_BLOCK_SIZE;
+                    } else {
+                        block_size = it->second.get_ref().block_size.get();
+                    }
+
+                    if (block_size < MIN_BTREE_BLOCK_SIZE || block_size > MAX_BTREE_BLOCK_SIZE
+                        || (block_size & (block_size - 1)) != 0) {
+                        block_size = DEFAULT_BTREE_BLOCK_SIZE;
+                        logINF("Namespace %s(%s) has an invalid block size. Using %d instead.\n",
+                                uuid_to_str(it->first).c_str(),
+                                it->second.get_ref().name.in_conflict() ? "Name in conflict" : it->second.get_ref().name.get().c_str(),
+                                block_size);
+                    }
+
                     namespace_id_t tmp = it->first;
-                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, bp, svs_by_namespace, ctx));
+                    reactor_data.insert(tmp, new watchable_and_reactor_t<protocol_t>(base_path, io_backender, this, it->first, cache_size, cpu_sharding_factor, block_size, bp, svs_by_namespace, ctx));
                 } else {
                     reactor_data.find(it->first)->second->watchable.set_value(bp);
                 }
@@ -16,7 +16,7 @@
  */
 
 #define SOFTWARE_NAME_STRING "RethinkDB"
-#define SERIALIZER_VERSION_STRING "1.11"
+#define SERIALIZER_VERSION_STRING "1.12"
 
 /**
  * Basic configuration parameters.
@@ -40,6 +40,14 @@
 // factor.
 #define DEFAULT_IO_BATCH_FACTOR                   8
 
+// Index writes that arrive while a metablock write is in flight share the next
+// metablock write (and its datasync). The window additionally holds a group of
+// index writes open for that many milliseconds to let more writes join it; the
+// max writes cap closes a group early so that its latency stays bounded.
+#define DEFAULT_GROUP_COMMIT_WINDOW_MS            0
+#define DEFAULT_GROUP_COMMIT_MAX_WRITES           256
+#define MAX_GROUP_COMMIT_WINDOW_MS                1000
+
 // Currently, each cache uses two IO accounts:
 // one account for writes, and one account for reads.
 // By adjusting the priorities of these accounts, reads
@@ -73,8 +81,22 @@
 // Size of the metablock (in bytes)
 #define METABLOCK_SIZE                            (4 * KILOBYTE)
 
-// Size of each btree node (in bytes) on disk
+// Size of each btree node (in bytes) on disk, unless the table was created with a
+// different block_size. It has to be a power of two between the minimum and the
+// maximum; node offsets are 16 bits wide, which is where the maximum comes from.
 #define DEFAULT_BTREE_BLOCK_SIZE                  (4 * KILOBYTE)
+#define MIN_BTREE_BLOCK_SIZE                      (4 * KILOBYTE)
+#define MAX_BTREE_BLOCK_SIZE                      (64 * KILOBYTE)
+
+// How full a btree node is left when it gets split by a key that goes past its end,
+// which is what keys written in ascending order do. The rest of the node goes to
+// the new node on its right, which the following keys then fill up.
+#define BTREE_APPEND_SPLIT_FILL_PERCENT           90
+
+// How many rows secondary index construction reads out of the primary btree, and how
+// many queued writes it replays, before writing their index entries in one transaction.
+// The entries are sorted, so bigger batches put more of them in each index leaf.
+#define SINDEX_POST_CONSTRUCTION_BATCH_SIZE       1024
 
 // Size of each extent (in bytes)
 #define DEFAULT_EXTENT_SIZE                       (512 * KILOBYTE)
@@ -110,12 +132,48 @@
 // We start flushing dirty pages as soon as we hit this fraction of the unsaved data limit
 #define FLUSH_AT_FRACTION_OF_UNSAVED_DATA_LIMIT   0.2
 
+// When the node has a cache budget (--cache-size), it is redistributed between the
+// caches of all tables on the node every CACHE_BALANCER_INTERVAL_MS milliseconds,
+// CACHE_BALANCER_STEP_FRACTION of a cache's size (but at least CACHE_BALANCER_MIN_STEP
+// bytes) at a time. No cache is shrunk below CACHE_BALANCER_MIN_CACHE_SIZE.
+#define CACHE_BALANCER_INTERVAL_MS                1000
+#define CACHE_BALANCER_STEP_FRACTION              0.1
+#define CACHE_BALANCER_MIN_STEP                   (4 * MEGABYTE)
+#define CACHE_BALANCER_MIN_CACHE_SIZE             (8 * MEGABYTE)
+
+// Each table is split into this many hash shards ("CPU shards") on every server, each
+// with its own store, cache and thread, unless it was created with a different
+// cpu_sharding_factor. All servers must use the same factor for a given table.
+#define DEFAULT_CPU_SHARDING_FACTOR               4
+#define MAX_CPU_SHARDING_FACTOR                   MAX_THREADS
+
 // How many times the page replacement algorithm tries to find an eligible page before giving up.
 // Note that (MAX_UNSAVED_DATA_LIMIT_FRACTION ** PAGE_REPL_NUM_TRIES) is the probability that the
 // page replacement algorithm will succeed on a given try, and if that probability is less than 1/2
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// With the 2Q page replacement policy, at most this fraction of the cache is kept in the
+// protected segment; the rest is left for blocks that have only been accessed once.
+#define PAGE_REPL_2Q_PROTECTED_FRACTION           0.75
+
+// Range scans keep this many of the upcoming children of the internal node they are
+// scanning loading in the background. The window grows when the scan catches up with
+// the disk and shrinks again when the disk keeps ahead of it.
+#define BTREE_PREFETCH_MIN_WINDOW                 2
+#define BTREE_PREFETCH_MAX_WINDOW                 64
+
+// Key filters (the Bloom filters that let lookups of missing keys skip going down the
+// btree) get this many bits per key they are sized for, which makes about one in a
+// hundred of those lookups go down the tree anyway. A filter is sized for at least
+// KEY_FILTER_MIN_KEYS keys, and for twice as many as the btree had when it was built.
+#define KEY_FILTER_BITS_PER_KEY                   10
+#define KEY_FILTER_MIN_KEYS                       4096
+
+// In KEY_FILTER_MODE_AUTO, a btree gets a key filter once this many lookups of keys
+// that it doesn't have have gone down the tree.
+#define KEY_FILTER_AUTO_MIN_MISSES                1024
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -134,6 +192,25 @@
 // have to wait until the first one finishes
 #define MAX_CONCURRENT_QUERIES_PER_CONNECTION     500
 
+// Outgoing cluster messages are queued per connection and coalesced into large writes.
+// By default a batch goes out as soon as the previous write finishes; a nonzero delay
+// makes the writer wait that long for more messages unless it already has at least
+// DEFAULT_CLUSTER_SEND_FLUSH_BYTES queued.
+#define DEFAULT_CLUSTER_SEND_FLUSH_DELAY_MS       0
+#define DEFAULT_CLUSTER_SEND_FLUSH_BYTES          (64 * KILOBYTE)
+#define MAX_CLUSTER_SEND_FLUSH_DELAY_MS           100
+
+// Senders block once this many bytes are waiting to be written to a single peer
+#define CLUSTER_SEND_QUEUE_MAX_BYTES              (16 * MEGABYTE)
+
+// A peer that sends a message larger than this gets disconnected, rather than making
+// us allocate however much it asks for
+#define CLUSTER_MAX_MESSAGE_SIZE                  (256 * MEGABYTE)
+
+// A connection keeps its receive buffer from one message to the next, unless a
+// message made it grow past this
+#define CLUSTER_RECEIVE_BUFFER_MAX_KEPT_BYTES     (1 * MEGABYTE)
+
 // The number of concurrent queries when loading memcached operations from a file.
 #define MAX_CONCURRENT_QUEURIES_ON_IMPORT         1000
 
@@ -172,6 +249,15 @@
 // What's the definition of a "young" extent in microseconds?
 #define GC_YOUNG_EXTENT_TIMELIMIT_MICROS          50000
 
+// A block whose previous version was written less than GC_HOT_REWRITE_MICROS ago is
+// written to the hot data extent, and one whose previous version is more than
+// GC_COLD_REWRITE_MICROS old goes to the cold one. Everything else is warm.
+#define GC_HOT_REWRITE_MICROS                     (10 * MILLION)
+#define GC_COLD_REWRITE_MICROS                    (600 * MILLION)
+
+// How often the GC recomputes the ages it weighs the garbage in old extents by.
+#define GC_BENEFIT_REFRESH_MICROS                 MILLION
+
 // If the size of the LBA on a given disk exceeds LBA_MIN_SIZE_FOR_GC, then the fraction of the
 // entries that are live and not garbage should be at least LBA_MIN_UNGARBAGE_FRACTION.
 // TODO: Maybe change this back to 20 megabytes?
@@ -197,6 +283,18 @@
 
 #define MAX_COROS_PER_THREAD                      10000
 
+// How many coroutines spawned with coro_t::spawn_stealable() can wait to be run in
+// one thread's work-stealing deque; beyond this they are just run on that thread.
+// Must be a power of two.
+#define COROUTINE_DEQUE_SIZE                      1024
+
+// How many coroutines a thread takes off its own work-stealing deque before letting
+// the rest of its event loop run
+#define COROUTINE_DEQUE_DRAIN_BATCH               16
+
+// Responses to client queries at least this big are encoded in a stealable coroutine
+#define MIN_STEALABLE_RESPONSE_SIZE               (64 * KILOBYTE)
+
 
 // Size of a cache line (used in cache_line_padded_t).
 #define CACHE_LINE_SIZE                           64
@@ -97,6 +97,9 @@ public:
 
     void append(const void *p, int64_t n);
 
+    // The total number of bytes appended so far.
+    int64_t size() const;
+
     intrusive_list_t<write_buffer_t> *unsafe_expose_buffers() { return &buffers_; }
 
     template <class T>
@@ -15,9 +15,7 @@ size_t varint_uint64_serialized_size(uint64_t value) {
     return count;
 }
 
-void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
-    // buf needs to be 10 or more -- ceil(64/7) is 10.
-    uint8_t buf[16];
+size_t serialize_varint_uint64_into_buf(const uint64_t value, uint8_t *buf) {
     size_t size = 0;
     if (value == 0) {
         buf[0] = 0;
@@ -32,6 +30,13 @@ void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
         buf[size] = n;
         ++size;
     }
+    rassert(size <= MAX_VARINT_UINT64_SIZE);
+    return size;
+}
+
+void serialize_varint_uint64(write_message_t *msg, const uint64_t value) {
+    uint8_t buf[MAX_VARINT_UINT64_SIZE];
+    size_t size = serialize_varint_uint64_into_buf(value, buf);
     msg->append(buf, size);
 }
 
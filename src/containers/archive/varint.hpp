@@ -22,6 +22,13 @@
 // silently truncate out-of-range varints when decoding.
 
 size_t varint_uint64_serialized_size(uint64_t value);
+
+// The most bytes a varint can take up: ceil(64/7).
+#define MAX_VARINT_UINT64_SIZE 10
+
+// Encodes `value` into `buf`, which must have room for MAX_VARINT_UINT64_SIZE
+// bytes, and returns the number of bytes used.
+size_t serialize_varint_uint64_into_buf(const uint64_t value, uint8_t *buf);
 void serialize_varint_uint64(write_message_t *msg, const uint64_t value);
 archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *value_out);
 
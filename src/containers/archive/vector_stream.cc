@@ -15,6 +15,10 @@ int64_t vector_stream_t::write(const void *p, int64_t n) {
 }
 
 vector_read_stream_t::vector_read_stream_t(const std::vector<char> *vector) : pos_(0), vec_(vector) { }
+vector_read_stream_t::vector_read_stream_t(const std::vector<char> *vector, int64_t offset)
+    : pos_(offset), vec_(vector) {
+    guarantee(offset >= 0 && static_cast<uint64_t>(offset) <= vector->size());
+}
 vector_read_stream_t::~vector_read_stream_t() { }
 
 int64_t vector_read_stream_t::read(void *p, int64_t n) {
@@ -24,10 +24,15 @@ private:
 class vector_read_stream_t : public read_stream_t {
 public:
     explicit vector_read_stream_t(const std::vector<char> *vector);
+    // Starts reading at `offset`.
+    vector_read_stream_t(const std::vector<char> *vector, int64_t offset);
     virtual ~vector_read_stream_t();
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
 
+    // The offset of the next byte to be read.
+    int64_t tell() const { return pos_; }
+
 private:
     int64_t pos_;
     const std::vector<char> *vec_;
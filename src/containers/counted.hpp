@@ -257,6 +257,87 @@ inline intptr_t counted_use_count(const slow_atomic_countable_t<T> *p) {
 }
 
 
+
+template <class> class promotable_countable_t;
+
+template <class T>
+inline void counted_add_ref(const promotable_countable_t<T> *p);
+template <class T>
+inline void counted_release(const promotable_countable_t<T> *p);
+template <class T>
+inline intptr_t counted_use_count(const promotable_countable_t<T> *p);
+
+// Like slow_atomic_countable_t, except that the refcount is only updated atomically
+// once `promote_to_atomic` has been called.  Until then, references to the object
+// must only be taken or dropped on one thread at a time.  An object may still move
+// to another thread along with the coroutine that holds its references, since the
+// thread switch orders the updates, but it has to be promoted before two threads
+// can hold references to it at once.
+template <class T>
+class promotable_countable_t {
+public:
+    promotable_countable_t() : refcount_(0), atomic_(false) { }
+
+protected:
+    ~promotable_countable_t() {
+        rassert(refcount_ == 0);
+    }
+
+    counted_t<T> counted_from_this() {
+        rassert(counted_use_count(this) > 0);
+        return counted_t<T>(static_cast<T *>(this));
+    }
+
+    counted_t<const T> counted_from_this() const {
+        rassert(counted_use_count(this) > 0);
+        return counted_t<const T>(static_cast<const T *>(this));
+    }
+
+    void promote_to_atomic() const {
+        atomic_ = true;
+    }
+
+    bool is_atomic() const {
+        return atomic_;
+    }
+
+private:
+    friend void counted_add_ref<T>(const promotable_countable_t<T> *p);
+    friend void counted_release<T>(const promotable_countable_t<T> *p);
+    friend intptr_t counted_use_count<T>(const promotable_countable_t<T> *p);
+
+    mutable intptr_t refcount_;
+    mutable bool atomic_;
+    DISABLE_COPYING(promotable_countable_t);
+};
+
+template <class T>
+inline void counted_add_ref(const promotable_countable_t<T> *p) {
+    DEBUG_VAR intptr_t res = p->atomic_
+        ? __sync_add_and_fetch(&p->refcount_, 1)
+        : ++p->refcount_;
+    rassert(res > 0);
+}
+
+template <class T>
+inline void counted_release(const promotable_countable_t<T> *p) {
+    intptr_t res = p->atomic_
+        ? __sync_sub_and_fetch(&p->refcount_, 1)
+        : --p->refcount_;
+    rassert(res >= 0);
+    if (res == 0) {
+        delete static_cast<T *>(const_cast<promotable_countable_t<T> *>(p));
+    }
+}
+
+template <class T>
+inline intptr_t counted_use_count(const promotable_countable_t<T> *p) {
+    intptr_t tmp = static_cast<const volatile intptr_t&>(p->refcount_);
+    rassert(tmp > 0);
+    return tmp;
+}
+
+
 // A noncopyable reference to a reference-counted object.
 template <class T>
 class movable_t {
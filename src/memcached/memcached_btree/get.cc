@@ -28,3 +28,30 @@ get_result_t memcached_get(const store_key_t &store_key, btree_slice_t *slice, e
     return get_result_t(dp, value->mcflags(), 0);
 }
 
+
+class memcached_get_multiple_callback_t : public multi_get_callback_t<memcached_value_t> {
+public:
+    memcached_get_multiple_callback_t(const std::vector<store_key_t> *_keys,
+                                      exptime_t _effective_time,
+                                      get_multiple_result_t *_result)
+        : keys(_keys), effective_time(_effective_time), result(_result) { }
+
+    void on_value(transaction_t *txn, size_t index, const memcached_value_t *value) {
+        if (value->expired(effective_time)) {
+            return;
+        }
+        // Large values are read from their own blocks, so this can block.
+        counted_t<data_buffer_t> dp = value_to_data_buffer(value, txn);
+        result->results[(*keys)[index]] = get_result_t(dp, value->mcflags(), 0);
+    }
+
+private:
+    const std::vector<store_key_t> *keys;
+    exptime_t effective_time;
+    get_multiple_result_t *result;
+};
+
+void memcached_get_multiple(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock, get_multiple_result_t *result_out) {
+    memcached_get_multiple_callback_t cb(&keys, effective_time, result_out);
+    get_multiple_keys(txn, superblock, keys, slice->root_eviction_priority, &slice->stats, &cb);
+}
@@ -2,6 +2,8 @@
 #ifndef MEMCACHED_MEMCACHED_BTREE_GET_HPP_
 #define MEMCACHED_MEMCACHED_BTREE_GET_HPP_
 
+#include <vector>
+
 #include "buffer_cache/types.hpp"
 #include "memcached/queries.hpp"
 
@@ -10,4 +12,7 @@ class superblock_t;
 
 get_result_t memcached_get(const store_key_t &key, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock);
 
+// `keys` has to be sorted. Goes down the btree once for all of them.
+void memcached_get_multiple(const std::vector<store_key_t> &keys, btree_slice_t *slice, exptime_t effective_time, transaction_t *txn, superblock_t *superblock, get_multiple_result_t *result_out);
+
 #endif // MEMCACHED_MEMCACHED_BTREE_GET_HPP_
@@ -9,8 +9,11 @@
 #include <stdarg.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <map>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "errors.hpp"
@@ -301,6 +304,42 @@ void do_one_get(txt_memcached_handler_t *rh, bool with_cas, get_t *gets, int i,
     }
 }
 
+/* Reads all of the keys of a `get` with one read, which the namespace interface
+splits into one read per shard. */
+void do_multiple_get(txt_memcached_handler_t *rh, std::vector<get_t> *gets, order_token_t token) {
+    std::vector<store_key_t> keys;
+    for (size_t i = 0; i < gets->size(); ++i) {
+        keys.push_back((*gets)[i].key);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    bool ok = false;
+    std::string error_message;
+    get_multiple_result_t result;
+    try {
+        memcached_protocol_t::read_t read(get_multiple_query_t(keys), time(NULL));
+        memcached_protocol_t::read_response_t response;
+        rh->nsi->read(read, &response, token, rh->interruptor);
+        result = boost::get<get_multiple_result_t>(response.result);
+        ok = true;
+    } catch (const cannot_perform_query_exc_t &e) {
+        error_message = e.what();
+    } catch (const interrupted_exc_t &) {
+        /* do nothing */
+    }
+
+    for (size_t i = 0; i < gets->size(); ++i) {
+        get_t *get = &(*gets)[i];
+        get->ok = ok;
+        get->error_message = error_message;
+        std::map<store_key_t, get_result_t>::const_iterator it = result.results.find(get->key);
+        if (it != result.results.end()) {
+            get->res = it->second;
+        }
+    }
+}
+
 void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas, int argc, char **argv, order_token_t token) {
     // We should already be spawned within a coroutine.
     pipeliner_acq_t pipeliner_acq(pipeliner);
@@ -336,8 +375,13 @@ void do_get(txt_memcached_handler_t *rh, pipeliner_t *pipeliner, bool with_cas,
 
     block_pm_duration get_timer(&rh->stats->pm_cmd_get);
 
-    /* Now that we're sure they're all valid, send off the requests */
-    pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    /* Now that we're sure they're all valid, send off the requests. A `gets` has to
+    generate a CAS for every key, so it still does one write per key. */
+    if (!with_cas && gets.size() > 1) {
+        do_multiple_get(rh, &gets, token);
+    } else {
+        pmap(gets.size(), boost::bind(&do_one_get, rh, with_cas, gets.data(), _1, token));
+    }
 
     if (rh->interruptor->is_pulsed()) {
         pipeliner_acq.begin_write();
@@ -77,9 +77,11 @@ archive_result_t deserialize(read_stream_t *s, counted_t<data_buffer_t> *buf) {
 }
 
 RDB_IMPL_SERIALIZABLE_1(get_query_t, key);
+RDB_IMPL_SERIALIZABLE_2(get_multiple_query_t, region, keys);
 RDB_IMPL_SERIALIZABLE_2(rget_query_t, region, maximum);
 RDB_IMPL_SERIALIZABLE_3(distribution_get_query_t, max_depth, result_limit, region);
 RDB_IMPL_SERIALIZABLE_3(get_result_t, value, flags, cas);
+RDB_IMPL_SERIALIZABLE_1(get_multiple_result_t, results);
 RDB_IMPL_SERIALIZABLE_3(key_with_data_buffer_t, key, mcflags, value_provider);
 RDB_IMPL_SERIALIZABLE_2(rget_result_t, pairs, truncated);
 RDB_IMPL_SERIALIZABLE_2(distribution_result_t, region, key_counts);
@@ -117,6 +119,9 @@ struct read_get_region_visitor_t : public boost::static_visitor<region_t> {
     region_t operator()(get_query_t get) {
         return monokey_region(get.key);
     }
+    region_t operator()(const get_multiple_query_t &get_multiple) {
+        return get_multiple.region;
+    }
     region_t operator()(rget_query_t rget) {
         return rget.region;
     }
@@ -149,6 +154,21 @@ struct read_shard_visitor_t : public boost::static_visitor<bool> {
         return ret;
     }
 
+    bool operator()(const get_multiple_query_t &get_multiple) const {
+        get_multiple_query_t tmp;
+        for (auto it = get_multiple.keys.begin(); it != get_multiple.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                tmp.keys.push_back(*it);
+            }
+        }
+        if (tmp.keys.empty()) {
+            return false;
+        }
+        tmp.region = region_intersection(*region, get_multiple.region);
+        *read_out = read_t(tmp, effective_time);
+        return true;
+    }
+
     template <class T>
     bool rangey_query(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -237,6 +257,15 @@ struct read_unshard_visitor_t : public boost::static_visitor<read_response_t> {
         guarantee(count == 1);
         return read_response_t(boost::get<get_result_t>(bits[0].result));
     }
+    read_response_t operator()(UNUSED const get_multiple_query_t &get_multiple) {
+        get_multiple_result_t result;
+        for (size_t i = 0; i < count; ++i) {
+            const get_multiple_result_t *bit = boost::get<get_multiple_result_t>(&bits[i].result);
+            guarantee(bit != NULL);
+            result.results.insert(bit->results.begin(), bit->results.end());
+        }
+        return read_response_t(result);
+    }
     read_response_t operator()(rget_query_t rget) {
         // TODO: do this without dynamic memory?
         std::vector<key_with_data_buffer_t> pairs;
@@ -408,14 +437,16 @@ region_t memcached_protocol_t::cpu_sharding_subspace(int subregion_number, int n
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_size,
+                 cache_balancer_t *balancer,
+                 page_repl_policy_t page_repl_policy,
                  bool create,
                  perfmon_collection_t *parent_perfmon_collection,
                  context_t *ctx,
                  io_backender_t *io,
                  const base_path_t &base_path)
     : btree_store_t<memcached_protocol_t>(
-            serializer, perfmon_name, cache_size,
-            create, parent_perfmon_collection, ctx, io,
+            serializer, perfmon_name, cache_size, balancer,
+            page_repl_policy, create, parent_perfmon_collection, ctx, io,
             base_path)
 { }
 
@@ -431,6 +462,13 @@ struct read_visitor_t : public boost::static_visitor<read_response_t> {
             memcached_get(get.key, btree, effective_time, txn, superblock));
     }
 
+    read_response_t operator()(const get_multiple_query_t& get_multiple) {
+        get_multiple_result_t result;
+        memcached_get_multiple(get_multiple.keys, btree, effective_time, txn, superblock,
+                               &result);
+        return read_response_t(result);
+    }
+
     read_response_t operator()(const rget_query_t& rget) {
         return read_response_t(
             memcached_rget_slice(btree, rget.region.inner, rget.maximum, effective_time, txn, superblock));
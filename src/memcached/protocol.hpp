@@ -32,9 +32,11 @@ write_message_t &operator<<(write_message_t &msg, const rget_result_t &iter);
 archive_result_t deserialize(read_stream_t *s, rget_result_t *iter);
 
 RDB_DECLARE_SERIALIZABLE(get_query_t);
+RDB_DECLARE_SERIALIZABLE(get_multiple_query_t);
 RDB_DECLARE_SERIALIZABLE(rget_query_t);
 RDB_DECLARE_SERIALIZABLE(distribution_get_query_t);
 RDB_DECLARE_SERIALIZABLE(get_result_t);
+RDB_DECLARE_SERIALIZABLE(get_multiple_result_t);
 RDB_DECLARE_SERIALIZABLE(key_with_data_buffer_t);
 RDB_DECLARE_SERIALIZABLE(rget_result_t);
 RDB_DECLARE_SERIALIZABLE(distribution_result_t);
@@ -58,7 +60,8 @@ public:
     struct context_t { };
 
     struct read_response_t {
-        typedef boost::variant<get_result_t, rget_result_t, distribution_result_t> result_t;
+        typedef boost::variant<get_result_t, get_multiple_result_t, rget_result_t,
+                               distribution_result_t> result_t;
 
         read_response_t() { }
         read_response_t(const read_response_t& r) : result(r.result) { }
@@ -68,7 +71,8 @@ public:
     };
 
     struct read_t {
-        typedef boost::variant<get_query_t, rget_query_t, distribution_get_query_t> query_t;
+        typedef boost::variant<get_query_t, get_multiple_query_t, rget_query_t,
+                               distribution_get_query_t> query_t;
 
         region_t get_region() const THROWS_NOTHING;
         // Returns true if the read had any applicability to the region, and a non-empty
@@ -169,6 +173,8 @@ public:
         store_t(serializer_t *serializer,
                 const std::string &perfmon_name,
                 int64_t cache_quota,
+                cache_balancer_t *balancer,
+                page_repl_policy_t page_repl_policy,
                 bool create,
                 perfmon_collection_t *collection,
                 context_t *,
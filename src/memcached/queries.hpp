@@ -52,6 +52,27 @@ struct get_result_t {
     cas_t cas;
 };
 
+/* `get` with several keys */
+
+struct get_multiple_query_t {
+    // Covers all of the keys; it gets narrowed down by sharding.
+    hash_region_t<key_range_t> region;
+    // Sorted, without duplicates.
+    std::vector<store_key_t> keys;
+
+    get_multiple_query_t() { }
+    // There has to be at least one key.
+    explicit get_multiple_query_t(const std::vector<store_key_t> &_keys)
+        : region(key_range_t(key_range_t::closed, _keys.front(),
+                             key_range_t::closed, _keys.back())),
+          keys(_keys) { }
+};
+
+struct get_multiple_result_t {
+    // The keys that were found and haven't expired.
+    std::map<store_key_t, get_result_t> results;
+};
+
 /* `rget` */
 
 struct rget_query_t {
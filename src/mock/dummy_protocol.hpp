@@ -9,6 +9,8 @@
 #include <utility>
 
 #include "backfill_progress.hpp"
+#include "btree/key_filter.hpp"
+#include "buffer_cache/mirrored/config.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/rwi_lock.hpp"
 #include "containers/archive/stl_types.hpp"
@@ -18,6 +20,7 @@
 #include "perfmon/types.hpp"
 #include "utils.hpp"
 
+class cache_balancer_t;
 class signal_t;
 class io_backender_t;
 class serializer_t;
@@ -106,11 +109,15 @@ public:
 
         store_t();
         store_t(serializer_t *serializer, const std::string &perfmon_name,
-                UNUSED int64_t cache_size, bool create,
+                UNUSED int64_t cache_size, UNUSED cache_balancer_t *balancer,
+                UNUSED page_repl_policy_t page_repl_policy, bool create,
                 perfmon_collection_t *collection, context_t *ctx,
                 io_backender_t *io, const base_path_t &);
         ~store_t();
 
+        // There are no btrees, so there are no key filters either.
+        void set_key_filter_mode(UNUSED key_filter_mode_t mode) { }
+
         void new_read_token(object_buffer_t<fifo_enforcer_sink_t::exit_read_t> *token_out) THROWS_NOTHING;
         void new_write_token(object_buffer_t<fifo_enforcer_sink_t::exit_write_t> *token_out) THROWS_NOTHING;
 
@@ -236,7 +236,14 @@ void protob_server_t<request_t, response_t, context_t>::send(
     conn->write(&size, sizeof(res.ByteSize()), closer);
     scoped_array_t<char> data(size);
 
-    res.SerializeToArray(data.data(), size);
+    if (size >= MIN_STEALABLE_RESPONSE_SIZE) {
+        // Encoding a large response can take a while, and only needs `res` and
+        // `data`, so an idle thread may as well do it while we serve other clients.
+        coro_t::run_stealable(boost::bind(&response_t::SerializeToArray,
+                                          &res, data.data(), size));
+    } else {
+        res.SerializeToArray(data.data(), size);
+    }
     conn->write(data.data(), size, closer);
 }
 
@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -12,6 +14,7 @@
 #include "btree/concurrent_traversal.hpp"
 #include "btree/erase_range.hpp"
 #include "btree/get_distribution.hpp"
+#include "btree/key_filter.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -26,17 +29,6 @@
 
 value_sizer_t<rdb_value_t>::value_sizer_t(block_size_t bs) : block_size_(bs) { }
 
-template<class Value>
-void find_keyvalue_location_for_write(
-    const btree_loc_info_t &info,
-    keyvalue_location_t<Value> *kv_loc_out,
-    promise_t<superblock_t *> *pass_back_superblock) {
-    find_keyvalue_location_for_write(
-        info.btree->txn, info.superblock, info.key->btree_key(), kv_loc_out,
-        &info.btree->slice->root_eviction_priority, &info.btree->slice->stats,
-        pass_back_superblock);
-}
-
 const rdb_value_t *value_sizer_t<rdb_value_t>::as_rdb(const void *p) {
     return reinterpret_cast<const rdb_value_t *>(p);
 }
@@ -68,17 +60,67 @@ bool btree_value_fits(block_size_t bs, int data_length, const rdb_value_t *value
     return blob::ref_fits(bs, data_length, value->value_ref(), blob::btree_maxreflen);
 }
 
-void rdb_get(const store_key_t &store_key, btree_slice_t *slice, transaction_t *txn, superblock_t *superblock, point_read_response_t *response) {
+void rdb_get(const store_key_t &store_key, btree_slice_t *slice, key_filter_t *key_filter, transaction_t *txn, superblock_t *superblock, point_read_response_t *response) {
+    if (key_filter != NULL && !key_filter->may_contain(store_key)) {
+        slice->stats.pm_keys_read.record();
+        superblock->release();
+        response->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
+        return;
+    }
+
     keyvalue_location_t<rdb_value_t> kv_location;
     find_keyvalue_location_for_read(txn, superblock, store_key.btree_key(), &kv_location, slice->root_eviction_priority, &slice->stats);
 
     if (!kv_location.value.has()) {
+        if (key_filter != NULL) {
+            key_filter->on_false_positive();
+        } else {
+            ++slice->key_lookup_misses;
+        }
         response->data.reset(new ql::datum_t(ql::datum_t::R_NULL));
     } else {
         response->data = get_data(kv_location.value.get(), txn);
     }
 }
 
+class rdb_get_multiple_callback_t : public multi_get_callback_t<rdb_value_t> {
+public:
+    rdb_get_multiple_callback_t(const std::vector<store_key_t> *_keys,
+                                batched_point_read_response_t *_response)
+        : keys(_keys), response(_response) { }
+
+    void on_value(transaction_t *txn, size_t index, const rdb_value_t *value) {
+        response->data[(*keys)[index]] = get_data(value, txn);
+    }
+
+private:
+    const std::vector<store_key_t> *keys;
+    batched_point_read_response_t *response;
+};
+
+void rdb_get_multiple(const std::vector<store_key_t> &keys, btree_slice_t *slice, key_filter_t *key_filter, transaction_t *txn, superblock_t *superblock, batched_point_read_response_t *response) {
+    if (key_filter == NULL) {
+        rdb_get_multiple_callback_t cb(&keys, response);
+        get_multiple_keys(txn, superblock, keys, slice->root_eviction_priority, &slice->stats, &cb);
+        slice->key_lookup_misses += keys.size() - response->data.size();
+        return;
+    }
+
+    std::vector<store_key_t> maybe_keys;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        if (key_filter->may_contain(*it)) {
+            maybe_keys.push_back(*it);
+        } else {
+            slice->stats.pm_keys_read.record();
+        }
+    }
+    rdb_get_multiple_callback_t cb(&maybe_keys, response);
+    get_multiple_keys(txn, superblock, maybe_keys, slice->root_eviction_priority, &slice->stats, &cb);
+    for (size_t i = response->data.size(); i < maybe_keys.size(); ++i) {
+        key_filter->on_false_positive();
+    }
+}
+
 void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
                         const store_key_t &key,
                         btree_slice_t *slice,
@@ -149,6 +191,9 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
     apply_keyvalue_change(txn, kv_location, key.btree_key(), timestamp,
                           false, &null_cb, &slice->root_eviction_priority);
     //                    ^^^^^ That means the key isn't expired.
+    if (slice->key_filter.has()) {
+        slice->key_filter->add(key.btree_key());
+    }
 }
 
 void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
@@ -173,45 +218,32 @@ void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
     apply_keyvalue_change(txn, kv_location, key.btree_key(), timestamp,
                           false, &null_cb, &slice->root_eviction_priority);
     //                    ^^^^^ That means the key isn't expired.
+    if (slice->key_filter.has()) {
+        slice->key_filter->add(key.btree_key());
+    }
 }
 
-void kv_location_set(keyvalue_location_t<rdb_value_t> *kv_location,
-                     const btree_loc_info_t &info,
-                     counted_t<const ql::datum_t> data,
-                     rdb_modification_info_t *mod_info_out) {
-    kv_location_set(kv_location, *info.key, data, info.btree->slice,
-                    info.btree->timestamp, info.btree->txn, mod_info_out);
-}
-void kv_location_delete(keyvalue_location_t<rdb_value_t> *kv_location,
-                        const btree_loc_info_t &info,
-                        rdb_modification_info_t *mod_info_out) {
-    kv_location_delete(kv_location, *info.key, info.btree->slice,
-                       info.btree->timestamp, info.btree->txn, mod_info_out);
-}
-
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+/* Replaces the value of key, which kv_location has to point at. */
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t &info,
+    const store_key_t &key,
+    keyvalue_location_t<rdb_value_t> *kv_location,
     const btree_point_replacer_t *replacer,
-    promise_t<superblock_t *> *superblock_promise,
     rdb_modification_info_t *mod_info_out) {
     bool return_vals = replacer->should_return_vals();
-    const std::string &primary_key = *info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const std::string &primary_key = *info.primary_key;
     ql::datum_ptr_t resp(ql::datum_t::R_OBJECT);
     try {
-        keyvalue_location_t<rdb_value_t> kv_location;
-        find_keyvalue_location_for_write(info, &kv_location, superblock_promise);
-
         bool started_empty, ended_empty;
         counted_t<const ql::datum_t> old_val;
-        if (!kv_location.value.has()) {
+        if (!kv_location->value.has()) {
             // If there's no entry with this key, pass NULL to the function.
             started_empty = true;
             old_val = make_counted<ql::datum_t>(ql::datum_t::R_NULL);
         } else {
             // Otherwise pass the entry with this key to the function.
             started_empty = false;
-            old_val = get_data(kv_location.value.get(), info.btree->txn);
+            old_val = get_data(kv_location->value.get(), info.txn);
             guarantee(old_val->get(primary_key, ql::NOTHROW).has());
         }
         guarantee(old_val.has());
@@ -260,7 +292,8 @@ batched_replace_response_t rdb_replace_and_return_superblock(
             } else {
                 conflict = resp.add("inserted", make_counted<ql::datum_t>(1.0));
                 r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                kv_location_set(&kv_location, info, new_val, mod_info_out);
+                kv_location_set(kv_location, key, new_val, info.slice,
+                                info.timestamp, info.txn, mod_info_out);
                 guarantee(mod_info_out->deleted.second.empty());
                 guarantee(!mod_info_out->added.second.empty());
                 mod_info_out->added.first = new_val;
@@ -268,7 +301,8 @@ batched_replace_response_t rdb_replace_and_return_superblock(
         } else {
             if (ended_empty) {
                 conflict = resp.add("deleted", make_counted<ql::datum_t>(1.0));
-                kv_location_delete(&kv_location, info, mod_info_out);
+                kv_location_delete(kv_location, key, info.slice,
+                                   info.timestamp, info.txn, mod_info_out);
                 guarantee(!mod_info_out->deleted.second.empty());
                 guarantee(mod_info_out->added.second.empty());
                 mod_info_out->deleted.first = old_val;
@@ -281,7 +315,8 @@ batched_replace_response_t rdb_replace_and_return_superblock(
                 } else {
                     conflict = resp.add("replaced", make_counted<ql::datum_t>(1.0));
                     r_sanity_check(new_val->get(primary_key, ql::NOTHROW).has());
-                    kv_location_set(&kv_location, info, new_val, mod_info_out);
+                    kv_location_set(kv_location, key, new_val, info.slice,
+                                    info.timestamp, info.txn, mod_info_out);
                     guarantee(!mod_info_out->deleted.second.empty());
                     guarantee(!mod_info_out->added.second.empty());
                     mod_info_out->added.first = new_val;
@@ -318,25 +353,79 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+class key_index_less_t {
+public:
+    explicit key_index_less_t(const std::vector<store_key_t> *_keys) : keys(_keys) { }
+    bool operator()(size_t a, size_t b) const {
+        return (*keys)[a] < (*keys)[b];
+    }
+private:
+    const std::vector<store_key_t> *keys;
+};
+
+/* What the coroutines of one rdb_batched_replace share. */
+struct batched_replace_state_t {
+    batched_replace_state_t(const btree_info_t *_info,
+                            const std::vector<store_key_t> *_keys,
+                            const btree_batched_replacer_t *_replacer)
+        : info(_info), keys(_keys), replacer(_replacer), responses(_keys->size()) { }
+
+    const btree_info_t *const info;
+    const std::vector<store_key_t> *const keys;
+    const btree_batched_replacer_t *const replacer;
+
+    // The indexes into keys that the current pass writes, sorted by key.
+    std::vector<size_t> order;
+    // The ones that the current pass couldn't write, for the next pass.
+    std::vector<size_t> leftovers;
+
+    std::vector<batched_replace_response_t> responses;
+    std::vector<rdb_modification_report_t> mod_reports;
+};
+
+/* Goes down the tree to the key at order[begin] and replaces it and the keys after
+it that the leaf's parent says are in the same leaf. Once it has reached the leaf,
+it pulses end_promise with the end of the keys it took, so that the next leaf's
+keys can go down the tree while the replacements in this one are made. */
+void do_a_leaf_of_replaces(
     auto_drainer_t::lock_t,
-    fifo_enforcer_sink_t *batched_replaces_fifo_sink,
-    const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    batched_replace_state_t *state,
+    superblock_t *superblock,
+    size_t begin,
     promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_report_cb_t *sindex_cb,
-    batched_replace_response_t *stats_out) {
-    fifo_enforcer_sink_t::exit_write_t exiter(
-        batched_replaces_fifo_sink, batched_replaces_fifo_token);
-
-    rdb_modification_report_t mod_report(*info.key);
-    counted_t<const ql::datum_t> res = rdb_replace_and_return_superblock(
-        info, &one_replace, superblock_promise, &mod_report.info);
-    *stats_out = (*stats_out)->merge(res, ql::stats_merge);
-
-    exiter.wait();
-    sindex_cb->on_mod_report(mod_report);
+    promise_t<size_t> *end_promise) {
+    const std::vector<store_key_t> &keys = *state->keys;
+    const std::vector<size_t> &order = state->order;
+
+    keyvalue_location_t<rdb_value_t> kv_location;
+    find_keyvalue_location_for_write(
+        state->info->txn, superblock, keys[order[begin]].btree_key(),
+        &kv_location, &state->info->slice->root_eviction_priority,
+        &state->info->slice->stats, superblock_promise);
+
+    size_t end = begin + 1;
+    while (end < order.size()
+           && keyvalue_location_covers(kv_location, keys[order[end]].btree_key())) {
+        ++end;
+    }
+    end_promise->pulse(end);
+
+    for (size_t i = begin; i < end; ++i) {
+        if (i != begin && !find_keyvalue_location_in_same_leaf(
+                state->info->txn, keys[order[i]].btree_key(), &kv_location)) {
+            // The leaf got split, or another split would need more than the locks
+            // we hold. The rest of our keys wait for the next pass.
+            state->leftovers.insert(state->leftovers.end(),
+                                    order.begin() + i, order.begin() + end);
+            break;
+        }
+        const size_t index = order[i];
+        rdb_modification_report_t mod_report(keys[index]);
+        one_replace_t one_replace(state->replacer, index);
+        state->responses[index] = rdb_replace_at_location(
+            *state->info, keys[index], &kv_location, &one_replace, &mod_report.info);
+        state->mod_reports.push_back(mod_report);
+    }
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -346,39 +435,59 @@ batched_replace_response_t rdb_batched_replace(
     const btree_batched_replacer_t *replacer,
     rdb_modification_report_cb_t *sindex_cb) {
 
-    fifo_enforcer_source_t batched_replaces_fifo_source;
-    fifo_enforcer_sink_t batched_replaces_fifo_sink;
+    batched_replace_state_t state(&info, &keys, replacer);
 
-    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    state.leftovers.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        state.leftovers[i] = i;
+    }
+    state.mod_reports.reserve(keys.size());
 
-    // We have to drain write operations before destructing everything above us,
-    // because the coroutines being drained use them.
     {
-        auto_drainer_t drainer;
-
-        // Note the destructor ordering: We release the superblock before draining
-        // on all the write operations.
         scoped_ptr_t<superblock_t> current_superblock(superblock->release());
-        for (size_t i = 0; i < keys.size(); ++i) {
-            // Pass out the point_replace_response_t.
-            promise_t<superblock_t *> superblock_promise;
-            coro_t::spawn(
-                boost::bind(
-                    &do_a_replace_from_batched_replace,
-                    auto_drainer_t::lock_t(&drainer),
-                    &batched_replaces_fifo_sink,
-                    batched_replaces_fifo_source.enter_write(),
-
-                    btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                    one_replace_t(replacer, i),
-
-                    &superblock_promise,
-                    sindex_cb,
-                    &stats));
-
-            current_superblock.init(superblock_promise.wait());
+        // Every pass writes at least the first key of each leaf it goes to, so
+        // there are no leftovers eventually.
+        while (!state.leftovers.empty()) {
+            state.order.swap(state.leftovers);
+            state.leftovers.clear();
+
+            // We go through the keys in order, so that all the keys that are in
+            // the same leaf get replaced one after another without going down the
+            // tree again. All the replaces of one key are done by the same
+            // coroutine, and the leftovers of a pass are the tail of what one
+            // coroutine took, so a stable sort keeps them in the order they were
+            // given in.
+            std::stable_sort(state.order.begin(), state.order.end(),
+                             key_index_less_t(&keys));
+
+            // We have to drain the pass's coroutines before starting the next one,
+            // and before destructing everything above us, because they use it.
+            auto_drainer_t drainer;
+            size_t i = 0;
+            while (i < state.order.size()) {
+                promise_t<superblock_t *> superblock_promise;
+                promise_t<size_t> end_promise;
+                coro_t::spawn(
+                    boost::bind(
+                        &do_a_leaf_of_replaces,
+                        auto_drainer_t::lock_t(&drainer),
+                        &state,
+                        current_superblock.release(),
+                        i,
+                        &superblock_promise,
+                        &end_promise));
+                i = end_promise.wait();
+                current_superblock.init(superblock_promise.wait());
+            }
         }
-    } // Make sure the drainer is destructed before the return statement.
+    } // The superblock is released before the secondary indexes get updated.
+
+    sindex_cb->on_mod_reports(state.mod_reports);
+
+    counted_t<const ql::datum_t> stats(new ql::datum_t(ql::datum_t::R_OBJECT));
+    for (size_t i = 0; i < state.responses.size(); ++i) {
+        stats = stats->merge(state.responses[i], ql::stats_merge);
+    }
     return stats;
 }
 
@@ -633,14 +742,28 @@ public:
         sorting_t _sorting,
         rget_read_response_t *_response)
         : bad_init(false),
+          saw_key(false),
           transaction(txn),
           response(_response),
           cumulative_size(0),
           ql_env(_ql_env),
           transform(_transform),
           terminal(_terminal),
-          sorting(_sorting)
+          sorting(_sorting),
+          projected(false),
+          projection_excludes(false)
     {
+        // If the first thing we do to each row is a projection, we only have to
+        // read the fields it needs.  (Sindex reads need the whole row for the
+        // sindex function.)
+        if (!transform.empty()) {
+            if (const projection_transform_t *projection
+                    = boost::get<projection_transform_t>(&transform.front())) {
+                query_language::projection_fields(*projection, &projected_fields,
+                                                  &projection_excludes);
+                projected = true;
+            }
+        }
         init(range);
     }
 
@@ -665,6 +788,7 @@ public:
         sindex_range_t _sindex_range,
         rget_read_response_t *_response)
         : bad_init(false),
+          saw_key(false),
           transaction(txn),
           response(_response),
           cumulative_size(0),
@@ -672,6 +796,8 @@ public:
           transform(_transform),
           terminal(_terminal),
           sorting(_sorting),
+          projected(false),
+          projection_excludes(false),
           primary_key_range(_primary_key_range),
           sindex_range(_sindex_range),
           sindex_multi(_sindex_multi)
@@ -711,6 +837,7 @@ public:
                      concurrent_traversal_fifo_enforcer_signal_t waiter)
         THROWS_ONLY(interrupted_exc_t) {
         store_key_t store_key(keyvalue.key());
+        saw_key = true;
         if (bad_init) {
             return false;
         }
@@ -722,8 +849,11 @@ public:
             }
         }
         try {
-            lazy_json_t first_value(static_cast<const rdb_value_t *>(keyvalue.value()),
-                                    transaction);
+            const rdb_value_t *value = static_cast<const rdb_value_t *>(keyvalue.value());
+            lazy_json_t first_value = projected
+                ? lazy_json_t(get_data(value, transaction,
+                                       projected_fields, projection_excludes))
+                : lazy_json_t(value, transaction);
             first_value.get();
 
             keyvalue.reset();
@@ -819,6 +949,7 @@ public:
 
     }
     bool bad_init;
+    bool saw_key;
     transaction_t *transaction;
     rget_read_response_t *response;
     size_t cumulative_size;
@@ -827,6 +958,12 @@ public:
     boost::optional<rdb_protocol_details::terminal_t> terminal;
     sorting_t sorting;
 
+    /* Set if the first transform is a projection, which only needs these fields
+     * (or, if `projection_excludes` is set, all the others). */
+    bool projected;
+    std::set<std::string> projected_fields;
+    bool projection_excludes;
+
     /* Only present if we're doing a sindex read.*/
     boost::optional<key_range_t> primary_key_range;
     boost::optional<sindex_range_t> sindex_range;
@@ -870,8 +1007,18 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
     boost::apply_visitor(result_finalizer_visitor_t(), response->result);
 }
 
+store_key_t sindex_key_filter_part(const btree_key_t *key) {
+    std::string secondary = ql::datum_t::extract_secondary(
+        key_to_unescaped_str(store_key_t(key)));
+    if (secondary.length() >= ql::datum_t::max_trunc_size()) {
+        secondary.erase(ql::datum_t::max_trunc_size());
+    }
+    return store_key_t(secondary);
+}
+
 void rdb_rget_secondary_slice(
     btree_slice_t *slice,
+    key_filter_t *key_filter,
     const sindex_range_t &sindex_range,
     const rdb_protocol_t::region_t &sindex_region,
     transaction_t *txn,
@@ -889,9 +1036,23 @@ void rdb_rget_secondary_slice(
         txn, ql_env, transform, terminal, sindex_region.inner, pk_range,
         sorting, sindex_func, sindex_multi, sindex_range, response);
 
-    btree_concurrent_traversal(
-        slice, txn, superblock, sindex_region.inner, &callback,
-        (forward(sorting) ? FORWARD : BACKWARD));
+    // The filter only helps when the range is a single value, which is what
+    // get_all asks for.
+    if (key_filter != NULL
+        && !key_filter->may_contain(sindex_range.start->truncated_secondary())) {
+        superblock->release();
+    } else {
+        btree_concurrent_traversal(
+            slice, txn, superblock, sindex_region.inner, &callback,
+            (forward(sorting) ? FORWARD : BACKWARD));
+        if (!callback.saw_key) {
+            if (key_filter != NULL) {
+                key_filter->on_false_positive();
+            } else if (sindex_range.is_single_value()) {
+                ++slice->key_lookup_misses;
+            }
+        }
+    }
 
     if (callback.cumulative_size >= rget_max_chunk_size) {
         response->truncated = true;
@@ -986,8 +1147,8 @@ rdb_modification_report_cb_t::~rdb_modification_report_cb_t() {
     }
 }
 
-void rdb_modification_report_cb_t::on_mod_report(
-        const rdb_modification_report_t &mod_report) {
+void rdb_modification_report_cb_t::on_mod_reports(
+        const std::vector<rdb_modification_report_t> &mod_reports) {
     if (!sindex_block_.has()) {
         // Don't allow interruption here, or we may end up with inconsistent data
         cond_t dummy_interruptor;
@@ -1002,11 +1163,13 @@ void rdb_modification_report_cb_t::on_mod_report(
     mutex_t::acq_t acq;
     store_->lock_sindex_queue(sindex_block_.get(), &acq);
 
-    write_message_t wm;
-    wm << rdb_sindex_change_t(mod_report);
-    store_->sindex_queue_push(wm, &acq);
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        write_message_t wm;
+        wm << rdb_sindex_change_t(*it);
+        store_->sindex_queue_push(wm, &acq);
+    }
 
-    rdb_update_sindexes(sindexes_, &mod_report, txn_);
+    rdb_update_sindexes(sindexes_, mod_reports, txn_);
 }
 
 typedef btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindex_access_vector_t;
@@ -1028,18 +1191,25 @@ void compute_keys(const store_key_t &primary_key, counted_t<const ql::datum_t> d
     }
 }
 
+/* A write to a secondary index that rdb_update_single_sindex has to make.
+ * Deletions have no value. */
+struct sindex_change_t {
+    sindex_change_t(const store_key_t &_key, const std::vector<char> *_value_ref)
+        : key(_key), value_ref(_value_ref) { }
+    store_key_t key;
+    const std::vector<char> *value_ref;
+};
+
+bool sindex_change_less(const sindex_change_t &a, const sindex_change_t &b) {
+    return a.key < b.key;
+}
+
 /* Used below by rdb_update_sindexes. */
 void rdb_update_single_sindex(
         const btree_store_t<rdb_protocol_t>::sindex_access_t *sindex,
-        const rdb_modification_report_t *modification,
+        const std::vector<rdb_modification_report_t> *modifications,
         transaction_t *txn,
         auto_drainer_t::lock_t) {
-    // Note if you get this error it's likely that you've passed in a default
-    // constructed mod_report. Don't do that.  Mod reports should always be passed
-    // to a function as an output parameter before they're passed to this
-    // function.
-    guarantee(modification->primary_key.size() != 0);
-
     ql::map_wire_func_t mapping;
     sindex_multi_bool_t multi = MULTI;
     vector_read_stream_t read_stream(&sindex->sindex.opaque_definition);
@@ -1056,77 +1226,84 @@ void rdb_update_single_sindex(
     cond_t non_interruptor;
     ql::env_t env(&non_interruptor);
 
-    superblock_t *super_block = sindex->super_block.get();
-
-    if (modification->info.deleted.first) {
-        guarantee(!modification->info.deleted.second.empty());
-        try {
-            counted_t<const ql::datum_t> deleted = modification->info.deleted.first;
-
-            std::vector<store_key_t> keys;
-
-            compute_keys(modification->primary_key, deleted, &mapping, multi, &env, &keys);
-
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
-
-                    find_keyvalue_location_for_write(txn, super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->root_eviction_priority,
-                                                     &sindex->btree->stats,
-                                                     &return_superblock_local);
+    std::vector<sindex_change_t> changes;
+    for (auto mod = modifications->begin(); mod != modifications->end(); ++mod) {
+        // Note if you get this error it's likely that you've passed in a default
+        // constructed mod_report. Don't do that.  Mod reports should always be passed
+        // to a function as an output parameter before they're passed to this
+        // function.
+        guarantee(mod->primary_key.size() != 0);
+
+        if (mod->info.deleted.first) {
+            guarantee(!mod->info.deleted.second.empty());
+            try {
+                std::vector<store_key_t> keys;
+                compute_keys(mod->primary_key, mod->info.deleted.first,
+                             &mapping, multi, &env, &keys);
+                for (auto it = keys.begin(); it != keys.end(); ++it) {
+                    changes.push_back(sindex_change_t(*it, NULL));
+                }
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (it wasn't actually in the index).
+            }
+        }
 
-                    if (kv_location.value.has()) {
-                        kv_location_delete(&kv_location, *it,
-                            sindex->btree, repli_timestamp_t::distant_past, txn, NULL);
-                    }
-                    // The keyvalue location gets destroyed here.
+        if (mod->info.added.first) {
+            try {
+                std::vector<store_key_t> keys;
+                compute_keys(mod->primary_key, mod->info.added.first,
+                             &mapping, multi, &env, &keys);
+                for (auto it = keys.begin(); it != keys.end(); ++it) {
+                    changes.push_back(sindex_change_t(*it, &mod->info.added.second));
                 }
-                super_block = return_superblock_local.wait();
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (we just drop the row from the index).
             }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (it wasn't actually in the index).
         }
     }
 
-    if (modification->info.added.first) {
-        try {
-            counted_t<const ql::datum_t> added = modification->info.added.first;
-
-            std::vector<store_key_t> keys;
-
-            compute_keys(modification->primary_key, added, &mapping, multi, &env, &keys);
-
-            for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t<rdb_value_t> kv_location;
-
-                    find_keyvalue_location_for_write(txn, super_block,
-                                                     it->btree_key(),
-                                                     &kv_location,
-                                                     &sindex->btree->root_eviction_priority,
-                                                     &sindex->btree->stats,
-                                                     &return_superblock_local);
+    // Sorted, all the changes to one leaf of the index can be made with a single
+    // descent. The sort is stable, so that a row that was written more than once
+    // has its index entries changed in the order it was written in.
+    std::stable_sort(changes.begin(), changes.end(), &sindex_change_less);
 
-                    kv_location_set(&kv_location, *it,
-                                    modification->info.added.second, sindex->btree,
+    superblock_t *super_block = sindex->super_block.get();
+    size_t i = 0;
+    while (i < changes.size()) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t<rdb_value_t> kv_location;
+
+            find_keyvalue_location_for_write(txn, super_block,
+                                             changes[i].key.btree_key(),
+                                             &kv_location,
+                                             &sindex->btree->root_eviction_priority,
+                                             &sindex->btree->stats,
+                                             &return_superblock_local);
+            do {
+                const sindex_change_t &change = changes[i];
+                if (change.value_ref == NULL) {
+                    if (kv_location.value.has()) {
+                        kv_location_delete(&kv_location, change.key,
+                            sindex->btree, repli_timestamp_t::distant_past, txn, NULL);
+                    }
+                } else {
+                    kv_location_set(&kv_location, change.key,
+                                    *change.value_ref, sindex->btree,
                                     repli_timestamp_t::distant_past, txn);
-                    // The keyvalue location gets destroyed here.
                 }
-                super_block = return_superblock_local.wait();
-            }
-        } catch (const ql::base_exc_t &) {
-            // Do nothing (we just drop the row from the index).
+                ++i;
+            } while (i < changes.size()
+                     && find_keyvalue_location_in_same_leaf(
+                         txn, changes[i].key.btree_key(), &kv_location));
+            // The keyvalue location gets destroyed here.
         }
+        super_block = return_superblock_local.wait();
     }
 }
 
 void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
-        const rdb_modification_report_t *modification,
+        const std::vector<rdb_modification_report_t> &modifications,
         transaction_t *txn) {
     {
         auto_drainer_t drainer;
@@ -1136,22 +1313,30 @@ void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
                                                     ++it) {
             coro_t::spawn_sometime(boost::bind(
                         &rdb_update_single_sindex, &*it,
-                        modification, txn, auto_drainer_t::lock_t(&drainer)));
+                        &modifications, txn, auto_drainer_t::lock_t(&drainer)));
         }
     }
 
     /* All of the sindex have been updated now it's time to actually clear the
-     * deleted blob if it exists. */
-    std::vector<char> ref_cpy(modification->info.deleted.second);
-    if (modification->info.deleted.first) {
-        ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
-        guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
-
-        rdb_value_deleter_t deleter;
-        deleter.delete_value(txn, ref_cpy.data());
+     * deleted blobs if they exist. */
+    for (auto mod = modifications.begin(); mod != modifications.end(); ++mod) {
+        if (mod->info.deleted.first) {
+            std::vector<char> ref_cpy(mod->info.deleted.second);
+            ref_cpy.insert(ref_cpy.end(), blob::btree_maxreflen - ref_cpy.size(), 0);
+            guarantee(ref_cpy.size() == static_cast<size_t>(blob::btree_maxreflen));
+
+            rdb_value_deleter_t deleter;
+            deleter.delete_value(txn, ref_cpy.data());
+        }
     }
 }
 
+void rdb_update_sindexes(const sindex_access_vector_t &sindexes,
+        const rdb_modification_report_t *modification,
+        transaction_t *txn) {
+    rdb_update_sindexes(sindexes, std::vector<rdb_modification_report_t>(1, *modification), txn);
+}
+
 void rdb_erase_range_sindexes(const sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
         transaction_t *txn, signal_t *interruptor) {
@@ -1178,6 +1363,66 @@ public:
     void process_a_leaf(transaction_t *txn, buf_lock_t *leaf_node_buf,
                         const btree_key_t *, const btree_key_t *,
                         signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
+        const leaf_node_t *leaf_node = static_cast<const leaf_node_t *>(leaf_node_buf->get_data_read());
+
+        std::vector<rdb_modification_report_t> mod_reports;
+        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+            /* Grab relevant values from the leaf node. */
+            const btree_key_t *key = (*it).first;
+            const void *value = (*it).second;
+            guarantee(key);
+
+            store_key_t pk(key);
+            mod_reports.push_back(rdb_modification_report_t(pk));
+            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
+            block_size_t block_size = txn->get_cache()->get_block_size();
+            mod_reports.back().info.added = std::make_pair(get_data(rdb_value, txn),
+                    std::vector<char>(rdb_value->value_ref(),
+                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
+        }
+
+        /* A leaf's rows go to as many different leaves of each index as there
+         * are rows, so they're put in a batch with the rows of other leaves. The
+         * batch gets written once it's big enough that its index entries share
+         * leaves. */
+        std::vector<rdb_modification_report_t> batch;
+        {
+            ASSERT_NO_CORO_WAITING;
+            pending_mod_reports_.insert(pending_mod_reports_.end(),
+                                        mod_reports.begin(), mod_reports.end());
+            if (pending_mod_reports_.size() >= SINDEX_POST_CONSTRUCTION_BATCH_SIZE) {
+                batch.swap(pending_mod_reports_);
+            }
+        }
+
+        if (!batch.empty()) {
+            write_batch(batch);
+        }
+    }
+
+    /* Writes the rows that are left over once the traversal is done. */
+    void finish() THROWS_NOTHING {
+        std::vector<rdb_modification_report_t> batch;
+        batch.swap(pending_mod_reports_);
+        if (!batch.empty()) {
+            write_batch(batch);
+        }
+    }
+
+    void postprocess_internal_node(buf_lock_t *) { }
+
+    void filter_interesting_children(UNUSED transaction_t *txn, ranged_block_ids_t *ids_source, interesting_children_callback_t *cb) {
+        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
+            cb->receive_interesting_child(i);
+        }
+        cb->no_more_interesting_children();
+    }
+
+    access_t btree_superblock_mode() { return rwi_read; }
+    access_t btree_node_mode() { return rwi_read; }
+
+private:
+    void write_batch(const std::vector<rdb_modification_report_t> &batch) THROWS_NOTHING {
         write_token_pair_t token_pair;
         store_->new_write_token_pair(&token_pair);
 
@@ -1227,42 +1472,14 @@ public:
             return;
         }
 
-        const leaf_node_t *leaf_node = static_cast<const leaf_node_t *>(leaf_node_buf->get_data_read());
-
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
-
-            store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            block_size_t block_size = txn->get_cache()->get_block_size();
-            mod_report.info.added = std::make_pair(get_data(rdb_value, txn),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(sindexes, &mod_report, wtxn.get());
-        }
-    }
-
-    void postprocess_internal_node(buf_lock_t *) { }
-
-    void filter_interesting_children(UNUSED transaction_t *txn, ranged_block_ids_t *ids_source, interesting_children_callback_t *cb) {
-        for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
-            cb->receive_interesting_child(i);
-        }
-        cb->no_more_interesting_children();
+        rdb_update_sindexes(sindexes, batch, wtxn.get());
     }
 
-    access_t btree_superblock_mode() { return rwi_read; }
-    access_t btree_node_mode() { return rwi_read; }
-
     btree_store_t<rdb_protocol_t> *store_;
     const std::set<uuid_u> &sindexes_to_post_construct_;
     cond_t *interrupt_myself_;
     signal_t *interruptor_;
+    std::vector<rdb_modification_report_t> pending_mod_reports_;
 };
 
 void post_construct_secondary_indexes(
@@ -1293,4 +1510,5 @@ void post_construct_secondary_indexes(
 
     btree_parallel_traversal(txn.get(), superblock.get(),
             store->btree.get(), &helper, &wait_any);
+    helper.finish();
 }
@@ -23,6 +23,7 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
 
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
@@ -80,12 +81,24 @@ struct rdb_modification_info_t;
 struct rdb_modification_report_t;
 class rdb_modification_report_cb_t;
 
+/* The key_filter arguments may be NULL; if they aren't, lookups of keys that the
+filter says aren't there don't go down the tree. */
 void rdb_get(const store_key_t &key,
              btree_slice_t *slice,
+             key_filter_t *key_filter,
              transaction_t *txn,
              superblock_t *superblock,
              point_read_response_t *response);
 
+/* Reads all of the keys, which have to be sorted, in one traversal of the
+tree. Keys that have no row are left out of the response. */
+void rdb_get_multiple(const std::vector<store_key_t> &keys,
+                      btree_slice_t *slice,
+                      key_filter_t *key_filter,
+                      transaction_t *txn,
+                      superblock_t *superblock,
+                      batched_point_read_response_t *response);
+
 enum return_vals_t {
     NO_RETURN_VALS = 0,
     RETURN_VALS = 1
@@ -108,20 +121,6 @@ struct btree_info_t {
     const std::string *primary_key;
 };
 
-struct btree_loc_info_t {
-    btree_loc_info_t(const btree_info_t *_btree,
-                     superblock_t *_superblock,
-                     const store_key_t *_key)
-        : btree(_btree), superblock(_superblock), key(_key) {
-        guarantee(btree != NULL);
-        guarantee(superblock != NULL);
-        guarantee(key != NULL);
-    }
-    const btree_info_t *const btree;
-    superblock_t *const superblock;
-    const store_key_t *const key;
-};
-
 struct btree_batched_replacer_t {
     virtual ~btree_batched_replacer_t() { }
     virtual counted_t<const ql::datum_t> replace(
@@ -135,6 +134,8 @@ struct btree_point_replacer_t {
     virtual bool should_return_vals() const = 0;
 };
 
+/* The keys that are in the same leaf are replaced with a single descent of the
+ * tree, and the keys of different leaves are replaced concurrently. */
 batched_replace_response_t rdb_batched_replace(
     const btree_info_t &info,
     scoped_ptr_t<superblock_t> *superblock,
@@ -205,8 +206,14 @@ void rdb_rget_slice(btree_slice_t *slice, const key_range_t &range,
                     sorting_t sorting,
                     rget_read_response_t *response);
 
+/* What the key filter of a sindex holds for its keys: the secondary part of the key,
+truncated the way datum_t::truncated_secondary truncates it. */
+store_key_t sindex_key_filter_part(const btree_key_t *key);
+
+/* key_filter may only be given if sindex_range is a single value. */
 void rdb_rget_secondary_slice(
     btree_slice_t *slice,
+    key_filter_t *key_filter,
     const sindex_range_t &sindex_range,
     const rdb_protocol_t::region_t &sindex_region,
     transaction_t *txn,
@@ -267,7 +274,7 @@ public:
             btree_store_t<rdb_protocol_t> *store, write_token_pair_t *token_pair,
             transaction_t *txn, block_id_t sindex_block, auto_drainer_t::lock_t lock);
 
-    void on_mod_report(const rdb_modification_report_t &mod_report);
+    void on_mod_reports(const std::vector<rdb_modification_report_t> &mod_reports);
 
     ~rdb_modification_report_cb_t();
 private:
@@ -279,7 +286,7 @@ private:
     block_id_t sindex_block_id_;
     auto_drainer_t::lock_t lock_;
 
-    /* Fields initialized by calls to on_mod_report */
+    /* Fields initialized by calls to on_mod_reports */
     scoped_ptr_t<buf_lock_t> sindex_block_;
     btree_store_t<rdb_protocol_t>::sindex_access_vector_t sindexes_;
 };
@@ -289,6 +296,13 @@ void rdb_update_sindexes(
         const rdb_modification_report_t *modification,
         transaction_t *txn);
 
+/* Applies a batch of modifications at once, going down each secondary index once
+ * for every leaf of it that they change rather than once for every key. */
+void rdb_update_sindexes(
+        const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &modifications,
+        transaction_t *txn);
+
 void rdb_erase_range_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
         const rdb_erase_range_report_t *erase_range,
@@ -304,7 +318,8 @@ void post_construct_secondary_indexes(
 class rdb_value_deleter_t : public value_deleter_t {
 friend void rdb_update_sindexes(
         const btree_store_t<rdb_protocol_t>::sindex_access_vector_t &sindexes,
-        const rdb_modification_report_t *modification, transaction_t *txn);
+        const std::vector<rdb_modification_report_t> &modifications,
+        transaction_t *txn);
 
     void delete_value(transaction_t *_txn, void *_value);
 };
@@ -7,11 +7,14 @@
 #include <stdlib.h>
 
 #include <algorithm>
+#include <limits>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
 #include "containers/archive/string_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "containers/scoped.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/pseudo_time.hpp"
@@ -27,11 +30,254 @@ const std::set<std::string> datum_t::_allowed_pts = std::set<std::string>();
 
 const char* const datum_t::reql_type_string = "$reql_type$";
 
-datum_t::datum_t(type_t _type, bool _bool) : type(_type), r_bool(_bool) {
+enum class datum_serialized_type_t {
+    R_ARRAY = 1,
+    R_BOOL = 2,
+    R_NULL = 3,
+    DOUBLE = 4,
+    R_OBJECT = 5,
+    R_STR = 6,
+    INT_NEGATIVE = 7,
+    INT_POSITIVE = 8,
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
+                                      datum_serialized_type_t::R_ARRAY,
+                                      datum_serialized_type_t::INT_POSITIVE);
+
+static archive_result_t skip_bytes(read_stream_t *s, uint64_t n) {
+    char buf[1024];
+    while (n > 0) {
+        const int64_t chunk = std::min<uint64_t>(n, sizeof(buf));
+        int64_t num_read = force_read(s, buf, chunk);
+        if (num_read == -1) {
+            return ARCHIVE_SOCK_ERROR;
+        }
+        if (num_read < chunk) {
+            return ARCHIVE_SOCK_EOF;
+        }
+        n -= chunk;
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+// Reads past a serialized datum.  This must be kept in sync with
+// operator<<(write_message_t &, const counted_t<const datum_t> &).
+static archive_result_t skip_datum(read_stream_t *s) {
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+
+    switch (type) {
+    case datum_serialized_type_t::R_ARRAY: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        for (uint64_t i = 0; !res && i < sz; ++i) {
+            res = skip_datum(s);
+        }
+        return res;
+    }
+    case datum_serialized_type_t::R_BOOL: {
+        bool value;
+        return deserialize(s, &value);
+    }
+    case datum_serialized_type_t::R_NULL:
+        return ARCHIVE_SUCCESS;
+    case datum_serialized_type_t::DOUBLE: {
+        double value;
+        return deserialize(s, &value);
+    }
+    case datum_serialized_type_t::INT_NEGATIVE:  // fall through
+    case datum_serialized_type_t::INT_POSITIVE: {
+        uint64_t value;
+        return deserialize_varint_uint64(s, &value);
+    }
+    case datum_serialized_type_t::R_OBJECT: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        for (uint64_t i = 0; !res && i < sz; ++i) {
+            uint64_t key_size;
+            res = deserialize_varint_uint64(s, &key_size);
+            if (!res) {
+                res = skip_bytes(s, key_size);
+            }
+            if (!res) {
+                res = skip_datum(s);
+            }
+        }
+        return res;
+    }
+    case datum_serialized_type_t::R_STR: {
+        uint64_t sz;
+        res = deserialize_varint_uint64(s, &sz);
+        return res ? res : skip_bytes(s, sz);
+    }
+    default:
+        return ARCHIVE_RANGE_ERROR;
+    }
+}
+
+/* An object that's read straight from its serialization.  A serialized object's
+ * fields are in key order, so looking one up is a binary search over the offsets
+ * of the keys, and only that field's value is deserialized, the first time it's
+ * looked up. */
+class datum_t::serialized_object_t {
+public:
+    explicit serialized_object_t(std::vector<char> &&_buf)
+        : buf(std::move(_buf)), materialized(NULL), shared(false) { }
+    ~serialized_object_t() {
+        delete materialized;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] != NULL) {
+                counted_release(values[i]);
+            }
+        }
+    }
+
+    // Finds the fields.  Returns false if `buf` isn't the serialization of an
+    // object.
+    MUST_USE bool init() {
+        if (buf.size() > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+        vector_read_stream_t s(&buf);
+        datum_serialized_type_t type;
+        uint64_t sz;
+        if (deserialize(&s, &type) || type != datum_serialized_type_t::R_OBJECT
+            || deserialize_varint_uint64(&s, &sz) || sz > buf.size()) {
+            return false;
+        }
+        fields.reserve(sz);
+        for (uint64_t i = 0; i < sz; ++i) {
+            field_t field;
+            uint64_t key_size;
+            if (deserialize_varint_uint64(&s, &key_size)
+                || key_size > buf.size() - s.tell()) {
+                return false;
+            }
+            field.key_offset = s.tell();
+            field.key_size = key_size;
+            if (skip_bytes(&s, key_size)) {
+                return false;
+            }
+            field.value_offset = s.tell();
+            if (skip_datum(&s)) {
+                return false;
+            }
+            fields.push_back(field);
+        }
+        values.init(fields.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = NULL;
+        }
+        return static_cast<uint64_t>(s.tell()) == buf.size();
+    }
+
+    counted_t<const datum_t> get(const std::string &key) const {
+        auto it = std::lower_bound(fields.begin(), fields.end(), key,
+                                   [this](const field_t &f, const std::string &k) {
+                                       return key_cmp(f, k) < 0;
+                                   });
+        if (it == fields.end() || key_cmp(*it, key) != 0) {
+            return counted_t<const datum_t>();
+        }
+        return value(it - fields.begin());
+    }
+
+    const std::map<std::string, counted_t<const datum_t> > &as_object() const {
+        // Another thread might get here at the same time.  Whoever's second throws
+        // their map away.
+        if (materialized == NULL) {
+            std::map<std::string, counted_t<const datum_t> > *obj
+                = new std::map<std::string, counted_t<const datum_t> >();
+            for (size_t i = 0; i < fields.size(); ++i) {
+                obj->insert(obj->end(),
+                            std::make_pair(std::string(buf.data() + fields[i].key_offset,
+                                                       fields[i].key_size),
+                                           value(i)));
+            }
+            if (!__sync_bool_compare_and_swap(&materialized, NULL, obj)) {
+                delete obj;
+            }
+        }
+        return *materialized;
+    }
+
+    // The map built by `as_object` holds the same datums as `values`, so sharing
+    // those covers it too.
+    void share_across_threads() const {
+        shared = true;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i] != NULL) {
+                values[i]->share_across_threads();
+            }
+        }
+    }
+
+    // The whole serialization, including the type.
+    const std::vector<char> &serialization() const { return buf; }
+
+private:
+    struct field_t {
+        uint32_t key_offset;
+        uint32_t key_size;
+        uint32_t value_offset;
+    };
+
+    // Compares like `std::string::compare`.
+    int key_cmp(const field_t &f, const std::string &key) const {
+        int res = memcmp(buf.data() + f.key_offset, key.data(),
+                         std::min<size_t>(f.key_size, key.size()));
+        if (res != 0) {
+            return res;
+        }
+        return f.key_size < key.size() ? -1 : (f.key_size > key.size() ? 1 : 0);
+    }
+
+    // Returns the value of the `i`th field, deserializing it if nobody has yet.
+    counted_t<const datum_t> value(size_t i) const {
+        const datum_t *cached = values[i];
+        if (cached != NULL) {
+            return counted_t<const datum_t>(cached);
+        }
+
+        vector_read_stream_t s(&buf, fields[i].value_offset);
+        counted_t<const datum_t> res;
+        archive_result_t ar = deserialize(&s, &res);
+        guarantee_err(ar == ARCHIVE_SUCCESS, "disk corruption (or programmer error) detected");
+        if (shared) {
+            res->share_across_threads();
+        }
+
+        // Like in `as_object`, whoever's second uses the value that got there first.
+        counted_add_ref(res.get());
+        if (!__sync_bool_compare_and_swap(&values[i], NULL, res.get())) {
+            counted_release(res.get());
+            return counted_t<const datum_t>(values[i]);
+        }
+        return res;
+    }
+
+    const std::vector<char> buf;
+    std::vector<field_t> fields;
+    // The values of `fields` that have been deserialized, or NULL; each one holds a
+    // reference.
+    mutable scoped_array_t<const datum_t *> values;
+    // Built by `as_object`, the first time it's called.
+    mutable std::map<std::string, counted_t<const datum_t> > *materialized;
+    mutable bool shared;
+
+    DISABLE_COPYING(serialized_object_t);
+};
+
+datum_t::datum_t(type_t _type, bool _bool)
+    : type(_type), serialized(false), r_bool(_bool) {
     r_sanity_check(_type == R_BOOL);
 }
 
-datum_t::datum_t(double _num) : type(R_NUM), r_num(_num) {
+datum_t::datum_t(double _num) : type(R_NUM), serialized(false), r_num(_num) {
     // so we can use `isfinite` in a GCC 4.4.3-compatible way
     using namespace std;  // NOLINT(build/namespaces)
     rcheck(isfinite(r_num), base_exc_t::GENERIC,
@@ -39,23 +285,24 @@ datum_t::datum_t(double _num) : type(R_NUM), r_num(_num) {
 }
 
 datum_t::datum_t(std::string &&_str)
-    : type(R_STR), r_str(new std::string(std::move(_str))) {
+    : type(R_STR), serialized(false), r_str(new std::string(std::move(_str))) {
     check_str_validity(*r_str);
 }
 
 datum_t::datum_t(const char *cstr)
-    : type(R_STR), r_str(new std::string(cstr)) { }
+    : type(R_STR), serialized(false), r_str(new std::string(cstr)) { }
 
 datum_t::datum_t(std::vector<counted_t<const datum_t> > &&_array)
-    : type(R_ARRAY), r_array(new std::vector<counted_t<const datum_t> >(std::move(_array))) { }
+    : type(R_ARRAY), serialized(false),
+      r_array(new std::vector<counted_t<const datum_t> >(std::move(_array))) { }
 
 datum_t::datum_t(std::map<std::string, counted_t<const datum_t> > &&_object)
-    : type(R_OBJECT),
+    : type(R_OBJECT), serialized(false),
       r_object(new std::map<std::string, counted_t<const datum_t> >(std::move(_object))) {
     maybe_sanitize_ptype();
 }
 
-datum_t::datum_t(datum_t::type_t _type) : type(_type) {
+datum_t::datum_t(datum_t::type_t _type) : type(_type), serialized(false) {
     r_sanity_check(type == R_ARRAY || type == R_OBJECT || type == R_NULL);
     switch (type) {
     case R_NULL: {
@@ -89,8 +336,13 @@ datum_t::~datum_t() {
         delete r_array;
     } break;
     case R_OBJECT: {
-        r_sanity_check(r_object != NULL);
-        delete r_object;
+        if (serialized) {
+            r_sanity_check(r_serialized != NULL);
+            delete r_serialized;
+        } else {
+            r_sanity_check(r_object != NULL);
+            delete r_object;
+        }
     } break;
     case UNINITIALIZED: break;
     default: unreachable();
@@ -168,17 +420,18 @@ void datum_t::check_str_validity(const std::string &str) {
                      str.c_str(), null_offset));
 }
 
-datum_t::datum_t(cJSON *json) {
+datum_t::datum_t(cJSON *json) : serialized(false) {
     init_json(json);
 }
-datum_t::datum_t(const scoped_cJSON_t &json) {
+datum_t::datum_t(const scoped_cJSON_t &json) : serialized(false) {
     init_json(json.get());
 }
 
 datum_t::type_t datum_t::get_type() const { return type; }
 
 bool datum_t::is_ptype() const {
-    return type == R_OBJECT && std_contains(*r_object, reql_type_string);
+    // (`from_serialized` never leaves a pseudotype serialized.)
+    return type == R_OBJECT && !serialized && std_contains(*r_object, reql_type_string);
 }
 
 bool datum_t::is_ptype(const std::string &reql_type) const {
@@ -187,8 +440,8 @@ bool datum_t::is_ptype(const std::string &reql_type) const {
 
 std::string datum_t::get_reql_type() const {
     r_sanity_check(get_type() == R_OBJECT);
-    auto maybe_reql_type = r_object->find(reql_type_string);
-    r_sanity_check(maybe_reql_type != r_object->end());
+    auto maybe_reql_type = as_object().find(reql_type_string);
+    r_sanity_check(maybe_reql_type != as_object().end());
     rcheck(maybe_reql_type->second->get_type() == R_STR,
            base_exc_t::GENERIC,
            strprintf("Error: Field `%s` must be a string (got `%s` of type %s):\n%s",
@@ -689,9 +942,13 @@ counted_t<const datum_t> datum_t::get(size_t index, throw_bool_t throw_bool) con
 
 counted_t<const datum_t> datum_t::get(const std::string &key,
                                       throw_bool_t throw_bool) const {
-    std::map<std::string, counted_t<const datum_t> >::const_iterator it
-        = as_object().find(key);
-    if (it != as_object().end()) return it->second;
+    if (type == R_OBJECT && serialized) {
+        if (counted_t<const datum_t> val = r_serialized->get(key)) return val;
+    } else {
+        std::map<std::string, counted_t<const datum_t> >::const_iterator it
+            = as_object().find(key);
+        if (it != as_object().end()) return it->second;
+    }
     if (throw_bool == THROW) {
         rfail(base_exc_t::NON_EXISTENCE,
               "No attribute `%s` in object:\n%s", key.c_str(), print().c_str());
@@ -699,9 +956,39 @@ counted_t<const datum_t> datum_t::get(const std::string &key,
     return counted_t<const datum_t>();
 }
 
+void datum_t::share_across_threads() const {
+    if (is_atomic()) {
+        // Whatever's in it was shared at the same time.
+        return;
+    }
+    promote_to_atomic();
+    switch (type) {
+    case R_ARRAY: {
+        for (auto it = r_array->begin(); it != r_array->end(); ++it) {
+            (*it)->share_across_threads();
+        }
+    } break;
+    case R_OBJECT: {
+        if (serialized) {
+            r_serialized->share_across_threads();
+        } else {
+            for (auto it = r_object->begin(); it != r_object->end(); ++it) {
+                it->second->share_across_threads();
+            }
+        }
+    } break;
+    case R_NULL: // fallthru
+    case R_BOOL: // fallthru
+    case R_NUM: // fallthru
+    case R_STR: break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 const std::map<std::string, counted_t<const datum_t> > &datum_t::as_object() const {
     check_type(R_OBJECT);
-    return *r_object;
+    return serialized ? r_serialized->as_object() : *r_object;
 }
 
 cJSON *datum_t::as_json_raw() const {
@@ -720,7 +1007,7 @@ cJSON *datum_t::as_json_raw() const {
     case R_OBJECT: {
         scoped_cJSON_t obj(cJSON_CreateObject());
         for (std::map<std::string, counted_t<const datum_t> >::const_iterator
-                 it = r_object->begin(); it != r_object->end(); ++it) {
+                 it = as_object().begin(); it != as_object().end(); ++it) {
             obj.AddItemToObject(it->first.c_str(), it->second->as_json_raw());
         }
         return obj.release();
@@ -764,6 +1051,7 @@ void datum_t::add(counted_t<const datum_t> val) {
 MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
                            clobber_bool_t clobber_bool) {
     check_type(R_OBJECT);
+    r_sanity_check(!serialized);
     check_str_validity(key);
     r_sanity_check(val.has());
     bool key_in_obj = r_object->count(key) > 0;
@@ -772,6 +1060,7 @@ MUST_USE bool datum_t::add(const std::string &key, counted_t<const datum_t> val,
 }
 
 MUST_USE bool datum_t::delete_field(const std::string &key) {
+    r_sanity_check(!serialized);
     return r_object->erase(key);
 }
 
@@ -900,9 +1189,9 @@ void datum_t::runtime_fail(base_exc_t::type_t exc_type,
     ql::runtime_fail(exc_type, test, file, line, msg);
 }
 
-datum_t::datum_t() : type(UNINITIALIZED) { }
+datum_t::datum_t() : type(UNINITIALIZED), serialized(false) { }
 
-datum_t::datum_t(const Datum *d) : type(UNINITIALIZED) {
+datum_t::datum_t(const Datum *d) : type(UNINITIALIZED), serialized(false) {
     init_from_pb(d);
 }
 
@@ -1004,7 +1293,7 @@ void datum_t::write_to_protobuf(Datum *d) const {
         d->set_type(Datum::R_OBJECT);
         // We use rbegin and rend so that things print the way we expect.
         for (std::map<std::string, counted_t<const datum_t> >::const_reverse_iterator
-                 it = r_object->rbegin(); it != r_object->rend(); ++it) {
+                 it = as_object().rbegin(); it != as_object().rend(); ++it) {
             Datum_AssocPair *ap = d->add_r_object();
             ap->set_key(it->first);
             it->second->write_to_protobuf(ap->mutable_val());
@@ -1015,21 +1304,6 @@ void datum_t::write_to_protobuf(Datum *d) const {
     }
 }
 
-enum class datum_serialized_type_t {
-    R_ARRAY = 1,
-    R_BOOL = 2,
-    R_NULL = 3,
-    DOUBLE = 4,
-    R_OBJECT = 5,
-    R_STR = 6,
-    INT_NEGATIVE = 7,
-    INT_POSITIVE = 8,
-};
-
-ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(datum_serialized_type_t, int8_t,
-                                      datum_serialized_type_t::R_ARRAY,
-                                      datum_serialized_type_t::INT_POSITIVE);
-
 // This must be kept in sync with operator<<(write_message_t &, const counted_t<const
 // datum_T> &).
 size_t serialized_size(const counted_t<const datum_t> &datum) {
@@ -1053,6 +1327,10 @@ size_t serialized_size(const counted_t<const datum_t> &datum) {
         }
     } break;
     case datum_t::R_OBJECT: {
+        if (datum->serialized) {
+            // That includes the type.
+            return datum->r_serialized->serialization().size();
+        }
         sz += serialized_size(datum->as_object());
     } break;
     case datum_t::R_STR: {
@@ -1102,6 +1380,11 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
         }
     } break;
     case datum_t::R_OBJECT: {
+        if (datum->serialized) {
+            const std::vector<char> &buf = datum->r_serialized->serialization();
+            wm.append(buf.data(), buf.size());
+            break;
+        }
         wm << datum_serialized_type_t::R_OBJECT;
         const std::map<std::string, counted_t<const datum_t> > &value = datum->as_object();
         wm << value;
@@ -1118,13 +1401,11 @@ write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t>
     return wm;
 }
 
-archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
-    datum_serialized_type_t type;
-    archive_result_t res = deserialize(s, &type);
-    if (res) {
-        return res;
-    }
-
+// Deserializes the rest of a datum whose type has been read already.
+static archive_result_t deserialize_untyped(read_stream_t *s,
+                                            datum_serialized_type_t type,
+                                            counted_t<const datum_t> *datum) {
+    archive_result_t res;
     switch (type) {
     case datum_serialized_type_t::R_ARRAY: {
         std::vector<counted_t<const datum_t> > value;
@@ -1220,6 +1501,80 @@ archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum)
     return ARCHIVE_SUCCESS;
 }
 
+archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum) {
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    return deserialize_untyped(s, type, datum);
+}
+
+datum_t::datum_t(serialized_object_t *object)
+    : type(R_OBJECT), serialized(true), r_serialized(object) { }
+
+counted_t<const datum_t> datum_t::from_serialized(std::vector<char> &&buf) {
+    scoped_ptr_t<serialized_object_t> object(new serialized_object_t(std::move(buf)));
+    // Pseudotypes are sanitized when they're built, so we build them.
+    if (object->init() && !object->get(reql_type_string).has()) {
+        return counted_t<const datum_t>(new datum_t(object.release()));
+    }
+
+    vector_read_stream_t s(&object->serialization());
+    counted_t<const datum_t> res;
+    if (deserialize(&s, &res) != ARCHIVE_SUCCESS) {
+        return counted_t<const datum_t>();
+    }
+    return res;
+}
+
+archive_result_t deserialize_fields(read_stream_t *s,
+                                    const std::set<std::string> &fields, bool exclude,
+                                    counted_t<const datum_t> *datum) {
+    datum_serialized_type_t type;
+    archive_result_t res = deserialize(s, &type);
+    if (res) {
+        return res;
+    }
+    if (type != datum_serialized_type_t::R_OBJECT) {
+        // Only objects have fields to skip.
+        return deserialize_untyped(s, type, datum);
+    }
+
+    uint64_t sz;
+    res = deserialize_varint_uint64(s, &sz);
+    if (res) {
+        return res;
+    }
+
+    std::map<std::string, counted_t<const datum_t> > value;
+    auto position = value.begin();
+    for (uint64_t i = 0; i < sz; ++i) {
+        std::string key;
+        res = deserialize(s, &key);
+        if (res) {
+            return res;
+        }
+        if ((fields.count(key) != 0) == exclude) {
+            res = skip_datum(s);
+        } else {
+            counted_t<const datum_t> field;
+            res = deserialize(s, &field);
+            position = value.insert(position, std::make_pair(std::move(key), field));
+        }
+        if (res) {
+            return res;
+        }
+    }
+    try {
+        datum->reset(new datum_t(std::move(value)));
+    } catch (const base_exc_t &) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+
+    return ARCHIVE_SUCCESS;
+}
+
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum) {
     const counted_t<const datum_t> *pointer = datum.get();
     const bool has = pointer->has();
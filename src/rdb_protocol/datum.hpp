@@ -46,8 +46,9 @@ enum throw_bool_t { NOTHROW = 0, THROW = 1};
 // CLOBBER: Overwrite existing values.
 enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1};
 
-// A `datum_t` is basically a JSON value, although we may extend it later.
-class datum_t : public slow_atomic_countable_t<datum_t> {
+// A `datum_t` is basically a JSON value, although we may extend it later.  Datums
+// are reference counted non-atomically until `share_across_threads` is called.
+class datum_t : public promotable_countable_t<datum_t> {
 public:
     // This ordering is important, because we use it to sort objects of
     // disparate type.  It should be alphabetical.
@@ -78,6 +79,16 @@ public:
 
     ~datum_t();
 
+    // Makes a datum out of its serialization, `buf`.  If it's an object, its fields
+    // aren't built: they're deserialized from `buf` when they're asked for.  Returns
+    // an empty pointer if `buf` isn't a valid serialization.
+    static counted_t<const datum_t> from_serialized(std::vector<char> &&buf);
+
+    // Makes it safe for several threads at once to take references to this datum
+    // and to the datums in it (see `promotable_countable_t`).  A datum that only
+    // moves between threads with the coroutine using it doesn't need this.
+    void share_across_threads() const;
+
     void write_to_protobuf(Datum *out) const;
 
     type_t get_type() const;
@@ -161,6 +172,12 @@ public:
                               const std::string &pkey) const;
 
 private:
+    class serialized_object_t;
+    explicit datum_t(serialized_object_t *object);
+    friend write_message_t &operator<<(write_message_t &wm,
+                                       const counted_t<const datum_t> &datum);
+    friend size_t serialized_size(const counted_t<const datum_t> &datum);
+
     friend class datum_ptr_t;
     friend void pseudo::sanitize_time(datum_t *time);
     void add(counted_t<const datum_t> val); // add to an array
@@ -195,6 +212,9 @@ private:
     void maybe_sanitize_ptype(const std::set<std::string> &allowed_pts = _allowed_pts);
 
     type_t type;
+    // Set if this is an object made by `from_serialized`, which keeps its fields in
+    // `r_serialized` rather than `r_object`.
+    bool serialized;
     union {
         bool r_bool;
         double r_num;
@@ -202,6 +222,7 @@ private:
         std::string *r_str;
         std::vector<counted_t<const datum_t> > *r_array;
         std::map<std::string, counted_t<const datum_t> > *r_object;
+        serialized_object_t *r_serialized;
     };
 
 public:
@@ -215,6 +236,12 @@ size_t serialized_size(const counted_t<const datum_t> &datum);
 
 write_message_t &operator<<(write_message_t &wm, const counted_t<const datum_t> &datum);
 archive_result_t deserialize(read_stream_t *s, counted_t<const datum_t> *datum);
+// Like `deserialize`, except that if the datum is an object, only the fields in
+// `fields` (or, if `exclude` is set, the fields not in it) are deserialized.  The
+// others are skipped without being built.
+archive_result_t deserialize_fields(read_stream_t *s,
+                                    const std::set<std::string> &fields, bool exclude,
+                                    counted_t<const datum_t> *datum);
 
 write_message_t &operator<<(write_message_t &wm, const empty_ok_t<const counted_t<const datum_t> > &datum);
 archive_result_t deserialize(read_stream_t *s, empty_ok_ref_t<counted_t<const datum_t> > datum);
@@ -7,6 +7,7 @@
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/term.hpp"
+#include "rdb_protocol/transform_visitors.hpp"
 #include "rdb_protocol/val.hpp"
 
 namespace ql {
@@ -19,6 +20,26 @@ const char *const empty_stream_msg =
 counted_t<datum_stream_t> datum_stream_t::slice(size_t l, size_t r) {
     return make_counted<slice_datum_stream_t>(l, r, this->counted_from_this());
 }
+counted_t<const datum_t> datum_stream_t::topk(
+    env_t *env, size_t k,
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons) {
+    topk_wire_func_t topk(k, comparisons);
+    rdb_protocol_t::rget_read_response_t::stream_t heap;
+    while (counted_t<const datum_t> d = next(env)) {
+        query_language::topk_push(
+            topk,
+            rdb_protocol_details::rget_item_t(
+                store_key_t(), query_language::topk_sort_key(env, topk, d), d),
+            &heap);
+    }
+    return query_language::topk_to_array(topk, &heap);
+}
+counted_t<datum_stream_t> datum_stream_t::project(
+    const projection_transform_t &projection, counted_t<func_t> f) {
+    return projection.kind == projection_transform_t::GET_FIELD
+        ? concatmap(f)
+        : map(f);
+}
 counted_t<datum_stream_t> datum_stream_t::zip() {
     return make_counted<zip_datum_stream_t>(this->counted_from_this());
 }
@@ -187,6 +208,13 @@ counted_t<datum_stream_t> lazy_datum_stream_t::concatmap(counted_t<func_t> f) {
         rdb_protocol_details::transform_variant_t(concatmap_wire_func_t(f)));
     return counted_t<datum_stream_t>(out.release());
 }
+counted_t<datum_stream_t> lazy_datum_stream_t::project(
+    const projection_transform_t &projection, UNUSED counted_t<func_t> f) {
+    scoped_ptr_t<lazy_datum_stream_t> out(new lazy_datum_stream_t(this));
+    out->json_stream = json_stream->add_transformation(
+        rdb_protocol_details::transform_variant_t(projection));
+    return counted_t<datum_stream_t>(out.release());
+}
 counted_t<datum_stream_t>
 lazy_datum_stream_t::filter(counted_t<func_t> f,
                             counted_t<func_t> default_filter_val) {
@@ -264,6 +292,17 @@ counted_t<const datum_t> lazy_datum_stream_t::gmr(env_t *env,
     }
 }
 
+counted_t<const datum_t> lazy_datum_stream_t::topk(
+    env_t *env, size_t k,
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons) {
+    topk_wire_func_t topk(k, comparisons);
+    rdb_protocol_t::rget_read_response_t::result_t res = run_terminal(env, topk);
+    rdb_protocol_t::rget_read_response_t::stream_t *heap =
+        boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&res);
+    r_sanity_check(heap);
+    return query_language::topk_to_array(topk, heap);
+}
+
 hinted_datum_t lazy_datum_stream_t::sorting_hint_next(env_t *env) {
     return json_stream->sorting_hint_next(env);
 }
@@ -415,6 +454,94 @@ counted_t<const datum_t> zip_datum_stream_t::next_impl(env_t *env) {
     return right.has() ? left->merge(right) : left;
 }
 
+// LT_CMP_T
+bool lt_cmp_t::operator()(env_t *env, counted_t<const datum_t> l,
+                          counted_t<const datum_t> r) const {
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        counted_t<const datum_t> lval;
+        counted_t<const datum_t> rval;
+        try {
+            lval = it->second->call(env, l)->as_datum();
+        } catch (const base_exc_t &e) {
+            if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                throw;
+            }
+        }
+
+        try {
+            rval = it->second->call(env, r)->as_datum();
+        } catch (const base_exc_t &e) {
+            if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                throw;
+            }
+        }
+
+        if (!lval.has() && !rval.has()) {
+            continue;
+        }
+        if (!lval.has()) {
+            return true != (it->first == DESC);
+        }
+        if (!rval.has()) {
+            return false != (it->first == DESC);
+        }
+        // TODO: use datum_t::cmp instead to be faster
+        if (*lval == *rval) {
+            continue;
+        }
+        return (*lval < *rval) != (it->first == DESC);
+    }
+
+    return false;
+}
+
+// ORDERBY_DATUM_STREAM_T
+orderby_datum_stream_t::orderby_datum_stream_t(
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &_comparisons,
+    counted_t<datum_stream_t> _src,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), comparisons(_comparisons), src(_src) {
+    r_sanity_check(src.has());
+}
+
+orderby_datum_stream_t::orderby_datum_stream_t(const orderby_datum_stream_t *copyee,
+                                               size_t _limit)
+    : eager_datum_stream_t(copyee->backtrace()),
+      comparisons(copyee->comparisons), src(copyee->src),
+      limit(copyee->limit ? std::min(*copyee->limit, _limit) : _limit) { }
+
+counted_t<datum_stream_t> orderby_datum_stream_t::slice(size_t l, size_t r) {
+    // Past `sort_el_limit` we'd better fail at it than keep that many elements.
+    if (sorted.has() || r > sort_el_limit) {
+        return datum_stream_t::slice(l, r);
+    }
+    counted_t<datum_stream_t> limited(new orderby_datum_stream_t(this, r));
+    return make_counted<slice_datum_stream_t>(l, r, limited);
+}
+
+void orderby_datum_stream_t::load_data(env_t *env) {
+    if (sorted.has()) {
+        return;
+    }
+    if (limit) {
+        sorted = make_counted<array_datum_stream_t>(src->topk(env, *limit, comparisons),
+                                                    backtrace());
+    } else {
+        sorted = make_counted<sort_datum_stream_t<lt_cmp_t> >(
+            env, lt_cmp_t(comparisons), src, backtrace());
+    }
+}
+
+counted_t<const datum_t> orderby_datum_stream_t::next_impl(env_t *env) {
+    load_data(env);
+    return sorted->next(env);
+}
+
+counted_t<const datum_t> orderby_datum_stream_t::as_array(env_t *env) {
+    load_data(env);
+    return sorted->as_array(env);
+}
+
 // UNION_DATUM_STREAM_T
 counted_t<datum_stream_t> union_datum_stream_t::filter(counted_t<func_t> f,
                                                        counted_t<func_t> default_filter_val) {
@@ -8,6 +8,9 @@
 #include <utility>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "rdb_protocol/stream.hpp"
 
 namespace query_language {
@@ -30,6 +33,10 @@ public:
                                              counted_t<func_t> default_filter_val) = 0;
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f) = 0;
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f) = 0;
+    // `f` does the same thing to an element as `projection`.  Streams that can't
+    // hand `projection` to the shards just map (or for `get_field`, concatmap) `f`.
+    virtual counted_t<datum_stream_t> project(const projection_transform_t &projection,
+                                              counted_t<func_t> f);
 
     // stream -> atom
     virtual counted_t<const datum_t> count(env_t *env) = 0;
@@ -43,8 +50,17 @@ public:
                                          counted_t<func_t> r) = 0;
 
 
+    // stream -> array
+    // Returns the first `k` elements of the stream in the order `order_by` would
+    // put them in, first element first.
+    virtual counted_t<const datum_t> topk(
+        env_t *env, size_t k,
+        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons);
+
     // stream -> stream (always eager)
-    counted_t<datum_stream_t> slice(size_t l, size_t r);
+    // (`slice` is virtual so that `orderby_datum_stream_t` knows how many elements
+    // it has to sort.)
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
     counted_t<datum_stream_t> zip();
     counted_t<datum_stream_t> indexes_of(counted_t<func_t> f);
 
@@ -216,6 +232,8 @@ public:
                                              counted_t<func_t> default_filter_val);
     virtual counted_t<datum_stream_t> map(counted_t<func_t> f);
     virtual counted_t<datum_stream_t> concatmap(counted_t<func_t> f);
+    virtual counted_t<datum_stream_t> project(const projection_transform_t &projection,
+                                              counted_t<func_t> f);
 
     virtual counted_t<const datum_t> count(env_t *env);
     virtual counted_t<const datum_t> reduce(env_t *env,
@@ -226,6 +244,9 @@ public:
                                          counted_t<func_t> m,
                                          counted_t<const datum_t> base,
                                          counted_t<func_t> r);
+    virtual counted_t<const datum_t> topk(
+        env_t *env, size_t k,
+        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons);
     virtual bool is_array() { return false; }
     virtual counted_t<const datum_t> as_array(UNUSED env_t *env) {
         return counted_t<const datum_t>();  // Cannot be converted implicitly.
@@ -274,6 +295,20 @@ private:
     counted_t<const datum_t> next_impl(env_t *env);
 };
 
+// The order `order_by` sorts by: it compares the values of each function in turn.
+class lt_cmp_t {
+public:
+    explicit lt_cmp_t(
+        std::vector<std::pair<order_direction_t, counted_t<func_t> > > _comparisons)
+        : comparisons(std::move(_comparisons)) { }
+
+    bool operator()(env_t *env, counted_t<const datum_t> l,
+                    counted_t<const datum_t> r) const;
+
+private:
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
+};
+
 // This has to be constructed explicitly rather than invoking `.sort()`.  There
 // was a good reason for this involving header dependencies, but I don't
 // remember exactly what it was.
@@ -367,6 +402,35 @@ private:
     bool is_arr_;
 };
 
+// What an unindexed `order_by` turns a stream into.  It doesn't read its source
+// until it's asked for an element, so that a `limit` or `slice` after it can tell
+// it how many elements will be used.  It then keeps only that many (and a table's
+// shards only send back their own first ones, see `topk`).  Otherwise it sorts
+// the whole stream with a `sort_datum_stream_t`.
+class orderby_datum_stream_t : public eager_datum_stream_t {
+public:
+    orderby_datum_stream_t(
+        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &_comparisons,
+        counted_t<datum_stream_t> _src,
+        const protob_t<const Backtrace> &bt_src);
+
+    virtual counted_t<datum_stream_t> slice(size_t l, size_t r);
+
+private:
+    orderby_datum_stream_t(const orderby_datum_stream_t *copyee, size_t _limit);
+
+    counted_t<const datum_t> next_impl(env_t *env);
+    counted_t<const datum_t> as_array(env_t *env);
+    void load_data(env_t *env);
+
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
+    const counted_t<datum_stream_t> src;
+    const boost::optional<size_t> limit;
+
+    // Empty until an element is asked for.
+    counted_t<datum_stream_t> sorted;
+};
+
 class union_datum_stream_t : public datum_stream_t {
 public:
     union_datum_stream_t(const std::vector<counted_t<datum_stream_t> > &_streams,
@@ -9,13 +9,36 @@ counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
     rdb_blob_wrapper_t blob(txn->get_cache()->get_block_size(),
                             const_cast<rdb_value_t *>(value)->value_ref(), blob::btree_maxreflen);
 
+    blob_acq_t acq_group;
+    buffer_group_t buffer_group;
+    blob.expose_all(txn, rwi_read, &buffer_group, &acq_group);
+    buffer_group_read_stream_t read_stream(const_view(&buffer_group));
+
+    // The value is copied out in one piece, and its fields are only deserialized
+    // when they're used.
+    std::vector<char> buf(value->value_size());
+    int64_t num_read = force_read(&read_stream, buf.data(), buf.size());
+    guarantee(num_read == static_cast<int64_t>(buf.size()));
+    counted_t<const ql::datum_t> data = ql::datum_t::from_serialized(std::move(buf));
+    guarantee(data.has(), "disk corruption (or programmer error) detected");
+
+    return data;
+}
+
+counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
+                                      transaction_t *txn,
+                                      const std::set<std::string> &fields,
+                                      bool exclude) {
+    rdb_blob_wrapper_t blob(txn->get_cache()->get_block_size(),
+                            const_cast<rdb_value_t *>(value)->value_ref(), blob::btree_maxreflen);
+
     counted_t<const ql::datum_t> data;
 
     blob_acq_t acq_group;
     buffer_group_t buffer_group;
     blob.expose_all(txn, rwi_read, &buffer_group, &acq_group);
     buffer_group_read_stream_t read_stream(const_view(&buffer_group));
-    int res = deserialize(&read_stream, &data);
+    int res = ql::deserialize_fields(&read_stream, fields, exclude, &data);
     guarantee_err(res == 0, "disk corruption (or programmer error) detected");
 
     return data;
@@ -2,6 +2,9 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <set>
+#include <string>
+
 #include "buffer_cache/blob.hpp"
 #include "buffer_cache/types.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -30,6 +33,12 @@ public:
 counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
                                       transaction_t *txn);
 
+// Only deserializes some top-level fields of the value; see `ql::deserialize_fields`.
+counted_t<const ql::datum_t> get_data(const rdb_value_t *value,
+                                      transaction_t *txn,
+                                      const std::set<std::string> &fields,
+                                      bool exclude);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, transaction_t *_txn)
         : rdb_value(_rdb_value), txn(_txn) {
@@ -92,6 +92,11 @@ counted_t<val_t> op_term_t::arg(scope_env_t *env, size_t i, eval_flags_t flags)
     return args[i]->eval(env, flags);
 }
 
+bool op_term_t::arg_is_deterministic(size_t i) const {
+    r_sanity_check(i < args.size());
+    return args[i]->is_deterministic();
+}
+
 counted_t<val_t> op_term_t::optarg(scope_env_t *env, const std::string &key) {
     std::map<std::string, counted_t<term_t> >::iterator it = optargs.find(key);
     if (it != optargs.end()) {
@@ -59,6 +59,7 @@ public:
 protected:
     size_t num_args() const; // number of arguments
     counted_t<val_t> arg(scope_env_t *env, size_t i, eval_flags_t flags = NO_FLAGS); // returns argument `i`
+    bool arg_is_deterministic(size_t i) const;
     // Tries to get an optional argument, returns `counted_t<val_t>()` if not
     // found.
     counted_t<val_t> optarg(scope_env_t *env, const std::string &key);
@@ -222,4 +222,24 @@ bool contains(counted_t<const datum_t> datum,
         return false;
     }
 }
+
+void top_level_fields(const pathspec_t &pathspec, bool whole_only,
+        std::set<std::string> *fields_out) {
+    if (const std::string *str = pathspec.as_str()) {
+        fields_out->insert(*str);
+    } else if (const std::vector<pathspec_t> *vec = pathspec.as_vec()) {
+        for (auto it = vec->begin(); it != vec->end(); ++it) {
+            top_level_fields(*it, whole_only, fields_out);
+        }
+    } else if (const std::map<std::string, pathspec_t> *map = pathspec.as_map()) {
+        if (!whole_only) {
+            for (auto it = map->begin(); it != map->end(); ++it) {
+                fields_out->insert(it->first);
+            }
+        }
+    } else {
+        unreachable();
+    }
+}
+
 } // namespace ql
@@ -3,6 +3,7 @@
 #define RDB_PROTOCOL_PATHSPEC_HPP_
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -89,6 +90,10 @@ counted_t<const datum_t> unproject(counted_t<const datum_t> datum,
 /* Return whether or not ALL of the paths in the pathspec exist in the datum. */
 bool contains(counted_t<const datum_t> datum,
         const pathspec_t &pathspec);
+/* Adds the top-level fields the pathspec names to `fields_out`.  If `whole_only`
+ * is set, the fields of which it only names subfields are left out. */
+void top_level_fields(const pathspec_t &pathspec, bool whole_only,
+        std::set<std::string> *fields_out);
 
 } // namespace ql
 
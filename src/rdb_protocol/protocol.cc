@@ -45,6 +45,9 @@ typedef rdb_protocol_t::read_response_t read_response_t;
 typedef rdb_protocol_t::point_read_t point_read_t;
 typedef rdb_protocol_t::point_read_response_t point_read_response_t;
 
+typedef rdb_protocol_t::batched_point_read_t batched_point_read_t;
+typedef rdb_protocol_t::batched_point_read_response_t batched_point_read_response_t;
+
 typedef rdb_protocol_t::rget_read_t rget_read_t;
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -91,6 +94,7 @@ RDB_IMPL_PROTOB_SERIALIZABLE(Backtrace);
 
 
 RDB_IMPL_SERIALIZABLE_2(filter_transform_t, filter_func, default_filter_val);
+RDB_IMPL_SERIALIZABLE_3(projection_transform_t, kind, paths, bt);
 
 namespace rdb_protocol_details {
 
@@ -152,26 +156,6 @@ void bring_sindexes_up_to_date(
                 mod_queue));
 }
 
-class apply_sindex_change_visitor_t : public boost::static_visitor<> {
-public:
-    apply_sindex_change_visitor_t(const sindex_access_vector_t *sindexes,
-            transaction_t *txn,
-            signal_t *interruptor)
-        : sindexes_(sindexes), txn_(txn), interruptor_(interruptor) { }
-    void operator()(const rdb_modification_report_t &mod_report) const {
-        rdb_update_sindexes(*sindexes_, &mod_report, txn_);
-    }
-
-    void operator()(const rdb_erase_range_report_t &erase_range_report) const {
-        rdb_erase_range_sindexes(*sindexes_, &erase_range_report, txn_, interruptor_);
-    }
-
-private:
-    const sindex_access_vector_t *sindexes_;
-    transaction_t *txn_;
-    signal_t *interruptor_;
-};
-
 /* This function is really part of the logic of bring_sindexes_up_to_date
  * however it needs to be in a seperate function so that it can be spawned in a
  * coro. 
@@ -238,6 +222,10 @@ void post_construct_and_drain_queue(
             mutex_t::acq_t acq;
             store->lock_sindex_queue(queue_sindex_block.get(), &acq);
 
+            /* Consecutive modifications are written to the indexes together,
+             * the way a batched write does it. An erase range has to see the
+             * modifications before it, so it ends the batch. */
+            std::vector<rdb_modification_report_t> mod_reports;
             while (mod_queue->size() >= previous_size &&
                    mod_queue->size() > 0) {
                 std::vector<char> data_vec;
@@ -248,8 +236,31 @@ void post_construct_and_drain_queue(
                 int ser_res = deserialize(&read_stream, &sindex_change);
                 guarantee_err(ser_res == 0, "corruption in disk-backed queue");
 
-                boost::apply_visitor(apply_sindex_change_visitor_t(&sindexes, queue_txn.get(), lock.get_drain_signal()),
-                                     sindex_change);
+                const rdb_modification_report_t *mod_report
+                    = boost::get<rdb_modification_report_t>(&sindex_change);
+                if (mod_report != NULL) {
+                    mod_reports.push_back(*mod_report);
+                    if (mod_reports.size() < SINDEX_POST_CONSTRUCTION_BATCH_SIZE) {
+                        continue;
+                    }
+                }
+
+                if (!mod_reports.empty()) {
+                    rdb_update_sindexes(sindexes, mod_reports, queue_txn.get());
+                    mod_reports.clear();
+                }
+
+                if (mod_report == NULL) {
+                    const rdb_erase_range_report_t *erase_range_report
+                        = boost::get<rdb_erase_range_report_t>(&sindex_change);
+                    guarantee(erase_range_report != NULL);
+                    rdb_erase_range_sindexes(sindexes, erase_range_report,
+                                             queue_txn.get(), lock.get_drain_signal());
+                }
+            }
+
+            if (!mod_reports.empty()) {
+                rdb_update_sindexes(sindexes, mod_reports, queue_txn.get());
             }
 
             previous_size = mod_queue->size();
@@ -400,12 +411,24 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+rdb_protocol_t::batched_point_read_t::batched_point_read_t(
+        const std::vector<store_key_t> &_keys)
+    : region(key_range_t(key_range_t::closed, _keys.front(),
+                         key_range_t::closed, _keys.back())),
+      keys(_keys) {
+    rassert(std::is_sorted(keys.begin(), keys.end()));
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol_t::monokey_region(pr.key);
     }
 
+    region_t operator()(const batched_point_read_t &bpr) const {
+        return bpr.region;
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -443,6 +466,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &bpr) const {
+        batched_point_read_t tmp;
+        for (auto it = bpr.keys.begin(); it != bpr.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                tmp.keys.push_back(*it);
+            }
+        }
+        if (tmp.keys.empty()) {
+            return false;
+        }
+        tmp.region = region_intersection(*region, bpr.region);
+        *read_out = read_t(tmp);
+        return true;
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -545,6 +583,18 @@ public:
         *response_out = responses[0];
     }
 
+    void operator()(const batched_point_read_t &) {
+        response_out->response = batched_point_read_response_t();
+        batched_point_read_response_t *res
+            = boost::get<batched_point_read_response_t>(&response_out->response);
+        for (size_t i = 0; i < count; ++i) {
+            const batched_point_read_response_t *rr
+                = boost::get<batched_point_read_response_t>(&responses[i].response);
+            guarantee(rr != NULL);
+            res->data.insert(rr->data.begin(), rr->data.end());
+        }
+    }
+
     void operator()(const rget_read_t &rg) {
         response_out->response = rget_read_response_t();
         rget_read_response_t *rg_response
@@ -809,6 +859,24 @@ private:
                     }
                 }
                 boost::get<ql::wire_datum_map_t>(rg_response->result).finalize();
+            } else if (const ql::topk_wire_func_t *topk_func =
+                    boost::get<ql::topk_wire_func_t>(&*rg.terminal)) {
+                // Each shard sent its own first `k`, which we merge into ours.
+                rg_response->result = rget_read_response_t::stream_t();
+                rget_read_response_t::stream_t *heap =
+                    boost::get<rget_read_response_t::stream_t>(&rg_response->result);
+
+                for (size_t i = 0; i < count; ++i) {
+                    const rget_read_response_t *_rr =
+                        boost::get<rget_read_response_t>(&responses[i].response);
+                    guarantee(_rr);
+                    const rget_read_response_t::stream_t *rhs =
+                        boost::get<rget_read_response_t::stream_t>(&(_rr->result));
+                    r_sanity_check(rhs);
+                    for (auto it = rhs->begin(); it != rhs->end(); ++it) {
+                        query_language::topk_push(*topk_func, *it, heap);
+                    }
+                }
             } else {
                 unreachable();
             }
@@ -1086,13 +1154,15 @@ void write_t::unshard(const write_response_t *responses, size_t count,
 store_t::store_t(serializer_t *serializer,
                  const std::string &perfmon_name,
                  int64_t cache_target,
+                 cache_balancer_t *balancer,
+                 page_repl_policy_t page_repl_policy,
                  bool create,
                  perfmon_collection_t *parent_perfmon_collection,
                  context_t *_ctx,
                  io_backender_t *io,
                  const base_path_t &base_path) :
-    btree_store_t<rdb_protocol_t>(serializer, perfmon_name, cache_target,
-            create, parent_perfmon_collection, _ctx, io, base_path),
+    btree_store_t<rdb_protocol_t>(serializer, perfmon_name, cache_target, balancer,
+            page_repl_policy, create, parent_perfmon_collection, _ctx, io, base_path),
     ctx(_ctx)
 {
     // Make sure to continue bringing sindexes up-to-date if it was interrupted earlier
@@ -1140,7 +1210,17 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = point_read_response_t();
         point_read_response_t *res =
             boost::get<point_read_response_t>(&response->response);
-        rdb_get(get.key, btree, txn, superblock, res);
+        rdb_get(get.key, btree, store->get_key_filter(btree, boost::none, NULL),
+                txn, superblock, res);
+    }
+
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        rdb_get_multiple(get.keys, btree,
+                         store->get_key_filter(btree, boost::none, NULL),
+                         txn, superblock, res);
     }
 
     void operator()(const rget_read_t &rget) {
@@ -1200,8 +1280,15 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             success = deserialize(&read_stream, &multi_bool);
             guarantee(success == ARCHIVE_SUCCESS, "Corrupted sindex description.");
 
+            // Only get_all (which looks up a single value) uses the key filter,
+            // so that range scans don't make us build filters for nothing.
+            btree_slice_t *sindex_slice = store->get_sindex_slice(*rget.sindex);
+            key_filter_t *key_filter = rget.sindex_range->is_single_value()
+                ? store->get_key_filter(sindex_slice, rget.sindex, &sindex_key_filter_part)
+                : NULL;
+
             rdb_rget_secondary_slice(
-                    store->get_sindex_slice(*rget.sindex),
+                    sindex_slice, key_filter,
                     *rget.sindex_range, *rget.sindex_region, // guaranteed present above
                     txn, sindex_sb.get(), &ql_env, rget.transform,
                     rget.terminal, rget.region.inner, rget.sorting,
@@ -1764,9 +1851,14 @@ bool sindex_range_t::contains(counted_t<const ql::datum_t> value) const {
            (!end   || (*value < *end   || (*value == *end && !end_open)));
 }
 
+bool sindex_range_t::is_single_value() const {
+    return start && end && !start_open && !end_open && *start == *end;
+}
+
 RDB_IMPL_ME_SERIALIZABLE_3(rdb_protocol_details::rget_item_t, key, sindex_key, data);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_response_t, data);
+RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::batched_point_read_response_t, data);
 RDB_IMPL_ME_SERIALIZABLE_4(rdb_protocol_t::rget_read_response_t,
                            result, key_range, truncated, last_considered_key);
 RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::distribution_read_response_t,
@@ -1775,6 +1867,7 @@ RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::sindex_list_response_t, sindexes);
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::read_response_t, response);
 
 RDB_IMPL_ME_SERIALIZABLE_1(rdb_protocol_t::point_read_t, key);
+RDB_IMPL_ME_SERIALIZABLE_2(rdb_protocol_t::batched_point_read_t, region, keys);
 
 RDB_IMPL_ME_SERIALIZABLE_4(sindex_range_t,
                            empty_ok(start), empty_ok(end), start_open, end_open);
@@ -86,6 +86,8 @@ public:
     // Constructs some kind of region out of truncated_secondary values.
     hash_region_t<key_range_t> to_region() const;
     bool contains(counted_t<const ql::datum_t> value) const;
+    // True if the range has exactly one value in it, like the ones get_all uses.
+    bool is_single_value() const;
 
     counted_t<const ql::datum_t> start, end;
     bool start_open, end_open;
@@ -106,6 +108,30 @@ struct filter_transform_t {
 
 RDB_DECLARE_SERIALIZABLE(filter_transform_t);
 
+/* A `pluck`, `without` or `get_field` on every element.  Unlike a map, the shards
+ * know which fields it reads, so they don't have to deserialize the others. */
+struct projection_transform_t {
+    enum kind_t { PLUCK, WITHOUT, GET_FIELD };
+
+    projection_transform_t() : kind(PLUCK) { }
+    projection_transform_t(kind_t _kind,
+                           counted_t<const ql::datum_t> _paths,
+                           const ql::backtrace_t &_bt)
+        : kind(_kind), paths(_paths), bt(_bt) { }
+
+    kind_t kind;
+    // The array of path arguments of `pluck` or `without`, or the field name of
+    // `get_field`.
+    counted_t<const ql::datum_t> paths;
+    ql::backtrace_t bt;
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(projection_transform_t::kind_t, int8_t,
+                                      projection_transform_t::PLUCK,
+                                      projection_transform_t::GET_FIELD);
+
+RDB_DECLARE_SERIALIZABLE(projection_transform_t);
+
 namespace rdb_protocol_details {
 
 struct backfill_atom_t {
@@ -127,12 +153,14 @@ RDB_DECLARE_SERIALIZABLE(backfill_atom_t);
 
 typedef boost::variant<ql::map_wire_func_t,
                        filter_transform_t,
-                       ql::concatmap_wire_func_t> transform_variant_t;
+                       ql::concatmap_wire_func_t,
+                       projection_transform_t> transform_variant_t;
 typedef std::list<transform_variant_t> transform_t;
 
 typedef boost::variant<ql::gmr_wire_func_t,
                        ql::count_wire_func_t,
-                       ql::reduce_wire_func_t> terminal_variant_t;
+                       ql::reduce_wire_func_t,
+                       ql::topk_wire_func_t> terminal_variant_t;
 typedef terminal_variant_t terminal_t;
 
 void bring_sindexes_up_to_date(
@@ -224,6 +252,12 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    struct batched_point_read_response_t {
+        // The rows of the keys that have one.
+        std::map<store_key_t, counted_t<const ql::datum_t> > data;
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     struct rget_read_response_t {
          // Present if there was no terminal
         typedef std::vector<rdb_protocol_details::rget_item_t> stream_t;
@@ -241,7 +275,7 @@ struct rdb_protocol_t {
             empty_t, // for `reduce`, sometimes
             ql::wire_datum_map_t, // for `gmr`, always
 
-            // Streaming Result.
+            // Streaming Result, and the heap of a `topk`.
             stream_t
             > result_t;
 
@@ -283,6 +317,7 @@ struct rdb_protocol_t {
 
     struct read_response_t {
         boost::variant<point_read_response_t,
+                       batched_point_read_response_t,
                        rget_read_response_t,
                        distribution_read_response_t,
                        sindex_list_response_t> response;
@@ -307,6 +342,21 @@ struct rdb_protocol_t {
         RDB_DECLARE_ME_SERIALIZABLE;
     };
 
+    /* Reads the rows of many primary keys at once. Each shard gets a single read
+    for all of its keys, and looks them up with one pass down the btree. */
+    class batched_point_read_t {
+    public:
+        batched_point_read_t() { }
+        // The keys have to be sorted, and there has to be at least one.
+        explicit batched_point_read_t(const std::vector<store_key_t> &_keys);
+
+        /* Covers all of the keys; it gets narrowed down by sharding. */
+        region_t region;
+        std::vector<store_key_t> keys;
+
+        RDB_DECLARE_ME_SERIALIZABLE;
+    };
+
     class rget_read_t {
     public:
         rget_read_t() { }
@@ -424,6 +474,7 @@ struct rdb_protocol_t {
 
     struct read_t {
         boost::variant<point_read_t,
+                       batched_point_read_t,
                        rget_read_t,
                        distribution_read_t,
                        sindex_list_t> read;
@@ -441,6 +492,7 @@ struct rdb_protocol_t {
 
         read_t() { }
         explicit read_t(const boost::variant<point_read_t,
+                                             batched_point_read_t,
                                              rget_read_t,
                                              distribution_read_t,
                                              sindex_list_t> &r)
@@ -752,6 +804,8 @@ struct rdb_protocol_t {
         store_t(serializer_t *serializer,
                 const std::string &perfmon_name,
                 int64_t cache_target,
+                cache_balancer_t *balancer,
+                page_repl_policy_t page_repl_policy,
                 bool create,
                 perfmon_collection_t *parent_perfmon_collection,
                 context_t *ctx,
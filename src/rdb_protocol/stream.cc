@@ -1,7 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream.hpp"
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
 #include "btree/keys.hpp"
+#include "concurrency/pmap.hpp"
 #include "rdb_protocol/ql2.hpp"
 #include "rdb_protocol/transform_visitors.hpp"
 #include "rdb_protocol/datum_stream.hpp"
@@ -18,6 +22,7 @@ batched_rget_stream_t::batched_rget_stream_t(
     bool _use_outdated, sorting_t _sorting,
     ql::rcheckable_t *_parent)
     : ns_access(_ns_access),
+      head_cursor(0),
       finished(false), started(false), optargs(_optargs), use_outdated(_use_outdated),
       range(left_bound_open ? key_range_t::open : key_range_t::closed,
             left_bound.has()
@@ -40,6 +45,7 @@ batched_rget_stream_t::batched_rget_stream_t(
     sorting_t _sorting, ql::rcheckable_t *_parent)
     : ns_access(_ns_access),
       sindex_id(_sindex_id),
+      head_cursor(0),
       finished(false),
       started(false),
       optargs(_optargs),
@@ -59,6 +65,9 @@ batched_rget_stream_t::batched_rget_stream_t(
 
 boost::optional<rget_item_t> batched_rget_stream_t::head(ql::env_t *env) {
     started = true;
+    if (sorting != UNORDERED) {
+        return merged_head(env);
+    }
     if (data.empty()) {
         if (finished) {
             return boost::optional<rget_item_t>();
@@ -73,11 +82,138 @@ boost::optional<rget_item_t> batched_rget_stream_t::head(ql::env_t *env) {
     return data.front();
 }
 
+boost::optional<rget_item_t> batched_rget_stream_t::merged_head(ql::env_t *env) {
+    if (finished) {
+        return boost::optional<rget_item_t>();
+    }
+    if (cursors.empty()) {
+        init_cursors();
+    }
+
+    // We can't tell which item comes next while a shard that has more data
+    // hasn't sent any of it.
+    for (;;) {
+        bool must_read = false;
+        for (auto it = cursors.begin(); it != cursors.end(); ++it) {
+            must_read |= !it->finished && it->data.empty();
+        }
+        if (!must_read) {
+            break;
+        }
+        read_cursors(env);
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].data.empty()) {
+            continue;
+        }
+        if (found) {
+            const store_key_t &key = cursors[i].data.front().key;
+            const store_key_t &key_to_beat = cursors[head_cursor].data.front().key;
+            if ((forward(sorting) && !(key < key_to_beat))
+                || (backward(sorting) && !(key > key_to_beat))) {
+                continue;
+            }
+        }
+        head_cursor = i;
+        found = true;
+    }
+    if (!found) {
+        finished = true;
+        return boost::optional<rget_item_t>();
+    }
+    return cursors[head_cursor].data.front();
+}
+
 void batched_rget_stream_t::pop() {
+    if (sorting != UNORDERED) {
+        guarantee(head_cursor < cursors.size() && !cursors[head_cursor].data.empty());
+        cursors[head_cursor].data.pop_front();
+        return;
+    }
     guarantee(!data.empty());
     data.pop_front();
 }
 
+void batched_rget_stream_t::init_cursors() {
+    guarantee(ns_access.get_namespace_if());
+    std::set<rdb_protocol_t::region_t> shards;
+    try {
+        shards = ns_access.get_namespace_if()->get_sharding_scheme();
+    } catch (const cannot_perform_query_exc_t &) {
+        // The sharding scheme is only a hint.  One cursor on the whole table
+        // works just as well, only with more waiting.
+        shards.insert(rdb_protocol_t::region_t::universe());
+    }
+
+    for (auto it = shards.begin(); it != shards.end(); ++it) {
+        if (sindex_id) {
+            // Every shard has a part of every sindex.
+            cursors.push_back(shard_cursor_t(*it, range));
+        } else {
+            rdb_protocol_t::region_t part
+                = region_intersection(*it, rdb_protocol_t::region_t(range));
+            if (!region_is_empty(part)) {
+                cursors.push_back(shard_cursor_t(*it, part.inner));
+            }
+        }
+    }
+    if (cursors.empty()) {
+        finished = true;
+    }
+}
+
+/* Reads the next chunk of every cursor that has run out of data.  While we're
+ * waiting for those anyway, we also read ahead on the cursors that are halfway
+ * through their last chunk, so that they don't hold things up next time. */
+void batched_rget_stream_t::read_cursors(ql::env_t *env) {
+    std::vector<size_t> to_read;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (!cursors[i].finished
+            && cursors[i].data.size() <= cursors[i].last_chunk_size / 2) {
+            to_read.push_back(i);
+        }
+    }
+
+    std::vector<rdb_protocol_t::read_response_t> responses(to_read.size());
+    std::vector<boost::optional<std::string> > errors(to_read.size());
+    pmap(to_read.size(), boost::bind(&batched_rget_stream_t::read_cursor, this,
+                                     env, boost::cref(to_read), &responses, &errors, _1));
+    if (env->interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+
+    for (size_t j = 0; j < to_read.size(); ++j) {
+        if (errors[j]) {
+            rfail_datum(ql::base_exc_t::GENERIC,
+                        "cannot perform read: %s", errors[j]->c_str());
+        }
+        shard_cursor_t *cursor = &cursors[to_read[j]];
+        const size_t old_size = cursor->data.size();
+        handle_response(&responses[j], &cursor->range, &cursor->data, &cursor->finished);
+        cursor->last_chunk_size = cursor->data.size() - old_size;
+        if (cursor->last_chunk_size == 0) {
+            cursor->finished = true;
+        }
+    }
+}
+
+void batched_rget_stream_t::read_cursor(
+        ql::env_t *env, const std::vector<size_t> &to_read,
+        std::vector<rdb_protocol_t::read_response_t> *responses,
+        std::vector<boost::optional<std::string> > *errors,
+        int i) {
+    const shard_cursor_t &cursor = cursors[to_read[i]];
+    try {
+        send_read(env, get_rget(cursor.shard, cursor.range), &(*responses)[i]);
+    } catch (const cannot_perform_query_exc_t &e) {
+        (*errors)[i] = std::string(e.what());
+    } catch (const interrupted_exc_t &) {
+        // `read_cursors` checks the interruptor once all the reads are done.
+    }
+}
+
 bool rget_item_sindex_key_less(const rget_item_t &left, const rget_item_t &right) {
     r_sanity_check(left.sindex_key);
     r_sanity_check(right.sindex_key);
@@ -247,72 +383,94 @@ rdb_protocol_t::rget_read_response_t::result_t batched_rget_stream_t::apply_term
 }
 
 rdb_protocol_t::rget_read_t batched_rget_stream_t::get_rget() {
+    return get_rget(rdb_protocol_t::region_t::universe(), range);
+}
+
+rdb_protocol_t::rget_read_t batched_rget_stream_t::get_rget(
+        const rdb_protocol_t::region_t &shard, const key_range_t &_range) {
     if (!sindex_id) {
-        return rdb_protocol_t::rget_read_t(rdb_protocol_t::region_t(range),
-                                           transform,
-                                           optargs,
-                                           sorting);
+        return rdb_protocol_t::rget_read_t(
+            region_intersection(shard, rdb_protocol_t::region_t(_range)),
+            transform,
+            optargs,
+            sorting);
+    } else {
+        rdb_protocol_t::rget_read_t rget(rdb_protocol_t::region_t(_range),
+                                         *sindex_id,
+                                         sindex_range,
+                                         transform,
+                                         optargs,
+                                         sorting);
+        rget.region = shard;
+        return rget;
+    }
+}
+
+void batched_rget_stream_t::send_read(ql::env_t *env,
+                                      const rdb_protocol_t::rget_read_t &rget,
+                                      rdb_protocol_t::read_response_t *res)
+    THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    rdb_protocol_t::read_t read(rget);
+    guarantee(ns_access.get_namespace_if());
+    if (use_outdated) {
+        ns_access.get_namespace_if()->read_outdated(read, res, env->interruptor);
     } else {
-        return rdb_protocol_t::rget_read_t(rdb_protocol_t::region_t(range),
-                                           *sindex_id,
-                                           sindex_range,
-                                           transform,
-                                           optargs,
-                                           sorting);
+        ns_access.get_namespace_if()->read(
+            read, res, order_token_t::ignore, env->interruptor);
     }
 }
 
 void batched_rget_stream_t::read_more(ql::env_t *env) {
-    rdb_protocol_t::read_t read(get_rget());
     try {
-        guarantee(ns_access.get_namespace_if());
         rdb_protocol_t::read_response_t res;
-        if (use_outdated) {
-            ns_access.get_namespace_if()->read_outdated(read, &res, env->interruptor);
-        } else {
-            ns_access.get_namespace_if()->read(
-                read, &res, order_token_t::ignore, env->interruptor);
-        }
-        rdb_protocol_t::rget_read_response_t *p_res
-            = boost::get<rdb_protocol_t::rget_read_response_t>(&res.response);
-        guarantee(p_res);
+        send_read(env, get_rget(), &res);
+        handle_response(&res, &range, &data, &finished);
+    } catch (const cannot_perform_query_exc_t &e) {
+        rfail_datum(ql::base_exc_t::GENERIC, "cannot perform read: %s", e.what());
+    }
+}
 
-        /* Re throw an exception if we got one. */
-        if (auto e = boost::get<ql::exc_t>(&p_res->result)) {
-            throw *e;
-        } else if (auto e2 = boost::get<ql::datum_exc_t>(&p_res->result)) {
-            throw *e2;
-        }
+void batched_rget_stream_t::handle_response(rdb_protocol_t::read_response_t *res,
+                                            key_range_t *range_inout,
+                                            std::deque<rget_item_t> *data_out,
+                                            bool *finished_out) {
+    rdb_protocol_t::rget_read_response_t *p_res
+        = boost::get<rdb_protocol_t::rget_read_response_t>(&res->response);
+    guarantee(p_res);
+
+    /* Re throw an exception if we got one. */
+    if (auto e = boost::get<ql::exc_t>(&p_res->result)) {
+        throw *e;
+    } else if (auto e2 = boost::get<ql::datum_exc_t>(&p_res->result)) {
+        throw *e2;
+    }
 
-        // todo: just do a straight copy?
-        typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
-        stream_t *stream = boost::get<stream_t>(&p_res->result);
-        guarantee(stream);
+    // todo: just do a straight copy?
+    typedef rdb_protocol_t::rget_read_response_t::stream_t stream_t;
+    stream_t *stream = boost::get<stream_t>(&p_res->result);
+    guarantee(stream);
 
-        for (stream_t::iterator i = stream->begin(); i != stream->end(); ++i) {
-            guarantee(i->data);
-            data.push_back(*i);
-        }
+    for (stream_t::iterator i = stream->begin(); i != stream->end(); ++i) {
+        guarantee(i->data);
+        data_out->push_back(*i);
+    }
 
-        if (forward(sorting)) {
-            range.left = p_res->last_considered_key;
-        } else {
-            range.right = key_range_t::right_bound_t(p_res->last_considered_key);
-        }
+    if (forward(sorting)) {
+        range_inout->left = p_res->last_considered_key;
+    } else {
+        range_inout->right = key_range_t::right_bound_t(p_res->last_considered_key);
+    }
 
-        if (forward(sorting) &&
-            (!range.left.increment() ||
-            (!range.right.unbounded && (range.right.key < range.left)))) {
-            finished = true;
-        } else if (backward(sorting)) {
-            guarantee(!range.right.unbounded);
-            if (!range.right.key.decrement() ||
-                range.right.key < range.left) {
-                finished = true;
-            }
+    if (forward(sorting) &&
+        (!range_inout->left.increment() ||
+        (!range_inout->right.unbounded && (range_inout->right.key < range_inout->left)))) {
+        *finished_out = true;
+    } else if (backward(sorting)) {
+        guarantee(!range_inout->right.unbounded);
+        if (!range_inout->right.key.decrement() ||
+            range_inout->right.key < range_inout->left) {
+            *finished_out = true;
         }
-    } catch (const cannot_perform_query_exc_t &e) {
-        rfail_datum(ql::base_exc_t::GENERIC, "cannot perform read: %s", e.what());
     }
 }
 
@@ -90,10 +90,43 @@ public:
                    ql::env_t *env);
 
 private:
+    /* A sorted read keeps a cursor on each shard.  Each shard sends back its
+     * data sorted, so `head` only has to merge the cursors' data, and a chunk
+     * from one shard never has to wait for the others to catch up. */
+    struct shard_cursor_t {
+        shard_cursor_t(const rdb_protocol_t::region_t &_shard, const key_range_t &_range)
+            : shard(_shard), range(_range), last_chunk_size(0), finished(false) { }
+
+        // The shard's part of the primary keyspace.
+        rdb_protocol_t::region_t shard;
+        // What's left to read of it, in the keyspace we're reading.
+        key_range_t range;
+        std::deque<rget_item_t> data;
+        size_t last_chunk_size;
+        bool finished;
+    };
+
     boost::optional<rget_item_t> head(ql::env_t *env);
+    boost::optional<rget_item_t> merged_head(ql::env_t *env);
     void pop();
     rdb_protocol_t::rget_read_t get_rget();
+    rdb_protocol_t::rget_read_t get_rget(const rdb_protocol_t::region_t &shard,
+                                         const key_range_t &_range);
     void read_more(ql::env_t *env);
+    void init_cursors();
+    void read_cursors(ql::env_t *env);
+    void read_cursor(ql::env_t *env, const std::vector<size_t> &to_read,
+                     std::vector<rdb_protocol_t::read_response_t> *responses,
+                     std::vector<boost::optional<std::string> > *errors,
+                     int i);
+    void send_read(ql::env_t *env, const rdb_protocol_t::rget_read_t &rget,
+                   rdb_protocol_t::read_response_t *res)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+    // Moves the data of a read's response to `data_out`, and `range_inout` past it.
+    void handle_response(rdb_protocol_t::read_response_t *res,
+                         key_range_t *range_inout,
+                         std::deque<rget_item_t> *data_out,
+                         bool *finished_out);
     bool check_and_set_key_in_sorting_buffer(const std::string &key);
 
     /* Returns true if the passed value is new. */
@@ -111,6 +144,11 @@ private:
     std::deque<rget_item_t> data;
     std::deque<rget_item_t> sorting_buffer;
 
+    // Only used by sorted reads.  `head_cursor` is the cursor `head` took its
+    // item from.
+    std::vector<shard_cursor_t> cursors;
+    size_t head_cursor;
+
     std::string key_in_sorting_buffer;
 
     boost::variant<counted_t<const ql::datum_t>, std::string> last_key;
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <map>
 #include <string>
 
@@ -155,7 +156,8 @@ public:
     table_create_term_t(compile_env_t *env, const protob_t<const Term> &term) :
         meta_write_op_t(env, term, argspec_t(1, 2),
                         optargspec_t({"datacenter", "primary_key",
-                                    "cache_size", "durability"})) { }
+                                    "cache_size", "cpu_sharding_factor",
+                                    "block_size", "durability"})) { }
 private:
     virtual std::string write_eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         uuid_u dc_id = nil_uuid();
@@ -183,6 +185,32 @@ private:
             cache_size = v->as_int<int64_t>();
         }
 
+        // 0 means as many CPU shards as this server has database threads.
+        int32_t cpu_sharding_factor = DEFAULT_CPU_SHARDING_FACTOR;
+        if (counted_t<val_t> v = optarg(env, "cpu_sharding_factor")) {
+            cpu_sharding_factor = v->as_int<int32_t>();
+            rcheck(0 <= cpu_sharding_factor
+                   && cpu_sharding_factor <= MAX_CPU_SHARDING_FACTOR,
+                   base_exc_t::GENERIC,
+                   strprintf("`cpu_sharding_factor` must be between 0 and %d.",
+                             MAX_CPU_SHARDING_FACTOR));
+            if (cpu_sharding_factor == 0) {
+                cpu_sharding_factor = std::min(get_num_db_threads(),
+                                               MAX_CPU_SHARDING_FACTOR);
+            }
+        }
+
+        int32_t block_size = DEFAULT_BTREE_BLOCK_SIZE;
+        if (counted_t<val_t> v = optarg(env, "block_size")) {
+            block_size = v->as_int<int32_t>();
+            rcheck(MIN_BTREE_BLOCK_SIZE <= block_size && block_size <= MAX_BTREE_BLOCK_SIZE
+                   && (block_size & (block_size - 1)) == 0,
+                   base_exc_t::GENERIC,
+                   strprintf("`block_size` must be a power of two between %d and %d.",
+                             static_cast<int>(MIN_BTREE_BLOCK_SIZE),
+                             static_cast<int>(MAX_BTREE_BLOCK_SIZE)));
+        }
+
         uuid_u db_id;
         name_string_t tbl_name;
         if (num_args() == 1) {
@@ -212,7 +240,7 @@ private:
             namespace_semilattice_metadata_t<rdb_protocol_t> ns =
                 new_namespace<rdb_protocol_t>(env->env->cluster_access.this_machine, db_id, dc_id, tbl_name,
                                               primary_key, port_defaults::reql_port,
-                                              cache_size);
+                                              cache_size, cpu_sharding_factor, block_size);
 
             // Set Durability
             std::map<datacenter_id_t, ack_expectation_t> *ack_map =
@@ -479,12 +507,16 @@ private:
                 = make_counted<union_datum_stream_t>(streams, backtrace());
             return new_val(stream, table);
         } else {
-            datum_ptr_t arr(datum_t::R_ARRAY);
+            std::vector<counted_t<const datum_t> > keys;
             for (size_t i = 1; i < num_args(); ++i) {
-                counted_t<const datum_t> key = arg(env, i)->as_datum();
-                counted_t<const datum_t> row = table->get_row(env->env, key);
-                if (row->get_type() != datum_t::R_NULL) {
-                    arr.add(row);
+                keys.push_back(arg(env, i)->as_datum());
+            }
+            std::vector<counted_t<const datum_t> > rows
+                = table->get_rows(env->env, keys);
+            datum_ptr_t arr(datum_t::R_ARRAY);
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (rows[i]->get_type() != datum_t::R_NULL) {
+                    arr.add(rows[i]);
                 }
             }
             counted_t<datum_stream_t> stream
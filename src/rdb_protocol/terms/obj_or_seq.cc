@@ -65,9 +65,43 @@ public:
         pb::set_var(pb::reset(body->mutable_args(0)), varnum);
         prop_bt(func.get());
     }
+protected:
+    // Evaluates the path arguments of `pluck` or `without` into the array their
+    // `projection_transform_t` takes.  Returns false if they can't be evaluated
+    // once for the whole sequence (in which case they're left to `func`).
+    bool projection_paths(scope_env_t *env, counted_t<const datum_t> *paths_out) {
+        std::vector<counted_t<const datum_t> > paths;
+        const size_t n = num_args();
+        paths.reserve(n - 1);
+        for (size_t i = 1; i < n; ++i) {
+            if (!arg_is_deterministic(i)) {
+                return false;
+            }
+        }
+        try {
+            for (size_t i = 1; i < n; ++i) {
+                paths.push_back(arg(env, i)->as_datum());
+            }
+            *paths_out = make_counted<const datum_t>(std::move(paths));
+            // The shards build this again; make sure they can.
+            pathspec_t pathspec(*paths_out, this);
+        } catch (const base_exc_t &) {
+            // `func` reports these, if there's an element to report them on.
+            return false;
+        }
+        return true;
+    }
+
 private:
     virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) = 0;
 
+    // Terms that a table's shards can do without calling `func` on each element
+    // set `*out` and return true.
+    virtual bool make_projection(UNUSED scope_env_t *env,
+                                 UNUSED projection_transform_t *out) {
+        return false;
+    }
+
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         counted_t<val_t> v0 = arg(env, 0);
         counted_t<const datum_t> d;
@@ -91,6 +125,11 @@ private:
             counted_t<func_term_t> func_term = make_counted<func_term_t>(&compile_env, func);
             counted_t<func_t> func = func_term->eval_to_func(env->scope);
 
+            projection_transform_t projection;
+            if (make_projection(env, &projection)) {
+                return new_val(env->env, v0->as_seq(env->env)->project(projection, func));
+            }
+
             switch (poly_type) {
             case MAP:
                 return new_val(env->env, v0->as_seq(env->env)->map(func));
@@ -130,6 +169,15 @@ private:
         pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
         return new_val(project(obj, pathspec, DONT_RECURSE));
     }
+    virtual bool make_projection(scope_env_t *env, projection_transform_t *out) {
+        counted_t<const datum_t> paths;
+        if (!projection_paths(env, &paths)) {
+            return false;
+        }
+        *out = projection_transform_t(projection_transform_t::PLUCK, paths,
+                                      backtrace_t(backtrace().get()));
+        return true;
+    }
     virtual const char *name() const { return "pluck"; }
 };
 
@@ -151,6 +199,15 @@ private:
         pathspec_t pathspec(make_counted<const datum_t>(std::move(paths)), this);
         return new_val(unproject(obj, pathspec, DONT_RECURSE));
     }
+    virtual bool make_projection(scope_env_t *env, projection_transform_t *out) {
+        counted_t<const datum_t> paths;
+        if (!projection_paths(env, &paths)) {
+            return false;
+        }
+        *out = projection_transform_t(projection_transform_t::WITHOUT, paths,
+                                      backtrace_t(backtrace().get()));
+        return true;
+    }
     virtual const char *name() const { return "without"; }
 };
 
@@ -222,6 +279,21 @@ private:
     virtual counted_t<val_t> obj_eval(scope_env_t *env, counted_t<val_t> v0) {
         return new_val(v0->as_datum()->get(arg(env, 1)->as_str()));
     }
+    virtual bool make_projection(scope_env_t *env, projection_transform_t *out) {
+        if (!arg_is_deterministic(1)) {
+            return false;
+        }
+        std::string field;
+        try {
+            field = arg(env, 1)->as_str();
+        } catch (const base_exc_t &) {
+            return false;
+        }
+        *out = projection_transform_t(projection_transform_t::GET_FIELD,
+                                      make_counted<const datum_t>(std::move(field)),
+                                      backtrace_t(backtrace().get()));
+        return true;
+    }
     virtual const char *name() const { return "get_field"; }
 };
 
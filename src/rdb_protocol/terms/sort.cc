@@ -50,55 +50,6 @@ public:
         : op_term_t(env, term, argspec_t(1, -1),
           optargspec_t({"index"})), src_term(term) { }
 private:
-    enum order_direction_t { ASC, DESC };
-    class lt_cmp_t {
-    public:
-        explicit lt_cmp_t(std::vector<std::pair<order_direction_t, counted_t<func_t> > > _comparisons)
-            : comparisons(std::move(_comparisons)) { }
-
-        bool operator()(env_t *env, counted_t<const datum_t> l, counted_t<const datum_t> r) const {
-            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                counted_t<const datum_t> lval;
-                counted_t<const datum_t> rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                if (!lval.has() && !rval.has()) {
-                    continue;
-                }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
-                }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
-                }
-                // TODO: use datum_t::cmp instead to be faster
-                if (*lval == *rval) {
-                    continue;
-                }
-                return (*lval < *rval) != (it->first == DESC);
-            }
-
-            return false;
-        }
-
-    private:
-        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
-    };
-
     virtual counted_t<val_t> eval_impl(scope_env_t *env, UNUSED eval_flags_t flags) {
         std::vector<std::pair<order_direction_t, counted_t<func_t> > > comparisons;
         scoped_ptr_t<datum_t> arr(new datum_t(datum_t::R_ARRAY));
@@ -111,8 +62,6 @@ private:
                         std::make_pair(ASC, arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
-        lt_cmp_t lt_cmp(comparisons);
-        // We can't have datum_stream_t::sort because templates suck.
 
         counted_t<table_t> tbl;
         counted_t<datum_stream_t> seq;
@@ -129,7 +78,8 @@ private:
         }
 
         /* Add a sorting to the table if we're doing indexed sorting. */
-        if (counted_t<val_t> index = optarg(env, "index")) {
+        counted_t<val_t> index = optarg(env, "index");
+        if (index.has()) {
             rcheck(tbl.has(), base_exc_t::GENERIC,
                    "Indexed order_by can only be performed on a TABLE.");
             rcheck(!seq.has(), base_exc_t::GENERIC,
@@ -155,7 +105,15 @@ private:
         }
 
         if (!comparisons.empty()) {
-            seq = make_counted<sort_datum_stream_t<lt_cmp_t> >(env->env, lt_cmp, seq, backtrace());
+            // An indexed sort has to go through the batches of equal index values
+            // one by one, so it can't skip any.
+            if (index.has()) {
+                // We can't have datum_stream_t::sort because templates suck.
+                seq = make_counted<sort_datum_stream_t<lt_cmp_t> >(
+                    env->env, lt_cmp_t(comparisons), seq, backtrace());
+            } else {
+                seq = make_counted<orderby_datum_stream_t>(comparisons, seq, backtrace());
+            }
         }
 
         return tbl.has() ? new_val(seq, tbl) : new_val(env->env, seq);
@@ -1,8 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/transform_visitors.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/lazy_json.hpp"
+#include "rdb_protocol/pathspec.hpp"
 
 typedef rdb_protocol_t::rget_read_response_t rget_read_response_t;
 
@@ -27,6 +30,10 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const topk_wire_func_t &func) const {
+        *res_out = exc_t(exc, func.get_bt().get(), 1);
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -59,6 +66,10 @@ public:
         *res_out = exc_t(exc, func.get_bt().get(), 1);
     }
 
+    void operator()(const projection_transform_t &transf) const {
+        *res_out = exc_t(exc.get_type(), exc.what(), transf.bt);
+    }
+
 private:
     const datum_exc_t exc;
     rget_read_response_t::result_t *res_out;
@@ -88,6 +99,7 @@ public:
     void operator()(const ql::map_wire_func_t &func) const;
     void operator()(const filter_transform_t &func) const;
     void operator()(const ql::concatmap_wire_func_t &func) const;
+    void operator()(const projection_transform_t &transf) const;
 
 private:
     counted_t<const ql::datum_t> arg;
@@ -126,6 +138,74 @@ void transform_visitor_t::operator()(const filter_transform_t &transf) const {
     }
 }
 
+static const char *projection_name(projection_transform_t::kind_t kind) {
+    switch (kind) {
+    case projection_transform_t::PLUCK: return "pluck";
+    case projection_transform_t::WITHOUT: return "without";
+    case projection_transform_t::GET_FIELD: return "get_field";
+    default: unreachable();
+    }
+}
+
+// This has to fail the same way `obj_or_seq_op_term_t` does.
+void transform_visitor_t::operator()(const projection_transform_t &transf) const {
+    if (arg->get_type() == ql::datum_t::R_ARRAY) {
+        throw ql::datum_exc_t(ql::base_exc_t::GENERIC,
+                              strprintf("Cannot perform %s on a sequence of sequences.",
+                                        projection_name(transf.kind)));
+    } else if (arg->get_type() != ql::datum_t::R_OBJECT) {
+        ql::base_exc_t::type_t type = ql::exc_type(arg);
+        if (transf.kind == projection_transform_t::GET_FIELD
+            && type == ql::base_exc_t::NON_EXISTENCE) {
+            // `get_field` skips these, like its `default` does.
+            return;
+        }
+        throw ql::datum_exc_t(type,
+                              strprintf("Cannot perform %s on a non-object "
+                                        "non-sequence `%s`.",
+                                        projection_name(transf.kind),
+                                        arg->trunc_print().c_str()));
+    }
+
+    switch (transf.kind) {
+    case projection_transform_t::PLUCK: {
+        out->push_back(ql::project(arg, ql::pathspec_t(transf.paths, NULL),
+                                   ql::DONT_RECURSE));
+    } break;
+    case projection_transform_t::WITHOUT: {
+        out->push_back(ql::unproject(arg, ql::pathspec_t(transf.paths, NULL),
+                                     ql::DONT_RECURSE));
+    } break;
+    case projection_transform_t::GET_FIELD: {
+        if (counted_t<const ql::datum_t> d = arg->get(transf.paths->as_str(),
+                                                      ql::NOTHROW)) {
+            out->push_back(d);
+        }
+    } break;
+    default: unreachable();
+    }
+}
+
+void projection_fields(const projection_transform_t &transf,
+                       std::set<std::string> *fields_out, bool *exclude_out) {
+    switch (transf.kind) {
+    case projection_transform_t::PLUCK: {
+        ql::top_level_fields(ql::pathspec_t(transf.paths, NULL), false, fields_out);
+        *exclude_out = false;
+    } break;
+    case projection_transform_t::WITHOUT: {
+        // We can only skip what `without` removes entirely.
+        ql::top_level_fields(ql::pathspec_t(transf.paths, NULL), true, fields_out);
+        *exclude_out = true;
+    } break;
+    case projection_transform_t::GET_FIELD: {
+        fields_out->insert(transf.paths->as_str());
+        *exclude_out = false;
+    } break;
+    default: unreachable();
+    }
+}
+
 void transform_apply(ql::env_t *ql_env,
                      counted_t<const ql::datum_t> json,
                      const rdb_protocol_details::transform_variant_t *t,
@@ -143,6 +223,7 @@ public:
     void operator()(const ql::count_wire_func_t &) const;
     void operator()(const ql::gmr_wire_func_t &) const;
     void operator()(const ql::reduce_wire_func_t &) const;
+    void operator()(const ql::topk_wire_func_t &) const;
 private:
     lazy_json_t json;
     ql::env_t *ql_env;
@@ -193,6 +274,17 @@ void terminal_visitor_t::operator()(const ql::reduce_wire_func_t &func) const {
     }
 }
 
+void terminal_visitor_t::operator()(const ql::topk_wire_func_t &func) const {
+    rget_read_response_t::stream_t *heap = boost::get<rget_read_response_t::stream_t>(out);
+    guarantee(heap);
+    counted_t<const ql::datum_t> el = json.get();
+    topk_push(func,
+              rdb_protocol_details::rget_item_t(store_key_t(),
+                                                topk_sort_key(ql_env, func, el),
+                                                el),
+              heap);
+}
+
 void terminal_apply(ql::env_t *ql_env,
                     lazy_json_t json,
                     const rdb_protocol_details::terminal_variant_t *t,
@@ -225,6 +317,13 @@ public:
         *out = rget_read_response_t::empty_t();
     }
 
+    void operator()(const ql::topk_wire_func_t &f) const {
+        for (size_t i = 0; i < f.num_comparisons(); ++i) {
+            guarantee(f.compile_comparison(i).has());
+        }
+        *out = rget_read_response_t::stream_t();
+    }
+
 private:
     rget_read_response_t::result_t *out;
 };
@@ -234,6 +333,75 @@ void terminal_initialize(const rdb_protocol_details::terminal_variant_t *t,
     boost::apply_visitor(terminal_initializer_visitor_t(out), *t);
 }
 
+counted_t<const ql::datum_t> topk_sort_key(ql::env_t *ql_env,
+                                           const ql::topk_wire_func_t &topk,
+                                           counted_t<const ql::datum_t> d) {
+    ql::datum_ptr_t key(ql::datum_t::R_ARRAY);
+    for (size_t i = 0; i < topk.num_comparisons(); ++i) {
+        ql::datum_ptr_t val(ql::datum_t::R_ARRAY);
+        try {
+            val.add(topk.compile_comparison(i)->call(ql_env, d)->as_datum());
+        } catch (const ql::base_exc_t &e) {
+            if (e.get_type() != ql::base_exc_t::NON_EXISTENCE) {
+                throw;
+            }
+        }
+        key.add(val.to_counted());
+    }
+    return key.to_counted();
+}
+
+/* Orders items by their `topk_sort_key`, the way `order_by` orders their
+ * elements. */
+class topk_less_t {
+public:
+    explicit topk_less_t(const ql::topk_wire_func_t *_topk) : topk(_topk) { }
+
+    bool operator()(const rdb_protocol_details::rget_item_t &l,
+                    const rdb_protocol_details::rget_item_t &r) const {
+        for (size_t i = 0; i < topk->num_comparisons(); ++i) {
+            counted_t<const ql::datum_t> lval = (*l.sindex_key)->get(i);
+            counted_t<const ql::datum_t> rval = (*r.sindex_key)->get(i);
+            if (*lval == *rval) {
+                continue;
+            }
+            return (*lval < *rval) != (topk->get_direction(i) == ql::DESC);
+        }
+        return false;
+    }
+
+private:
+    const ql::topk_wire_func_t *topk;
+};
+
+void topk_push(const ql::topk_wire_func_t &topk,
+               const rdb_protocol_details::rget_item_t &item,
+               rget_read_response_t::stream_t *heap) {
+    if (topk.get_k() == 0) {
+        return;
+    }
+    topk_less_t less(&topk);
+    if (heap->size() < topk.get_k()) {
+        heap->push_back(item);
+        std::push_heap(heap->begin(), heap->end(), less);
+    } else if (less(item, heap->front())) {
+        std::pop_heap(heap->begin(), heap->end(), less);
+        heap->back() = item;
+        std::push_heap(heap->begin(), heap->end(), less);
+    }
+}
+
+counted_t<const ql::datum_t> topk_to_array(const ql::topk_wire_func_t &topk,
+                                           rget_read_response_t::stream_t *heap) {
+    std::sort_heap(heap->begin(), heap->end(), topk_less_t(&topk));
+    ql::datum_ptr_t arr(ql::datum_t::R_ARRAY);
+    for (auto it = heap->begin(); it != heap->end(); ++it) {
+        arr.add(it->data);
+    }
+    heap->clear();
+    return arr.to_counted();
+}
+
 
 
 }  // namespace query_language
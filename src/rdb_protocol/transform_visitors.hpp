@@ -3,6 +3,8 @@
 #define RDB_PROTOCOL_TRANSFORM_VISITORS_HPP_
 
 #include <list>
+#include <set>
+#include <string>
 
 #include "http/json.hpp"
 #include "rdb_protocol/env.hpp"
@@ -27,6 +29,11 @@ void transform_apply(ql::env_t *ql_env, counted_t<const ql::datum_t> json,
                      const rdb_protocol_details::transform_variant_t *t,
                      std::vector<counted_t<const ql::datum_t> > *out);
 
+// The top-level fields of an object that `transf` needs: the ones in `fields_out`
+// or, if `exclude_out` is set, the ones that aren't.
+void projection_fields(const projection_transform_t &transf,
+                       std::set<std::string> *fields_out, bool *exclude_out);
+
 // Sets the result type based on a terminal.
 void terminal_initialize(const rdb_protocol_details::terminal_variant_t *t,
                          rdb_protocol_t::rget_read_response_t::result_t *out);
@@ -35,6 +42,25 @@ void terminal_apply(ql::env_t *ql_env, lazy_json_t json,
                     const rdb_protocol_details::terminal_variant_t *t,
                     rdb_protocol_t::rget_read_response_t::result_t *out);
 
+// Computes what a `topk` sorts `d` by: an array with, for each comparison, an
+// array holding the value, or an empty one if the value is missing.  (Missing
+// values come first, like they do in `order_by`.)
+counted_t<const ql::datum_t> topk_sort_key(ql::env_t *ql_env,
+                                           const ql::topk_wire_func_t &topk,
+                                           counted_t<const ql::datum_t> d);
+
+// The first `k` elements of a `topk` are kept in a heap, whose first item is the
+// last of them.  The `sindex_key` of each item is its `topk_sort_key`.  This adds
+// `item` to the heap if it's one of the first `k`.
+void topk_push(const ql::topk_wire_func_t &topk,
+               const rdb_protocol_details::rget_item_t &item,
+               rdb_protocol_t::rget_read_response_t::stream_t *heap);
+
+// Empties the heap into an array, first element first.
+counted_t<const ql::datum_t> topk_to_array(
+    const ql::topk_wire_func_t &topk,
+    rdb_protocol_t::rget_read_response_t::stream_t *heap);
+
 }  // namespace query_language
 
 #endif  // RDB_PROTOCOL_TRANSFORM_VISITORS_HPP_
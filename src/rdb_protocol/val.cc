@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/val.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/meta_utils.hpp"
@@ -271,6 +273,47 @@ counted_t<const datum_t> table_t::get_row(env_t *env, counted_t<const datum_t> p
     return p_res->data;
 }
 
+std::vector<counted_t<const datum_t> > table_t::get_rows(
+        env_t *env, const std::vector<counted_t<const datum_t> > &pvals) {
+    std::vector<counted_t<const datum_t> > rows;
+    if (pvals.empty()) {
+        return rows;
+    }
+
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t((*it)->print_primary()));
+    }
+    std::vector<store_key_t> sorted_keys(keys);
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()),
+                      sorted_keys.end());
+
+    rdb_protocol_t::read_t read((rdb_protocol_t::batched_point_read_t(sorted_keys)));
+    rdb_protocol_t::read_response_t res;
+    if (use_outdated) {
+        access->get_namespace_if()->read_outdated(read, &res, env->interruptor);
+    } else {
+        access->get_namespace_if()->read(
+            read, &res, order_token_t::ignore, env->interruptor);
+    }
+    rdb_protocol_t::batched_point_read_response_t *b_res =
+        boost::get<rdb_protocol_t::batched_point_read_response_t>(&res.response);
+    r_sanity_check(b_res);
+
+    rows.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        auto row = b_res->data.find(*it);
+        if (row != b_res->data.end()) {
+            rows.push_back(row->second);
+        } else {
+            rows.push_back(make_counted<const datum_t>(datum_t::R_NULL));
+        }
+    }
+    return rows;
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         counted_t<const datum_t> value,
@@ -153,5 +153,20 @@ counted_t<func_t> gmr_wire_func_t::compile_reduce() const {
     return reduce.compile_wire_func();
 }
 
+topk_wire_func_t::topk_wire_func_t(
+    uint64_t _k,
+    const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons)
+    : k(_k) {
+    r_sanity_check(!comparisons.empty());
+    for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+        directions.push_back(it->first);
+        funcs.push_back(map_wire_func_t(it->second));
+    }
+}
+
+counted_t<func_t> topk_wire_func_t::compile_comparison(size_t i) const {
+    return funcs[i].compile_wire_func();
+}
+
 
 }  // namespace ql
@@ -5,6 +5,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "containers/uuid.hpp"
@@ -101,6 +102,36 @@ private:
     reduce_wire_func_t reduce;
 };
 
+enum order_direction_t { ASC, DESC };
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(order_direction_t, int8_t, ASC, DESC);
+
+// The first `k` elements of an `order_by`.  Each shard keeps only its own first `k`
+// (see `query_language::topk_push`), and the parser keeps the first `k` of those.
+class topk_wire_func_t {
+public:
+    topk_wire_func_t() : k(0) { }
+    topk_wire_func_t(
+        uint64_t _k,
+        const std::vector<std::pair<order_direction_t, counted_t<func_t> > > &comparisons);
+
+    uint64_t get_k() const { return k; }
+    size_t num_comparisons() const { return funcs.size(); }
+    order_direction_t get_direction(size_t i) const { return directions[i]; }
+    counted_t<func_t> compile_comparison(size_t i) const;
+
+    protob_t<const Backtrace> get_bt() const {
+        return funcs.front().get_bt();
+    }
+
+    RDB_MAKE_ME_SERIALIZABLE_3(k, directions, funcs);
+
+private:
+    uint64_t k;
+    std::vector<order_direction_t> directions;
+    std::vector<map_wire_func_t> funcs;
+};
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
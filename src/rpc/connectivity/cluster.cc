@@ -1,6 +1,11 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "rpc/connectivity/cluster.hpp"
 
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/optional.hpp>
 
@@ -10,7 +15,9 @@
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/pmap.hpp"
 #include "concurrency/semaphore.hpp"
+#include "config/args.hpp"
 #include "containers/archive/string_stream.hpp"
+#include "containers/archive/varint.hpp"
 #include "containers/object_buffer.hpp"
 #include "containers/uuid.hpp"
 #include "logger.hpp"
@@ -144,6 +151,8 @@ connectivity_cluster_t::run_t::connection_entry_t::connection_entry_t(run_t *p,
     pm_bytes_sent(secs_to_ticks(1), true),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection, uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    send_queue(c == NULL ? NULL : new cluster_send_queue_t(c, p->parent->send_batching,
+                                                           &pm_collection)),
     parent(p), peer(id),
     entries(new one_per_thread_t<entry_installation_t>(this)) {
     if (peer != parent->parent->me && parent->heartbeat_manager != NULL) {
@@ -156,12 +165,15 @@ connectivity_cluster_t::run_t::connection_entry_t::~connection_entry_t() THROWS_
         parent->heartbeat_manager->end_peer_heartbeat(peer);
     }
 
-    // Delete entries early just so we can make the assertion below.
-    entries.reset();
+    /* Stop writing before we wait for senders to go away, so that nobody is
+    stuck waiting for space in the send queue. */
+    if (send_queue.has()) {
+        send_queue->shutdown();
+    }
 
-    /* `~entry_installation_t` destroys the `auto_drainer_t`'s in entries,
-    so nothing can be holding the `send_mutex`. */
-    guarantee(!send_mutex.is_locked());
+    /* `~entry_installation_t` destroys the `auto_drainer_t`'s in entries, so
+    once this returns nobody can be pushing onto `send_queue`. */
+    entries.reset();
 }
 
 static void ping_connection_watcher(peer_id_t peer, peers_list_callback_t *connect_disconnect_cb) THROWS_NOTHING {
@@ -364,11 +376,9 @@ private:
     DISABLE_COPYING(heartbeat_keepalive_t);
 };
 
-// Error-handling helper for connectivity_cluster_t::run_t::handle(). Returns true if handle()
+// Error-handling helpers for connectivity_cluster_t::run_t::handle(). Return true if handle()
 // should return.
-template<typename T>
-static bool deserialize_and_check(tcp_conn_stream_t *c, T *p, const char *peer) {
-    archive_result_t res = deserialize(c, p);
+static bool check_archive_result(archive_result_t res, const char *peer) {
     switch (res) {
       case ARCHIVE_SUCCESS: return false; // no problem.
 
@@ -385,6 +395,54 @@ static bool deserialize_and_check(tcp_conn_stream_t *c, T *p, const char *peer)
     }
 }
 
+template<typename T>
+static bool deserialize_and_check(tcp_conn_stream_t *c, T *p, const char *peer) {
+    return check_archive_result(deserialize(c, p), peer);
+}
+
+/* Messages go over the wire as frames: a varint length followed by that many
+bytes. That's the same encoding as a serialized `std::string`, which is what we
+used to send, so it doesn't change the protocol. `cluster_send_queue_t` writes
+them. */
+
+// Reads a frame into `*frame`. `*frame` is a per-connection buffer that keeps
+// its capacity from one message to the next, so we usually don't allocate and
+// the bytes are copied only once, straight from the socket. Frames larger than
+// CLUSTER_MAX_MESSAGE_SIZE are refused before anything gets allocated for them.
+static archive_result_t receive_message_frame(tcp_conn_stream_t *conn, std::string *frame) {
+    uint64_t size;
+    archive_result_t res = deserialize_varint_uint64(conn, &size);
+    if (res) { return res; }
+
+    if (size > static_cast<uint64_t>(CLUSTER_MAX_MESSAGE_SIZE)) {
+        return ARCHIVE_RANGE_ERROR;
+    }
+
+    frame->resize(size);
+    if (size == 0) {
+        return ARCHIVE_SUCCESS;
+    }
+    int64_t num_read = force_read(conn, &(*frame)[0], size);
+    if (num_read == -1) {
+        return ARCHIVE_SOCK_ERROR;
+    }
+    if (static_cast<uint64_t>(num_read) < size) {
+        return ARCHIVE_SOCK_EOF;
+    }
+    return ARCHIVE_SUCCESS;
+}
+
+// Flattens `msg` into a string, for messages we send to ourself.
+static std::string write_message_to_string(write_message_t *msg) {
+    std::string ret;
+    ret.reserve(msg->size());
+    intrusive_list_t<write_buffer_t> *buffers = msg->unsafe_expose_buffers();
+    for (write_buffer_t *b = buffers->head(); b; b = buffers->next(b)) {
+        ret.append(b->data, b->size);
+    }
+    return ret;
+}
+
 // Reads a chunk of data off of the connection, buffer must have at least 'size' bytes
 //  available to write into
 static bool read_header_chunk(tcp_conn_stream_t *conn, char *buffer, int64_t size, const char *peer) {
@@ -784,17 +842,23 @@ void connectivity_cluster_t::run_t::handle(
         /* Main message-handling loop: read messages off the connection until
         it's closed, which may be due to network events, or the other end
         shutting down, or us shutting down. */
+        std::string frame;
         try {
             while (true) {
-                /* For now, we use `std::string` for messages on the wire: it's
-                just a length and a byte vector. This is obviously slow and we
-                should change it when we care about performance. */
-                std::string message;
-                if (deserialize_and_check(conn, &message, peername))
+                if (check_archive_result(receive_message_frame(conn, &frame), peername))
                     break;
 
-                string_read_stream_t stream(std::move(message), 0);
+                /* The handler reads the message in place. It may take the
+                buffer for itself (the mailbox manager does, to hand a message
+                to another thread); otherwise we get it back to reuse for the
+                next message. */
+                string_read_stream_t stream(std::move(frame), 0);
                 message_handler->on_message(other_id, &stream); // might raise fake_archive_exc_t
+                int64_t unused_offset = 0;
+                stream.swap(&frame, &unused_offset);
+                if (frame.capacity() > CLUSTER_RECEIVE_BUFFER_MAX_KEPT_BYTES) {
+                    std::string().swap(frame);
+                }
             }
         } catch (const fake_archive_exc_t &) {
             /* The exception broke us out of the loop, and that's what we
@@ -862,14 +926,15 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
 
     guarantee(!dest.is_nil());
 
-    /* We currently write the message to a vector_stream_t, then
-       serialize that as a string. It's horribly inefficient, of course. */
-    // TODO: If we don't do it this way, we (or the caller) will need
+    /* The callback serializes the message straight into a `write_message_t`,
+    and we send its buffers as they are. */
+    // TODO: If we don't serialize here, we (or the caller) will need
     // to worry about having the writer run on the connection thread.
-    string_stream_t buffer;
+    scoped_ptr_t<cluster_send_queue_t::message_t> message(new cluster_send_queue_t::message_t);
+    write_message_t *msg = &message->msg;
     {
         ASSERT_FINITE_CORO_WAITING;
-        callback->write(&buffer);
+        callback->write(msg);
     }
 
 #ifdef CLUSTER_MESSAGE_DEBUGGING
@@ -881,7 +946,8 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         debug_print(&buf, dest);
         buf.appendf("\n");
         fprintf(stderr, "%s", buf.c_str());
-        print_hd(buffer.str()->data(), 0, buffer.str()->size());
+        std::string contents = write_message_to_string(msg);
+        print_hd(contents.data(), 0, contents.size());
     }
 #endif
 
@@ -911,35 +977,19 @@ void connectivity_cluster_t::send_message(peer_id_t dest, send_message_write_cal
         conn_structure_lock = it->second.second;
     }
 
-    size_t bytes_sent = buffer.str().size();
+    size_t bytes_sent = msg->size();
 
     if (conn_structure->conn == NULL) {
         // We're sending a message to ourself
         guarantee(dest == me);
         // We could be on any thread here! Oh no!
-        string_read_stream_t read_stream(std::move(buffer.str()), 0);
+        string_read_stream_t read_stream(write_message_to_string(msg), 0);
         current_run->message_handler->on_message(me, &read_stream);
     } else {
         guarantee(dest != me);
-        on_thread_t threader(conn_structure->conn->home_thread());
-
-        /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
-        mutex_t::acq_t acq(&conn_structure->send_mutex);
-
-        {
-            write_message_t msg;
-            msg << buffer.str();
-            int res = send_write_message(conn_structure->conn, &msg);
-            if (res) {
-                /* Close the other half of the connection to make sure that
-                   `connectivity_cluster_t::run_t::handle()` notices that something is
-                   up */
-                if (conn_structure->conn->is_read_open()) {
-                    conn_structure->conn->shutdown_read();
-                }
-            }
-        }
+        /* The connection's writer coroutine sends it, together with whatever
+        else is queued for this peer. */
+        conn_structure->send_queue->push(message.release(), conn_structure_lock);
     }
 
     conn_structure->pm_bytes_sent.record(bytes_sent);
@@ -976,6 +1026,11 @@ peer_address_t connectivity_cluster_t::get_peer_address(peer_id_t p) THROWS_NOTH
     return peer_address_t(it->second.first->address);
 }
 
+void connectivity_cluster_t::set_send_batching(const cluster_send_batching_t &batching) THROWS_NOTHING {
+    assert_thread();
+    send_batching = batching;
+}
+
 rwi_lock_assertion_t *connectivity_cluster_t::get_peers_list_lock() THROWS_NOTHING {
     return &thread_info.get()->lock;
 }
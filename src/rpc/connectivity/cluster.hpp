@@ -18,6 +18,7 @@
 #include "rpc/connectivity/connectivity.hpp"
 #include "rpc/connectivity/messages.hpp"
 #include "rpc/connectivity/heartbeat.hpp"
+#include "rpc/connectivity/send_queue.hpp"
 #include "containers/uuid.hpp"
 
 namespace boost {
@@ -105,15 +106,16 @@ public:
             cross-thread to access the routing table. */
             peer_address_t address;
 
-            /* Unused for our connection to ourself */
-            mutex_t send_mutex;
-
             uuid_u session_id;
 
             perfmon_collection_t pm_collection;
             perfmon_sampler_t pm_bytes_sent;
             perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
 
+            /* NULL for our connection to ourself. It must be ready before
+            `entries` makes us visible to senders. */
+            scoped_ptr_t<cluster_send_queue_t> send_queue;
+
         private:
             /* We only hold this information so we can deregister ourself */
             run_t *parent;
@@ -259,6 +261,11 @@ public:
     peer's hostnames (if any) */
     peer_address_t get_peer_address(peer_id_t) THROWS_NOTHING;
 
+    /* Changes how outgoing messages are coalesced on connections that are
+    established from now on. `serve()` sets it from the --cluster-flush-delay and
+    --cluster-flush-bytes options. */
+    void set_send_batching(const cluster_send_batching_t &batching) THROWS_NOTHING;
+
 private:
     friend class run_t;
 
@@ -293,6 +300,8 @@ private:
 
     run_t *current_run;
 
+    cluster_send_batching_t send_batching;
+
     perfmon_collection_t connectivity_collection;
     perfmon_membership_t stats_membership;
 
@@ -45,7 +45,7 @@ private:
 
     class heartbeat_writer_t : public send_message_write_callback_t {
     public:
-        void write(UNUSED write_stream_t *stream) { }
+        void write(UNUSED write_message_t *msg) { }
     };
 
     struct per_thread_data_t {
@@ -4,7 +4,7 @@
 
 class connectivity_service_t;
 class peer_id_t;
-class write_stream_t;
+class write_message_t;
 
 #include "containers/archive/string_stream.hpp"
 
@@ -49,7 +49,7 @@ destructor is called. */
 class send_message_write_callback_t {
 public:
     virtual ~send_message_write_callback_t() { }
-    virtual void write(write_stream_t *stream) = 0;
+    virtual void write(write_message_t *msg) = 0;
 };
 
 class message_service_t  {
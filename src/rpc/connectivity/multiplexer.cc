@@ -72,12 +72,9 @@ public:
         tag(_tag), subwriter(_subwriter) { }
     virtual ~tagged_message_writer_t() { }
 
-    void write(write_stream_t *os) {
-        write_message_t msg;
-        msg << tag;
-        int res = send_write_message(os, &msg);
-        if (res) { throw fake_archive_exc_t(); }
-        subwriter->write(os);
+    void write(write_message_t *msg) {
+        *msg << tag;
+        subwriter->write(msg);
     }
 
 private:
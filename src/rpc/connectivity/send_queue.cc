@@ -0,0 +1,211 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include "rpc/connectivity/send_queue.hpp"
+
+#include <sys/uio.h>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/archive/tcp_conn_stream.hpp"
+#include "containers/archive/varint.hpp"
+#include "containers/scoped.hpp"
+
+cluster_send_queue_t::cluster_send_queue_t(tcp_conn_stream_t *_conn,
+                                           const cluster_send_batching_t &_batching,
+                                           perfmon_collection_t *stats_parent) :
+    conn(_conn),
+    batching(_batching),
+    incoming(NULL),
+    queued_bytes(0),
+    writer_wakeup(NULL),
+    is_shut_down(false),
+    pm_batch_messages(secs_to_ticks(1), false),
+    pm_batch_bytes(secs_to_ticks(1), false),
+    pm_queueing_delay(secs_to_ticks(1), false),
+    stats_membership(&stats,
+        &pm_batch_messages, "batch_messages",
+        &pm_batch_bytes, "batch_bytes",
+        &pm_queueing_delay, "queueing_delay",
+        NULL),
+    stats_collection_membership(stats_parent, &stats, "send_queue") {
+    guarantee(conn != NULL);
+    guarantee(conn->home_thread() == home_thread());
+    coro_t::spawn_sometime(boost::bind(&cluster_send_queue_t::writer_coroutine,
+                                       this, auto_drainer_t::lock_t(&drainer)));
+}
+
+cluster_send_queue_t::~cluster_send_queue_t() {
+    assert_thread();
+    /* The `auto_drainer_t` stops the writer coroutine, which throws away
+    anything that's still queued. */
+}
+
+void cluster_send_queue_t::push(message_t *message, auto_drainer_t::lock_t keepalive) {
+    message->size = message->msg.size();
+    message->enqueue_time = get_ticks();
+    const int64_t backlog = __atomic_add_fetch(&queued_bytes, message->size, __ATOMIC_RELAXED);
+
+    /* Once `message` is on the stack the writer may send and delete it at any
+    time, so we mustn't touch it after this. If the stack was empty, the writer
+    might be asleep; it's up to us to wake it. */
+    if (push_incoming(message)) {
+        coro_t::spawn_sometime(boost::bind(&cluster_send_queue_t::notify_writer,
+                                           this, keepalive));
+    }
+
+    if (backlog > batching.max_queued_bytes) {
+        on_thread_t thread_switcher(home_thread());
+        wait_for_space();
+    }
+}
+
+void cluster_send_queue_t::shutdown() {
+    assert_thread();
+    is_shut_down = true;
+    if (conn->is_write_open()) {
+        conn->shutdown_write();
+    }
+    release_space_waiters();
+}
+
+bool cluster_send_queue_t::push_incoming(message_t *message) {
+    message_t *head = __atomic_load_n(&incoming, __ATOMIC_RELAXED);
+    do {
+        message->next = head;
+    } while (!__atomic_compare_exchange_n(&incoming, &head, message, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return head == NULL;
+}
+
+cluster_send_queue_t::message_t *cluster_send_queue_t::take_incoming() {
+    message_t *newest_first = __atomic_exchange_n(&incoming, static_cast<message_t *>(NULL),
+                                                  __ATOMIC_ACQUIRE);
+    message_t *oldest_first = NULL;
+    while (newest_first != NULL) {
+        message_t *next = newest_first->next;
+        newest_first->next = oldest_first;
+        oldest_first = newest_first;
+        newest_first = next;
+    }
+    return oldest_first;
+}
+
+// `keepalive` belongs to the pushing thread; it's released after we switch back.
+void cluster_send_queue_t::notify_writer(UNUSED auto_drainer_t::lock_t keepalive) {
+    on_thread_t thread_switcher(home_thread());
+    if (writer_wakeup != NULL) {
+        writer_wakeup->pulse_if_not_already_pulsed();
+    }
+}
+
+void cluster_send_queue_t::wait_for_space() {
+    assert_thread();
+    while (!is_shut_down
+           && __atomic_load_n(&queued_bytes, __ATOMIC_RELAXED) > batching.max_queued_bytes) {
+        cond_t space;
+        space_waiters.push_back(&space);
+        space.wait_lazily_unordered();
+    }
+}
+
+void cluster_send_queue_t::release_space_waiters() {
+    assert_thread();
+    std::vector<cond_t *> waiters;
+    waiters.swap(space_waiters);
+    for (size_t i = 0; i < waiters.size(); ++i) {
+        waiters[i]->pulse();
+    }
+}
+
+void cluster_send_queue_t::writer_coroutine(auto_drainer_t::lock_t keepalive) {
+    assert_thread();
+    try {
+        for (;;) {
+            if (__atomic_load_n(&incoming, __ATOMIC_ACQUIRE) == NULL) {
+                cond_t wakeup;
+                assignment_sentry_t<cond_t *> wakeup_sentry(&writer_wakeup, &wakeup);
+                wait_interruptible(&wakeup, keepalive.get_drain_signal());
+                continue;
+            }
+
+            /* Give more messages a chance to pile up, unless we already have
+            enough for a decent-sized write. */
+            if (batching.flush_delay_ms > 0
+                && __atomic_load_n(&queued_bytes, __ATOMIC_RELAXED) < batching.flush_bytes) {
+                nap(batching.flush_delay_ms, keepalive.get_drain_signal());
+            }
+
+            send_batch(take_incoming());
+            release_space_waiters();
+        }
+    } catch (const interrupted_exc_t &) {
+        /* We're being destroyed. Nobody can push any more, because the
+        connection entry that owns us has already drained its senders. */
+    }
+
+    message_t *leftover = take_incoming();
+    while (leftover != NULL) {
+        message_t *next = leftover->next;
+        delete leftover;
+        leftover = next;
+    }
+}
+
+void cluster_send_queue_t::send_batch(message_t *batch) {
+    assert_thread();
+
+    /* Each message goes out as a frame: its length as a varint, then its
+    buffers. We hand all of the frames to the kernel in a single `writev()`. */
+    const ticks_t now = get_ticks();
+    int64_t num_messages = 0;
+    int64_t num_bytes = 0;
+    size_t num_buffers = 0;
+    for (message_t *m = batch; m != NULL; m = m->next) {
+        ++num_messages;
+        num_bytes += m->size;
+        num_buffers += m->msg.unsafe_expose_buffers()->size();
+        pm_queueing_delay.record(ticks_to_secs(now - m->enqueue_time));
+    }
+
+    scoped_array_t<uint8_t> headers(num_messages * MAX_VARINT_UINT64_SIZE);
+    std::vector<iovec> iov;
+    iov.reserve(num_messages + num_buffers);
+    int64_t i = 0;
+    for (message_t *m = batch; m != NULL; m = m->next, ++i) {
+        uint8_t *header = headers.data() + i * MAX_VARINT_UINT64_SIZE;
+        iovec header_iov;
+        header_iov.iov_base = header;
+        header_iov.iov_len = serialize_varint_uint64_into_buf(m->size, header);
+        iov.push_back(header_iov);
+
+        intrusive_list_t<write_buffer_t> *buffers = m->msg.unsafe_expose_buffers();
+        for (write_buffer_t *b = buffers->head(); b != NULL; b = buffers->next(b)) {
+            iovec buffer_iov;
+            buffer_iov.iov_base = b->data;
+            buffer_iov.iov_len = b->size;
+            iov.push_back(buffer_iov);
+        }
+    }
+
+    if (conn->writev(iov.data(), iov.size()) == -1) {
+        /* Close the other half of the connection to make sure that
+        `connectivity_cluster_t::run_t::handle()` notices that something is
+        up */
+        if (conn->is_read_open()) {
+            conn->shutdown_read();
+        }
+    }
+
+    pm_batch_messages.record(num_messages);
+    pm_batch_bytes.record(num_bytes);
+
+    while (batch != NULL) {
+        message_t *next = batch->next;
+        delete batch;
+        batch = next;
+    }
+    __atomic_sub_fetch(&queued_bytes, num_bytes, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,118 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef RPC_CONNECTIVITY_SEND_QUEUE_HPP_
+#define RPC_CONNECTIVITY_SEND_QUEUE_HPP_
+
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "config/args.hpp"
+#include "containers/archive/archive.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+class tcp_conn_stream_t;
+
+/* Controls how `cluster_send_queue_t` coalesces messages. By default, the
+writer sends whatever has queued up as soon as its previous write is done, so
+there's no added latency. A nonzero `flush_delay_ms` makes it wait up to that
+long for more messages to arrive, unless at least `flush_bytes` are already
+waiting. */
+struct cluster_send_batching_t {
+    cluster_send_batching_t() :
+        flush_delay_ms(DEFAULT_CLUSTER_SEND_FLUSH_DELAY_MS),
+        flush_bytes(DEFAULT_CLUSTER_SEND_FLUSH_BYTES),
+        max_queued_bytes(CLUSTER_SEND_QUEUE_MAX_BYTES) { }
+
+    int64_t flush_delay_ms;
+    int64_t flush_bytes;
+
+    // Senders block once this many bytes are waiting to go out.
+    int64_t max_queued_bytes;
+};
+
+/* `cluster_send_queue_t` is the outgoing half of a cluster connection. Any
+thread can push messages onto it without switching to the connection's thread
+or taking a lock; a single writer coroutine on the connection's thread takes
+everything that has queued up and writes it to the socket with one `writev()`.
+Under heavy fan-out (a broadcaster sending every write to all of its replicas)
+this turns one syscall and two thread switches per message into one syscall per
+batch.
+
+Messages pushed from the same thread are sent in the order they were pushed. */
+
+class cluster_send_queue_t : public home_thread_mixin_t {
+public:
+    class message_t {
+    public:
+        message_t() : size(0), enqueue_time(0), next(NULL) { }
+
+        // The caller serializes the message into this before pushing it.
+        write_message_t msg;
+
+    private:
+        friend class cluster_send_queue_t;
+        int64_t size;
+        ticks_t enqueue_time;
+        message_t *next;
+
+        DISABLE_COPYING(message_t);
+    };
+
+    // Must be constructed on the connection's thread.
+    cluster_send_queue_t(tcp_conn_stream_t *conn,
+                         const cluster_send_batching_t &batching,
+                         perfmon_collection_t *stats_parent);
+    ~cluster_send_queue_t();
+
+    /* Takes ownership of `message` and queues it to be sent. May be called on
+    any thread; `keepalive` must be a lock that keeps the queue alive on the
+    calling thread. Usually returns without blocking, but if more than
+    `max_queued_bytes` are waiting to be sent it blocks until the writer catches
+    up. */
+    void push(message_t *message, auto_drainer_t::lock_t keepalive);
+
+    /* Called when the connection is going away. Shuts down the write half of the
+    connection, so anything still queued or pushed from now on is dropped, and
+    releases any senders that are waiting for space. */
+    void shutdown();
+
+private:
+    // Pushes onto `incoming`; returns true if it was empty before.
+    bool push_incoming(message_t *message);
+    // Takes everything in `incoming`, oldest first.
+    message_t *take_incoming();
+
+    void notify_writer(auto_drainer_t::lock_t keepalive);
+    void wait_for_space();
+
+    void writer_coroutine(auto_drainer_t::lock_t keepalive);
+    void send_batch(message_t *batch);
+    void release_space_waiters();
+
+    tcp_conn_stream_t *conn;
+    const cluster_send_batching_t batching;
+
+    /* A lock-free stack of messages that have been pushed but not yet taken by
+    the writer, newest first. Accessed from any thread with atomic operations. */
+    message_t *incoming;
+
+    // The number of bytes pushed but not yet written; also updated atomically.
+    int64_t queued_bytes;
+
+    // These are only touched on the connection's thread.
+    cond_t *writer_wakeup;
+    std::vector<cond_t *> space_waiters;
+    bool is_shut_down;
+
+    perfmon_collection_t stats;
+    perfmon_sampler_t pm_batch_messages, pm_batch_bytes, pm_queueing_delay;
+    perfmon_multi_membership_t stats_membership;
+    perfmon_membership_t stats_collection_membership;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(cluster_send_queue_t);
+};
+
+#endif  // RPC_CONNECTIVITY_SEND_QUEUE_HPP_
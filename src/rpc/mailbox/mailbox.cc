@@ -60,16 +60,10 @@ public:
         dest_thread(_dest_thread), dest_mailbox_id(_dest_mailbox_id), subwriter(_subwriter) { }
     virtual ~raw_mailbox_writer_t() { }
 
-    void write(write_stream_t *stream) {
-        write_message_t msg;
-        msg << dest_thread;
-        msg << dest_mailbox_id;
-
-        // TODO: Maybe pass write_message_t to writer... eventually.
-        int res = send_write_message(stream, &msg);
-        if (res) { throw fake_archive_exc_t(); }
-
-        subwriter->write(stream);
+    void write(write_message_t *msg) {
+        *msg << dest_thread;
+        *msg << dest_mailbox_id;
+        subwriter->write(msg);
     }
 private:
     int32_t dest_thread;
@@ -84,27 +78,70 @@ void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest, mailbox_write_c
     src->message_service->send_message(dest.peer, &writer);
 }
 
-mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
-    message_service(ms)
-    { }
+/* mailbox_table_t */
+
+const uint32_t mailbox_table_t::NO_FREE_SLOT = UINT32_MAX;
 
-mailbox_manager_t::mailbox_table_t::mailbox_table_t() {
-    next_mailbox_id = (UINT64_MAX / get_num_threads()) * get_thread_id().threadnum;
+mailbox_table_t::mailbox_table_t() :
+    first_free(NO_FREE_SLOT), num_free(0) { }
+
+mailbox_table_t::~mailbox_table_t() {
+    guarantee(size() == 0, "Please destroy all mailboxes before destroying the cluster");
+}
+
+raw_mailbox_t::id_t mailbox_table_t::register_mailbox(raw_mailbox_t *mb) {
+    guarantee(mb != NULL);
+    uint32_t index;
+    if (first_free != NO_FREE_SLOT) {
+        index = first_free;
+        first_free = slots[index].next_free;
+        --num_free;
+    } else {
+        guarantee(slots.size() < NO_FREE_SLOT, "Too many mailboxes on one thread");
+        index = slots.size();
+        slot_t slot;
+        slot.generation = 1;
+        slots.push_back(slot);
+    }
+    slot_t *slot = &slots[index];
+    slot->mailbox = mb;
+    slot->next_free = NO_FREE_SLOT;
+    return (static_cast<raw_mailbox_t::id_t>(slot->generation) << 32) | index;
 }
 
-mailbox_manager_t::mailbox_table_t::~mailbox_table_t() {
-    guarantee(mailboxes.empty(), "Please destroy all mailboxes before destroying the cluster");
+void mailbox_table_t::unregister_mailbox(raw_mailbox_t::id_t id) {
+    const uint32_t index = id_index(id);
+    guarantee(index < slots.size());
+    slot_t *slot = &slots[index];
+    guarantee(slot->mailbox != NULL && slot->generation == id_generation(id));
+    slot->mailbox = NULL;
+    // Skip generation 0 when wrapping around, so that no ID is ever 0.
+    if (++slot->generation == 0) {
+        slot->generation = 1;
+    }
+    slot->next_free = first_free;
+    first_free = index;
+    ++num_free;
 }
 
-raw_mailbox_t *mailbox_manager_t::mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) {
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator it = mailboxes.find(id);
-    if (it == mailboxes.end()) {
+raw_mailbox_t *mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) const {
+    const uint32_t index = id_index(id);
+    if (index >= slots.size()) {
+        return NULL;
+    }
+    const slot_t &slot = slots[index];
+    if (slot.generation != id_generation(id)) {
         return NULL;
-    } else {
-        return it->second;
     }
+    return slot.mailbox;
 }
 
+/* mailbox_manager_t */
+
+mailbox_manager_t::mailbox_manager_t(message_service_t *ms) :
+    message_service(ms)
+    { }
+
 void mailbox_manager_t::on_message(UNUSED peer_id_t source_peer, string_read_stream_t *stream) {
     int32_t dest_thread;
     raw_mailbox_t::id_t dest_mailbox_id;
@@ -127,6 +164,16 @@ void mailbox_manager_t::on_message(UNUSED peer_id_t source_peer, string_read_str
 void mailbox_manager_t::mailbox_read_coroutine(threadnum_t dest_thread,
                                                raw_mailbox_t::id_t dest_mailbox_id,
                                                string_read_stream_t *stream) {
+    if (dest_thread == get_thread_id()) {
+        // `read` is done with the stream by the time it can block, so we can read
+        // the message in place and leave the buffer to the connection.
+        raw_mailbox_t *mbox = mailbox_tables.get()->find_mailbox(dest_mailbox_id);
+        if (mbox != NULL) {
+            mbox->callback->read(stream);
+        }
+        return;
+    }
+
     // Take the string from the read stream, so it can be deallocated in the caller
     std::string stream_data;
     int64_t data_offset = 0;
@@ -143,22 +190,11 @@ void mailbox_manager_t::mailbox_read_coroutine(threadnum_t dest_thread,
     }
 }
 
-raw_mailbox_t::id_t mailbox_manager_t::generate_mailbox_id() {
-    raw_mailbox_t::id_t id = ++mailbox_tables.get()->next_mailbox_id;
-    return id;
-}
-
 raw_mailbox_t::id_t mailbox_manager_t::register_mailbox(raw_mailbox_t *mb) {
-    raw_mailbox_t::id_t id = generate_mailbox_id();
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *> *mailboxes = &mailbox_tables.get()->mailboxes;
-    std::pair<std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator, bool> res
-        = mailboxes->insert(std::make_pair(id, mb));
-    guarantee(res.second);  // Assert a new element was inserted.
-    return id;
+    return mailbox_tables.get()->register_mailbox(mb);
 }
 
 void mailbox_manager_t::unregister_mailbox(raw_mailbox_t::id_t id) {
-    size_t num_elements_erased = mailbox_tables.get()->mailboxes.erase(id);
-    guarantee(num_elements_erased == 1);
+    mailbox_tables.get()->unregister_mailbox(id);
 }
 
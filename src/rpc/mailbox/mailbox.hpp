@@ -2,8 +2,8 @@
 #ifndef RPC_MAILBOX_MAILBOX_HPP_
 #define RPC_MAILBOX_MAILBOX_HPP_
 
-#include <map>
 #include <string>
+#include <vector>
 
 #include "containers/archive/archive.hpp"
 #include "rpc/connectivity/cluster.hpp"
@@ -17,13 +17,15 @@ to handle messages it receives. To send messages to the mailbox, call the
 class mailbox_write_callback_t {
 public:
     virtual ~mailbox_write_callback_t() { }
-    virtual void write(write_stream_t *stream) = 0;
+    virtual void write(write_message_t *msg) = 0;
 };
 
 class mailbox_read_callback_t {
 public:
     virtual ~mailbox_read_callback_t() { }
 
+    // Has to be done with `stream` before it blocks; the connection reuses the
+    // stream's buffer for the next message as soon as it gets control back.
     virtual void read(read_stream_t *stream) = 0;
 };
 
@@ -97,6 +99,54 @@ void send(mailbox_manager_t *src,
           raw_mailbox_t::address_t dest,
           mailbox_write_callback_t *callback);
 
+/* `mailbox_table_t` maps mailbox IDs to the mailboxes on one thread. Mailboxes
+live in a flat array of slots, and a mailbox's ID is its slot index in the low
+32 bits and the slot's generation in the high 32 bits. Registering, looking up
+and unregistering a mailbox are all constant-time and, once the array has grown
+to the peak number of mailboxes, don't allocate.
+
+The generation is bumped every time a slot is freed, so a message addressed to a
+mailbox that has been destroyed won't be delivered to a newer mailbox that
+reuses its slot. Generations start at 1, so no valid ID is ever 0. */
+
+class mailbox_table_t {
+public:
+    mailbox_table_t();
+    ~mailbox_table_t();
+
+    raw_mailbox_t::id_t register_mailbox(raw_mailbox_t *mb);
+    void unregister_mailbox(raw_mailbox_t::id_t id);
+
+    // Returns NULL if there is no such mailbox (any more).
+    raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t id) const;
+
+    size_t size() const { return slots.size() - num_free; }
+
+private:
+    static const uint32_t NO_FREE_SLOT;
+
+    static uint32_t id_index(raw_mailbox_t::id_t id) {
+        return static_cast<uint32_t>(id);
+    }
+    static uint32_t id_generation(raw_mailbox_t::id_t id) {
+        return static_cast<uint32_t>(id >> 32);
+    }
+
+    struct slot_t {
+        // NULL if the slot is free
+        raw_mailbox_t *mailbox;
+        uint32_t generation;
+        // If the slot is free, the index of the next free slot.
+        uint32_t next_free;
+    };
+
+    std::vector<slot_t> slots;
+    uint32_t first_free;
+    size_t num_free;
+
+    DISABLE_COPYING(mailbox_table_t);
+};
+
 /* `mailbox_manager_t` uses a `message_service_t` to provide mailbox capability.
 Usually you will split a `message_service_t` into several sub-services using
 `message_multiplexer_t` and put a `mailbox_manager_t` on only one of them,
@@ -118,22 +168,12 @@ private:
 
     message_service_t *message_service;
 
-    struct mailbox_table_t {
-        mailbox_table_t();
-        ~mailbox_table_t();
-        raw_mailbox_t::id_t next_mailbox_id;
-        // TODO: use a buffered structure to reduce dynamic allocation
-        std::map<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
-        raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t);
-    };
     one_per_thread_t<mailbox_table_t> mailbox_tables;
 
-    raw_mailbox_t::id_t generate_mailbox_id();
-
     raw_mailbox_t::id_t register_mailbox(raw_mailbox_t *mb);
     void unregister_mailbox(raw_mailbox_t::id_t id);
 
-    static void write_mailbox_message(write_stream_t *stream,
+    static void write_mailbox_message(write_message_t *msg,
                                       threadnum_t dest_thread,
                                       raw_mailbox_t::id_t dest_mailbox_id,
                                       mailbox_write_callback_t *callback);
@@ -5,9 +5,20 @@
 #include <string>
 
 #include "config/args.hpp"
+#include "containers/archive/archive.hpp"
 #include "serializer/types.hpp"
 #include "rpc/serialize_macros.hpp"
 
+/* How data blocks written for index writes are stored on disk. Blocks that were
+written compressed can be read whatever this is set to. */
+enum block_compression_t {
+    BLOCK_COMPRESSION_NONE = 0,
+    BLOCK_COMPRESSION_LZ4
+};
+
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(block_compression_t, int8_t,
+                                      BLOCK_COMPRESSION_NONE, BLOCK_COMPRESSION_LZ4);
+
 /* Configuration for the serializer that can change from run to run */
 
 struct log_serializer_dynamic_config_t {
@@ -16,6 +27,9 @@ struct log_serializer_dynamic_config_t {
         gc_high_ratio = DEFAULT_GC_HIGH_RATIO;
         read_ahead = true;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        group_commit_window_ms = DEFAULT_GROUP_COMMIT_WINDOW_MS;
+        group_commit_max_writes = DEFAULT_GROUP_COMMIT_MAX_WRITES;
+        block_compression = BLOCK_COMPRESSION_NONE;
     }
 
     /* When the proportion of garbage blocks hits gc_high_ratio, then the serializer will collect
@@ -30,7 +44,20 @@ struct log_serializer_dynamic_config_t {
     /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
     bool read_ahead;
 
-    RDB_MAKE_ME_SERIALIZABLE_4(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead);
+    /* Index writes are committed in groups that share a single LBA sync and metablock
+    write. A group takes in every index write that arrives while the previous group's
+    metablock is being written, and at least those that arrive in the first
+    group_commit_window_ms milliseconds, but never more than group_commit_max_writes. */
+    int32_t group_commit_window_ms;
+    int32_t group_commit_max_writes;
+
+    /* A block is only stored compressed if that saves at least one DEVICE_BLOCK_SIZE
+    of disk space; the cache always sees it uncompressed. */
+    block_compression_t block_compression;
+
+    RDB_MAKE_ME_SERIALIZABLE_7(gc_low_ratio, gc_high_ratio, io_batch_factor, read_ahead,
+                               group_commit_window_ms, group_commit_max_writes,
+                               block_compression);
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
@@ -5,6 +5,9 @@
 
 #include <inttypes.h>
 #include <sys/uio.h>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
@@ -20,12 +23,15 @@
 const int64_t APPROXIMATE_READ_AHEAD_SIZE = 32 * DEFAULT_BTREE_BLOCK_SIZE;
 
 // Identifies an extent, the time we started writing to the
-// extent, whether it's the extent we're currently writing to, and
-// describes blocks are garbage.
+// extent, whether it's the extent we're currently writing to, its
+// temperature, and describes blocks are garbage.
 class gc_entry_t : public intrusive_list_node_t<gc_entry_t> {
 private:
     struct block_info_t {
         uint32_t relative_offset;
+        // The size of the block on disk, and the size it has in its tokens and the
+        // LBA, which is bigger if it's compressed.
+        block_size_t disk_block_size;
         block_size_t block_size;
         bool token_referenced;
         bool index_referenced;
@@ -33,10 +39,13 @@ private:
 
 public:
     /* This constructor is for starting a new active extent. */
-    explicit gc_entry_t(data_block_manager_t *_parent)
+    gc_entry_t(data_block_manager_t *_parent, block_temperature_t _temperature)
         : parent(_parent),
           extent_ref(parent->extent_manager->gen_extent()),
           timestamp(current_microtime()),
+          data_timestamp(0),
+          temperature(_temperature),
+          gc_benefit(0),
           was_written(false),
           state(state_active),
           extent_offset(extent_ref.offset()) {
@@ -44,11 +53,15 @@ public:
     }
 
     /* This constructor is for reconstructing extents that the LBA tells us contained
-       data blocks. */
+       data blocks. We don't know how old their data is, only that it has survived a
+       restart, so we treat it as cold and as old as it can be. */
     gc_entry_t(data_block_manager_t *_parent, int64_t _offset)
         : parent(_parent),
           extent_ref(parent->extent_manager->reserve_extent(_offset)),
           timestamp(current_microtime()),
+          data_timestamp(0),
+          temperature(block_temperature_cold),
+          gc_benefit(0),
           was_written(false),
           state(state_reconstructing),
           extent_offset(extent_ref.offset()) {
@@ -87,11 +100,18 @@ public:
         return block_infos.empty()
             ? 0
             : block_infos.back().relative_offset
-            + aligned_value(block_infos.back().block_size);
+            + aligned_value(block_infos.back().disk_block_size);
     }
 
-    // Returns the ostensible size of the block_index'th block.  Note that
-    // block_boundaries[i] + block_size(i) <= block_boundaries[i + 1].
+    // Returns the ostensible size of the block_index'th block on disk.  Note that
+    // block_boundaries[i] + disk_block_size(i) <= block_boundaries[i + 1].
+    block_size_t disk_block_size(unsigned int block_index) const {
+        guarantee(state != state_reconstructing);
+        guarantee(block_index < block_infos.size());
+        return block_infos[block_index].disk_block_size;
+    }
+
+    // Returns the size of the block_index'th block once it's decompressed.
     block_size_t block_size(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(block_index < block_infos.size());
@@ -117,22 +137,24 @@ public:
     }
 
     bool new_offset(block_size_t block_size,
+                    block_size_t disk_block_size,
                     uint32_t *relative_offset_out,
                     unsigned int *block_index_out) {
         // Returns true if there's enough room at the end of the extent for the new
         // block.
         guarantee(state == state_active);
-        guarantee(block_size.ser_value() <= parent->static_config->extent_size());
+        guarantee(disk_block_size.ser_value() <= parent->static_config->extent_size());
 
         uint32_t offset = back_relative_offset();
         guarantee(offset <= parent->static_config->extent_size());
 
-        if (offset > parent->static_config->extent_size() - block_size.ser_value()) {
+        if (offset > parent->static_config->extent_size() - disk_block_size.ser_value()) {
             return false;
         } else {
             *relative_offset_out = offset;
             *block_index_out = block_infos.size();
-            block_infos.push_back(block_info_t{offset, block_size, false, false});
+            block_infos.push_back(block_info_t{offset, disk_block_size, block_size,
+                                               false, false});
             return true;
         }
     }
@@ -164,12 +186,23 @@ public:
         uint32_t b = parent->static_config->extent_size();
         for (auto it = block_infos.begin(); it < block_infos.end(); ++it) {
             if (it->token_referenced || it->index_referenced) {
-                b -= aligned_value(it->block_size);
+                b -= aligned_value(it->disk_block_size);
             }
         }
         return b;
     }
 
+    // Cost-benefit, as in LFS: the garbage we'd reclaim by GCing the extent, over
+    // the live data we'd have to copy to do so, weighted by how long the data has
+    // been sitting there. Older data is less likely to turn into garbage on its
+    // own if we just wait.
+    void update_gc_benefit(microtime_t now) {
+        const uint32_t garbage = garbage_bytes();
+        const uint32_t live = parent->static_config->extent_size() - garbage;
+        const double age = now > data_timestamp ? now - data_timestamp : 0;
+        gc_benefit = (age + 1) * garbage / std::max<uint32_t>(live, 1);
+    }
+
     bool block_is_garbage(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(block_index < block_infos.size());
@@ -192,7 +225,7 @@ public:
         uint32_t b = 0;
         for (auto it = block_infos.begin(); it < block_infos.end(); ++it) {
             if (it->token_referenced) {
-                b += aligned_value(it->block_size);
+                b += aligned_value(it->disk_block_size);
             }
         }
         return b;
@@ -210,19 +243,23 @@ public:
         return std::lower_bound(block_infos.begin(), block_infos.end(), relative_offset, &gc_entry_t::info_less);
     }
 
-    void mark_live_indexwise_with_offset(int64_t offset, block_size_t block_size) {
+    void mark_live_indexwise_with_offset(int64_t offset, block_size_t block_size,
+                                         block_size_t disk_block_size) {
         guarantee(offset >= extent_ref.offset() && offset < extent_ref.offset() + UINT32_MAX);
 
         uint32_t relative_offset = offset - extent_ref.offset();
 
         auto it = find_lower_bound_iter(relative_offset);
         if (it == block_infos.end()) {
-            block_infos.push_back(block_info_t{relative_offset, block_size, false, true});
+            block_infos.push_back(block_info_t{relative_offset, disk_block_size, block_size,
+                                               false, true});
         } else if (it->relative_offset > relative_offset) {
-            guarantee(it->relative_offset >= relative_offset + aligned_value(block_size));
-            block_infos.insert(it, block_info_t{relative_offset, block_size, false, true});
+            guarantee(it->relative_offset >= relative_offset + aligned_value(disk_block_size));
+            block_infos.insert(it, block_info_t{relative_offset, disk_block_size, block_size,
+                                                false, true});
         } else {
             guarantee(it->relative_offset == relative_offset);
+            guarantee(it->disk_block_size == disk_block_size);
             guarantee(it->block_size == block_size);
             it->index_referenced = true;
         }
@@ -243,7 +280,7 @@ public:
         uint32_t b = 0;
         for (auto it = block_infos.begin(); it < block_infos.end(); ++it) {
             if (it->index_referenced) {
-                b += aligned_value(it->block_size);
+                b += aligned_value(it->disk_block_size);
             }
         }
         return b;
@@ -260,7 +297,7 @@ public:
         for (auto it = block_infos.begin(); it != block_infos.end(); ++it) {
             ret += strprintf("%s[%" PRIi64 "..+%" PRIu32 ") %c%c",
                              it == block_infos.begin() ? "" : separator,
-                             offset + it->relative_offset, it->block_size.ser_value(),
+                             offset + it->relative_offset, it->disk_block_size.ser_value(),
                              it->token_referenced ? 'T' : ' ',
                              it->index_referenced ? 'I' : ' ');
         }
@@ -286,6 +323,15 @@ public:
     // When we started writing to the extent (this time).
     const microtime_t timestamp;
 
+    // When the youngest data in the extent was written by an index write. Blocks
+    // the GC moves here keep the time from the extent they came from.
+    microtime_t data_timestamp;
+
+    block_temperature_t temperature;
+
+    // As of parent->gc_benefit_time; this is what gc_pq is ordered by.
+    double gc_benefit;
+
     // The PQ entry pointing to us.
     priority_queue_t<gc_entry_t *, gc_entry_less_t>::entry_t *our_pq_entry;
 
@@ -334,8 +380,12 @@ private:
 data_block_manager_t::data_block_manager_t(const log_serializer_dynamic_config_t *_dynamic_config, extent_manager_t *em, log_serializer_t *_serializer, const log_serializer_on_disk_static_config_t *_static_config, log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted), dynamic_config(_dynamic_config),
       static_config(_static_config), extent_manager(em), serializer(_serializer),
-      gc_state(), gc_stats(stats)
+      gc_benefit_time(0), gc_state(), gc_stats(stats)
 {
+    for (int i = 0; i < NUM_BLOCK_TEMPERATURES; ++i) {
+        active_extents[i] = NULL;
+    }
+
     rassert(dynamic_config != NULL);
     rassert(static_config != NULL);
     rassert(extent_manager != NULL);
@@ -359,7 +409,8 @@ void data_block_manager_t::start_reconstruct() {
 // gc_entry_t in the entries table.  (This is used when we start up, when
 // everything is presumed to be garbage, until we mark it as
 // non-garbage.)
-void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size) {
+void data_block_manager_t::mark_live(int64_t offset, block_size_t block_size,
+                                     block_size_t disk_block_size) {
     uint64_t extent_id = static_config->extent_index(offset);
 
     if (entries.get(extent_id) == NULL) {
@@ -370,7 +421,7 @@ void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size
     }
 
     gc_entry_t *entry = entries.get(extent_id);
-    entry->mark_live_indexwise_with_offset(offset, ser_block_size);
+    entry->mark_live_indexwise_with_offset(offset, block_size, disk_block_size);
 }
 
 void data_block_manager_t::end_reconstruct() {
@@ -386,6 +437,8 @@ void data_block_manager_t::start_existing(file_t *file,
     gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE));
     gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH));
 
+    gc_benefit_time = current_microtime();
+
     /* Reconstruct the active data block extents from the metablock. */
     const int64_t offset = last_metablock->active_extent;
 
@@ -398,7 +451,7 @@ void data_block_manager_t::start_existing(file_t *file,
             reconstructed_extents.push_back(e);
         }
 
-        active_extent = entries.get(offset / extent_manager->extent_size);
+        gc_entry_t *active_extent = entries.get(offset / extent_manager->extent_size);
         guarantee(active_extent != NULL);
 
         /* Turn the extent from a reconstructing extent into an active extent */
@@ -406,8 +459,8 @@ void data_block_manager_t::start_existing(file_t *file,
         reconstructed_extents.remove(active_extent);
 
         active_extent->make_active();
-    } else {
-        active_extent = NULL;
+        active_extent->temperature = block_temperature_warm;
+        active_extents[block_temperature_warm] = active_extent;
     }
 
     /* Convert any extents that we found live blocks in, but that are not active
@@ -418,6 +471,7 @@ void data_block_manager_t::start_existing(file_t *file,
         guarantee(entry->state == gc_entry_t::state_reconstructing);
         entry->state = gc_entry_t::state_old;
 
+        entry->update_gc_benefit(gc_benefit_time);
         entry->our_pq_entry = gc_pq.push(entry);
 
         gc_stats.old_total_block_bytes += static_config->extent_size();
@@ -516,6 +570,62 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+// A compressed block on disk is the block's ls_buf_data_t header followed by the LZ4
+// compressed cache data, disk_block_size.value() bytes of it.  The LBA keeps both
+// sizes.  We only store a block compressed if that saves at least one device
+// block; otherwise compress_block returns false and the block is written as it is.
+#ifdef HAVE_LZ4
+bool compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                    scoped_malloc_t<ser_buffer_t> *compressed_out,
+                    block_size_t *disk_block_size_out) {
+    const int64_t max_aligned_size
+        = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE) - DEVICE_BLOCK_SIZE;
+    if (max_aligned_size <= static_cast<int64_t>(sizeof(ls_buf_data_t))) {
+        return false;
+    }
+
+    scoped_malloc_t<ser_buffer_t> compressed(malloc_aligned(max_aligned_size,
+                                                            DEVICE_BLOCK_SIZE));
+    const int compressed_size = LZ4_compress_default(buf->cache_data,
+                                                     compressed->cache_data,
+                                                     block_size.value(),
+                                                     max_aligned_size - sizeof(ls_buf_data_t));
+    if (compressed_size <= 0) {
+        return false;
+    }
+
+    compressed->ser_header = buf->ser_header;
+    *compressed_out = std::move(compressed);
+    *disk_block_size_out = block_size_t::unsafe_make(sizeof(ls_buf_data_t) + compressed_size);
+    return true;
+}
+
+void decompress_block(const ser_buffer_t *compressed, block_size_t disk_block_size,
+                      block_size_t block_size, ser_buffer_t *buf_out) {
+    buf_out->ser_header = compressed->ser_header;
+    const int size = LZ4_decompress_safe(compressed->cache_data, buf_out->cache_data,
+                                         disk_block_size.value(), block_size.value());
+    guarantee(size == static_cast<int>(block_size.value()),
+              "Corrupted compressed block %" PRIu64 " (decompressed to %d bytes "
+              "instead of %" PRIu32 ")", compressed->ser_header.block_id, size,
+              block_size.value());
+}
+#else
+// Without LZ4, `--block-compression lz4` is rejected on the command line, and a
+// serializer config that asks for it anyway just writes every block as it is.
+bool compress_block(UNUSED const ser_buffer_t *buf, UNUSED block_size_t block_size,
+                    UNUSED scoped_malloc_t<ser_buffer_t> *compressed_out,
+                    UNUSED block_size_t *disk_block_size_out) {
+    return false;
+}
+
+void decompress_block(const ser_buffer_t *compressed, UNUSED block_size_t disk_block_size,
+                      UNUSED block_size_t block_size, UNUSED ser_buffer_t *buf_out) {
+    crash("Block %" PRIu64 " was written with LZ4 compression, but this build of "
+          "RethinkDB doesn't support LZ4.", compressed->ser_header.block_id);
+}
+#endif  // HAVE_LZ4
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -591,13 +701,24 @@ public:
                     continue;
                 }
 
+                const block_size_t block_size
+                    = block_size_t::unsafe_make(info.ser_block_size);
+                const block_size_t disk_block_size
+                    = block_size_t::unsafe_make(info.actual_disk_block_size());
+                guarantee(disk_block_size.ser_value() <= *(lower_it + 1) - *lower_it);
+
                 scoped_malloc_t<ser_buffer_t> data = parent->serializer->malloc();
-                memcpy(data.get(), current_buf, info.ser_block_size);
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
+                if (disk_block_size == block_size) {
+                    memcpy(data.get(), current_buf, block_size.ser_value());
+                } else {
+                    decompress_block(reinterpret_cast<const ser_buffer_t *>(current_buf),
+                                     disk_block_size, block_size, data.get());
+                }
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size_t::unsafe_make(info.ser_block_size));
+                                                               block_size,
+                                                               disk_block_size);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, ls_token);
@@ -626,9 +747,24 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     return !entry->was_written && serializer->should_perform_read_ahead();
 }
 
-void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
+void data_block_manager_t::read(int64_t off_in, block_size_t block_size,
+                                block_size_t disk_block_size,
                                 void *buf_out, file_account_t *io_account) {
     guarantee(state == state_ready);
+    if (disk_block_size == block_size) {
+        read_from_disk(off_in, block_size.ser_value(), buf_out, io_account);
+    } else {
+        scoped_malloc_t<ser_buffer_t> compressed(
+                malloc_aligned(ceil_aligned(disk_block_size.ser_value(), DEVICE_BLOCK_SIZE),
+                               DEVICE_BLOCK_SIZE));
+        read_from_disk(off_in, disk_block_size.ser_value(), compressed.get(), io_account);
+        decompress_block(compressed.get(), disk_block_size, block_size,
+                         static_cast<ser_buffer_t *>(buf_out));
+    }
+}
+
+void data_block_manager_t::read_from_disk(int64_t off_in, uint32_t ser_block_size_in,
+                                          void *buf_out, file_account_t *io_account) {
     if (should_perform_read_ahead(off_in)) {
         dbm_read_ahead_t::perform_read_ahead(this, off_in, ser_block_size_in,
                                              buf_out, io_account);
@@ -653,27 +789,58 @@ void data_block_manager_t::read(int64_t off_in, uint32_t ser_block_size_in,
 
 std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
-                                  bool assign_new_block_sequence_id,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
-    // Either we're ready to write, or we're shutting down and just finished reading
-    // blocks for gc and called do_write.
-    guarantee(state == state_ready ||
-              (state == state_shutting_down && gc_state.step() == gc_write));
+    const bool compress
+        = dynamic_config->block_compression == BLOCK_COMPRESSION_LZ4;
 
-    // These tokens are grouped by extent.  You can do a contiguous write in each
-    // extent.
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
-        = gimme_some_new_offsets(writes);
+    std::vector<disk_write_t> disk_writes;
+    disk_writes.reserve(writes.size());
+    std::vector<scoped_malloc_t<ser_buffer_t> > compressed_bufs;
 
     for (auto it = writes.begin(); it != writes.end(); ++it) {
         it->buf->ser_header.block_id = it->block_id;
-        if (assign_new_block_sequence_id) {
-            ++serializer->latest_block_sequence_id;
-            it->buf->ser_header.block_sequence_id = serializer->latest_block_sequence_id;
+        ++serializer->latest_block_sequence_id;
+        it->buf->ser_header.block_sequence_id = serializer->latest_block_sequence_id;
+
+        scoped_malloc_t<ser_buffer_t> compressed;
+        block_size_t disk_block_size = it->block_size;
+        if (compress && compress_block(it->buf, it->block_size,
+                                       &compressed, &disk_block_size)) {
+            disk_writes.push_back(disk_write_t(compressed.get(), it->block_size,
+                                               disk_block_size));
+            compressed_bufs.push_back(std::move(compressed));
+        } else {
+            disk_writes.push_back(disk_write_t(it->buf, it->block_size,
+                                               it->block_size));
         }
+
+        stats->pm_serializer_block_bytes_written
+            += gc_entry_t::aligned_value(it->block_size);
+        stats->pm_serializer_block_disk_bytes_written
+            += gc_entry_t::aligned_value(disk_block_size);
     }
 
+    return write_blocks(disk_writes, false, std::move(compressed_bufs),
+                        io_account, cb);
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_blocks(const std::vector<disk_write_t> &writes,
+                                   bool gc_writes,
+                                   std::vector<scoped_malloc_t<ser_buffer_t> > &&bufs,
+                                   file_account_t *io_account,
+                                   iocallback_t *cb) {
+    // Either we're ready to write, or we're shutting down and just finished reading
+    // blocks for gc and called do_write.
+    guarantee(state == state_ready ||
+              (state == state_shutting_down && gc_state.step() == gc_write));
+
+    // Each group of writes can be done with one contiguous write.
+    std::vector<std::vector<size_t> > groups;
+    std::vector<counted_t<ls_block_token_pointee_t> > tokens
+        = gimme_some_new_offsets(writes, gc_writes, &groups);
+
     stats->pm_serializer_data_blocks_written += writes.size();
 
     struct intermediate_cb_t : public iocallback_t {
@@ -688,42 +855,41 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         size_t ops_remaining;
         iocallback_t *cb;
+        // The compressed copies of the blocks, which have to outlive the writes.
+        std::vector<scoped_malloc_t<ser_buffer_t> > bufs;
     };
 
     intermediate_cb_t *const intermediate_cb = new intermediate_cb_t;
-    intermediate_cb->ops_remaining = token_groups.size();
+    intermediate_cb->ops_remaining = groups.size();
     intermediate_cb->cb = cb;
+    intermediate_cb->bufs = std::move(bufs);
 
-    size_t write_number = 0;
-    for (size_t i = 0; i < token_groups.size(); ++i) {
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const std::vector<size_t> &group = groups[i];
 
-        const int64_t front_offset = token_groups[i].front()->offset();
-        const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+        const int64_t front_offset = tokens[group.front()]->offset();
+        const int64_t back_offset = tokens[group.back()]->offset()
+            + gc_entry_t::aligned_value(tokens[group.back()]->disk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
         const int64_t write_size = back_offset - front_offset;
 
-        scoped_array_t<iovec> iovecs(token_groups[i].size());
+        scoped_array_t<iovec> iovecs(group.size());
 
         int64_t last_written_offset = front_offset;
 
-        for (size_t j = 0; j < token_groups[i].size(); ++j) {
-            const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+        for (size_t j = 0; j < group.size(); ++j) {
+            const int64_t j_offset = tokens[group[j]]->offset();
+            const block_size_t j_disk_block_size = tokens[group[j]]->disk_block_size();
             guarantee(j_offset == last_written_offset);
-            const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
+            const size_t j_aligned_size = gc_entry_t::aligned_value(j_disk_block_size);
 
-            // The behavior of gimme_some_new_offsets is supposed to retain order, so
-            // we expect writes[write_number] to have the currently-relevant write.
-            guarantee(writes[write_number].block_size == j_block_size);
+            guarantee(writes[group[j]].disk_block_size == j_disk_block_size);
 
-            iovecs[j].iov_base = writes[write_number].buf;
+            iovecs[j].iov_base = writes[group[j]].buf;
             iovecs[j].iov_len = j_aligned_size;
             last_written_offset = j_offset + j_aligned_size;
-
-            ++write_number;
         }
 
         guarantee(last_written_offset == back_offset);
@@ -732,15 +898,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                              std::move(iovecs), io_account, intermediate_cb);
     }
 
-    std::vector<counted_t<ls_block_token_pointee_t> > ret;
-    ret.reserve(writes.size());
-    for (auto it = token_groups.begin(); it != token_groups.end(); ++it) {
-        for (auto jt = it->begin(); jt != it->end(); ++jt) {
-            ret.push_back(std::move(*jt));
-        }
-    }
-
-    return ret;
+    return tokens;
 }
 
 void data_block_manager_t::check_and_handle_empty_extent(uint64_t extent_id) {
@@ -784,6 +942,7 @@ void data_block_manager_t::check_and_handle_empty_extent(uint64_t extent_id) {
         rassert(entries.get(extent_id) == NULL);
 
     } else if (entry->state == gc_entry_t::state_old) {
+        entry->update_gc_benefit(gc_benefit_time);
         entry->our_pq_entry->update();
     }
 }
@@ -820,7 +979,7 @@ void data_block_manager_t::mark_garbage(int64_t offset, extent_transaction_t *tx
     // Add to old garbage count if necessary (works because of the
     // !entry->block_is_garbage(block_index) assertion above).
     if (entry->state == gc_entry_t::state_old && entry->block_is_garbage(block_index)) {
-        gc_stats.old_garbage_block_bytes += gc_entry_t::aligned_value(entry->block_size(block_index));
+        gc_stats.old_garbage_block_bytes += gc_entry_t::aligned_value(entry->disk_block_size(block_index));
     }
 
     check_and_handle_empty_extent(extent_id);
@@ -850,7 +1009,7 @@ void data_block_manager_t::mark_garbage_tokenwise_with_offset(int64_t offset) {
     // Add to old garbage count if necessary (works because of the
     // !entry->block_is_garbage(block_index) assertion above).
     if (entry->state == gc_entry_t::state_old && entry->block_is_garbage(block_index)) {
-        gc_stats.old_garbage_block_bytes += gc_entry_t::aligned_value(entry->block_size(block_index));
+        gc_stats.old_garbage_block_bytes += gc_entry_t::aligned_value(entry->disk_block_size(block_index));
     }
 
     check_and_handle_empty_extent(extent_id);
@@ -893,20 +1052,25 @@ void data_block_manager_t::gc_writer_t::write_gcs(gc_write_t *writes, size_t num
             // Step 1: Write buffers to disk and assemble index operations
             ASSERT_NO_CORO_WAITING;
 
-            std::vector<buf_write_info_t> the_writes;
+            // The blocks are moved as they are on disk, so compressed blocks
+            // stay compressed.
+            std::vector<disk_write_t> the_writes;
             the_writes.reserve(num_writes);
             for (size_t i = 0; i < num_writes; ++i) {
                 old_block_tokens.push_back(parent->serializer->generate_block_token(writes[i].old_offset,
-                                                                                    writes[i].block_size));
+                                                                                    writes[i].block_size,
+                                                                                    writes[i].disk_block_size));
 
-                the_writes.push_back(buf_write_info_t(writes[i].buf,
-                                                      writes[i].block_size,
-                                                      writes[i].buf->ser_header.block_id));
+                the_writes.push_back(disk_write_t(writes[i].buf,
+                                                  writes[i].block_size,
+                                                  writes[i].disk_block_size));
             }
 
             new_block_tokens
-                = parent->many_writes(the_writes, false, parent->choose_gc_io_account(),
-                                      &block_write_cond);
+                = parent->write_blocks(the_writes, true,
+                                       std::vector<scoped_malloc_t<ser_buffer_t> >(),
+                                       parent->choose_gc_io_account(),
+                                       &block_write_cond);
 
             guarantee(new_block_tokens.size() == num_writes);
         }
@@ -1004,6 +1168,10 @@ void data_block_manager_t::run_gc() {
 
                 ASSERT_NO_CORO_WAITING;
 
+                if (current_microtime() - gc_benefit_time > GC_BENEFIT_REFRESH_MICROS) {
+                    refresh_gc_benefits();
+                }
+
                 ++stats->pm_serializer_data_extents_gced;
 
                 /* grab the entry */
@@ -1053,7 +1221,7 @@ void data_block_manager_t::run_gc() {
 
                         const uint32_t end
                             = gc_state.current_entry->relative_offset(i)
-                            + gc_entry_t::aligned_value(gc_state.current_entry->block_size(i));
+                            + gc_entry_t::aligned_value(gc_state.current_entry->disk_block_size(i));
 
                         if (beg <= current_interval_end) {
                             current_interval_end = end;
@@ -1124,7 +1292,8 @@ void data_block_manager_t::run_gc() {
                         + gc_state.current_entry->relative_offset(i);
 
                     gc_writes.push_back(gc_write_t(block, block_offset,
-                                                   gc_state.current_entry->block_size(i)));
+                                                   gc_state.current_entry->block_size(i),
+                                                   gc_state.current_entry->disk_block_size(i)));
                 }
 
                 guarantee(gc_writes.size() == num_writes);
@@ -1184,6 +1353,7 @@ void data_block_manager_t::run_gc() {
 void data_block_manager_t::prepare_metablock(data_block_manager::metablock_mixin_t *metablock) {
     guarantee(state == state_ready || state == state_shutting_down);
 
+    gc_entry_t *active_extent = active_extents[block_temperature_warm];
     if (active_extent != NULL) {
         metablock->active_extent = active_extent->extent_ref.offset();
     } else {
@@ -1212,10 +1382,12 @@ void data_block_manager_t::actually_shutdown() {
 
     guarantee(reconstructed_extents.head() == NULL);
 
-    if (active_extent != NULL) {
-        UNUSED int64_t extent = active_extent->extent_ref.release();
-        delete active_extent;
-        active_extent = NULL;
+    for (int i = 0; i < NUM_BLOCK_TEMPERATURES; ++i) {
+        if (active_extents[i] != NULL) {
+            UNUSED int64_t extent = active_extents[i]->extent_ref.release();
+            delete active_extents[i];
+            active_extents[i] = NULL;
+        }
     }
 
     while (gc_entry_t *entry = young_extent_queue.head()) {
@@ -1235,59 +1407,144 @@ void data_block_manager_t::actually_shutdown() {
     }
 }
 
-std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::gimme_some_new_offsets(const std::vector<disk_write_t> &writes,
+                                             bool gc_writes,
+                                             std::vector<std::vector<size_t> > *groups_out) {
     ASSERT_NO_CORO_WAITING;
 
-    // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
-        ++stats->pm_serializer_data_extents_allocated;
+    const microtime_t now = current_microtime();
+
+    // GC writes all come from the same extent and get moved one temperature colder.
+    gc_entry_t *const gc_source = gc_writes ? gc_state.current_entry : NULL;
+    guarantee(!gc_writes || gc_source != NULL);
+
+    std::vector<block_temperature_t> temperatures;
+    temperatures.reserve(writes.size());
+    for (auto it = writes.begin(); it != writes.end(); ++it) {
+        if (gc_writes) {
+            temperatures.push_back(gc_source->temperature == block_temperature_hot
+                                   ? block_temperature_warm
+                                   : block_temperature_cold);
+        } else {
+            temperatures.push_back(index_write_temperature(it->buf->ser_header.block_id,
+                                                           now));
+        }
     }
 
+    std::vector<counted_t<ls_block_token_pointee_t> > ret(writes.size());
 
-    guarantee(active_extent->state == gc_entry_t::state_active);
+    for (int t = 0; t < NUM_BLOCK_TEMPERATURES; ++t) {
+        const block_temperature_t temperature = static_cast<block_temperature_t>(t);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
+        // The writes that go into the current active extent at this temperature.
+        std::vector<size_t> group;
 
-    std::vector<counted_t<ls_block_token_pointee_t> > tokens;
-    for (auto it = writes.begin(); it != writes.end(); ++it) {
-        uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
-        unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue, and make a
-            // new gc_entry_t.
-            active_extent->state = gc_entry_t::state_young;
-            young_extent_queue.push_back(active_extent);
-            mark_unyoung_entries();
-
-            active_extent = new gc_entry_t(this);
-            ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
-            guarantee(succeeded);
-
-            // Push the current group of tokens, if it's nonempty, onto the return vector.
-            if (!tokens.empty()) {
-                ret.push_back(std::move(tokens));
-                tokens.clear();
+        for (size_t i = 0; i < writes.size(); ++i) {
+            if (temperatures[i] != temperature) {
+                continue;
             }
+
+            // Start a new extent if necessary.
+            if (active_extents[t] == NULL) {
+                active_extents[t] = new gc_entry_t(this, temperature);
+                ++stats->pm_serializer_data_extents_allocated;
+            }
+
+            gc_entry_t *active_extent = active_extents[t];
+            guarantee(active_extent->state == gc_entry_t::state_active);
+
+            uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
+            unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
+            if (!active_extent->new_offset(writes[i].block_size,
+                                           writes[i].disk_block_size,
+                                           &relative_offset, &block_index)) {
+                // Move the active extent's gc_entry_t to the young extent queue, and
+                // make a new gc_entry_t.
+                active_extent->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(active_extent);
+                mark_unyoung_entries();
+
+                active_extent = new gc_entry_t(this, temperature);
+                active_extents[t] = active_extent;
+                ++stats->pm_serializer_data_extents_allocated;
+                const bool succeeded = active_extent->new_offset(writes[i].block_size,
+                                                                 writes[i].disk_block_size,
+                                                                 &relative_offset,
+                                                                 &block_index);
+                guarantee(succeeded);
+
+                // Push the current group of writes, if it's nonempty, onto the
+                // groups.
+                if (!group.empty()) {
+                    groups_out->push_back(std::move(group));
+                    group.clear();
+                }
+            }
+
+            const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
+            active_extent->was_written = true;
+            active_extent->mark_live_tokenwise(block_index);
+            active_extent->data_timestamp
+                = std::max(active_extent->data_timestamp,
+                           gc_writes ? gc_source->data_timestamp : now);
+
+            const uint32_t aligned_size
+                = gc_entry_t::aligned_value(writes[i].disk_block_size);
+            if (gc_writes) {
+                *gc_stats.gc_bytes_copied[gc_source->temperature] += aligned_size;
+            } else {
+                *gc_stats.index_bytes_written[t] += aligned_size;
+            }
+
+            ret[i] = serializer->generate_block_token(offset, writes[i].block_size,
+                                                      writes[i].disk_block_size);
+            group.push_back(i);
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        if (!group.empty()) {
+            groups_out->push_back(std::move(group));
+        }
+    }
+
+    return ret;
+}
+
+block_temperature_t data_block_manager_t::index_write_temperature(block_id_t block_id,
+                                                                  microtime_t now) const {
+    const flagged_off64_t offset = serializer->lba_index->get_block_offset(block_id);
+    if (!offset.has_value()) {
+        // A new block, or one that was deleted. We don't know anything about it.
+        return block_temperature_warm;
+    }
+
+    const gc_entry_t *entry = entries.get(static_config->extent_index(offset.get_value()));
+    guarantee(entry != NULL);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+    const microtime_t age = now > entry->data_timestamp ? now - entry->data_timestamp : 0;
+    if (age < GC_HOT_REWRITE_MICROS) {
+        return block_temperature_hot;
+    } else if (age > GC_COLD_REWRITE_MICROS) {
+        return block_temperature_cold;
+    } else {
+        return block_temperature_warm;
     }
+}
 
-    if (!tokens.empty()) {
-        ret.push_back(std::move(tokens));
+void data_block_manager_t::refresh_gc_benefits() {
+    ASSERT_NO_CORO_WAITING;
+    gc_benefit_time = current_microtime();
+
+    std::vector<gc_entry_t *> old_entries;
+    old_entries.reserve(gc_pq.size());
+    while (!gc_pq.empty()) {
+        old_entries.push_back(gc_pq.pop());
     }
 
-    return ret;
+    for (auto it = old_entries.begin(); it != old_entries.end(); ++it) {
+        (*it)->update_gc_benefit(gc_benefit_time);
+        (*it)->our_pq_entry = gc_pq.push(*it);
+    }
 }
 
 // Looks at young_extent_queue and pops things off the queue that are
@@ -1316,6 +1573,7 @@ void data_block_manager_t::remove_last_unyoung_entry() {
     guarantee(entry->state == gc_entry_t::state_young);
     entry->state = gc_entry_t::state_old;
 
+    entry->update_gc_benefit(gc_benefit_time);
     entry->our_pq_entry = gc_pq.push(entry);
 
     gc_stats.old_total_block_bytes += static_config->extent_size();
@@ -1340,7 +1598,7 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->gc_benefit < y->gc_benefit;
 }
 
 /****************
@@ -1369,4 +1627,11 @@ void data_block_manager_t::gc_stat_t::operator-=(int64_t num) {
 
 data_block_manager_t::gc_stats_t::gc_stats_t(log_serializer_stats_t *_stats)
     : old_total_block_bytes(&_stats->pm_serializer_old_total_block_bytes),
-      old_garbage_block_bytes(&_stats->pm_serializer_old_garbage_block_bytes) { }
+      old_garbage_block_bytes(&_stats->pm_serializer_old_garbage_block_bytes) {
+    index_bytes_written[block_temperature_hot] = &_stats->pm_serializer_hot_bytes_written;
+    index_bytes_written[block_temperature_warm] = &_stats->pm_serializer_warm_bytes_written;
+    index_bytes_written[block_temperature_cold] = &_stats->pm_serializer_cold_bytes_written;
+    gc_bytes_copied[block_temperature_hot] = &_stats->pm_serializer_hot_gc_bytes_copied;
+    gc_bytes_copied[block_temperature_warm] = &_stats->pm_serializer_warm_gc_bytes_copied;
+    gc_bytes_copied[block_temperature_cold] = &_stats->pm_serializer_cold_gc_bytes_copied;
+}
@@ -24,6 +24,19 @@ struct gc_entry_less_t {
     bool operator() (const gc_entry_t *x, const gc_entry_t *y);
 };
 
+/* Blocks are written to a different active extent depending on how often they get
+rewritten, so that each extent tends to fill up with blocks that become garbage at
+about the same time. An index write goes by how long ago the extent holding the
+block's previous version was written; the GC moves blocks it copies one temperature
+colder. */
+enum block_temperature_t {
+    block_temperature_hot = 0,
+    block_temperature_warm,
+    block_temperature_cold
+};
+
+const int NUM_BLOCK_TEMPERATURES = 3;
+
 namespace data_block_manager {
 struct shutdown_callback_t;  // see log_serializer.hpp.
 struct metablock_mixin_t;  // see log_serializer.hpp.
@@ -34,13 +47,27 @@ class data_block_manager_t {
     friend class dbm_read_ahead_t;
 private:
     struct gc_write_t {
+        // The block as it is on disk (possibly compressed).
         ser_buffer_t *buf;
         int64_t old_offset;
         block_size_t block_size;
+        block_size_t disk_block_size;
         gc_write_t(ser_buffer_t *b, int64_t _old_offset,
-                   block_size_t _block_size)
+                   block_size_t _block_size, block_size_t _disk_block_size)
             : buf(b), old_offset(_old_offset),
-              block_size(_block_size) { }
+              block_size(_block_size), disk_block_size(_disk_block_size) { }
+    };
+
+    // A block as we write it to disk. `buf` holds `disk_block_size` bytes, which is
+    // less than `block_size` if the block is compressed.
+    struct disk_write_t {
+        ser_buffer_t *buf;
+        block_size_t block_size;
+        block_size_t disk_block_size;
+        disk_write_t(ser_buffer_t *_buf, block_size_t _block_size,
+                     block_size_t _disk_block_size)
+            : buf(_buf), block_size(_block_size),
+              disk_block_size(_disk_block_size) { }
     };
 
     struct gc_writer_t {
@@ -64,7 +91,8 @@ public:
     static void prepare_initial_metablock(data_block_manager::metablock_mixin_t *mb);
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
-    void read(int64_t off_in, uint32_t ser_block_size,
+    // Reads the block and decompresses it if it's stored compressed.
+    void read(int64_t off_in, block_size_t block_size, block_size_t disk_block_size,
               void *buf_out, file_account_t *io_account);
 
     /* exposed gc api */
@@ -73,7 +101,7 @@ public:
 
     /* r{start,end}_reconstruct functions for safety */
     void start_reconstruct();
-    void mark_live(int64_t offset, block_size_t block_size);
+    void mark_live(int64_t offset, block_size_t block_size, block_size_t disk_block_size);
     void end_reconstruct();
 
     /* We must make sure that blocks which have tokens pointing to them don't
@@ -97,19 +125,38 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    // Writes blocks for index writes, compressing them if the dynamic config says
+    // so. Each gets a new block sequence id.
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
-                bool assign_new_block_sequence_id,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
-
 
 private:
     void actually_shutdown();
 
+    // `gc_writes` is true when the GC is moving blocks out of
+    // `gc_state.current_entry`. `bufs` are freed once the writes are done.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_blocks(const std::vector<disk_write_t> &writes,
+                 bool gc_writes,
+                 std::vector<scoped_malloc_t<ser_buffer_t> > &&bufs,
+                 file_account_t *io_account,
+                 iocallback_t *cb);
+
+    // Returns a token for each write, in the same order. The writes that ended up
+    // next to each other in the same extent are listed in `groups_out` (as indices
+    // into `writes`), so that each group can be written contiguously.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    gimme_some_new_offsets(const std::vector<disk_write_t> &writes,
+                           bool gc_writes,
+                           std::vector<std::vector<size_t> > *groups_out);
+
+    // Reads the block as it is on disk.
+    void read_from_disk(int64_t off_in, uint32_t ser_block_size,
+                        void *buf_out, file_account_t *io_account);
+
     file_account_t *choose_gc_io_account();
 
     /* Checks whether the extent is empty and if it is, notifies the extent manager
@@ -128,6 +175,13 @@ private:
 
     bool should_perform_read_ahead(int64_t offset);
 
+    // Which active extent an index write of `block_id` should go to.
+    block_temperature_t index_write_temperature(block_id_t block_id,
+                                                microtime_t now) const;
+
+    // Recomputes the GC benefit of everything in gc_pq as of now, and reorders it.
+    void refresh_gc_benefits();
+
     /* internal garbage collection structures */
     struct gc_read_callback_t : public iocallback_t {
         data_block_manager_t *parent;
@@ -171,8 +225,10 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
-    gc_entry_t *active_extent;
+    /* Contains the extents in the gc_entry_t::state_active state, one (or NULL) per
+       block temperature. Only the warm one is recorded in the metablock; after a
+       restart, the other two are treated like any other old extent. */
+    gc_entry_t *active_extents[NUM_BLOCK_TEMPERATURES];
 
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
@@ -180,6 +236,11 @@ private:
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time that the GC benefits of the entries in gc_pq are computed against.
+       Their ages keep growing, so every GC_BENEFIT_REFRESH_MICROS we recompute all
+       of them against a new time. */
+    microtime_t gc_benefit_time;
+
 
     /* Buffer used during GC. */
     std::vector<gc_write_t> gc_writes;
@@ -244,6 +305,10 @@ private:
     struct gc_stats_t {
         gc_stat_t old_total_block_bytes;
         gc_stat_t old_garbage_block_bytes;
+        // Bytes index writes put into extents of each temperature, and bytes the GC
+        // then had to copy out of them again.
+        perfmon_counter_t *index_bytes_written[NUM_BLOCK_TEMPERATURES];
+        perfmon_counter_t *gc_bytes_copied[NUM_BLOCK_TEMPERATURES];
         explicit gc_stats_t(log_serializer_stats_t *);
     };
 
@@ -101,7 +101,8 @@ public:
                         e->block_id,
                         e->recency,
                         e->offset,
-                        e->ser_block_size);
+                        e->ser_block_size,
+                        e->disk_block_size);
             }
             
             owner->state = lba_list_t::state_ready;
@@ -148,16 +149,22 @@ block_size_t lba_list_t::get_block_size(block_id_t block) {
     return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
 }
 
+block_size_t lba_list_t::get_disk_block_size(block_id_t block) {
+    return block_size_t::unsafe_make(get_block_info(block).actual_disk_block_size());
+}
+
 repli_timestamp_t lba_list_t::get_block_recency(block_id_t block) {
     return get_block_info(block).recency;
 }
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t disk_block_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size,
+                                   disk_block_size);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -166,7 +173,7 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size, disk_block_size);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -204,6 +211,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.disk_block_size,
                 io_account,
                 txn);
     }
@@ -212,11 +220,12 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size) {
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t disk_block_size) {
     
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size, disk_block_size);
 }
 
 class lba_syncer_t :
@@ -296,10 +305,11 @@ public:
             block_id_t block_id = id;
             flagged_off64_t off = owner->get_block_offset(block_id);
             if (off.has_value()) {
-                uint32_t ser_block_size = owner->get_ser_block_size(block_id);
+                const index_block_info_t info = owner->get_block_info(block_id);
                 owner->disk_structures[i]->add_entry(block_id,
-                                                     owner->get_block_recency(block_id),
-                                                     off, ser_block_size,
+                                                     info.recency,
+                                                     off, info.ser_block_size,
+                                                     info.disk_block_size,
                                                      io_account, txn);
             }
         }
@@ -9,7 +9,9 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/types.hpp"
+#include "concurrency/wait_any.hpp"
 #include "logger.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/data_block_manager.hpp"
@@ -114,8 +116,10 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_block_reads(secs_to_ticks(1)),
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
-      pm_serializer_index_writes(secs_to_ticks(1)),
+      pm_serializer_index_writes(secs_to_ticks(1), true),
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
+      pm_serializer_metablock_writes(secs_to_ticks(1), true),
+      pm_serializer_index_writes_per_metablock(secs_to_ticks(1), false),
       pm_extents_in_use(),
       pm_bytes_in_use(),
       pm_serializer_lba_extents(),
@@ -126,6 +130,14 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_blocks_written(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_hot_bytes_written(),
+      pm_serializer_warm_bytes_written(),
+      pm_serializer_cold_bytes_written(),
+      pm_serializer_hot_gc_bytes_copied(),
+      pm_serializer_warm_gc_bytes_copied(),
+      pm_serializer_cold_gc_bytes_copied(),
+      pm_serializer_block_bytes_written(),
+      pm_serializer_block_disk_bytes_written(),
       pm_serializer_lba_gcs(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
@@ -134,6 +146,8 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_block_writes, "serializer_block_writes",
           &pm_serializer_index_writes, "serializer_index_writes",
           &pm_serializer_index_writes_size, "serializer_index_writes_size",
+          &pm_serializer_metablock_writes, "serializer_metablock_writes",
+          &pm_serializer_index_writes_per_metablock, "serializer_index_writes_per_metablock",
           &pm_extents_in_use, "serializer_extents_in_use",
           &pm_bytes_in_use, "serializer_bytes_in_use",
           &pm_serializer_lba_extents, "serializer_lba_extents",
@@ -144,6 +158,14 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_blocks_written, "serializer_data_blocks_written",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
+          &pm_serializer_hot_bytes_written, "serializer_hot_bytes_written",
+          &pm_serializer_warm_bytes_written, "serializer_warm_bytes_written",
+          &pm_serializer_cold_bytes_written, "serializer_cold_bytes_written",
+          &pm_serializer_hot_gc_bytes_copied, "serializer_hot_gc_bytes_copied",
+          &pm_serializer_warm_gc_bytes_copied, "serializer_warm_gc_bytes_copied",
+          &pm_serializer_cold_gc_bytes_copied, "serializer_cold_gc_bytes_copied",
+          &pm_serializer_block_bytes_written, "serializer_block_bytes_written",
+          &pm_serializer_block_disk_bytes_written, "serializer_block_disk_bytes_written",
           &pm_serializer_lba_gcs, "serializer_lba_gcs",
           NULLPTR)
 { }
@@ -276,7 +298,9 @@ struct ls_start_existing_fsm_t :
             for (block_id_t id = 0; id < ser->lba_index->end_block_id(); id++) {
                 flagged_off64_t offset = ser->lba_index->get_block_offset(id);
                 if (offset.has_value()) {
-                    ser->data_block_manager->mark_live(offset.get_value(), ser->lba_index->get_block_size(id));
+                    ser->data_block_manager->mark_live(offset.get_value(),
+                                                       ser->lba_index->get_block_size(id),
+                                                       ser->lba_index->get_disk_block_size(id));
                 }
             }
             ser->data_block_manager->end_reconstruct();
@@ -361,7 +385,8 @@ log_serializer_t::log_serializer_t(dynamic_config_t _dynamic_config, serializer_
       metablock_manager(NULL),
       lba_index(NULL),
       data_block_manager(NULL),
-      last_write(NULL),
+      last_group(NULL),
+      open_group(NULL),
       active_write_count(0) {
     // STATE A
     /* This is because the serializer is not completely converted to coroutines yet. */
@@ -376,7 +401,8 @@ log_serializer_t::~log_serializer_t() {
     if (!shutdown(&cond)) cond.wait();
 
     rassert(state == state_unstarted || state == state_shut_down);
-    rassert(last_write == NULL);
+    rassert(last_group == NULL);
+    rassert(open_group == NULL);
     rassert(active_write_count == 0);
 }
 
@@ -413,7 +439,7 @@ void log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t>& tok
     ticks_t pm_time;
     stats->pm_serializer_block_reads.begin(&pm_time);
 
-    data_block_manager->read(token->offset_, token->block_size().ser_value(),
+    data_block_manager->read(token->offset_, token->block_size(), token->disk_block_size(),
                              buf, io_account);
 
     stats->pm_serializer_block_reads.end(&pm_time);
@@ -458,6 +484,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t>& write_op
             const index_write_op_t& op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
             uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            uint32_t disk_block_size = lba_index->get_block_info(op.block_id).disk_block_size;
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -473,12 +500,16 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t>& write_op
                 if (token.has()) {
                     offset = flagged_off64_t::make(token->offset_);
                     ser_block_size = token->block_size().ser_value();
+                    disk_block_size = token->disk_block_size() == token->block_size()
+                        ? 0 : token->disk_block_size().ser_value();
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(), token->block_size(),
+                                                  token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    disk_block_size = 0;
                 }
             }
 
@@ -486,7 +517,7 @@ void log_serializer_t::index_write(const std::vector<index_write_op_t>& write_op
                 : lba_index->get_block_recency(op.block_id);
 
             lba_index->set_block_info(op.block_id, recency,
-                                      offset, ser_block_size,
+                                      offset, ser_block_size, disk_block_size,
                                       io_account, &context.extent_txn);
         }
     }
@@ -509,53 +540,24 @@ void log_serializer_t::index_write_prepare(index_write_context_t *context, file_
 
 void log_serializer_t::index_write_finish(index_write_context_t *context, file_account_t *io_account) {
     assert_thread();
-    metablock_t mb_buffer;
-
-    /* Sync the LBA */
-    struct : public cond_t, public lba_list_t::sync_callback_t {
-        void on_lba_sync() { pulse(); }
-    } on_lba_sync;
-    lba_index->sync(io_account, &on_lba_sync);
-
-    /* Prepare metablock now instead of in when we write it so that we will have the correct
-    metablock information for this write even if another write starts before we finish writing
-    our data and LBA. */
-    prepare_metablock(&mb_buffer);
 
     /* Stop the extent manager transaction so another one can start, but don't commit it
     yet */
     extent_manager->end_transaction(&context->extent_txn);
 
-    /* Get in line for the metablock manager */
-    bool waiting_for_prev_write;
-    cond_t on_prev_write_submitted_metablock;
-    if (last_write) {
-        last_write->next_metablock_write = &on_prev_write_submitted_metablock;
-        waiting_for_prev_write = true;
-    } else {
-        waiting_for_prev_write = false;
-    }
-    last_write = context;
-
-    on_lba_sync.wait();
-    if (waiting_for_prev_write) on_prev_write_submitted_metablock.wait();
-
-    struct : public cond_t, public mb_manager_t::metablock_write_callback_t {
-        void on_metablock_write() { pulse(); }
-    } on_metablock_write;
-    const bool done_with_metablock = metablock_manager->write_metablock(&mb_buffer, io_account, &on_metablock_write);
-
-    /* If there was another transaction waiting for us to write our metablock so it could
-    write its metablock, notify it now so it can write its metablock. */
-    if (context->next_metablock_write) {
-        context->next_metablock_write->pulse();
+    if (open_group != NULL) {
+        /* Somebody is already gathering index writes for the next metablock, so let
+        them write it for us too. */
+        join_index_write_group(open_group, context);
+        context->metablock_written.wait();
     } else {
-        rassert(context == last_write);
-        last_write = NULL;
+        index_write_group_t group;
+        open_group = &group;
+        join_index_write_group(&group, context);
+        write_group_metablock(&group, io_account);
+        rassert(context->metablock_written.is_pulsed());
     }
 
-    if (!done_with_metablock) on_metablock_write.wait();
-
     active_write_count--;
 
     /* End the extent manager transaction so the extents can actually get reused. */
@@ -568,17 +570,97 @@ void log_serializer_t::index_write_finish(index_write_context_t *context, file_a
     // last transaction, shut ourselves down for good.
     if (state == log_serializer_t::state_shutting_down
         && shutdown_state == log_serializer_t::shutdown_waiting_on_serializer
-        && last_write == NULL
+        && last_group == NULL
         && active_write_count == 0) {
 
         next_shutdown_step();
     }
 }
 
+void log_serializer_t::join_index_write_group(index_write_group_t *group, index_write_context_t *context) {
+    assert_thread();
+    rassert(group == open_group);
+    group->writes.push_back(context);
+
+    if (static_cast<int64_t>(group->writes.size()) >= dynamic_config.group_commit_max_writes) {
+        /* Whoever comes next starts a new group. */
+        open_group = NULL;
+        group->full.pulse();
+    }
+}
+
+void log_serializer_t::write_group_metablock(index_write_group_t *group, file_account_t *io_account) {
+    assert_thread();
+
+    /* Get in line behind the previous group */
+    bool waiting_for_prev_group;
+    cond_t on_prev_group_wrote_metablock;
+    if (last_group) {
+        last_group->next_metablock_write = &on_prev_group_wrote_metablock;
+        waiting_for_prev_group = true;
+    } else {
+        waiting_for_prev_group = false;
+    }
+    last_group = group;
+
+    /* Keep the group open for the configured window (unless it fills up first), and
+    for as long as the previous group's metablock is being written, since we couldn't
+    write ours before then anyway. */
+    if (dynamic_config.group_commit_window_ms > 0 && !group->full.is_pulsed()) {
+        signal_timer_t window;
+        window.start(dynamic_config.group_commit_window_ms);
+        wait_any_t window_or_full(&window, &group->full);
+        window_or_full.wait_lazily_unordered();
+    }
+    if (waiting_for_prev_group) on_prev_group_wrote_metablock.wait();
+
+    if (open_group == group) {
+        open_group = NULL;
+    }
+    stats->pm_serializer_index_writes_per_metablock.record(group->writes.size());
+
+    /* Sync the LBA once for the whole group. Every index write in the group has already
+    updated the in-memory LBA, so this covers all of them. */
+    struct : public cond_t, public lba_list_t::sync_callback_t {
+        void on_lba_sync() { pulse(); }
+    } on_lba_sync;
+    lba_index->sync(io_account, &on_lba_sync);
+
+    /* Prepare the metablock before we block, so that it describes exactly the index
+    writes that are done at this point. */
+    metablock_t mb_buffer;
+    prepare_metablock(&mb_buffer);
+
+    on_lba_sync.wait();
+
+    ticks_t pm_time;
+    stats->pm_serializer_metablock_writes.begin(&pm_time);
+    metablock_manager->co_write_metablock(&mb_buffer, io_account);
+    stats->pm_serializer_metablock_writes.end(&pm_time);
+
+    /* Release everybody in the group in the order they joined, so that index writes
+    still complete in the order in which they started. */
+    while (index_write_context_t *context = group->writes.head()) {
+        group->writes.remove(context);
+        context->metablock_written.pulse();
+    }
+
+    /* If there was another group waiting for us to write our metablock so it could
+    write its metablock, notify it now so it can write its metablock. */
+    if (group->next_metablock_write) {
+        group->next_metablock_write->pulse();
+    } else {
+        rassert(group == last_group);
+        last_group = NULL;
+    }
+}
+
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size,
+                                                                         disk_block_size));
     return ret;
 }
 
@@ -589,7 +671,7 @@ log_serializer_t::block_writes(const std::vector<buf_write_info_t> &write_infos,
     stats->pm_serializer_block_writes += write_infos.size();
 
     std::vector<counted_t<ls_block_token_pointee_t> > result
-        = data_block_manager->many_writes(write_infos, true, io_account, cb);
+        = data_block_manager->many_writes(write_infos, io_account, cb);
     guarantee(result.size() == write_infos.size());
     return result;
 }
@@ -712,7 +794,9 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(info.offset.get_value(),
+                                    block_size_t::unsafe_make(info.ser_block_size),
+                                    block_size_t::unsafe_make(info.actual_disk_block_size()));
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -751,7 +835,7 @@ bool log_serializer_t::next_shutdown_step() {
     if (shutdown_state == shutdown_begin) {
         // First shutdown step
         shutdown_state = shutdown_waiting_on_serializer;
-        if (last_write || active_write_count > 0) {
+        if (last_group || active_write_count > 0) {
             state = state_shutting_down;
             shutdown_in_one_shot = false;
             return false;
@@ -893,9 +977,11 @@ bool log_serializer_t::should_perform_read_ahead() {
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset) {
     serializer_->assert_thread();
     serializer_->register_block_token(this, initial_offset);
 }
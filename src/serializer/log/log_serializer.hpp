@@ -9,15 +9,16 @@
 #include "serializer/serializer.hpp"
 #include "serializer/log/config.hpp"
 #include "utils.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/mutex_assertion.hpp"
+#include "containers/intrusive_list.hpp"
 
 #include "serializer/log/metablock_manager.hpp"
 #include "serializer/log/extent_manager.hpp"
 #include "serializer/log/lba/lba_list.hpp"
 #include "serializer/log/stats.hpp"
 
-class cond_t;
 class data_block_manager_t;
 struct block_magic_t;
 class io_backender_t;
@@ -165,7 +166,8 @@ private:
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                             block_size_t block_size,
+                                                             block_size_t disk_block_size);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
@@ -174,18 +176,36 @@ private:
             repli_timestamp_t recency_timestamp);
     bool should_perform_read_ahead();
 
-    struct index_write_context_t {
-        index_write_context_t() : next_metablock_write(NULL) { }
+    struct index_write_context_t : public intrusive_list_node_t<index_write_context_t> {
+        index_write_context_t() { }
         extent_transaction_t extent_txn;
-        cond_t *next_metablock_write;
+        /* Pulsed once the metablock that covers this write is on disk. */
+        cond_t metablock_written;
 
     private:
         DISABLE_COPYING(index_write_context_t);
     };
+    /* Index writes that finish close together share one LBA sync and one metablock
+    write. The first index write to find no open group starts one and becomes its
+    leader; it writes the metablock on behalf of everybody who joined and then
+    releases them in the order in which they joined. */
+    struct index_write_group_t {
+        index_write_group_t() : next_metablock_write(NULL) { }
+        intrusive_list_t<index_write_context_t> writes;
+        /* Pulsed when the group has reached `group_commit_max_writes` and is closed to
+        new index writes. */
+        cond_t full;
+        cond_t *next_metablock_write;
+
+    private:
+        DISABLE_COPYING(index_write_group_t);
+    };
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(index_write_context_t *context, file_account_t *io_account);
     /* Finishes a write transaction */
     void index_write_finish(index_write_context_t *context, file_account_t *io_account);
+    void join_index_write_group(index_write_group_t *group, index_write_context_t *context);
+    void write_group_metablock(index_write_group_t *group, file_account_t *io_account);
 
     /* This mess is because the serializer is still mostly FSM-based */
     bool shutdown(cond_t *cb);
@@ -241,11 +261,13 @@ private:
     lba_list_t *lba_index;
     data_block_manager_t *data_block_manager;
 
-    /* The running index writes organize themselves into a list so that they can be sure to
-    write their metablocks in the correct order. last_write points to the most recent
-    transaction that started but did not finish; new index writes use it to find the
-    end of the list so they can append themselves to it. */
-    index_write_context_t *last_write;
+    /* The index write groups organize themselves into a list so that they can be sure to
+    write their metablocks in the correct order. last_group points to the most recent
+    group that has not written its metablock yet; new groups use it to find the end of
+    the list so they can append themselves to it. open_group is the group that new index
+    writes join, if any. */
+    index_write_group_t *last_group;
+    index_write_group_t *open_group;
 
     int active_write_count;
 
@@ -255,18 +255,6 @@ void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_
     mb_buffer_in_use = false;
 }
 
-template<class metablock_t>
-void metablock_manager_t<metablock_t>::write_metablock_callback(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb) {
-    co_write_metablock(mb, io_account);
-    cb->on_metablock_write();
-}
-
-template<class metablock_t>
-bool metablock_manager_t<metablock_t>::write_metablock(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb) {
-    coro_t::spawn(boost::bind(&metablock_manager_t<metablock_t>::write_metablock_callback, this, mb, io_account, cb));
-    return false;
-}
-
 template<class metablock_t>
 void metablock_manager_t<metablock_t>::shutdown() {
 
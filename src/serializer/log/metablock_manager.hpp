@@ -91,11 +91,6 @@ public:
 
     bool start_existing(file_t *dbfile, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb);
 
-    struct metablock_write_callback_t {
-        virtual void on_metablock_write() = 0;
-        virtual ~metablock_write_callback_t() {}
-    };
-    bool write_metablock(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb);
     void co_write_metablock(metablock_t *mb, file_account_t *io_account);
 
     void shutdown();
@@ -128,7 +123,6 @@ private:
     };
 
     void start_existing_callback(file_t *dbfile, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb);
-    void write_metablock_callback(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb);
     void on_io_complete();
 
     mutex_t write_lock;
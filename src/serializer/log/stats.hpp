@@ -14,6 +14,10 @@ struct log_serializer_stats_t {
     perfmon_duration_sampler_t pm_serializer_index_writes;
     perfmon_sampler_t pm_serializer_index_writes_size;
 
+    /* Each metablock write ends in a datasync, so these are also our fsyncs. */
+    perfmon_duration_sampler_t pm_serializer_metablock_writes;
+    perfmon_sampler_t pm_serializer_index_writes_per_metablock;
+
     /* used in serializer/log/extent_manager.cc */
     perfmon_counter_t pm_extents_in_use;
     perfmon_counter_t pm_bytes_in_use;
@@ -30,6 +34,22 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
 
+    /* Per block temperature, what index writes wrote into data extents of that
+    temperature and what the GC had to copy back out of them. The write
+    amplification of a temperature is (bytes_written + gc_bytes_copied) /
+    bytes_written. */
+    perfmon_counter_t pm_serializer_hot_bytes_written;
+    perfmon_counter_t pm_serializer_warm_bytes_written;
+    perfmon_counter_t pm_serializer_cold_bytes_written;
+    perfmon_counter_t pm_serializer_hot_gc_bytes_copied;
+    perfmon_counter_t pm_serializer_warm_gc_bytes_copied;
+    perfmon_counter_t pm_serializer_cold_gc_bytes_copied;
+
+    /* How many (device block aligned) bytes of data blocks index writes wrote, and
+    how many of them ended up on disk after compression. */
+    perfmon_counter_t pm_serializer_block_bytes_written;
+    perfmon_counter_t pm_serializer_block_disk_bytes_written;
+
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
 
@@ -0,0 +1,225 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "btree/operations.hpp"
+#include "serializer/config.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+struct batch_test_value_t;
+
+template <>
+class value_sizer_t<batch_test_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<batch_test_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        return 1 + *reinterpret_cast<const uint8_t *>(value);
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 't', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<batch_test_value_t>);
+};
+
+namespace unittest {
+
+/* A btree with a single writer, which makes each batch of writes in a
+ * transaction of its own. */
+class batch_test_btree_t {
+public:
+    batch_test_btree_t()
+        : io_backender(file_direct_io_mode_t::buffered_desired),
+          file_opener(temp_file.name(), &io_backender) {
+        standard_serializer_t::create(&file_opener,
+                                      standard_serializer_t::static_config_t());
+        serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                                  &file_opener,
+                                                  &get_global_perfmon_collection()));
+        cache_t::create(serializer.get());
+        cache.init(new cache_t(serializer.get(), cache_config,
+                               &get_global_perfmon_collection()));
+        btree_slice_t::create(cache.get(), std::vector<char>(), std::vector<char>());
+        btree.init(new btree_slice_t(cache.get(), &get_global_perfmon_collection(), "unittest"));
+    }
+
+    // Writes the value for every key in keys.
+    void write(const std::vector<std::string> &keys, const std::string &value) {
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn(btree.get(), rwi_write, keys.size(),
+                                     repli_timestamp_t::distant_past,
+                                     order_source.check_in("batch_test_btree_t::write"),
+                                     WRITE_DURABILITY_SOFT, &superblock, &txn);
+
+        scoped_ptr_t<superblock_t> current_superblock(superblock.release());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            promise_t<superblock_t *> superblock_promise;
+            {
+                store_key_t key(keys[i]);
+                keyvalue_location_t<batch_test_value_t> kv_location;
+                find_keyvalue_location_for_write(txn.get(), current_superblock.release(),
+                                                 key.btree_key(),
+                                                 &kv_location, &btree->root_eviction_priority,
+                                                 &btree->stats, &superblock_promise);
+                std::string buffer(1, static_cast<char>(value.size()));
+                buffer += value;
+                scoped_malloc_t<batch_test_value_t> new_value(buffer.data(), buffer.data() + buffer.size());
+                kv_location.value = std::move(new_value);
+                null_key_modification_callback_t<batch_test_value_t> null_cb;
+                apply_keyvalue_change(txn.get(), &kv_location, key.btree_key(),
+                                      repli_timestamp_t::distant_past, false, &null_cb,
+                                      &btree->root_eviction_priority);
+            }
+            current_superblock.init(superblock_promise.wait());
+        }
+    }
+
+    bool lookup(const std::string &key, std::string *value_out) {
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(btree.get(), rwi_read,
+                                                 order_source.check_in("batch_test_btree_t::lookup"),
+                                                 CACHE_SNAPSHOTTED_NO, &superblock, &txn);
+        keyvalue_location_t<batch_test_value_t> kv_location;
+        find_keyvalue_location_for_read(txn.get(), superblock.get(), store_key_t(key).btree_key(),
+                                        &kv_location, btree->root_eviction_priority, &btree->stats);
+        if (!kv_location.value.has()) {
+            return false;
+        }
+        const char *data = reinterpret_cast<const char *>(kv_location.value.get());
+        *value_out = std::string(data + 1, data + 1 + static_cast<uint8_t>(data[0]));
+        return true;
+    }
+
+    // Looks up all of the keys in one traversal. The values of the keys that
+    // have one go in values_out.
+    void lookup_multiple(const std::vector<std::string> &keys,
+                         std::map<std::string, std::string> *values_out) {
+        std::vector<store_key_t> sorted_keys;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sorted_keys.push_back(store_key_t(keys[i]));
+        }
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+
+        scoped_ptr_t<transaction_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        get_btree_superblock_and_txn_for_reading(btree.get(), rwi_read,
+                                                 order_source.check_in("batch_test_btree_t::lookup_multiple"),
+                                                 CACHE_SNAPSHOTTED_NO, &superblock, &txn);
+        lookup_multiple_callback_t cb(&sorted_keys, values_out);
+        get_multiple_keys(txn.get(), superblock.get(), sorted_keys,
+                          btree->root_eviction_priority, &btree->stats, &cb);
+    }
+
+private:
+    class lookup_multiple_callback_t : public multi_get_callback_t<batch_test_value_t> {
+    public:
+        lookup_multiple_callback_t(const std::vector<store_key_t> *_keys,
+                                   std::map<std::string, std::string> *_values)
+            : keys(_keys), values(_values) { }
+
+        void on_value(UNUSED transaction_t *txn, size_t index, const batch_test_value_t *value) {
+            const char *data = reinterpret_cast<const char *>(value);
+            const store_key_t &key = (*keys)[index];
+            (*values)[std::string(key.contents(), key.contents() + key.size())]
+                = std::string(data + 1, data + 1 + static_cast<uint8_t>(data[0]));
+        }
+
+    private:
+        const std::vector<store_key_t> *keys;
+        std::map<std::string, std::string> *values;
+    };
+
+    temp_file_t temp_file;
+    io_backender_t io_backender;
+    filepath_file_opener_t file_opener;
+    scoped_ptr_t<standard_serializer_t> serializer;
+    mirrored_cache_config_t cache_config;
+    scoped_ptr_t<cache_t> cache;
+    order_source_t order_source;
+
+public:
+    scoped_ptr_t<btree_slice_t> btree;
+};
+
+std::string batch_test_key(int i) {
+    return strprintf("key%08d", i);
+}
+
+std::vector<std::string> random_batch(int num_keys, int key_space) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < num_keys; ++i) {
+        keys.push_back(batch_test_key(random() % key_space));
+    }
+    return keys;
+}
+
+void run_multi_get_test() {
+    batch_test_btree_t tree;
+    std::map<std::string, std::string> mirror;
+    const int key_space = 20000;
+
+    for (int round = 0; round < 20; ++round) {
+        std::vector<std::string> keys = random_batch(1000, key_space);
+        std::string value = strprintf("value%d", round);
+        tree.write(keys, value);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            mirror[keys[i]] = value;
+        }
+    }
+
+    for (int round = 0; round < 20; ++round) {
+        std::vector<std::string> keys = random_batch(1000, key_space);
+
+        std::map<std::string, std::string> point_values;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            std::string value;
+            if (tree.lookup(keys[i], &value)) {
+                point_values[keys[i]] = value;
+            }
+        }
+
+        std::map<std::string, std::string> multi_values;
+        tree.lookup_multiple(keys, &multi_values);
+
+        ASSERT_EQ(point_values, multi_values);
+        for (size_t i = 0; i < keys.size(); ++i) {
+            std::map<std::string, std::string>::iterator it = mirror.find(keys[i]);
+            ASSERT_EQ(it != mirror.end(), multi_values.count(keys[i]) == 1) << keys[i];
+        }
+    }
+
+    // An empty tree and an empty batch.
+    batch_test_btree_t empty_tree;
+    std::map<std::string, std::string> values;
+    empty_tree.lookup_multiple(random_batch(10, key_space), &values);
+    tree.lookup_multiple(std::vector<std::string>(), &values);
+    ASSERT_TRUE(values.empty());
+}
+
+TEST(BtreeMultiGetTest, MultiGet) {
+    run_in_thread_pool(&run_multi_get_test);
+}
+
+}  // namespace unittest
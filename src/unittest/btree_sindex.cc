@@ -109,6 +109,8 @@ void run_sindex_btree_store_api_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -216,7 +218,7 @@ void run_sindex_btree_store_api_test() {
 
             point_read_response_t response;
 
-            rdb_get(key, store.get_sindex_slice(id), txn.get(),
+            rdb_get(key, store.get_sindex_slice(id), NULL, txn.get(),
                     sindex_super_block.get(), &response);
 
             ASSERT_EQ(ql::datum_t(1.0), *response.data);
@@ -1,8 +1,15 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "concurrency/pmap.hpp"
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 
 
 namespace unittest {
@@ -63,5 +70,153 @@ TEST(DatumTest, NumericSerialization) {
 }
 
 
+counted_t<const ql::datum_t> deserialize_fields_of(
+        const counted_t<const ql::datum_t> &datum,
+        const std::set<std::string> &fields, bool exclude) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << datum;
+    int write_res = send_write_message(&write_stream, &wm);
+    EXPECT_EQ(0, write_res);
+
+    string_read_stream_t read_stream(std::move(write_stream.str()), 0);
+    counted_t<const ql::datum_t> res;
+    EXPECT_EQ(ARCHIVE_SUCCESS, ql::deserialize_fields(&read_stream, fields, exclude, &res));
+    return res;
+}
+
+TEST(DatumTest, DeserializeFields) {
+    // Every kind of value, so that skipping each of them is tested.
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj["arr"] = make_counted<const ql::datum_t>(std::vector<counted_t<const ql::datum_t> >(
+        2, make_counted<const ql::datum_t>("elem")));
+    obj["bool"] = make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, true);
+    obj["null"] = make_counted<const ql::datum_t>(ql::datum_t::R_NULL);
+    obj["double"] = make_counted<const ql::datum_t>(1.5);
+    obj["int"] = make_counted<const ql::datum_t>(-300.0);
+    obj["str"] = make_counted<const ql::datum_t>(std::string(5000, 'x'));
+    std::map<std::string, counted_t<const ql::datum_t> > inner(obj);
+    obj["obj"] = make_counted<const ql::datum_t>(std::move(inner));
+    const counted_t<const ql::datum_t> datum
+        = make_counted<const ql::datum_t>(std::map<std::string, counted_t<const ql::datum_t> >(obj));
+
+    // Excluding nothing reads the whole object.
+    ASSERT_EQ(*datum, *deserialize_fields_of(datum, std::set<std::string>(), true));
+
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        std::set<std::string> fields;
+        fields.insert(it->first);
+        fields.insert("missing");
+
+        counted_t<const ql::datum_t> only = deserialize_fields_of(datum, fields, false);
+        ASSERT_EQ(1u, only->as_object().size());
+        ASSERT_EQ(*it->second, *only->get(it->first));
+
+        counted_t<const ql::datum_t> others = deserialize_fields_of(datum, fields, true);
+        ASSERT_EQ(obj.size() - 1, others->as_object().size());
+        ASSERT_FALSE(others->get(it->first, ql::NOTHROW).has());
+    }
+
+    // Non-objects are read whole.
+    ASSERT_EQ(*obj["arr"], *deserialize_fields_of(obj["arr"], std::set<std::string>(), false));
+    ASSERT_EQ(*obj["str"], *deserialize_fields_of(obj["str"], std::set<std::string>(), false));
+}
+
+std::vector<char> serialize_to_vector(const counted_t<const ql::datum_t> &datum) {
+    string_stream_t write_stream;
+    write_message_t wm;
+    wm << datum;
+    int write_res = send_write_message(&write_stream, &wm);
+    EXPECT_EQ(0, write_res);
+    return std::vector<char>(write_stream.str().begin(), write_stream.str().end());
+}
+
+TEST(DatumTest, SerializedObject) {
+    std::map<std::string, counted_t<const ql::datum_t> > obj;
+    obj["a"] = make_counted<const ql::datum_t>(1.0);
+    obj["ab"] = make_counted<const ql::datum_t>("str");
+    obj["b"] = make_counted<const ql::datum_t>(std::vector<counted_t<const ql::datum_t> >(
+        3, make_counted<const ql::datum_t>(ql::datum_t::R_BOOL, false)));
+    obj["c"] = make_counted<const ql::datum_t>(ql::datum_t::R_NULL);
+    const counted_t<const ql::datum_t> datum
+        = make_counted<const ql::datum_t>(std::map<std::string, counted_t<const ql::datum_t> >(obj));
+    const std::vector<char> buf = serialize_to_vector(datum);
+
+    counted_t<const ql::datum_t> serialized
+        = ql::datum_t::from_serialized(std::vector<char>(buf));
+    ASSERT_TRUE(serialized.has());
+    ASSERT_EQ(ql::datum_t::R_OBJECT, serialized->get_type());
+
+    // Fields are found without building the object...
+    for (auto it = obj.begin(); it != obj.end(); ++it) {
+        ASSERT_EQ(*it->second, *serialized->get(it->first));
+    }
+    ASSERT_FALSE(serialized->get("", ql::NOTHROW).has());
+    ASSERT_FALSE(serialized->get("aa", ql::NOTHROW).has());
+    ASSERT_FALSE(serialized->get("d", ql::NOTHROW).has());
+
+    // ...each of them only once...
+    ASSERT_EQ(serialized->get("b").get(), serialized->get("b").get());
+
+    // ...and it's written back out unchanged.
+    ASSERT_EQ(buf, serialize_to_vector(serialized));
+    ASSERT_EQ(*datum, *serialized);
+    ASSERT_EQ(obj.size(), serialized->as_object().size());
+    ASSERT_EQ(serialized->get("b").get(), serialized->as_object().at("b").get());
+
+    // Pseudotypes are built as usual.
+    const counted_t<const ql::datum_t> ptype = ql::pseudo::make_time(0.0, "Z");
+    counted_t<const ql::datum_t> deserialized_ptype
+        = ql::datum_t::from_serialized(serialize_to_vector(ptype));
+    ASSERT_TRUE(deserialized_ptype.has());
+    ASSERT_TRUE(deserialized_ptype->is_ptype(ql::pseudo::time_string));
+    ASSERT_EQ(*ptype, *deserialized_ptype);
+
+    // Truncated data is rejected.
+    ASSERT_FALSE(ql::datum_t::from_serialized(
+                     std::vector<char>(buf.begin(), buf.end() - 1)).has());
+}
+
+counted_t<const ql::datum_t> make_rows(int num_rows) {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    for (int i = 0; i < num_rows; ++i) {
+        std::map<std::string, counted_t<const ql::datum_t> > row;
+        row["id"] = make_counted<const ql::datum_t>(static_cast<double>(i));
+        row["name"] = make_counted<const ql::datum_t>("row");
+        rows.push_back(make_counted<const ql::datum_t>(std::move(row)));
+    }
+    return make_counted<const ql::datum_t>(std::move(rows));
+}
+
+void take_references(const counted_t<const ql::datum_t> *rows, int thread) {
+    on_thread_t th((threadnum_t(thread)));
+    for (int i = 0; i < 100; ++i) {
+        for (size_t j = 0; j < (*rows)->size(); ++j) {
+            counted_t<const ql::datum_t> row = (*rows)->get(j);
+            std::map<std::string, counted_t<const ql::datum_t> > copy = row->as_object();
+            ASSERT_EQ(2u, copy.size());
+        }
+    }
+}
+
+void run_share_across_threads_test() {
+    counted_t<const ql::datum_t> rows = make_rows(100);
+    rows->share_across_threads();
+    pmap(get_num_threads(), boost::bind(&take_references, &rows, _1));
+
+    // Every reference taken on the other threads was dropped.
+    ASSERT_TRUE(rows.unique());
+    for (size_t i = 0; i < rows->size(); ++i) {
+        const std::map<std::string, counted_t<const ql::datum_t> > &row
+            = rows->get(i)->as_object();
+        for (auto it = row.begin(); it != row.end(); ++it) {
+            ASSERT_TRUE(it->second.unique());
+        }
+    }
+}
+
+TEST(DatumTest, ShareAcrossThreads) {
+    run_in_thread_pool(&run_share_across_threads_test, 4);
+}
 
 }  // namespace unittest
@@ -0,0 +1,158 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/io/disk.hpp"
+#include "arch/io/disk/uring.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static const size_t io_size = 4096;
+
+struct io_waiter_t : public linux_iocallback_t {
+    void on_io_complete() { done.pulse(); }
+    cond_t done;
+};
+
+// Fills `buf` with a pattern that depends on `seed`.
+static void fill_pattern(char *buf, size_t size, int seed) {
+    for (size_t i = 0; i < size; ++i) {
+        buf[i] = static_cast<char>((i * 7 + seed) & 0xff);
+    }
+}
+
+static void *malloc_io_buf(size_t size) {
+    return malloc_aligned(size, DEVICE_BLOCK_SIZE);
+}
+
+void run_read_write_test(file_io_backend_t io_backend) {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS, io_backend);
+
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read | linux_file_t::mode_write | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+    file->set_size_at_least(16 * io_size);
+
+    char *buf = static_cast<char *>(malloc_io_buf(io_size));
+
+    // A plain write, with datasyncs.
+    {
+        fill_pattern(buf, io_size, 1);
+        io_waiter_t waiter;
+        file->write_async(0, io_size, buf, DEFAULT_DISK_ACCOUNT, &waiter, file_t::WRAP_IN_DATASYNCS);
+        waiter.done.wait();
+    }
+
+    // A writev of two blocks.
+    char *buf2 = static_cast<char *>(malloc_io_buf(io_size));
+    char *buf3 = static_cast<char *>(malloc_io_buf(io_size));
+    {
+        fill_pattern(buf2, io_size, 2);
+        fill_pattern(buf3, io_size, 3);
+        scoped_array_t<iovec> iovecs(2);
+        iovecs[0].iov_base = buf2;
+        iovecs[0].iov_len = io_size;
+        iovecs[1].iov_base = buf3;
+        iovecs[1].iov_len = io_size;
+        io_waiter_t waiter;
+        file->writev_async(io_size, 2 * io_size, std::move(iovecs), DEFAULT_DISK_ACCOUNT, &waiter);
+        waiter.done.wait();
+    }
+
+    // Read all three blocks back.
+    char *expected = static_cast<char *>(malloc_io_buf(io_size));
+    for (int i = 0; i < 3; ++i) {
+        fill_pattern(expected, io_size, i + 1);
+        memset(buf, 0, io_size);
+        io_waiter_t waiter;
+        file->read_async(i * io_size, io_size, buf, DEFAULT_DISK_ACCOUNT, &waiter);
+        waiter.done.wait();
+        EXPECT_EQ(0, memcmp(expected, buf, io_size)) << "block " << i;
+    }
+
+    free(expected);
+    free(buf3);
+    free(buf2);
+    free(buf);
+}
+
+TEST(DiskBackendTest, PoolReadWrite) {
+    run_in_thread_pool(boost::bind(&run_read_write_test, file_io_backend_t::pool));
+}
+
+TEST(DiskBackendTest, UringReadWrite) {
+    // Falls back to the pool if io_uring isn't available.
+    run_in_thread_pool(boost::bind(&run_read_write_test, file_io_backend_t::uring_desired));
+}
+
+#if USE_IO_URING
+
+struct io_failure_waiter_t : public linux_iocallback_t {
+    io_failure_waiter_t() : errsv(0) { }
+    void on_io_complete() { done.pulse(); }
+    void on_io_failure(int _errsv, int64_t, int64_t) {
+        errsv = _errsv;
+        done.pulse();
+    }
+    int errsv;
+    cond_t done;
+};
+
+/* A read that runs past the end of the file comes back short.  The rest is
+resubmitted, and when that reads nothing the read fails with EIO. */
+void run_uring_short_read_test() {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired,
+                                DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                                file_io_backend_t::uring_desired);
+
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read | linux_file_t::mode_write | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+    file->set_size_at_least(3 * io_size);
+
+    char *buf = static_cast<char *>(malloc_io_buf(2 * io_size));
+    {
+        fill_pattern(buf, io_size, 1);
+        io_waiter_t waiter;
+        file->write_async(io_size, io_size, buf, DEFAULT_DISK_ACCOUNT, &waiter, file_t::NO_DATASYNCS);
+        waiter.done.wait();
+    }
+
+    // Cut the file short behind `file`'s back, so that the read runs past its end.
+    int truncate_res = truncate(temp_file.name().permanent_path().c_str(), 2 * io_size);
+    ASSERT_EQ(0, truncate_res);
+
+    io_failure_waiter_t waiter;
+    file->read_async(io_size, 2 * io_size, buf, DEFAULT_DISK_ACCOUNT, &waiter);
+    waiter.done.wait();
+    EXPECT_EQ(EIO, waiter.errsv);
+
+    free(buf);
+}
+
+TEST(DiskBackendTest, UringShortRead) {
+    if (uring_diskmgr_t::is_available()) {
+        run_in_thread_pool(&run_uring_short_read_test);
+    }
+}
+
+#endif  // USE_IO_URING
+
+}  // namespace unittest
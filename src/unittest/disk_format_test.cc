@@ -55,6 +55,8 @@ TEST(DiskFormatTest, LbaMetablockMixinT) {
 
 TEST(DiskFormatTest, LbaEntryT) {
     EXPECT_EQ(0u, offsetof(lba_entry_t, block_id));
+    EXPECT_EQ(8u, offsetof(lba_entry_t, ser_block_size));
+    EXPECT_EQ(12u, offsetof(lba_entry_t, disk_block_size));
     EXPECT_EQ(16u, offsetof(lba_entry_t, recency));
     EXPECT_EQ(24u, offsetof(lba_entry_t, offset));
     EXPECT_EQ(32u, sizeof(lba_entry_t));
@@ -65,11 +67,13 @@ TEST(DiskFormatTest, LbaEntryT) {
     ASSERT_TRUE(lba_entry_t::is_padding(&ent));
     flagged_off64_t real = flagged_off64_t::unused();
     real = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 0);
+    ASSERT_FALSE(lba_entry_t::is_padding(&ent));
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, real, 1234, 512);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
     flagged_off64_t deleteblock = flagged_off64_t::unused();
     deleteblock = flagged_off64_t::make(1);
-    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234);
+    ent = lba_entry_t::make(1, repli_timestamp_t::invalid, deleteblock, 1234, 0);
     ASSERT_FALSE(lba_entry_t::is_padding(&ent));
 }
 
@@ -2,12 +2,14 @@
 #ifndef UNITTEST_DUMMY_NAMESPACE_INTERFACE_HPP_
 #define UNITTEST_DUMMY_NAMESPACE_INTERFACE_HPP_
 
+#include <set>
 #include <vector>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
+#include "clustering/administration/namespace_interface_repository.hpp"
 #include "concurrency/pmap.hpp"
 #include "containers/scoped.hpp"
 #include "unittest/clustering_utils.hpp"
@@ -209,7 +211,7 @@ public:
     dummy_namespace_interface_t(std::vector<typename protocol_t::region_t>
             shards, store_view_t<protocol_t> **stores, order_source_t
             *order_source, typename protocol_t::context_t *_ctx)
-        : ctx(_ctx)
+        : shard_regions(shards.begin(), shards.end()), ctx(_ctx)
     {
         /* Make sure shards are non-overlapping and stuff */
         {
@@ -275,13 +277,41 @@ public:
         return sharder->write(write, response, tok, interruptor);
     }
 
+    std::set<typename protocol_t::region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t) {
+        return shard_regions;
+    }
+
 private:
+    std::set<typename protocol_t::region_t> shard_regions;
     boost::ptr_vector<dummy_performer_t<protocol_t> > performers;
     boost::ptr_vector<dummy_timestamper_t<protocol_t> > timestampers;
     scoped_ptr_t<dummy_sharder_t<protocol_t> > sharder;
     typename protocol_t::context_t *ctx;
 };
 
+/* Hands out the same namespace interface for every namespace id, for code that
+reads tables through a `base_namespace_repo_t`, like `batched_rget_stream_t`. */
+template <class protocol_t>
+class dummy_namespace_repo_t : public base_namespace_repo_t<protocol_t> {
+public:
+    explicit dummy_namespace_repo_t(namespace_interface_t<protocol_t> *nsi) {
+        entry.namespace_if.pulse(nsi);
+        entry.ref_count = 0;
+        entry.pulse_when_ref_count_becomes_zero = NULL;
+        entry.pulse_when_ref_count_becomes_nonzero = NULL;
+    }
+
+private:
+    typedef typename base_namespace_repo_t<protocol_t>::namespace_cache_entry_t
+        namespace_cache_entry_t;
+
+    namespace_cache_entry_t *get_cache_entry(const uuid_u &) {
+        return &entry;
+    }
+
+    namespace_cache_entry_t entry;
+};
+
 }   /* namespace unittest */
 
 #endif /* UNITTEST_DUMMY_NAMESPACE_INTERFACE_HPP_ */
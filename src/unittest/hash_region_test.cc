@@ -3,6 +3,7 @@
 
 #include "hash_region.hpp"
 #include "btree/keys.hpp"
+#include "memcached/protocol.hpp"
 #include "memcached/region.hpp"
 
 namespace unittest {
@@ -116,5 +117,27 @@ TEST(HashRegionTest, SpecialNonSquareRegionJoin) {
 
 
 
+TEST(HashRegionTest, CpuShardingSubspaces) {
+    // Tables can have any number of CPU shards, and the subspaces always have to
+    // tile the hash space.
+    const int factors[] = { 1, 2, 3, 4, 7, 16, 33, MAX_CPU_SHARDING_FACTOR };
+    for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); ++f) {
+        std::vector<hash_region_t<key_range_t> > vec;
+        for (int i = 0; i < factors[f]; ++i) {
+            hash_region_t<key_range_t> r = memcached_protocol_t::cpu_sharding_subspace(i, factors[f]);
+            ASSERT_LT(r.beg, r.end);
+            vec.push_back(r);
+        }
+
+        hash_region_t<key_range_t> r;
+        region_join_result_t res = region_join(vec, &r);
+
+        ASSERT_EQ(REGION_JOIN_OK, res);
+        ASSERT_EQ(0u, r.beg);
+        ASSERT_EQ(HASH_REGION_HASH_SIZE, r.end);
+        assert_equal(key_range_t::universe(), r.inner);
+    }
+}
+
 }  // namespace unittest
 
@@ -1,11 +1,13 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include "unittest/gtest.hpp"
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 namespace unittest {
 
@@ -61,6 +63,61 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+// Keys that are short, that differ in their first eight bytes, and that don't.
+std::string short_key(int i) { return strprintf("%d", i); }
+std::string long_key(int i) { return strprintf("%03d:0123456789", i); }
+std::string prefixed_key(int i) { return strprintf("user:000%03d", i); }
+
+void run_offset_index_test(std::string (*make_key)(int)) {
+    block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < 100; ++i) {
+        keys.push_back(store_key_t(make_key((i * 7919) % 1000)));
+        ASSERT_TRUE(internal_node::insert(bs, node.get(), keys.back().btree_key(), i, i + 1));
+    }
+    verify(bs, node.get());
+    std::sort(keys.begin(), keys.end());
+
+    for (int i = 0; i < 1000; ++i) {
+        store_key_t key(make_key(i));
+        const int expected = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        ASSERT_EQ(expected, internal_node::get_offset_index(node.get(), key.btree_key()));
+    }
+}
+
+TEST(InternalNodeTest, LargeBlocks) {
+    for (uint32_t size = 2 * DEFAULT_BTREE_BLOCK_SIZE; size <= MAX_BTREE_BLOCK_SIZE; size *= 2) {
+        block_size_t bs = block_size_t::unsafe_make(size);
+        scoped_malloc_t<internal_node_t> node(bs.value());
+        internal_node::init(bs, node.get());
+
+        int num_pairs = 0;
+        while (!internal_node::is_full(node.get())) {
+            store_key_t key(strprintf("%08d", (num_pairs * 7919) % 100000));
+            ASSERT_TRUE(internal_node::insert(bs, node.get(), key.btree_key(),
+                                              num_pairs, num_pairs + 1));
+            ++num_pairs;
+        }
+        verify(bs, node.get());
+        ASSERT_GT(num_pairs, static_cast<int>(size / 32));
+
+        scoped_malloc_t<internal_node_t> rnode(bs.value());
+        store_key_t median;
+        internal_node::split(bs, node.get(), rnode.get(), median.btree_key());
+        verify(bs, node.get());
+        verify(bs, rnode.get());
+        ASSERT_EQ(num_pairs + 1, node->npairs + rnode->npairs);
+    }
+}
+
+TEST(InternalNodeTest, OffsetIndex) {
+    run_offset_index_test(&short_key);
+    run_offset_index_test(&long_key);
+    run_offset_index_test(&prefixed_key);
+}
 
 }  // namespace unittest
 
@@ -0,0 +1,82 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <string>
+
+#include "btree/key_filter.hpp"
+#include "btree/slice.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+store_key_t key_filter_test_key(int i) {
+    return store_key_t(strprintf("key%08d", i));
+}
+
+void run_key_filter_test() {
+    btree_stats_t stats(&get_global_perfmon_collection(), "key_filter_test");
+    counted_t<key_filter_t> filter = make_counted<key_filter_t>(
+        static_cast<key_filter_t::key_part_t>(NULL), &stats);
+
+    // Until it has been built, the filter can't be used.
+    ASSERT_FALSE(filter->is_ready());
+    ASSERT_TRUE(filter->needs_rebuild());
+
+    // Keys written during the rebuild count as much as the ones the scan finds.
+    const int num_keys = 20000;
+    filter->start_rebuild();
+    ASSERT_FALSE(filter->needs_rebuild());
+    for (int i = 0; i < num_keys; ++i) {
+        if (i % 2 == 0) {
+            filter->add_from_rebuild(key_filter_test_key(i).btree_key());
+        } else {
+            filter->add(key_filter_test_key(i).btree_key());
+        }
+    }
+    filter->finish_rebuild();
+    ASSERT_TRUE(filter->is_ready());
+    for (int i = 0; i < num_keys; ++i) {
+        ASSERT_TRUE(filter->may_contain(key_filter_test_key(i)));
+    }
+
+    // The first rebuild doesn't know how many keys there are, so the filter ends up
+    // too small. The second one sizes it for them.
+    ASSERT_TRUE(filter->needs_rebuild());
+    filter->start_rebuild();
+    for (int i = 0; i < num_keys; ++i) {
+        filter->add_from_rebuild(key_filter_test_key(i).btree_key());
+    }
+    // The keys that get written go into the old bits as well, which are in use
+    // until the rebuild is done.
+    filter->add(key_filter_test_key(num_keys).btree_key());
+    ASSERT_TRUE(filter->may_contain(key_filter_test_key(num_keys)));
+    filter->finish_rebuild();
+    ASSERT_FALSE(filter->needs_rebuild());
+    for (int i = 0; i <= num_keys; ++i) {
+        ASSERT_TRUE(filter->may_contain(key_filter_test_key(i)));
+    }
+
+    int false_positives = 0;
+    const int num_lookups = 100000;
+    for (int i = num_keys + 1; i < num_keys + 1 + num_lookups; ++i) {
+        if (filter->may_contain(key_filter_test_key(i))) {
+            ++false_positives;
+        }
+    }
+    ASSERT_LT(false_positives, num_lookups / 50);
+
+    // A rebuild that gets aborted leaves the filter the way it was.
+    filter->start_rebuild();
+    filter->abort_rebuild();
+    ASSERT_TRUE(filter->is_ready());
+    ASSERT_TRUE(filter->may_contain(key_filter_test_key(0)));
+
+    filter->detach();
+    ASSERT_TRUE(filter->is_detached());
+    ASSERT_FALSE(filter->needs_rebuild());
+}
+
+TEST(KeyFilterTest, AddAndRebuild) {
+    run_in_thread_pool(&run_key_filter_test);
+}
+
+}  // namespace unittest
@@ -0,0 +1,319 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#ifndef UNITTEST_LEAF_NODE_TRACKER_HPP_
+#define UNITTEST_LEAF_NODE_TRACKER_HPP_
+
+#include <map>
+#include <string>
+
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+#include "unittest/gtest.hpp"
+
+/* A small value type for leaf nodes, and `LeafNodeTracker`, a leaf node that keeps a
+map of what it should contain and checks itself against it after every change.
+Shared by the leaf node tests and benchmarks. */
+
+struct short_value_t;
+
+template <>
+class value_sizer_t<short_value_t> : public value_sizer_t<void> {
+public:
+    explicit value_sizer_t<short_value_t>(block_size_t bs) : block_size_(bs) { }
+
+    int size(const void *value) const {
+        int x = *reinterpret_cast<const uint8_t *>(value);
+        return 1 + x;
+    }
+
+    bool fits(const void *value, int length_available) const {
+        return length_available > 0 && size(value) <= length_available;
+    }
+
+    int max_possible_size() const {
+        return 256;
+    }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 's', 'h', 'L', 'F' } };
+        return magic;
+    }
+
+    block_size_t block_size() const { return block_size_; }
+
+private:
+    block_size_t block_size_;
+
+    DISABLE_COPYING(value_sizer_t<short_value_t>);
+};
+
+namespace unittest {
+
+class short_value_buffer_t {
+public:
+    explicit short_value_buffer_t(const short_value_t *v) {
+        memcpy(data_, v, reinterpret_cast<const uint8_t *>(v)[0] + 1);
+    }
+
+    explicit short_value_buffer_t(const std::string& v) {
+        rassert(v.size() <= 255);
+        data_[0] = v.size();
+        memcpy(data_ + 1, v.data(), v.size());
+    }
+
+    short_value_t *data() {
+        return reinterpret_cast<short_value_t *>(data_);
+    }
+
+    std::string as_str() const {
+        return std::string(data_ + 1, data_ + 1 + data_[0]);
+    }
+
+private:
+    uint8_t data_[256];
+};
+
+class LeafNodeTracker {
+public:
+    explicit LeafNodeTracker(uint32_t block_size = 4096)
+        : bs_(block_size_t::unsafe_make(block_size)), sizer_(bs_), node_(bs_.value()),
+          tstamp_counter_(0) {
+        leaf::init(&sizer_, node_.get());
+        Print();
+    }
+
+    leaf_node_t *node() { return node_.get(); }
+
+    bool Insert(const store_key_t& key, const std::string& value, repli_timestamp_t tstamp) {
+        short_value_buffer_t v(value);
+
+        if (leaf::is_full(&sizer_, node(), key.btree_key(), v.data())) {
+            Print();
+
+            Verify();
+            return false;
+        }
+
+        leaf::insert(&sizer_, node(), key.btree_key(), v.data(), tstamp, key_modification_proof_t::real_proof());
+
+        kv_[key] = value;
+
+        Print();
+
+        Verify();
+        return true;
+    }
+
+    bool Insert(const store_key_t &key, const std::string &value) {
+        return Insert(key, value, NextTimestamp());
+    }
+
+    void Remove(const store_key_t& key, repli_timestamp_t tstamp) {
+        ASSERT_TRUE(ShouldHave(key));
+
+        kv_.erase(key);
+
+        leaf::remove(&sizer_, node(), key.btree_key(), tstamp, key_modification_proof_t::real_proof());
+
+        Verify();
+
+        Print();
+    }
+
+    void Remove(const store_key_t &key) {
+        Remove(key, NextTimestamp());
+    }
+
+    void Merge(LeafNodeTracker *lnode) {
+        SCOPED_TRACE("Merge");
+
+        ASSERT_EQ(bs_.ser_value(), lnode->bs_.ser_value());
+
+        leaf::merge(&sizer_, lnode->node(), node());
+
+        int old_kv_size = kv_.size();
+        for (std::map<store_key_t, std::string>::iterator p = lnode->kv_.begin(), e = lnode->kv_.end(); p != e; ++p) {
+            kv_[p->first] = p->second;
+        }
+
+        ASSERT_EQ(kv_.size(), old_kv_size + lnode->kv_.size());
+
+        lnode->kv_.clear();
+
+        {
+            SCOPED_TRACE("mergee verify");
+            Verify();
+        }
+        {
+            SCOPED_TRACE("lnode verify");
+            lnode->Verify();
+        }
+    }
+
+    void Level(int nodecmp_value, LeafNodeTracker *sibling, bool *could_level_out) {
+        // Assertions can cause us to exit the function early, so give
+        // the output parameter an initialized value.
+        *could_level_out = false;
+        ASSERT_EQ(bs_.ser_value(), sibling->bs_.ser_value());
+
+        store_key_t replacement;
+        bool can_level = leaf::level(&sizer_, nodecmp_value, node(), sibling->node(), replacement.btree_key());
+
+        if (can_level) {
+            ASSERT_TRUE(!sibling->kv_.empty());
+            if (nodecmp_value < 0) {
+                // Copy keys from front of sibling until and including replacement key.
+
+                std::map<store_key_t, std::string>::iterator p = sibling->kv_.begin();
+                while (p != sibling->kv_.end() && p->first < replacement) {
+                    kv_[p->first] = p->second;
+                    std::map<store_key_t, std::string>::iterator prev = p;
+                    ++p;
+                    sibling->kv_.erase(prev);
+                }
+                ASSERT_TRUE(p != sibling->kv_.end());
+                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
+                kv_[p->first] = p->second;
+                sibling->kv_.erase(p);
+            } else {
+                // Copy keys from end of sibling until but not including replacement key.
+
+                std::map<store_key_t, std::string>::iterator p = sibling->kv_.end();
+                --p;
+                while (p != sibling->kv_.begin() && p->first > replacement) {
+                    kv_[p->first] = p->second;
+                    std::map<store_key_t, std::string>::iterator prev = p;
+                    --p;
+                    sibling->kv_.erase(prev);
+                }
+
+                ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(replacement));
+            }
+        }
+
+        *could_level_out = can_level;
+
+        Verify();
+        sibling->Verify();
+    }
+
+    void Split(LeafNodeTracker *right, bool appending = false) {
+        ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
+
+        ASSERT_TRUE(leaf::is_empty(right->node()));
+
+        store_key_t median;
+        if (appending) {
+            leaf::split_for_append(&sizer_, node(), right->node(), median.btree_key());
+        } else {
+            leaf::split(&sizer_, node(), right->node(), median.btree_key());
+        }
+
+        std::map<store_key_t, std::string>::iterator p = kv_.end();
+        --p;
+        while (p->first > median && p != kv_.begin()) {
+            right->kv_[p->first] = p->second;
+            std::map<store_key_t, std::string>::iterator prev = p;
+            --p;
+            kv_.erase(prev);
+        }
+
+        ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
+    }
+
+    bool IsFull(const store_key_t& key, const std::string& value) {
+        short_value_buffer_t value_buf(value);
+        return leaf::is_full(&sizer_, node(), key.btree_key(), value_buf.data());
+    }
+
+    bool ShouldHave(const store_key_t& key) {
+        return kv_.end() != kv_.find(key);
+    }
+
+    repli_timestamp_t NextTimestamp() {
+        ++tstamp_counter_;
+        repli_timestamp_t ret;
+        ret.longtime = tstamp_counter_;
+        return ret;
+    }
+
+    // This only prints if we enable printing.
+    void Print() {
+        // leaf::print(stdout, &sizer_, node_);
+    }
+
+    class verify_receptor_t : public leaf::entry_reception_callback_t {
+    public:
+        verify_receptor_t() : got_lost_deletions_(false) { }
+
+        void lost_deletions() {
+            ASSERT_FALSE(got_lost_deletions_);
+            got_lost_deletions_ = true;
+        }
+
+        void deletion(UNUSED const btree_key_t *k, UNUSED repli_timestamp_t tstamp) {
+            ASSERT_TRUE(false);
+        }
+
+        void key_value(const btree_key_t *k, const void *v_value, UNUSED repli_timestamp_t tstamp) {
+            ASSERT_TRUE(got_lost_deletions_);
+            const short_value_t *value = static_cast<const short_value_t *>(v_value);
+
+            store_key_t k_buf(k);
+            short_value_buffer_t v_buf(value);
+            std::string v_str = v_buf.as_str();
+
+            ASSERT_TRUE(kv_map_.find(k_buf) == kv_map_.end());
+            kv_map_[k_buf] = v_str;
+        }
+
+        const std::map<store_key_t, std::string>& map() const { return kv_map_; }
+
+    private:
+        bool got_lost_deletions_;
+
+        std::map<store_key_t, std::string> kv_map_;
+    };
+
+    void printmap(const std::map<store_key_t, std::string>& m) {
+        for (std::map<store_key_t, std::string>::const_iterator p = m.begin(), q = m.end(); p != q; ++p) {
+            printf("%s: %s;", key_to_debug_str(p->first).c_str(), p->second.c_str());
+        }
+    }
+
+
+    void Verify() {
+        // Of course, this will fail with rassert, not a gtest assertion.
+        leaf::validate(&sizer_, node());
+
+        verify_receptor_t receptor;
+        repli_timestamp_t max_possible_tstamp = { tstamp_counter_ };
+        leaf::dump_entries_since_time(&sizer_, node(), repli_timestamp_t::distant_past, max_possible_tstamp, &receptor);
+
+        if (receptor.map() != kv_) {
+            printf("receptor.map(): ");
+            printmap(receptor.map());
+            printf("\nkv_: ");
+            printmap(kv_);
+            printf("\n");
+        }
+        ASSERT_TRUE(receptor.map() == kv_);
+    }
+
+public:
+    block_size_t bs_;
+    value_sizer_t<short_value_t> sizer_;
+    scoped_malloc_t<leaf_node_t> node_;
+
+    uint64_t tstamp_counter_;
+
+    std::map<store_key_t, std::string> kv_;
+
+
+    DISABLE_COPYING(LeafNodeTracker);
+};
+
+}  // namespace unittest
+
+#endif  // UNITTEST_LEAF_NODE_TRACKER_HPP_
@@ -48,7 +48,7 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<mem
         underlying_stores.push_back(
                 new memcached_protocol_t::store_t(multiplexer->proxies[i],
                     temp_file.name().permanent_path() + strprintf("_%zd", i),
-                    GIGABYTE, true, &get_global_perfmon_collection(), NULL,
+                    GIGABYTE, NULL, PAGE_REPL_POLICY_2Q, true, &get_global_perfmon_collection(), NULL,
                     &io_backender, base_path_t(".")));
     }
 
@@ -144,5 +144,53 @@ TEST(MemcachedProtocol, GetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test);
 }
 
+/* `GetMultiple` reads keys from both shards with one `get_multiple_query_t`. */
+void run_get_multiple_test(namespace_interface_t<memcached_protocol_t> *nsi, order_source_t *order_source) {
+    const char *const set_keys[] = { "b", "m", "n", "z" };
+    for (size_t i = 0; i < sizeof(set_keys) / sizeof(set_keys[0]); ++i) {
+        sarc_mutation_t set;
+        set.key = store_key_t(set_keys[i]);
+        set.data = data_buffer_t::create(1);
+        set.data->buf()[0] = set_keys[i][0];
+        set.flags = i;
+        set.exptime = 0;
+        set.add_policy = add_policy_yes;
+        set.replace_policy = replace_policy_yes;
+        memcached_protocol_t::write_t write(set, time(NULL), 12345);
+
+        cond_t interruptor;
+        memcached_protocol_t::write_response_t result;
+        nsi->write(write, &result, order_source->check_in("unittest::run_get_multiple_test(memcached_protocol.cc-A)"), &interruptor);
+    }
+
+    std::vector<store_key_t> keys;
+    keys.push_back(store_key_t("a"));
+    keys.push_back(store_key_t("b"));
+    keys.push_back(store_key_t("m"));
+    keys.push_back(store_key_t("n"));
+    keys.push_back(store_key_t("o"));
+    keys.push_back(store_key_t("z"));
+    memcached_protocol_t::read_t read(get_multiple_query_t(keys), time(NULL));
+
+    cond_t interruptor;
+    memcached_protocol_t::read_response_t result;
+    nsi->read(read, &result, order_source->check_in("unittest::run_get_multiple_test(memcached_protocol.cc-B)").with_read_mode(), &interruptor);
+
+    get_multiple_result_t *maybe_result = boost::get<get_multiple_result_t>(&result.result);
+    ASSERT_TRUE(maybe_result != NULL);
+    ASSERT_EQ(4u, maybe_result->results.size());
+    for (size_t i = 0; i < sizeof(set_keys) / sizeof(set_keys[0]); ++i) {
+        auto it = maybe_result->results.find(store_key_t(set_keys[i]));
+        ASSERT_TRUE(it != maybe_result->results.end());
+        ASSERT_TRUE(it->second.value.has());
+        ASSERT_EQ(1, it->second.value->size());
+        EXPECT_EQ(set_keys[i][0], it->second.value->buf()[0]);
+        EXPECT_EQ(i, it->second.flags);
+    }
+}
+TEST(MemcachedProtocol, GetMultiple) {
+    run_in_thread_pool_with_namespace_interface(&run_get_multiple_test);
+}
+
 }   /* namespace unittest */
 
@@ -0,0 +1,84 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/pmap.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+static void send_to_thread(threadnum_t thread, linux_thread_message_t *msg) {
+    if (continue_on_thread(thread, msg)) {
+        call_later_on_this_thread(msg);
+    }
+}
+
+/* `Ordering` has every thread send a numbered stream of messages to thread 0 at
+the same time, and checks that each stream arrives in order. */
+
+struct numbered_message_t : public linux_thread_message_t {
+    numbered_message_t() : source(-1), number(-1), last_seen(NULL), remaining(NULL), done(NULL) { }
+    void on_thread_switch() {
+        EXPECT_EQ(last_seen[source] + 1, number);
+        last_seen[source] = number;
+        if (--*remaining == 0) {
+            done->pulse();
+        }
+    }
+    int source;
+    int number;
+    int *last_seen;
+    int *remaining;
+    cond_t *done;
+};
+
+void send_numbered_messages(int num_messages, scoped_array_t<numbered_message_t> *messages,
+                            int *last_seen, int *remaining, cond_t *done, int source) {
+    on_thread_t thread_switcher((threadnum_t(source)));
+    for (int i = 0; i < num_messages; ++i) {
+        numbered_message_t *msg = &messages[source][i];
+        msg->source = source;
+        msg->number = i;
+        msg->last_seen = last_seen;
+        msg->remaining = remaining;
+        msg->done = done;
+        send_to_thread(threadnum_t(0), msg);
+        if (i % 100 == 0) {
+            coro_t::yield();
+        }
+    }
+}
+
+void run_ordering_test() {
+    const int num_messages = 10000;
+    const int num_threads = get_num_threads();
+
+    scoped_array_t<scoped_array_t<numbered_message_t> > messages(num_threads);
+    std::vector<int> last_seen(num_threads, -1);
+    int remaining = num_threads * num_messages;
+    cond_t done;
+    for (int i = 0; i < num_threads; ++i) {
+        messages[i].init(num_messages);
+    }
+
+    pmap(num_threads, boost::bind(&send_numbered_messages, num_messages, messages.data(),
+                                  last_seen.data(), &remaining, &done, _1));
+    done.wait();
+
+    for (int i = 0; i < num_threads; ++i) {
+        EXPECT_EQ(num_messages - 1, last_seen[i]);
+    }
+}
+
+TEST(MessageHubTest, Ordering) {
+    run_in_thread_pool(&run_ordering_test, 4);
+}
+
+}  // namespace unittest
@@ -3,7 +3,11 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
 #include "buffer_cache/buffer_cache.hpp"
+#include "buffer_cache/mirrored/cache_balancer.hpp"
+#include "perfmon/core.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "serializer/config.hpp"
 #include "serializer/translator.hpp"
@@ -130,5 +134,222 @@ TEST(MirroredTest, Durability) {
     unittest::run_in_thread_pool(boost::bind(&durability_tester_t::check_snapshotted_file_contents, &tester));
 }
 
+/* A mock file with a serializer on it, split between `num_caches` proxies, each of
+which has had a cache created on it.  This must be made in a thread pool. */
+class test_cache_files_t {
+public:
+    explicit test_cache_files_t(int num_caches) {
+        standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+        log_serializer.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                                      &file_opener,
+                                                      &get_global_perfmon_collection()));
+
+        std::vector<standard_serializer_t *> serializers;
+        serializers.push_back(log_serializer.get());
+        serializer_multiplexer_t::create(serializers, num_caches);
+        multiplexer.init(new serializer_multiplexer_t(serializers));
+        for (int i = 0; i < num_caches; ++i) {
+            mc_cache_t::create(serializer(i));
+        }
+    }
+
+    translator_serializer_t *serializer(int i) const {
+        return multiplexer->proxies[i];
+    }
+
+    int64_t block_size() const {
+        return log_serializer->get_block_size().ser_value();
+    }
+
+    // Writes `count` new blocks through a cache big enough to hold all of them, and
+    // makes sure they hit the disk.  Each block holds its index in `block_ids`.
+    void write_blocks(int i, int count, std::vector<block_id_t> *block_ids) const {
+        mirrored_cache_config_t cache_cfg;
+        cache_cfg.max_size = GIGABYTE;
+        mc_cache_t cache(serializer(i), cache_cfg, &get_global_perfmon_collection());
+        mc_transaction_t txn(&cache, rwi_write, 0, repli_timestamp_t::distant_past,
+                             order_token_t::ignore, WRITE_DURABILITY_HARD);
+        for (int j = 0; j < count; ++j) {
+            mc_buf_lock_t buf(&txn);
+            *static_cast<int *>(buf.get_data_write()) = block_ids->size();
+            block_ids->push_back(buf.get_block_id());
+        }
+    }
+
+private:
+    mock_file_opener_t file_opener;
+    scoped_ptr_t<standard_serializer_t> log_serializer;
+    scoped_ptr_t<serializer_multiplexer_t> multiplexer;
+
+    DISABLE_COPYING(test_cache_files_t);
+};
+
+// Reads the `n`th block written by `test_cache_files_t::write_blocks`.
+void read_test_block(mc_transaction_t *txn, const std::vector<block_id_t> &block_ids,
+                     int n) {
+    mc_buf_lock_t buf(txn, block_ids[n], rwi_read);
+    ASSERT_EQ(n, *static_cast<const int *>(buf.get_data_read()));
+}
+
+void read_test_block(mc_cache_t *cache, const std::vector<block_id_t> &block_ids, int n) {
+    mc_transaction_t txn(cache, rwi_read, order_token_t::ignore);
+    read_test_block(&txn, block_ids, n);
+}
+
+/* Reads a small hot set twice and then scans past it with more blocks than the cache
+holds.  With 2Q the hot set is protected and the scan, which reads each block once,
+protects nothing; the random policy never protects anything.  Which blocks get
+evicted depends on the page replacement's random sampling, so this only checks the
+bookkeeping; bench/cache_bench.cc measures how well the hot set survives. */
+void run_scan_resistance_test(page_repl_policy_t policy) {
+    const int num_hot_blocks = 64;
+    const int num_scan_blocks = 1024;
+    const int cache_blocks = 128;
+
+    test_cache_files_t files(1);
+    std::vector<block_id_t> block_ids;
+    files.write_blocks(0, num_hot_blocks + num_scan_blocks, &block_ids);
+
+    mirrored_cache_config_t cache_cfg;
+    cache_cfg.max_size = cache_blocks * files.block_size();
+    cache_cfg.page_repl_policy = policy;
+    perfmon_collection_t stats;
+    mc_cache_t cache(files.serializer(0), cache_cfg, &stats);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < num_hot_blocks; ++i) {
+            read_test_block(&cache, block_ids, i);
+        }
+    }
+    // Nothing has been evicted yet.
+    EXPECT_EQ(policy == PAGE_REPL_POLICY_2Q ? num_hot_blocks : 0,
+              get_stat_counter(&stats, "cache", "blocks_protected"));
+
+    for (int i = num_hot_blocks; i < num_hot_blocks + num_scan_blocks; ++i) {
+        read_test_block(&cache, block_ids, i);
+    }
+
+    int hot_left = 0;
+    for (int i = 0; i < num_hot_blocks; ++i) {
+        hot_left += cache.contains_block(block_ids[i]) ? 1 : 0;
+    }
+    EXPECT_EQ(policy == PAGE_REPL_POLICY_2Q ? hot_left : 0,
+              get_stat_counter(&stats, "cache", "blocks_protected"));
+}
+
+TEST(MirroredTest, ScanResistance) {
+    unittest::run_in_thread_pool(boost::bind(&run_scan_resistance_test,
+                                             PAGE_REPL_POLICY_RANDOM));
+    unittest::run_in_thread_pool(boost::bind(&run_scan_resistance_test,
+                                             PAGE_REPL_POLICY_2Q));
+}
+
+/* Two caches share a budget. One of them keeps reading a working set that is bigger
+than its half of the budget while the other one sits idle, so the balancer should
+move memory from the idle cache to the busy one. */
+void run_cache_balancer_test() {
+    test_cache_files_t files(2);
+    const int num_blocks = 24 * MEGABYTE / files.block_size();
+    std::vector<block_id_t> block_ids;
+    files.write_blocks(0, num_blocks, &block_ids);
+
+    cache_balancer_t balancer(32 * MEGABYTE, 20);
+    mirrored_cache_config_t cache_cfg;
+    cache_cfg.max_size = 16 * MEGABYTE;
+    cache_cfg.max_dirty_size = 8 * MEGABYTE;
+    cache_cfg.balancer = &balancer;
+
+    mc_cache_t busy(files.serializer(0), cache_cfg, &get_global_perfmon_collection());
+    mc_cache_t idle(files.serializer(1), cache_cfg, &get_global_perfmon_collection());
+    ASSERT_EQ(16 * MEGABYTE, busy.get_max_size());
+    ASSERT_EQ(16 * MEGABYTE, idle.get_max_size());
+
+    // Keep the busy cache busy until the balancer has given it room for all of its
+    // working set, yielding so that the balancer's rounds get to run.
+    signal_timer_t timeout;
+    timeout.start(60 * THOUSAND);
+    while (busy.get_max_size() < 24 * MEGABYTE && !timeout.is_pulsed()) {
+        read_test_block(&busy, block_ids, randint(num_blocks));
+        coro_t::yield();
+    }
+
+    EXPECT_GE(busy.get_max_size(), 24 * MEGABYTE);
+    EXPECT_EQ(CACHE_BALANCER_MIN_CACHE_SIZE, idle.get_max_size());
+    EXPECT_LE(busy.get_max_size() + idle.get_max_size(), balancer.get_total_size());
+
+    // The dirty limits moved with the cache sizes.
+    EXPECT_NEAR(busy.get_max_size() / 2, busy.get_max_dirty_size(), files.block_size());
+    EXPECT_NEAR(idle.get_max_size() / 2, idle.get_max_dirty_size(), files.block_size());
+}
+
+TEST(MirroredTest, CacheBalancer) {
+    unittest::run_in_thread_pool(run_cache_balancer_test);
+}
+
+/* Blocks that a scan prefetched and then read once should stay probationary, so
+that a later scan pushes them out, unlike blocks that really were read twice. */
+void run_prefetch_test() {
+    const int num_prefetched_blocks = 64;
+    const int num_hot_blocks = 32;
+    const int num_scan_blocks = 1024;
+    const int cache_blocks = 256;
+
+    test_cache_files_t files(1);
+    std::vector<block_id_t> block_ids;
+    files.write_blocks(0, num_prefetched_blocks + num_hot_blocks + num_scan_blocks,
+                       &block_ids);
+
+    mirrored_cache_config_t cache_cfg;
+    cache_cfg.max_size = cache_blocks * files.block_size();
+    cache_cfg.page_repl_policy = PAGE_REPL_POLICY_2Q;
+
+    {
+        // Nobody waits for these, so the destructor has to.
+        mc_cache_t cache(files.serializer(0), cache_cfg, &get_global_perfmon_collection());
+        mc_transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+        for (int i = 0; i < num_prefetched_blocks; ++i) {
+            txn.prefetch_block(block_ids[i]);
+        }
+    }
+
+    mc_cache_t cache(files.serializer(0), cache_cfg, &get_global_perfmon_collection());
+    mc_transaction_t txn(&cache, rwi_read, order_token_t::ignore);
+
+    for (int i = 0; i < num_prefetched_blocks; ++i) {
+        EXPECT_FALSE(txn.prefetch_block(block_ids[i]));
+    }
+    for (int i = 0; i < num_prefetched_blocks; ++i) {
+        read_test_block(&txn, block_ids, i);
+    }
+    for (int i = 0; i < num_prefetched_blocks; ++i) {
+        EXPECT_TRUE(txn.prefetch_block(block_ids[i]));
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = num_prefetched_blocks; i < num_prefetched_blocks + num_hot_blocks; ++i) {
+            read_test_block(&txn, block_ids, i);
+        }
+    }
+
+    for (int i = num_prefetched_blocks + num_hot_blocks; i < static_cast<int>(block_ids.size()); ++i) {
+        read_test_block(&txn, block_ids, i);
+    }
+
+    int prefetched_left = 0;
+    for (int i = 0; i < num_prefetched_blocks; ++i) {
+        prefetched_left += cache.contains_block(block_ids[i]) ? 1 : 0;
+    }
+    int hot_left = 0;
+    for (int i = num_prefetched_blocks; i < num_prefetched_blocks + num_hot_blocks; ++i) {
+        hot_left += cache.contains_block(block_ids[i]) ? 1 : 0;
+    }
+    EXPECT_LT(prefetched_left, num_prefetched_blocks / 2);
+    EXPECT_GT(hot_left, num_hot_blocks * 9 / 10);
+}
+
+TEST(MirroredTest, Prefetch) {
+    unittest::run_in_thread_pool(run_prefetch_test);
+}
+
 }  // namespace unittest
 
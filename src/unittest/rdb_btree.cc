@@ -1,4 +1,10 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <inttypes.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include "errors.hpp"
 #include <boost/bind.hpp>
@@ -19,7 +25,9 @@
 #include "unittest/unittest_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
 
-#define TOTAL_KEYS_TO_INSERT 1000
+// Enough rows that post-construction writes them in more than one batch (see
+// SINDEX_POST_CONSTRUCTION_BATCH_SIZE).
+#define TOTAL_KEYS_TO_INSERT 3000
 #define MAX_RETRIES_FOR_SINDEX_POSTCONSTRUCT 5
 
 #pragma GCC diagnostic ignored "-Wshadow"
@@ -324,6 +332,8 @@ void run_sindex_post_construction() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -368,6 +378,8 @@ void run_erase_range_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -438,6 +450,8 @@ void run_sindex_interruption_via_drop_test() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -483,6 +497,8 @@ void run_sindex_interruption_via_store_delete() {
             &serializer,
             "unit_test_store",
             GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
             true,
             &get_global_perfmon_collection(),
             NULL,
@@ -504,4 +520,214 @@ TEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     run_in_thread_pool(&run_sindex_interruption_via_store_delete);
 }
 
+/* Writes every row it is given with a count of how many times it has been written
+and the index in the batch that last wrote it, or deletes it. */
+class counting_replacer_t : public btree_batched_replacer_t {
+public:
+    counting_replacer_t(const std::vector<int> *_ids, int _sid_offset, bool _delete_rows)
+        : ids(_ids), sid_offset(_sid_offset), delete_rows(_delete_rows) { }
+
+    counted_t<const ql::datum_t> replace(
+        const counted_t<const ql::datum_t> &d, size_t index) const {
+        if (delete_rows) {
+            return make_counted<ql::datum_t>(ql::datum_t::R_NULL);
+        }
+        int64_t count = 1;
+        if (d->get_type() != ql::datum_t::R_NULL) {
+            count += d->get("count")->as_int();
+        }
+        const int id = (*ids)[index];
+        std::string data = strprintf(
+            "{\"id\" : %d, \"sid\" : %d, \"count\" : %" PRIi64 ", \"last\" : %zu}",
+            id, sid_offset + id, count, index);
+        return make_counted<ql::datum_t>(scoped_cJSON_t(cJSON_Parse(data.c_str())));
+    }
+    bool should_return_vals() const { return false; }
+
+private:
+    const std::vector<int> *const ids;
+    const int sid_offset;
+    const bool delete_rows;
+};
+
+void batched_replace_rows(btree_store_t<rdb_protocol_t> *store,
+                          const std::vector<int> &ids,
+                          int sid_offset,
+                          bool delete_rows) {
+    cond_t dummy_interruptor;
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> real_superblock;
+    write_token_pair_t token_pair;
+    store->new_write_token_pair(&token_pair);
+    store->acquire_superblock_for_write(
+        rwi_write, repli_timestamp_t::invalid,
+        1, WRITE_DURABILITY_SOFT,
+        &token_pair, &txn, &real_superblock, &dummy_interruptor);
+    block_id_t sindex_block_id = real_superblock->get_sindex_block_id();
+    scoped_ptr_t<superblock_t> superblock(real_superblock.release());
+
+    std::vector<store_key_t> keys;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        keys.push_back(store_key_t(
+            make_counted<const ql::datum_t>(double(ids[i]))->print_primary()));
+    }
+
+    const std::string primary_key("id");
+    counting_replacer_t replacer(&ids, sid_offset, delete_rows);
+    rdb_modification_report_cb_t sindex_cb(
+        store, &token_pair, txn.get(), sindex_block_id,
+        auto_drainer_t::lock_t(&store->drainer));
+    batched_replace_response_t response = rdb_batched_replace(
+        btree_info_t(store->btree.get(), repli_timestamp_t::invalid, txn.get(),
+                     &primary_key),
+        &superblock, keys, &replacer, &sindex_cb);
+    ASSERT_FALSE(response->get("errors", ql::NOTHROW).has()) << response->print();
+}
+
+counted_t<const ql::datum_t> get_row(btree_store_t<rdb_protocol_t> *store, int id) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    point_read_response_t response;
+    rdb_get(store_key_t(make_counted<const ql::datum_t>(double(id))->print_primary()),
+            store->btree.get(), NULL, txn.get(), super_block.get(), &response);
+    return response.data;
+}
+
+size_t count_sindex_rows(btree_store_t<rdb_protocol_t> *store,
+                         const std::string &sindex_id, int sid) {
+    cond_t dummy_interruptor;
+    read_token_pair_t token_pair;
+    store->new_read_token_pair(&token_pair);
+
+    scoped_ptr_t<transaction_t> txn;
+    scoped_ptr_t<real_superblock_t> super_block;
+    store->acquire_superblock_for_read(rwi_read,
+            &token_pair.main_read_token, &txn, &super_block,
+            &dummy_interruptor, true);
+
+    scoped_ptr_t<real_superblock_t> sindex_sb;
+    bool sindex_exists = store->acquire_sindex_superblock_for_read(sindex_id,
+            super_block->get_sindex_block_id(), &token_pair,
+            txn.get(), &sindex_sb,
+            static_cast<std::vector<char>*>(NULL), &dummy_interruptor);
+    guarantee(sindex_exists);
+
+    rdb_protocol_t::rget_read_response_t res;
+    store_key_t sid_key(make_counted<const ql::datum_t>(double(sid))->print_primary());
+    rdb_rget_slice(store->get_sindex_slice(sindex_id),
+        rdb_protocol_t::sindex_key_range(sid_key, sid_key),
+        txn.get(), sindex_sb.get(), NULL, rdb_protocol_details::transform_t(),
+        boost::optional<rdb_protocol_details::terminal_t>(), ASCENDING, &res);
+
+    rdb_protocol_t::rget_read_response_t::stream_t *stream
+        = boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&res.result);
+    guarantee(stream != NULL);
+    return stream->size();
+}
+
+struct expected_row_t {
+    int sid;
+    int64_t count;
+    size_t last;
+};
+
+/* Writes random batches of rows, with repeated keys, through rdb_batched_replace
+into a store with a secondary index, and checks the rows and the index entries
+against what writing them one after the other would have left. The batches are big
+enough to split leaves while they are written. */
+void run_batched_replace_test() {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    rdb_protocol_t::store_t store(
+            &serializer,
+            "unit_test_store",
+            GIGABYTE,
+            NULL,
+            PAGE_REPL_POLICY_2Q,
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."));
+
+    std::string sindex_id = create_sindex(&store);
+    bring_sindexes_up_to_date(&store, sindex_id);
+
+    const int key_space = 2000;
+    std::map<int, expected_row_t> expected;
+    std::set<int> stale_sids;
+    for (int round = 0; round < 12; ++round) {
+        std::vector<int> ids;
+        for (int i = 0; i < 600; ++i) {
+            ids.push_back(random() % key_space);
+        }
+        // Every fourth batch deletes, which merges and levels the leaves.
+        const bool delete_rows = round % 4 == 3;
+        const int sid_offset = round * key_space;
+        batched_replace_rows(&store, ids, sid_offset, delete_rows);
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            std::map<int, expected_row_t>::iterator it = expected.find(ids[i]);
+            if (it != expected.end() && it->second.sid != sid_offset + ids[i]) {
+                stale_sids.insert(it->second.sid);
+            }
+            if (delete_rows) {
+                if (it != expected.end()) {
+                    stale_sids.insert(it->second.sid);
+                    expected.erase(it);
+                }
+            } else if (it == expected.end()) {
+                expected_row_t row = { sid_offset + ids[i], 1, i };
+                expected[ids[i]] = row;
+            } else {
+                it->second.sid = sid_offset + ids[i];
+                it->second.count += 1;
+                it->second.last = i;
+            }
+        }
+    }
+
+    for (int id = 0; id < key_space; ++id) {
+        counted_t<const ql::datum_t> row = get_row(&store, id);
+        std::map<int, expected_row_t>::iterator it = expected.find(id);
+        if (it == expected.end()) {
+            ASSERT_EQ(ql::datum_t::R_NULL, row->get_type()) << id;
+            continue;
+        }
+        ASSERT_EQ(ql::datum_t::R_OBJECT, row->get_type()) << id;
+        ASSERT_EQ(it->second.sid, row->get("sid")->as_int()) << id;
+        ASSERT_EQ(it->second.count, row->get("count")->as_int()) << id;
+        ASSERT_EQ(static_cast<int64_t>(it->second.last), row->get("last")->as_int()) << id;
+        ASSERT_EQ(1u, count_sindex_rows(&store, sindex_id, it->second.sid)) << id;
+    }
+    for (std::set<int>::iterator it = stale_sids.begin(); it != stale_sids.end(); ++it) {
+        ASSERT_EQ(0u, count_sindex_rows(&store, sindex_id, *it)) << *it;
+    }
+}
+
+TEST(RDBBtree, BatchedReplace) {
+    run_in_thread_pool(&run_batched_replace_test);
+}
+
 } //namespace unittest
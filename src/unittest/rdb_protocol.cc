@@ -1,15 +1,25 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/make_shared.hpp>
 
+#include "arch/timing.hpp"
 #include "buffer_cache/buffer_cache.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "containers/iterators.hpp"
 #include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "memcached/protocol.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/stream.hpp"
+#include "rdb_protocol/transform_visitors.hpp"
 #include "rpc/directory/read_manager.hpp"
 #include "rpc/semilattice/semilattice_manager.hpp"
 #include "serializer/config.hpp"
@@ -83,9 +93,11 @@ void run_with_namespace_interface(boost::function<void(namespace_interface_t<rdb
     for (size_t i = 0; i < store_shards.size(); ++i) {
         underlying_stores.push_back(
                 new rdb_protocol_t::store_t(serializers[i].get(),
-                    temp_files[i].name().permanent_path(), GIGABYTE, true,
-                    &get_global_perfmon_collection(), &ctx,
+                    temp_files[i].name().permanent_path(), GIGABYTE, NULL,
+                    PAGE_REPL_POLICY_2Q, true, &get_global_perfmon_collection(), &ctx,
                     &io_backender, base_path_t(".")));
+        // So that the reads of the tests go through key filters right away.
+        underlying_stores.back().set_key_filter_mode(KEY_FILTER_MODE_ON);
     }
 
     boost::ptr_vector<store_view_t<rdb_protocol_t> > stores;
@@ -477,5 +489,351 @@ TEST(RDBProtocol, OvershardedMissingAttr) {
     run_in_thread_pool_with_namespace_interface(&run_sindex_missing_attr_test, true);
 }
 
+// Reads the first `k` rows in the order of their "sid", which each shard
+// computes for its own rows.
+std::vector<counted_t<const ql::datum_t> > read_topk(
+        namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+        size_t k, ql::order_direction_t direction) {
+    const ql::sym_t arg(1);
+    ql::protob_t<const Term> mapping = ql::r::var(arg)["sid"].release_counted();
+    ql::map_wire_func_t m(mapping, make_vector(arg), get_backtrace(mapping));
+    ql::topk_wire_func_t topk(k, make_vector(std::make_pair(direction,
+                                                            m.compile_wire_func())));
+
+    ql::protob_t<const Term> db = ql::r::db("test").release_counted();
+    std::map<std::string, ql::wire_func_t> optargs;
+    optargs["db"] = ql::wire_func_t(db, std::vector<ql::sym_t>(), get_backtrace(db));
+
+    rdb_protocol_t::rget_read_t rget(rdb_protocol_t::region_t::universe(),
+                                     rdb_protocol_details::terminal_t(topk), optargs);
+    rdb_protocol_t::read_t read(rget);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response, osource->check_in("unittest::read_topk(rdb_protocol_t.cc-A"), &interruptor);
+
+    rdb_protocol_t::rget_read_response_t *rget_resp =
+        boost::get<rdb_protocol_t::rget_read_response_t>(&response.response);
+    guarantee(rget_resp != NULL);
+    rdb_protocol_t::rget_read_response_t::stream_t *heap =
+        boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&rget_resp->result);
+    guarantee(heap != NULL);
+
+    counted_t<const ql::datum_t> arr = query_language::topk_to_array(topk, heap);
+    std::vector<counted_t<const ql::datum_t> > rows;
+    for (size_t i = 0; i < arr->size(); ++i) {
+        rows.push_back(arr->get(i));
+    }
+    return rows;
+}
+
+void run_topk_test(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource) {
+    // Rows 0 through 99 have every "sid" from 0 to 99 once; the last three
+    // rows have none.
+    const int num_rows = 103;
+    for (int i = 0; i < num_rows; ++i) {
+        ql::datum_ptr_t row(ql::datum_t::R_OBJECT);
+        UNUSED bool b = row.add("id", make_counted<const ql::datum_t>(static_cast<double>(i)));
+        if (i < 100) {
+            b = row.add("sid", make_counted<const ql::datum_t>(static_cast<double>((i * 37) % 100)));
+        }
+        counted_t<const ql::datum_t> data = row.to_counted();
+
+        rdb_protocol_t::write_t write(
+            rdb_protocol_t::point_write_t(store_key_t(data->get("id")->print_primary()), data),
+            DURABILITY_REQUIREMENT_DEFAULT);
+        rdb_protocol_t::write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("unittest::run_topk_test(rdb_protocol_t.cc-A"), &interruptor);
+        ASSERT_TRUE(boost::get<rdb_protocol_t::point_write_response_t>(&response.response) != NULL);
+    }
+
+    // Rows without a "sid" come first, like they do in `order_by`.
+    std::vector<counted_t<const ql::datum_t> > asc = read_topk(nsi, osource, 10, ql::ASC);
+    ASSERT_EQ(10u, asc.size());
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_FALSE(asc[i]->get("sid", ql::NOTHROW).has());
+    }
+    for (size_t i = 3; i < asc.size(); ++i) {
+        ASSERT_EQ(static_cast<double>(i - 3), asc[i]->get("sid")->as_num());
+    }
+
+    std::vector<counted_t<const ql::datum_t> > desc = read_topk(nsi, osource, 10, ql::DESC);
+    ASSERT_EQ(10u, desc.size());
+    for (size_t i = 0; i < desc.size(); ++i) {
+        ASSERT_EQ(static_cast<double>(99 - i), desc[i]->get("sid")->as_num());
+    }
+
+    // Asking for more rows than there are gets all of them.
+    ASSERT_EQ(static_cast<size_t>(num_rows), read_topk(nsi, osource, 1000, ql::ASC).size());
+    ASSERT_TRUE(read_topk(nsi, osource, 0, ql::ASC).empty());
+}
+
+TEST(RDBProtocol, TopK) {
+    run_in_thread_pool_with_namespace_interface(&run_topk_test, false);
+}
+
+TEST(RDBProtocol, OvershardedTopK) {
+    run_in_thread_pool_with_namespace_interface(&run_topk_test, true);
+}
+
+counted_t<const ql::datum_t> key_filter_test_row(int id) {
+    // Every even "sid" below 100 ends up in use, and no odd one does.
+    ql::datum_ptr_t row(ql::datum_t::R_OBJECT);
+    UNUSED bool b = row.add("id", make_counted<const ql::datum_t>(static_cast<double>(id)));
+    b = row.add("sid", make_counted<const ql::datum_t>(static_cast<double>(2 * (id % 50))));
+    return row.to_counted();
+}
+
+store_key_t key_filter_test_key(int id) {
+    return store_key_t(make_counted<const ql::datum_t>(static_cast<double>(id))->print_primary());
+}
+
+void check_point_reads(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                       int num_rows, int num_missing) {
+    for (int i = 0; i < num_rows + num_missing; ++i) {
+        rdb_protocol_t::read_t read(rdb_protocol_t::point_read_t(key_filter_test_key(i)));
+        rdb_protocol_t::read_response_t response;
+
+        cond_t interruptor;
+        nsi->read(read, &response, osource->check_in("unittest::check_point_reads(rdb_protocol_t.cc-A"), &interruptor);
+
+        rdb_protocol_t::point_read_response_t *res =
+            boost::get<rdb_protocol_t::point_read_response_t>(&response.response);
+        ASSERT_TRUE(res != NULL);
+        ASSERT_TRUE(res->data.has());
+        if (i < num_rows) {
+            ASSERT_EQ(*key_filter_test_row(i), *res->data) << "row " << i;
+        } else {
+            ASSERT_EQ(ql::datum_t(ql::datum_t::R_NULL), *res->data) << "row " << i;
+        }
+    }
+}
+
+void check_batched_point_read(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                              int num_rows, int num_missing) {
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < num_rows + num_missing; ++i) {
+        keys.push_back(key_filter_test_key(i));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    rdb_protocol_t::batched_point_read_t batched_read(keys);
+    rdb_protocol_t::read_t read(batched_read);
+    rdb_protocol_t::read_response_t response;
+
+    cond_t interruptor;
+    nsi->read(read, &response, osource->check_in("unittest::check_batched_point_read(rdb_protocol_t.cc-A"), &interruptor);
+
+    rdb_protocol_t::batched_point_read_response_t *res =
+        boost::get<rdb_protocol_t::batched_point_read_response_t>(&response.response);
+    ASSERT_TRUE(res != NULL);
+    // The missing keys are left out.
+    ASSERT_EQ(static_cast<size_t>(num_rows), res->data.size());
+    for (int i = 0; i < num_rows; ++i) {
+        auto it = res->data.find(key_filter_test_key(i));
+        ASSERT_TRUE(it != res->data.end()) << "row " << i;
+        ASSERT_EQ(*key_filter_test_row(i), *it->second) << "row " << i;
+    }
+}
+
+void check_get_alls(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource,
+                    const std::string &sindex_id, int num_rows) {
+    for (int sid = 0; sid < 100; ++sid) {
+        counted_t<const ql::datum_t> sindex_key_literal
+            = make_counted<const ql::datum_t>(static_cast<double>(sid));
+        rdb_protocol_t::read_t read(rdb_protocol_t::rget_read_t(
+            sindex_id, sindex_range_t(sindex_key_literal, false, sindex_key_literal, false)));
+        rdb_protocol_t::read_response_t response;
+
+        cond_t interruptor;
+        nsi->read(read, &response, osource->check_in("unittest::check_get_alls(rdb_protocol_t.cc-A"), &interruptor);
+
+        rdb_protocol_t::rget_read_response_t *rget_resp =
+            boost::get<rdb_protocol_t::rget_read_response_t>(&response.response);
+        ASSERT_TRUE(rget_resp != NULL);
+        rdb_protocol_t::rget_read_response_t::stream_t *stream =
+            boost::get<rdb_protocol_t::rget_read_response_t::stream_t>(&rget_resp->result);
+        ASSERT_TRUE(stream != NULL);
+
+        std::set<int> expected_ids;
+        for (int i = sid / 2; sid % 2 == 0 && i < num_rows; i += 50) {
+            expected_ids.insert(i);
+        }
+        std::set<int> ids;
+        for (auto it = stream->begin(); it != stream->end(); ++it) {
+            ASSERT_EQ(sid, it->data->get("sid")->as_num());
+            ids.insert(it->data->get("id")->as_int());
+        }
+        ASSERT_EQ(expected_ids.size(), stream->size()) << "sid " << sid;
+        ASSERT_TRUE(expected_ids == ids) << "sid " << sid;
+    }
+}
+
+/* `KeyFilter` checks that the key filters never hide a row from point reads, batched
+point reads or get_all. The first reads create the filters of the primary btree and
+of the sindex, and the rows of the next round get written while those are being built.
+Later on the primary filter gets more keys than its first build made room for, and
+the rows of that round get written while it is rebuilt at a bigger size. */
+void run_key_filter_test(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource) {
+    std::string sindex_id = create_sindex(nsi, osource);
+
+    const int num_rounds = 6;
+    const int rows_per_round = 1000;
+    int num_rows = 0;
+    for (int round = 0; round < num_rounds; ++round) {
+        for (int j = 0; j < rows_per_round; ++j, ++num_rows) {
+            counted_t<const ql::datum_t> data = key_filter_test_row(num_rows);
+            rdb_protocol_t::write_t write(
+                rdb_protocol_t::point_write_t(key_filter_test_key(num_rows), data),
+                DURABILITY_REQUIREMENT_DEFAULT);
+            rdb_protocol_t::write_response_t response;
+
+            cond_t interruptor;
+            nsi->write(write, &response, osource->check_in("unittest::run_key_filter_test(rdb_protocol_t.cc-A"), &interruptor);
+            ASSERT_TRUE(boost::get<rdb_protocol_t::point_write_response_t>(&response.response) != NULL);
+        }
+
+        check_point_reads(nsi, osource, num_rows, rows_per_round / 10);
+        check_batched_point_read(nsi, osource, num_rows, rows_per_round / 10);
+        check_get_alls(nsi, osource, sindex_id, num_rows);
+
+        // Give the filters time to get built, so that the reads of the next round
+        // go through them.
+        nap(100);
+    }
+}
+
+TEST(RDBProtocol, KeyFilter) {
+    run_in_thread_pool_with_namespace_interface(&run_key_filter_test, false);
+}
+
+TEST(RDBProtocol, OvershardedKeyFilter) {
+    run_in_thread_pool_with_namespace_interface(&run_key_filter_test, true);
+}
+
+std::string ordered_rget_test_id(int id) {
+    return strprintf("%c%05d", 'a' + id % 26, id);
+}
+
+counted_t<const ql::datum_t> ordered_rget_test_row(int id, int num_rows) {
+    // The "sid"s are all different, in an order that has nothing to do with the
+    // ids. The padding makes every shard send back its rows in several chunks.
+    ql::datum_ptr_t row(ql::datum_t::R_OBJECT);
+    UNUSED bool b = row.add("id", make_counted<const ql::datum_t>(ordered_rget_test_id(id)));
+    b = row.add("sid", make_counted<const ql::datum_t>(
+                    static_cast<double>((id * 37) % num_rows)));
+    b = row.add("padding", make_counted<const ql::datum_t>(std::string(2000, 'x')));
+    return row.to_counted();
+}
+
+std::vector<counted_t<const ql::datum_t> > read_stream(query_language::json_stream_t *stream,
+                                                       ql::env_t *env) {
+    std::vector<counted_t<const ql::datum_t> > rows;
+    while (counted_t<const ql::datum_t> row = stream->next(env)) {
+        rows.push_back(row);
+    }
+    return rows;
+}
+
+/* `OrderedRget` reads a table in primary key order and in sindex order, both ways,
+and checks that it gets every row exactly once and in order. A sorted read keeps a
+cursor on every shard and merges them; each shard has several chunks of rows. */
+void run_ordered_rget_test(namespace_interface_t<rdb_protocol_t> *nsi, order_source_t *osource) {
+    std::string sindex_id = create_sindex(nsi, osource);
+
+    const int num_rows = 3000;
+    std::vector<store_key_t> primary_keys;
+    for (int i = 0; i < num_rows; ++i) {
+        counted_t<const ql::datum_t> data = ordered_rget_test_row(i, num_rows);
+        // Printed primary keys all start with their type, which puts them all on
+        // the same side of the shard boundary at "n". The raw ids fall on both.
+        store_key_t pk(ordered_rget_test_id(i));
+        primary_keys.push_back(pk);
+
+        rdb_protocol_t::write_t write(rdb_protocol_t::point_write_t(pk, data),
+                                      DURABILITY_REQUIREMENT_DEFAULT);
+        rdb_protocol_t::write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("unittest::run_ordered_rget_test(rdb_protocol_t.cc-A"), &interruptor);
+        ASSERT_TRUE(boost::get<rdb_protocol_t::point_write_response_t>(&response.response) != NULL);
+    }
+    std::sort(primary_keys.begin(), primary_keys.end());
+
+    ASSERT_EQ(2u, nsi->get_sharding_scheme().size());
+
+    dummy_namespace_repo_t<rdb_protocol_t> ns_repo(nsi);
+    cond_t interruptor;
+    ql::env_t env(&interruptor);
+    namespace_repo_t<rdb_protocol_t>::access_t ns_access(&ns_repo, generate_uuid(), &interruptor);
+    const std::map<std::string, ql::wire_func_t> optargs;
+
+    const sorting_t sortings[] = { ASCENDING, DESCENDING };
+    for (size_t s = 0; s < sizeof(sortings) / sizeof(sortings[0]); ++s) {
+        const bool ascending = sortings[s] == ASCENDING;
+
+        {
+            boost::shared_ptr<query_language::json_stream_t> stream(
+                new query_language::batched_rget_stream_t(
+                    ns_access,
+                    counted_t<const ql::datum_t>(), false,
+                    counted_t<const ql::datum_t>(), false,
+                    optargs, false, sortings[s], NULL));
+            std::vector<counted_t<const ql::datum_t> > rows = read_stream(stream.get(), &env);
+            ASSERT_EQ(static_cast<size_t>(num_rows), rows.size());
+            for (int i = 0; i < num_rows; ++i) {
+                const store_key_t &expected = ascending
+                    ? primary_keys[i]
+                    : primary_keys[num_rows - 1 - i];
+                ASSERT_EQ(expected, store_key_t(rows[i]->get("id")->as_str()))
+                    << "row " << i;
+            }
+        }
+
+        {
+            boost::shared_ptr<query_language::json_stream_t> stream(
+                new query_language::batched_rget_stream_t(
+                    ns_access, sindex_id,
+                    counted_t<const ql::datum_t>(), false,
+                    counted_t<const ql::datum_t>(), false,
+                    optargs, false, sortings[s], NULL));
+            std::vector<counted_t<const ql::datum_t> > rows = read_stream(stream.get(), &env);
+            ASSERT_EQ(static_cast<size_t>(num_rows), rows.size());
+            for (int i = 0; i < num_rows; ++i) {
+                const int expected = ascending ? i : num_rows - 1 - i;
+                ASSERT_EQ(expected, rows[i]->get("sid")->as_int()) << "row " << i;
+            }
+        }
+
+        {
+            // Part of the sindex, with one end open.
+            const int start = num_rows / 3;
+            const int end = 2 * num_rows / 3;
+            boost::shared_ptr<query_language::json_stream_t> stream(
+                new query_language::batched_rget_stream_t(
+                    ns_access, sindex_id,
+                    make_counted<const ql::datum_t>(static_cast<double>(start)), false,
+                    make_counted<const ql::datum_t>(static_cast<double>(end)), true,
+                    optargs, false, sortings[s], NULL));
+            std::vector<counted_t<const ql::datum_t> > rows = read_stream(stream.get(), &env);
+            ASSERT_EQ(static_cast<size_t>(end - start), rows.size());
+            for (int i = 0; i < end - start; ++i) {
+                const int expected = ascending ? start + i : end - 1 - i;
+                ASSERT_EQ(expected, rows[i]->get("sid")->as_int()) << "row " << i;
+            }
+        }
+    }
+}
+
+TEST(RDBProtocol, OrderedRget) {
+    run_in_thread_pool_with_namespace_interface(&run_ordered_rget_test, false);
+}
+
+TEST(RDBProtocol, OvershardedOrderedRget) {
+    run_in_thread_pool_with_namespace_interface(&run_ordered_rget_test, true);
+}
+
 }   /* namespace unittest */
 
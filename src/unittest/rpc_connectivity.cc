@@ -1,4 +1,6 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
@@ -28,11 +30,8 @@ public:
         public:
             explicit writer_t(int _data) : data(_data) { }
             virtual ~writer_t() { }
-            void write(write_stream_t *stream) {
-                write_message_t msg;
-                msg << data;
-                int res = send_write_message(stream, &msg);
-                if (res) { throw fake_archive_exc_t(); }
+            void write(write_message_t *msg) {
+                *msg << data;
             }
             int32_t data;
         } writer(message);
@@ -197,6 +196,42 @@ TEST(RPCConnectivityTest, OrderingMultiThread) {
     unittest::run_in_thread_pool(&run_ordering_test, 3);
 }
 
+/* `BatchedOrdering` checks that messages still arrive, and in order, when the
+send queue holds them back to coalesce them into larger writes. */
+
+void run_batched_ordering_test() {
+    cluster_send_batching_t batching;
+    batching.flush_delay_ms = 5;
+    batching.flush_bytes = 1024;
+
+    connectivity_cluster_t c1, c2;
+    c1.set_send_batching(batching);
+    recording_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    const int num_messages = 1000;
+    for (int i = 0; i < num_messages; i++) {
+        a1.send(i, c2.get_me());
+    }
+
+    let_stuff_happen();
+
+    for (int i = 0; i < num_messages - 1; i++) {
+        a2.expect_order(i, i+1);
+    }
+}
+TEST(RPCConnectivityTest, BatchedOrdering) {
+    unittest::run_in_thread_pool(&run_batched_ordering_test);
+}
+TEST(RPCConnectivityTest, BatchedOrderingMultiThread) {
+    unittest::run_in_thread_pool(&run_batched_ordering_test, 3);
+}
+
 /* `GetPeersList` confirms that the behavior of `cluster_t::get_peers_list()` is
 correct. */
 
@@ -497,11 +532,10 @@ public:
         class dump_spectrum_writer_t : public send_message_write_callback_t {
         public:
             virtual ~dump_spectrum_writer_t() { }
-            void write(write_stream_t *stream) {
+            void write(write_message_t *msg) {
                 char spectrum[CHAR_MAX - CHAR_MIN + 1];
                 for (int i = CHAR_MIN; i <= CHAR_MAX; i++) spectrum[i - CHAR_MIN] = i;
-                int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
-                if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                msg->append(spectrum, CHAR_MAX - CHAR_MIN + 1);
             }
         } writer;
         service->send_message(peer, &writer);
@@ -546,6 +580,81 @@ TEST(RPCConnectivityTest, BinaryDataMultiThread) {
     unittest::run_in_thread_pool(&run_binary_data_test, 3);
 }
 
+/* `LargeMessage` sends messages that span many serialization buffers and are
+bigger than the socket buffers, so the gathering write has to resume partway
+through a buffer. */
+
+class large_message_application_t : public message_handler_t {
+public:
+    explicit large_message_application_t(message_service_t *s) :
+        service(s),
+        num_received(0)
+        { }
+    void send_large_message(peer_id_t peer, int seed, size_t size) {
+        class large_message_writer_t : public send_message_write_callback_t {
+        public:
+            large_message_writer_t(int _seed, size_t _size) : seed(_seed), size(_size) { }
+            virtual ~large_message_writer_t() { }
+            void write(write_message_t *msg) {
+                *msg << static_cast<int32_t>(seed);
+                *msg << static_cast<uint64_t>(size);
+                for (size_t i = 0; i < size; ++i) {
+                    char c = static_cast<char>((i * 31 + seed) & 0xff);
+                    msg->append(&c, 1);
+                }
+            }
+            int seed;
+            size_t size;
+        } writer(seed, size);
+        service->send_message(peer, &writer);
+    }
+    void on_message(peer_id_t, string_read_stream_t *stream) {
+        int32_t seed;
+        uint64_t size;
+        if (deserialize(stream, &seed) || deserialize(stream, &size)) {
+            throw fake_archive_exc_t();
+        }
+        std::vector<char> data(size);
+        int64_t res = force_read(stream, data.data(), size);
+        if (res != static_cast<int64_t>(size)) { throw fake_archive_exc_t(); }
+
+        EXPECT_EQ(num_received, seed);
+        for (size_t i = 0; i < size; ++i) {
+            EXPECT_EQ(static_cast<char>((i * 31 + seed) & 0xff), data[i]);
+        }
+        ++num_received;
+    }
+    message_service_t *service;
+    int num_received;
+};
+
+void run_large_message_test() {
+
+    connectivity_cluster_t c1, c2;
+    large_message_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a1, 0, NULL);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &a2, 0, NULL);
+    cr1.join(c2.get_peer_address(c2.get_me()));
+
+    let_stuff_happen();
+
+    const size_t sizes[] = { 4 * MEGABYTE, 0, 100 * KILOBYTE + 7, 4 * MEGABYTE + 1 };
+    const int num_messages = sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < num_messages; ++i) {
+        a1.send_large_message(c2.get_me(), i, sizes[i]);
+    }
+
+    let_stuff_happen();
+
+    EXPECT_EQ(num_messages, a2.num_received);
+}
+TEST(RPCConnectivityTest, LargeMessage) {
+    unittest::run_in_thread_pool(&run_large_message_test);
+}
+TEST(RPCConnectivityTest, LargeMessageMultiThread) {
+    unittest::run_in_thread_pool(&run_large_message_test, 3);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 
 void run_peer_id_semantics_test() {
@@ -22,11 +22,8 @@ private:
     class write_impl_t : public mailbox_write_callback_t {
     public:
         explicit write_impl_t(int _arg) : arg(_arg) { }
-        void write(write_stream_t *stream) {
-            write_message_t msg;
-            msg << arg;
-            int res = send_write_message(stream, &msg);
-            if (res) { throw fake_archive_exc_t(); }
+        void write(write_message_t *msg) {
+            *msg << arg;
         }
     private:
         friend class read_impl_t;
@@ -56,6 +53,9 @@ public:
     void expect(int message) {
         EXPECT_EQ(1u, inbox.count(message));
     }
+    void expect_undelivered(int message) {
+        EXPECT_EQ(0u, inbox.count(message));
+    }
     raw_mailbox_t mailbox;
 };
 
@@ -143,6 +143,38 @@ TEST(RPCMailboxTest, DeadMailbox) {
 TEST(RPCMailboxTest, DeadMailboxMultiThread) {
     unittest::run_in_thread_pool(&run_dead_mailbox_test, 3);
 }
+
+/* `ReusedMailbox` sends a message to a defunct mailbox after a new mailbox has
+been created in its place. The new mailbox must not get the message. */
+
+void run_reused_mailbox_test() {
+    connectivity_cluster_t c1, c2;
+    mailbox_manager_t m1(&c1), m2(&c2);
+    connectivity_cluster_t::run_t r1(&c1, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m1, 0, NULL);
+    connectivity_cluster_t::run_t r2(&c2, get_unittest_addresses(), peer_address_t(), ANY_PORT, &m2, 0, NULL);
+    r1.join(c2.get_peer_address(c2.get_me()));
+    let_stuff_happen();
+
+    raw_mailbox_t::address_t old_address;
+    {
+        dummy_mailbox_t mbox(&m1);
+        old_address = mbox.mailbox.get_address();
+    }
+
+    dummy_mailbox_t mbox(&m1);
+    send(&m1, old_address, 12345);
+    send(&m2, old_address, 78888);
+    send(&m2, mbox.mailbox.get_address(), 5);
+
+    let_stuff_happen();
+
+    mbox.expect_undelivered(12345);
+    mbox.expect_undelivered(78888);
+    mbox.expect(5);
+}
+TEST(RPCMailboxTest, ReusedMailbox) {
+    unittest::run_in_thread_pool(&run_reused_mailbox_test);
+}
 /* `MailboxAddressSemantics` makes sure that `raw_mailbox_t::address_t` behaves as
 expected. */
 
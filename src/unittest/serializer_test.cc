@@ -1,7 +1,17 @@
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/starter.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/cond_var.hpp"
+#include "perfmon/core.hpp"
 #include "serializer/config.hpp"
 #include "unittest/mock_file.hpp"
 #include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
 
 namespace unittest {
 
@@ -20,5 +30,261 @@ TEST(SerializerTest, CreateConstructDestroy) {
     run_in_thread_pool(run_CreateConstructDestroy, 4);
 }
 
+/* The tests below write blocks whose contents depend on their block id and on how
+many times they've been rewritten, so that they can be checked again after the file
+is reopened. Even blocks are easy to compress and odd ones are random. Only the even
+ones get rewritten. */
+
+void fill_test_block(block_id_t block_id, int version, uint32_t size, char *data) {
+    if (block_id % 2 == 0) {
+        for (uint32_t i = 0; i < size; ++i) {
+            data[i] = 'a' + ((block_id + version + i / 64) % 26);
+        }
+    } else {
+        uint32_t x = block_id * 2654435761U + 1;
+        for (uint32_t i = 0; i < size; ++i) {
+            x = x * 1103515245U + 12345U;
+            data[i] = static_cast<char>(x >> 24);
+        }
+    }
+}
+
+void write_test_block(standard_serializer_t *ser, block_id_t block_id, int version) {
+    scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+    fill_test_block(block_id, version, ser->get_block_size().value(), buf->cache_data);
+
+    index_write_op_t op(block_id);
+    op.token = serializer_block_write(ser, buf.get(), ser->get_block_size(),
+                                      block_id, DEFAULT_DISK_ACCOUNT);
+    op.recency = repli_timestamp_t::distant_past;
+    serializer_index_write(ser, op, DEFAULT_DISK_ACCOUNT);
+}
+
+// Writes every block, then rewrites the even ones `num_rewrites` times. In between,
+// the first extents stop being young, so that the GC can pick them.
+void write_test_blocks(standard_serializer_t *ser, int num_blocks, int num_rewrites) {
+    for (block_id_t block_id = 0; block_id < static_cast<block_id_t>(num_blocks); ++block_id) {
+        write_test_block(ser, block_id, 0);
+    }
+
+    nap(GC_YOUNG_EXTENT_TIMELIMIT_MICROS / 1000 * 2);
+
+    for (int version = 1; version <= num_rewrites; ++version) {
+        for (block_id_t block_id = 0; block_id < static_cast<block_id_t>(num_blocks); block_id += 2) {
+            write_test_block(ser, block_id, version);
+        }
+    }
+}
+
+void check_test_blocks(standard_serializer_t *ser, int num_blocks, int num_rewrites) {
+    ASSERT_EQ(static_cast<block_id_t>(num_blocks), ser->max_block_id());
+    std::vector<char> expected(ser->get_block_size().value());
+    for (block_id_t block_id = 0; block_id < static_cast<block_id_t>(num_blocks); ++block_id) {
+        counted_t<standard_block_token_t> token = ser->index_read(block_id);
+        ASSERT_TRUE(token.has());
+        ASSERT_EQ(ser->get_block_size().ser_value(), token->block_size().ser_value());
+        scoped_malloc_t<ser_buffer_t> buf = ser->malloc();
+        ser->block_read(token, buf.get(), DEFAULT_DISK_ACCOUNT);
+        ASSERT_EQ(block_id, buf->ser_header.block_id);
+        fill_test_block(block_id, block_id % 2 == 0 ? num_rewrites : 0,
+                        expected.size(), expected.data());
+        ASSERT_EQ(0, memcmp(expected.data(), buf->cache_data, expected.size()));
+    }
+}
+
+/* Lots of concurrent index writes, which the serializer commits in groups. */
+
+const int num_group_commit_writes = 200;
+
+void group_commit_write(standard_serializer_t *ser, block_id_t block_id,
+                        int *remaining, cond_t *done) {
+    write_test_block(ser, block_id, 0);
+    --*remaining;
+    if (*remaining == 0) {
+        done->pulse();
+    }
+}
+
+void run_group_commit_test(int window_ms, int max_writes,
+                           int min_metablock_writes, int max_metablock_writes) {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+
+    standard_serializer_t::dynamic_config_t config;
+    config.group_commit_window_ms = window_ms;
+    config.group_commit_max_writes = max_writes;
+
+    {
+        perfmon_collection_t stats;
+        standard_serializer_t ser(config, &file_opener, &stats);
+        const int64_t index_writes
+            = get_stat_counter(&stats, "serializer", "serializer_index_writes");
+        const int64_t metablock_writes
+            = get_stat_counter(&stats, "serializer", "serializer_metablock_writes");
+
+        int remaining = num_group_commit_writes;
+        cond_t done;
+        for (block_id_t block_id = 0; block_id < num_group_commit_writes; ++block_id) {
+            coro_t::spawn_sometime(std::bind(&group_commit_write, &ser, block_id,
+                                             &remaining, &done));
+        }
+        done.wait();
+
+        // Every index write went into exactly one group, and each group got one
+        // metablock write.
+        ASSERT_EQ(index_writes + num_group_commit_writes,
+                  get_stat_counter(&stats, "serializer", "serializer_index_writes"));
+        const int64_t groups
+            = get_stat_counter(&stats, "serializer", "serializer_metablock_writes")
+            - metablock_writes;
+        ASSERT_LE(min_metablock_writes, groups);
+        ASSERT_GE(max_metablock_writes, groups);
+
+        check_test_blocks(&ser, num_group_commit_writes, 0);
+    }
+
+    // Everything must have made it into a metablock.
+    standard_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+    check_test_blocks(&ser, num_group_commit_writes, 0);
+}
+
+// The writes that finish while the first group's metablock is being written all
+// share the second one.
+TEST(SerializerTest, GroupCommit) {
+    run_in_thread_pool(std::bind(&run_group_commit_test, 0, DEFAULT_GROUP_COMMIT_MAX_WRITES,
+                                 1, 5), 4);
+}
+
+// Groups are held open until they have 16 writes.
+TEST(SerializerTest, GroupCommitWindow) {
+    run_in_thread_pool(std::bind(&run_group_commit_test, 5, 16,
+                                 (num_group_commit_writes + 15) / 16, 20), 4);
+}
+
+TEST(SerializerTest, GroupCommitSingleWrites) {
+    run_in_thread_pool(std::bind(&run_group_commit_test, 0, 1,
+                                 num_group_commit_writes, num_group_commit_writes), 4);
+}
+
+/* Half of the blocks get rewritten over and over while the rest sit still, so the
+extents they started out in fill up with garbage and get GCed, while the rewrites
+go into hot extents of their own. */
+
+const int num_hot_cold_blocks = 1024;
+const int num_hot_rewrites = 3;
+
+void run_hot_cold_gc_test() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::static_config_t static_config;
+    standard_serializer_t::create(&file_opener, static_config);
+
+    {
+        perfmon_collection_t stats;
+        standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                                  &file_opener, &stats);
+        write_test_blocks(&ser, num_hot_cold_blocks, num_hot_rewrites);
+        check_test_blocks(&ser, num_hot_cold_blocks, num_hot_rewrites);
+
+        // Half of what the first writes put into the first extents became garbage,
+        // which is more than enough to start the GC.
+        ASSERT_LT(0, get_stat_counter(&stats, "serializer", "serializer_data_extents_gced"));
+
+        // New blocks are warm, and blocks rewritten right after their last write
+        // are hot. Nothing has been around for long enough to be cold, except for
+        // what the GC moves out of a warm extent.
+        ASSERT_LT(0, get_stat_counter(&stats, "serializer", "serializer_warm_bytes_written"));
+        ASSERT_LT(0, get_stat_counter(&stats, "serializer", "serializer_hot_bytes_written"));
+        ASSERT_EQ(0, get_stat_counter(&stats, "serializer", "serializer_cold_bytes_written"));
+
+        // The blocks that keep getting rewritten don't share extents with the ones
+        // that don't, wherever the GC has put the latter.
+        std::set<int64_t> hot_extents, other_extents;
+        for (block_id_t block_id = 0; block_id < num_hot_cold_blocks; ++block_id) {
+            counted_t<standard_block_token_t> token = ser.index_read(block_id);
+            const int64_t extent = token->offset() / static_config.extent_size();
+            (block_id % 2 == 0 ? hot_extents : other_extents).insert(extent);
+        }
+        for (auto it = hot_extents.begin(); it != hot_extents.end(); ++it) {
+            ASSERT_EQ(0u, other_extents.count(*it)) << "extent " << *it;
+        }
+    }
+
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener, &get_global_perfmon_collection());
+    check_test_blocks(&ser, num_hot_cold_blocks, num_hot_rewrites);
+}
+
+TEST(SerializerTest, HotColdGC) {
+    run_in_thread_pool(run_hot_cold_gc_test, 4);
+}
+
+/* With compression turned on, the even blocks get compressed. They get rewritten
+so that the GC has to move the compressed blocks around, and the database is
+reopened without compression. */
+
+const int num_compression_blocks = 512;
+const int num_compression_rewrites = 3;
+
+#ifdef HAVE_LZ4
+void run_compression_test() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::create(&file_opener, standard_serializer_t::static_config_t());
+
+    standard_serializer_t::dynamic_config_t config;
+    config.block_compression = BLOCK_COMPRESSION_LZ4;
+
+    {
+        standard_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+        write_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+
+        // The compressible blocks take up less than a block on disk.
+        counted_t<standard_block_token_t> even = ser.index_read(0);
+        counted_t<standard_block_token_t> odd = ser.index_read(1);
+        ASSERT_LT(even->disk_block_size().ser_value(), ser.get_block_size().ser_value());
+        ASSERT_EQ(odd->disk_block_size().ser_value(), ser.get_block_size().ser_value());
+
+        check_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+    }
+
+    // Compressed blocks can still be read with compression turned off.
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener, &get_global_perfmon_collection());
+    check_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+}
+
+TEST(SerializerTest, Compression) {
+    run_in_thread_pool(run_compression_test, 4);
+}
+#endif  // HAVE_LZ4
+
+/* Tables can be created with bigger blocks than the default. The compression test's
+blocks work just as well at that size, and get GCed the same way. (Without LZ4 the
+blocks just aren't compressed.) */
+void run_large_block_test() {
+    mock_file_opener_t file_opener;
+    standard_serializer_t::static_config_t static_config;
+    static_config.block_size_ = MAX_BTREE_BLOCK_SIZE;
+    standard_serializer_t::create(&file_opener, static_config);
+
+    standard_serializer_t::dynamic_config_t config;
+    config.block_compression = BLOCK_COMPRESSION_LZ4;
+
+    {
+        standard_serializer_t ser(config, &file_opener, &get_global_perfmon_collection());
+        ASSERT_EQ(static_cast<uint32_t>(MAX_BTREE_BLOCK_SIZE), ser.get_block_size().ser_value());
+        write_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+        check_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+    }
+
+    // The block size comes from the file, not from the config we open it with.
+    standard_serializer_t ser(standard_serializer_t::dynamic_config_t(),
+                              &file_opener, &get_global_perfmon_collection());
+    ASSERT_EQ(static_cast<uint32_t>(MAX_BTREE_BLOCK_SIZE), ser.get_block_size().ser_value());
+    check_test_blocks(&ser, num_compression_blocks, num_compression_rewrites);
+}
+
+TEST(SerializerTest, LargeBlocks) {
+    run_in_thread_pool(run_large_block_test, 4);
+}
 
 }  // namespace unittest
@@ -3,11 +3,17 @@
 
 #include <stdlib.h>
 
+#include <functional>
+
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
 #include "arch/timing.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
 #include "arch/runtime/starter.hpp"
+#include "concurrency/pmap.hpp"
+#include "perfmon/core.hpp"
 #include "unittest/gtest.hpp"
 #include "utils.hpp"
 
@@ -70,4 +76,34 @@ void run_in_thread_pool(const boost::function<void()>& fun, int num_workers) {
     ::run_in_thread_pool(fun, num_workers);
 }
 
+void visit_stats_on_thread(perfmon_collection_t *stats, void *context, int thread) {
+    on_thread_t th((threadnum_t(thread)));
+    stats->visit_stats(context);
+}
+
+const perfmon_result_t *find_stat_result(const perfmon_result_t *map,
+                                         const std::string &name) {
+    auto it = map->get_map()->find(name);
+    guarantee(it != map->get_map()->end(), "no stat named %s", name.c_str());
+    return it->second;
+}
+
+int64_t get_stat_counter(perfmon_collection_t *stats, const std::string &section,
+                         const std::string &name) {
+    void *context = stats->begin_stats();
+    pmap(get_num_threads(), std::bind(&visit_stats_on_thread, stats, context,
+                                      std::placeholders::_1));
+    scoped_ptr_t<perfmon_result_t> result = stats->end_stats(context);
+
+    const perfmon_result_t *value
+        = find_stat_result(find_stat_result(result.get(), section), name);
+    if (value->is_map()) {
+        value = find_stat_result(value, "total");
+    }
+
+    int64_t ret;
+    guarantee(strtoi64_strict(*value->get_string(), 10, &ret));
+    return ret;
+}
+
 }  // namespace unittest
@@ -12,6 +12,8 @@
 #include "rpc/serialize_macros.hpp"
 #include "arch/address.hpp"
 
+class perfmon_collection_t;
+
 namespace unittest {
 
 serializer_filepath_t make_unittest_filepaths(const std::string &permanent_path,
@@ -35,6 +37,12 @@ std::set<ip_address_t> get_unittest_addresses();
 
 void run_in_thread_pool(const boost::function<void()>& fun, int num_workers = 1);
 
+// Reads the counter `name` in the `section` that is registered in `stats`, collecting
+// it from every thread. Duration samplers are read by how many times they've been
+// started.
+int64_t get_stat_counter(perfmon_collection_t *stats, const std::string &section,
+                         const std::string &name);
+
 }  // namespace unittest
 
 #endif /* UNITTEST_UNITTEST_UTILS_HPP_ */
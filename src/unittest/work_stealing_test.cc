@@ -0,0 +1,144 @@
+// Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/bind.hpp>
+
+#include "arch/runtime/runtime.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "containers/scoped.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+/* Each job spins for a while, records which thread it ran on, and wakes up the
+spawner when it is the last one to finish. */
+
+struct spin_job_t {
+    spin_job_t(int _spin_iterations, int *_runs_per_thread, int *_remaining, coro_t *_waiter)
+        : spin_iterations(_spin_iterations), runs_per_thread(_runs_per_thread),
+          remaining(_remaining), waiter(_waiter) { }
+    void operator()() const {
+        volatile int sink = 0;
+        for (int i = 0; i < spin_iterations; ++i) {
+            sink += i;
+        }
+        __sync_fetch_and_add(&runs_per_thread[get_thread_id().threadnum], 1);
+        if (__sync_sub_and_fetch(remaining, 1) == 0) {
+            waiter->notify_sometime();
+        }
+    }
+    int spin_iterations;
+    int *runs_per_thread;
+    int *remaining;
+    coro_t *waiter;
+};
+
+// Spawns `num_jobs` stealable jobs from thread 0 and waits for them to finish.
+void run_spin_jobs(int num_jobs, int spin_iterations, scoped_array_t<int> *runs_per_thread) {
+    runs_per_thread->init(get_num_threads());
+    for (int i = 0; i < get_num_threads(); ++i) {
+        (*runs_per_thread)[i] = 0;
+    }
+
+    int remaining = num_jobs;
+    for (int i = 0; i < num_jobs; ++i) {
+        coro_t::spawn_stealable(spin_job_t(spin_iterations, runs_per_thread->data(),
+                                           &remaining, coro_t::self()));
+    }
+    coro_t::wait();
+}
+
+void run_spawn_stealable_test() {
+    const int num_jobs = 5000;
+
+    scoped_array_t<int> runs_per_thread;
+    run_spin_jobs(num_jobs, 10000, &runs_per_thread);
+
+    int total = 0;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        total += runs_per_thread[i];
+    }
+    EXPECT_EQ(num_jobs, total);
+}
+
+TEST(WorkStealingTest, SpawnStealable) {
+    coro_t::set_work_stealing(true);
+    run_in_thread_pool(&run_spawn_stealable_test, 4);
+    coro_t::set_work_stealing(false);
+}
+
+TEST(WorkStealingTest, SpawnStealableWithoutStealing) {
+    run_in_thread_pool(&run_spawn_stealable_test, 4);
+}
+
+struct sum_job_t {
+    sum_job_t(const std::vector<int> *_values, int *_sum_out)
+        : values(_values), sum_out(_sum_out) { }
+    void operator()() const {
+        int sum = 0;
+        for (size_t i = 0; i < values->size(); ++i) {
+            sum += (*values)[i];
+        }
+        *sum_out = sum;
+    }
+    const std::vector<int> *values;
+    int *sum_out;
+};
+
+void run_run_stealable_test() {
+    std::vector<int> values;
+    for (int i = 1; i <= 1000; ++i) {
+        values.push_back(i);
+    }
+
+    const threadnum_t thread = get_thread_id();
+    for (int i = 0; i < 100; ++i) {
+        int sum = 0;
+        coro_t::run_stealable(sum_job_t(&values, &sum));
+        EXPECT_EQ(500500, sum);
+        EXPECT_EQ(thread.threadnum, get_thread_id().threadnum);
+    }
+}
+
+TEST(WorkStealingTest, RunStealable) {
+    coro_t::set_work_stealing(true);
+    run_in_thread_pool(&run_run_stealable_test, 4);
+    coro_t::set_work_stealing(false);
+}
+
+/* `ShutdownWithStolenCoroutines` returns while the coroutines it spawned are
+still being stolen, and checks that the thread pool lets every one of them finish
+before it shuts down. The jobs hop over to thread 0 and back, so a thread that
+has nothing of its own left to do still has to wait for them. */
+
+struct homing_job_t {
+    explicit homing_job_t(int *_finished) : finished(_finished) { }
+    void operator()() const {
+        volatile int sink = 0;
+        for (int i = 0; i < 10000; ++i) {
+            sink += i;
+        }
+        on_thread_t thread_switcher((threadnum_t(0)));
+        __sync_fetch_and_add(finished, 1);
+    }
+    int *finished;
+};
+
+void run_shutdown_test(int num_jobs, int *finished) {
+    for (int i = 0; i < num_jobs; ++i) {
+        coro_t::spawn_stealable(homing_job_t(finished));
+    }
+}
+
+TEST(WorkStealingTest, ShutdownWithStolenCoroutines) {
+    const int num_jobs = 1000;
+    int finished = 0;
+    coro_t::set_work_stealing(true);
+    run_in_thread_pool(boost::bind(&run_shutdown_test, num_jobs, &finished), 4);
+    coro_t::set_work_stealing(false);
+    EXPECT_EQ(num_jobs, finished);
+}
+
+}  // namespace unittest